@@ -0,0 +1,75 @@
+/**
+ * @file alloc.c
+ * @brief Implementation of the checked allocation helpers.
+ *
+ * Every allocation that the program cannot go on without goes through these
+ * wrappers, so the out of memory report lives in one place.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "alloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Reports that there is no memory left and ends the program.
+ */
+void exitWithoutMemory(void) {
+  printf("No memory\n");
+  exit(1);
+}
+
+/**
+ * @brief Allocates a block of memory, ending the program if there is none.
+ *
+ * @param size The number of bytes to allocate.
+ * @return void* The allocated block.
+ */
+void *allocateOrExit(size_t size) {
+  void *block = malloc(size);
+  if (block == NULL)
+    exitWithoutMemory();
+  return block;
+}
+
+/**
+ * @brief Allocates a zeroed array, ending the program if there is no memory.
+ *
+ * @param count The number of elements.
+ * @param size The size of each element.
+ * @return void* The allocated array.
+ */
+void *zeroAllocateOrExit(size_t count, size_t size) {
+  void *block = calloc(count, size);
+  if (block == NULL)
+    exitWithoutMemory();
+  return block;
+}
+
+/**
+ * @brief Resizes a block of memory, ending the program if there is none.
+ *
+ * @param block The block to resize (may be NULL).
+ * @param size The new size in bytes.
+ * @return void* The resized block.
+ */
+void *reallocateOrExit(void *block, size_t size) {
+  void *grown = realloc(block, size);
+  if (grown == NULL)
+    exitWithoutMemory();
+  return grown;
+}
+
+/**
+ * @brief Copies a string into newly allocated memory, ending the program if
+ * there is none.
+ *
+ * @param text The string to copy.
+ * @return char* The copy.
+ */
+char *duplicateOrExit(const char *text) {
+  size_t size = strlen(text) + 1;
+  return (char *)memcpy(allocateOrExit(size), text, size);
+}
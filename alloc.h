@@ -0,0 +1,58 @@
+/**
+ * @file alloc.h
+ * @brief Header file for the checked allocation helpers.
+ *
+ * This file contains the declarations of the wrappers around the standard
+ * allocation functions used by every module. Running out of memory is not
+ * recoverable here, so each wrapper reports it and ends the program instead
+ * of returning NULL.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stdlib.h>
+
+/**
+ * @brief Reports that there is no memory left and ends the program.
+ */
+void exitWithoutMemory(void);
+
+/**
+ * @brief Allocates a block of memory, ending the program if there is none.
+ *
+ * @param size The number of bytes to allocate.
+ * @return void* The allocated block.
+ */
+void *allocateOrExit(size_t size);
+
+/**
+ * @brief Allocates a zeroed array, ending the program if there is no memory.
+ *
+ * @param count The number of elements.
+ * @param size The size of each element.
+ * @return void* The allocated array.
+ */
+void *zeroAllocateOrExit(size_t count, size_t size);
+
+/**
+ * @brief Resizes a block of memory, ending the program if there is none.
+ *
+ * @param block The block to resize (may be NULL).
+ * @param size The new size in bytes.
+ * @return void* The resized block.
+ */
+void *reallocateOrExit(void *block, size_t size);
+
+/**
+ * @brief Copies a string into newly allocated memory, ending the program if
+ * there is none.
+ *
+ * @param text The string to copy.
+ * @return char* The copy.
+ */
+char *duplicateOrExit(const char *text);
+
+#endif
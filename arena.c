@@ -0,0 +1,148 @@
+/**
+ * @file arena.c
+ * @brief Implementation of the per-command scratch arena.
+ *
+ * Allocations are carved from one main block. When it runs out, extra blocks
+ * are taken from malloc until the next reset, which then replaces the main
+ * block with one large enough for all of them. Once the workload's largest
+ * command has run, the arena stops calling malloc.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "arena.h"
+#include "alloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Initializes an empty arena.
+ *
+ * @param arena The arena.
+ */
+void initializeArena(ScratchArena *arena) {
+  arena->data = NULL;
+  arena->used = 0;
+  arena->capacity = 0;
+  arena->overflow = NULL;
+  arena->overflowBytes = 0;
+  arena->peak = 0;
+}
+
+/**
+ * @brief Rounds a size up to a multiple of ARENA_ALIGNMENT.
+ *
+ * @param size The size.
+ * @return size_t The rounded size.
+ */
+static size_t alignSize(size_t size) {
+  return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+/**
+ * @brief Frees the overflow blocks of an arena.
+ *
+ * @param arena The arena.
+ */
+static void freeOverflow(ScratchArena *arena) {
+  while (arena->overflow != NULL) {
+    ArenaBlock *next = arena->overflow->next;
+    free(arena->overflow);
+    arena->overflow = next;
+  }
+}
+
+/**
+ * @brief Allocates a block for a request that does not fit in the main
+ * block.
+ *
+ * @param arena The arena.
+ * @param size The number of bytes, already aligned.
+ * @return void* The memory.
+ */
+static void *allocateOverflow(ScratchArena *arena, size_t size) {
+  size_t header = alignSize(sizeof(ArenaBlock));
+  ArenaBlock *block = (ArenaBlock *)allocateOrExit(header + size);
+  block->size = size;
+  block->next = arena->overflow;
+  arena->overflow = block;
+  arena->overflowBytes += size;
+  return (char *)block + header;
+}
+
+/**
+ * @brief Allocates memory that lives until the arena is reset.
+ *
+ * @param arena The arena.
+ * @param size The number of bytes.
+ * @return void* The memory, aligned to ARENA_ALIGNMENT.
+ */
+void *arenaAlloc(ScratchArena *arena, size_t size) {
+  size = alignSize(size);
+  if (size > arena->capacity - arena->used)
+    return allocateOverflow(arena, size);
+  void *memory = arena->data + arena->used;
+  arena->used += size;
+  return memory;
+}
+
+/**
+ * @brief Copies a string into the arena.
+ *
+ * @param arena The arena.
+ * @param text The string.
+ * @return char* The copy.
+ */
+char *arenaStrdup(ScratchArena *arena, const char *text) {
+  return arenaStrndup(arena, text, strlen(text));
+}
+
+/**
+ * @brief Copies the first bytes of a string into the arena.
+ *
+ * @param arena The arena.
+ * @param text The string.
+ * @param length The number of bytes to copy.
+ * @return char* The null-terminated copy.
+ */
+char *arenaStrndup(ScratchArena *arena, const char *text, size_t length) {
+  char *copy = (char *)arenaAlloc(arena, length + 1);
+  memcpy(copy, text, length);
+  copy[length] = '\0';
+  return copy;
+}
+
+/**
+ * @brief Releases everything allocated from the arena. If the main block was
+ * too small, it grows so the same work fits next time.
+ *
+ * @param arena The arena.
+ */
+void resetArena(ScratchArena *arena) {
+  size_t total = arena->used + arena->overflowBytes;
+  if (total > arena->peak)
+    arena->peak = total;
+  freeOverflow(arena);
+  if (arena->overflowBytes > 0) {
+    size_t capacity = arena->capacity ? arena->capacity : 4096;
+    while (capacity < total)
+      capacity *= 2;
+    free(arena->data);
+    arena->data = (char *)allocateOrExit(capacity);
+    arena->capacity = capacity;
+  }
+  arena->used = 0;
+  arena->overflowBytes = 0;
+}
+
+/**
+ * @brief Frees the memory used by the arena, leaving it empty.
+ *
+ * @param arena The arena.
+ */
+void freeArena(ScratchArena *arena) {
+  freeOverflow(arena);
+  free(arena->data);
+  initializeArena(arena);
+}
@@ -0,0 +1,85 @@
+/**
+ * @file arena.h
+ * @brief Header file for the per-command scratch arena.
+ *
+ * This file contains the declarations of a bump-pointer arena for the
+ * allocations that do not outlive a command. Everything allocated from it is
+ * released at once when the command ends.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdio.h>
+
+#define ARENA_ALIGNMENT 16
+
+// Structure for a block allocated when the arena's main block is full
+typedef struct ArenaBlock {
+  struct ArenaBlock *next; // Next overflow block
+  size_t size;             // Usable bytes after the header
+} ArenaBlock;
+
+// Structure for a scratch arena
+typedef struct {
+  char *data;              // Main block
+  size_t used;             // Bytes handed out from the main block
+  size_t capacity;         // Size of the main block
+  ArenaBlock *overflow;    // Blocks allocated since the last reset
+  size_t overflowBytes;    // Bytes handed out from the overflow blocks
+  size_t peak;             // Most bytes used by a single command
+} ScratchArena;
+
+/**
+ * @brief Initializes an empty arena.
+ *
+ * @param arena The arena.
+ */
+void initializeArena(ScratchArena *arena);
+
+/**
+ * @brief Allocates memory that lives until the arena is reset.
+ *
+ * @param arena The arena.
+ * @param size The number of bytes.
+ * @return void* The memory, aligned to ARENA_ALIGNMENT.
+ */
+void *arenaAlloc(ScratchArena *arena, size_t size);
+
+/**
+ * @brief Copies a string into the arena.
+ *
+ * @param arena The arena.
+ * @param text The string.
+ * @return char* The copy.
+ */
+char *arenaStrdup(ScratchArena *arena, const char *text);
+
+/**
+ * @brief Copies the first bytes of a string into the arena.
+ *
+ * @param arena The arena.
+ * @param text The string.
+ * @param length The number of bytes to copy.
+ * @return char* The null-terminated copy.
+ */
+char *arenaStrndup(ScratchArena *arena, const char *text, size_t length);
+
+/**
+ * @brief Releases everything allocated from the arena. If the main block was
+ * too small, it grows so the same work fits next time.
+ *
+ * @param arena The arena.
+ */
+void resetArena(ScratchArena *arena);
+
+/**
+ * @brief Frees the memory used by the arena, leaving it empty.
+ *
+ * @param arena The arena.
+ */
+void freeArena(ScratchArena *arena);
+
+#endif
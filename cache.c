@@ -0,0 +1,310 @@
+/**
+ * @file cache.c
+ * @brief Implementation of the cache of formatted listing results and of
+ * recently resolved users.
+ *
+ * Every command that changes a lot advances the catalog epoch, so a cached
+ * listing is valid exactly while its epoch is the current one and nothing
+ * has to be invalidated explicitly. The cache holds a fixed number of
+ * entries, replaced least recently used first, and listings larger than
+ * LIST_CACHE_MAX_BYTES are not kept.
+ *
+ * User entries never move while they exist (the user table does not
+ * resize), so a cached user only has to be dropped when its entry is freed.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "cache.h"
+#include "alloc.h"
+#include "project.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Initializes an empty text buffer.
+ *
+ * @param buffer The text buffer.
+ */
+void initializeTextBuffer(TextBuffer *buffer) {
+  buffer->data = NULL;
+  buffer->length = 0;
+  buffer->capacity = 0;
+  buffer->arena = NULL;
+}
+
+/**
+ * @brief Initializes an empty text buffer whose text lives in an arena, for
+ * output that is written before the arena is reset.
+ *
+ * @param buffer The text buffer.
+ * @param arena The arena.
+ */
+void initializeScratchText(TextBuffer *buffer, ScratchArena *arena) {
+  initializeTextBuffer(buffer);
+  buffer->arena = arena;
+}
+
+/**
+ * @brief Makes room for more text at the end of a buffer.
+ *
+ * @param buffer The text buffer.
+ * @param extra The number of bytes to append.
+ * @return char* Where the new text must be written (with room for a null
+ * terminator after it).
+ */
+char *reserveText(TextBuffer *buffer, size_t extra) {
+  size_t needed = buffer->length + extra + 1;
+  if (needed > buffer->capacity) {
+    size_t newCapacity = buffer->capacity ? buffer->capacity * 2 : 256;
+    while (newCapacity < needed)
+      newCapacity *= 2;
+    if (buffer->arena == NULL) {
+      buffer->data = (char *)reallocateOrExit(buffer->data, newCapacity);
+    } else {
+      // The old text is left in the arena until it is reset
+      char *grown = (char *)arenaAlloc(buffer->arena, newCapacity);
+      if (buffer->data != NULL)
+        memcpy(grown, buffer->data, buffer->length + 1);
+      buffer->data = grown;
+    }
+    buffer->capacity = newCapacity;
+  }
+  return buffer->data + buffer->length;
+}
+
+/**
+ * @brief Appends a string to a text buffer.
+ *
+ * @param buffer The text buffer.
+ * @param text The string to append.
+ */
+void appendText(TextBuffer *buffer, const char *text) {
+  size_t length = strlen(text);
+  memcpy(reserveText(buffer, length), text, length + 1);
+  buffer->length += length;
+}
+
+/**
+ * @brief Frees the memory used by a text buffer, leaving it empty.
+ *
+ * @param buffer The text buffer.
+ */
+void freeTextBuffer(TextBuffer *buffer) {
+  if (buffer->arena == NULL)
+    free(buffer->data);
+  initializeTextBuffer(buffer);
+}
+
+/**
+ * @brief Initializes an empty listing cache.
+ *
+ * @param cache The listing cache.
+ */
+void initializeListCache(ListCache *cache) {
+  for (int i = 0; i < LIST_CACHE_SIZE; i++) {
+    cache->entries[i].key = NULL;
+    initializeTextBuffer(&cache->entries[i].output);
+    cache->entries[i].epoch = 0;
+    cache->entries[i].lastUsed = 0;
+  }
+  cache->tick = 0;
+  cache->hits = 0;
+  cache->misses = 0;
+}
+
+/**
+ * @brief Finds the entry of a listing, whatever its epoch.
+ *
+ * @param cache The listing cache.
+ * @param key The arguments of the listing.
+ * @return ListCacheEntry* The entry, or NULL if there is none.
+ */
+static ListCacheEntry *findEntry(ListCache *cache, const char *key) {
+  for (int i = 0; i < LIST_CACHE_SIZE; i++) {
+    ListCacheEntry *entry = &cache->entries[i];
+    if (entry->key != NULL && strcmp(entry->key, key) == 0)
+      return entry;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Looks up the output of a listing built at the current epoch.
+ *
+ * @param cache The listing cache.
+ * @param key The arguments of the listing.
+ * @param epoch The current catalog epoch.
+ * @return const TextBuffer* The cached output, or NULL on a miss.
+ */
+const TextBuffer *findCachedListing(ListCache *cache, const char *key,
+                                    unsigned long epoch) {
+  ListCacheEntry *entry = findEntry(cache, key);
+  cache->tick++;
+  if (entry == NULL || entry->epoch != epoch) {
+    cache->misses++;
+    return NULL;
+  }
+  cache->hits++;
+  entry->lastUsed = cache->tick;
+  return &entry->output;
+}
+
+/**
+ * @brief Picks the entry to hold a listing: its current entry, a free one,
+ * or the least recently used one.
+ *
+ * @param cache The listing cache.
+ * @param key The arguments of the listing.
+ * @return ListCacheEntry* The entry to overwrite.
+ */
+static ListCacheEntry *pickEntry(ListCache *cache, const char *key) {
+  ListCacheEntry *entry = findEntry(cache, key);
+  if (entry != NULL)
+    return entry;
+  ListCacheEntry *oldest = &cache->entries[0];
+  for (int i = 0; i < LIST_CACHE_SIZE; i++) {
+    if (cache->entries[i].key == NULL)
+      return &cache->entries[i];
+    if (cache->entries[i].lastUsed < oldest->lastUsed)
+      oldest = &cache->entries[i];
+  }
+  return oldest;
+}
+
+/**
+ * @brief Stores the output of a listing, replacing an older entry for the
+ * same arguments or the least recently used one.
+ *
+ * @param cache The listing cache.
+ * @param key The arguments of the listing.
+ * @param epoch The catalog epoch the output was built at.
+ * @param output The output on the heap, whose text the cache takes over (left
+ * empty).
+ */
+void storeCachedListing(ListCache *cache, const char *key, unsigned long epoch,
+                        TextBuffer *output) {
+  if (output->length > LIST_CACHE_MAX_BYTES) {
+    freeTextBuffer(output);
+    return;
+  }
+  ListCacheEntry *entry = pickEntry(cache, key);
+  if (entry->key == NULL || strcmp(entry->key, key) != 0) {
+    free(entry->key);
+    entry->key = duplicateOrExit(key);
+  }
+  freeTextBuffer(&entry->output);
+  entry->output = *output;
+  entry->epoch = epoch;
+  entry->lastUsed = cache->tick;
+  initializeTextBuffer(output);
+}
+
+/**
+ * @brief Counts the entries and bytes held by a listing cache.
+ *
+ * @param cache The listing cache.
+ * @param bytes Pointer to store the number of bytes of cached output.
+ * @return int The number of entries in use.
+ */
+int listCacheUsage(const ListCache *cache, size_t *bytes) {
+  int used = 0;
+  *bytes = 0;
+  for (int i = 0; i < LIST_CACHE_SIZE; i++) {
+    if (cache->entries[i].key != NULL) {
+      used++;
+      *bytes += cache->entries[i].output.length;
+    }
+  }
+  return used;
+}
+
+/**
+ * @brief Frees the memory used by a listing cache, leaving it empty.
+ *
+ * @param cache The listing cache.
+ */
+void freeListCache(ListCache *cache) {
+  for (int i = 0; i < LIST_CACHE_SIZE; i++) {
+    free(cache->entries[i].key);
+    freeTextBuffer(&cache->entries[i].output);
+  }
+  initializeListCache(cache);
+}
+
+/**
+ * @brief Initializes an empty user cache.
+ *
+ * @param cache The user cache.
+ */
+void initializeUserCache(UserCache *cache) {
+  for (int i = 0; i < USER_CACHE_SIZE; i++) {
+    cache->entries[i].hash = 0;
+    cache->entries[i].user = NULL;
+  }
+  cache->hits = 0;
+  cache->misses = 0;
+}
+
+/**
+ * @brief Looks up a recently resolved user, counting the hit or miss.
+ *
+ * @param cache The user cache.
+ * @param hash The user name's 64-bit hash (see hashUserName64).
+ * @param userName The user name.
+ * @return UserIndex* The user entry, or NULL on a miss.
+ */
+UserIndex *findCachedUser(UserCache *cache, unsigned long long hash,
+                          const char *userName) {
+  UserCacheEntry *entry = &cache->entries[hash & (USER_CACHE_SIZE - 1)];
+  // The full hash rules out almost every other name before comparing
+  if (entry->user != NULL && entry->hash == hash &&
+      userHasName(entry->user, userName)) {
+    cache->hits++;
+    return entry->user;
+  }
+  cache->misses++;
+  return NULL;
+}
+
+/**
+ * @brief Stores a resolved user, replacing the entry in its slot.
+ *
+ * @param cache The user cache.
+ * @param hash The user name's 64-bit hash.
+ * @param user The user entry.
+ */
+void storeCachedUser(UserCache *cache, unsigned long long hash,
+                     UserIndex *user) {
+  UserCacheEntry *entry = &cache->entries[hash & (USER_CACHE_SIZE - 1)];
+  entry->hash = hash;
+  entry->user = user;
+}
+
+/**
+ * @brief Drops a user from the cache before its entry is freed.
+ *
+ * @param cache The user cache.
+ * @param hash The user name's 64-bit hash.
+ * @param user The user entry.
+ */
+void forgetCachedUser(UserCache *cache, unsigned long long hash,
+                      const UserIndex *user) {
+  UserCacheEntry *entry = &cache->entries[hash & (USER_CACHE_SIZE - 1)];
+  if (entry->user == user)
+    entry->user = NULL;
+}
+
+/**
+ * @brief Counts the entries in use in a user cache.
+ *
+ * @param cache The user cache.
+ * @return int The number of entries in use.
+ */
+int userCacheUsage(const UserCache *cache) {
+  int used = 0;
+  for (int i = 0; i < USER_CACHE_SIZE; i++)
+    used += cache->entries[i].user != NULL;
+  return used;
+}
@@ -0,0 +1,195 @@
+/**
+ * @file cache.h
+ * @brief Header file for the cache of formatted listing results and of
+ * recently resolved users.
+ *
+ * This file contains the declarations of a growable text buffer used to
+ * build command output, of a small cache that keeps the formatted output
+ * of recent listings together with the catalog epoch it was built at, and of
+ * a direct-mapped cache of recently resolved user entries.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "arena.h"
+#include <stdio.h>
+
+#define LIST_CACHE_SIZE 8
+#define LIST_CACHE_MAX_BYTES (1 << 20)
+#define USER_CACHE_SIZE 64 // A power of two
+
+// Structure for a growable text buffer
+typedef struct {
+  char *data;          // Text, always null-terminated when not NULL
+  size_t length;       // Number of bytes of text
+  size_t capacity;     // Current capacity of data
+  ScratchArena *arena; // Arena holding data, or NULL if it is on the heap
+} TextBuffer;
+
+// Structure for one cached listing
+typedef struct {
+  char *key;                // Arguments of the listing, or NULL if unused
+  TextBuffer output;        // Formatted output of the listing
+  unsigned long epoch;      // Catalog epoch the output was built at
+  unsigned long lastUsed;   // Tick of the last hit or store
+} ListCacheEntry;
+
+// Structure for the cache of recent listings
+typedef struct {
+  ListCacheEntry entries[LIST_CACHE_SIZE];
+  unsigned long tick;   // Increases on every lookup
+  unsigned long hits;   // Lookups answered from the cache
+  unsigned long misses; // Lookups that had to build the listing
+} ListCache;
+
+// Structure for one recently resolved user
+typedef struct {
+  unsigned long long hash;  // 64-bit hash of the user name
+  struct UserIndex *user;   // User entry, or NULL if unused
+} UserCacheEntry;
+
+// Structure for the direct-mapped cache of recently resolved users
+typedef struct {
+  UserCacheEntry entries[USER_CACHE_SIZE];
+  unsigned long hits;   // Lookups answered from the cache
+  unsigned long misses; // Lookups that had to probe the user table
+} UserCache;
+
+/**
+ * @brief Initializes an empty text buffer.
+ *
+ * @param buffer The text buffer.
+ */
+void initializeTextBuffer(TextBuffer *buffer);
+
+/**
+ * @brief Initializes an empty text buffer whose text lives in an arena, for
+ * output that is written before the arena is reset.
+ *
+ * @param buffer The text buffer.
+ * @param arena The arena.
+ */
+void initializeScratchText(TextBuffer *buffer, ScratchArena *arena);
+
+/**
+ * @brief Makes room for more text at the end of a buffer.
+ *
+ * @param buffer The text buffer.
+ * @param extra The number of bytes to append.
+ * @return char* Where the new text must be written (with room for a null
+ * terminator after it).
+ */
+char *reserveText(TextBuffer *buffer, size_t extra);
+
+/**
+ * @brief Appends a string to a text buffer.
+ *
+ * @param buffer The text buffer.
+ * @param text The string to append.
+ */
+void appendText(TextBuffer *buffer, const char *text);
+
+/**
+ * @brief Frees the memory used by a text buffer, leaving it empty.
+ *
+ * @param buffer The text buffer.
+ */
+void freeTextBuffer(TextBuffer *buffer);
+
+/**
+ * @brief Initializes an empty listing cache.
+ *
+ * @param cache The listing cache.
+ */
+void initializeListCache(ListCache *cache);
+
+/**
+ * @brief Looks up the output of a listing built at the current epoch.
+ *
+ * @param cache The listing cache.
+ * @param key The arguments of the listing.
+ * @param epoch The current catalog epoch.
+ * @return const TextBuffer* The cached output, or NULL on a miss.
+ */
+const TextBuffer *findCachedListing(ListCache *cache, const char *key,
+                                    unsigned long epoch);
+
+/**
+ * @brief Stores the output of a listing, replacing an older entry for the
+ * same arguments or the least recently used one.
+ *
+ * @param cache The listing cache.
+ * @param key The arguments of the listing.
+ * @param epoch The catalog epoch the output was built at.
+ * @param output The output on the heap, whose text the cache takes over (left
+ * empty).
+ */
+void storeCachedListing(ListCache *cache, const char *key, unsigned long epoch,
+                        TextBuffer *output);
+
+/**
+ * @brief Counts the entries and bytes held by a listing cache.
+ *
+ * @param cache The listing cache.
+ * @param bytes Pointer to store the number of bytes of cached output.
+ * @return int The number of entries in use.
+ */
+int listCacheUsage(const ListCache *cache, size_t *bytes);
+
+/**
+ * @brief Frees the memory used by a listing cache, leaving it empty.
+ *
+ * @param cache The listing cache.
+ */
+void freeListCache(ListCache *cache);
+
+/**
+ * @brief Initializes an empty user cache.
+ *
+ * @param cache The user cache.
+ */
+void initializeUserCache(UserCache *cache);
+
+/**
+ * @brief Looks up a recently resolved user, counting the hit or miss.
+ *
+ * @param cache The user cache.
+ * @param hash The user name's 64-bit hash (see hashUserName64).
+ * @param userName The user name.
+ * @return struct UserIndex* The user entry, or NULL on a miss.
+ */
+struct UserIndex *findCachedUser(UserCache *cache, unsigned long long hash,
+                                 const char *userName);
+
+/**
+ * @brief Stores a resolved user, replacing the entry in its slot.
+ *
+ * @param cache The user cache.
+ * @param hash The user name's 64-bit hash.
+ * @param user The user entry.
+ */
+void storeCachedUser(UserCache *cache, unsigned long long hash,
+                     struct UserIndex *user);
+
+/**
+ * @brief Drops a user from the cache before its entry is freed.
+ *
+ * @param cache The user cache.
+ * @param hash The user name's 64-bit hash.
+ * @param user The user entry.
+ */
+void forgetCachedUser(UserCache *cache, unsigned long long hash,
+                      const struct UserIndex *user);
+
+/**
+ * @brief Counts the entries in use in a user cache.
+ *
+ * @param cache The user cache.
+ * @return int The number of entries in use.
+ */
+int userCacheUsage(const UserCache *cache);
+
+#endif
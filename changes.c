@@ -0,0 +1,260 @@
+/**
+ * @file changes.c
+ * @brief Implementation of the change feed.
+ *
+ * This file contains the implementation of the change-data-capture feed. The
+ * program has a single writer, so the ring needs no locks: publishing only
+ * moves the count of published events forward, and a consumer that falls
+ * more than a ring behind skips to the oldest event still held and is told
+ * how many it lost. Changes made inside a branch are staged and published
+ * only when the outermost branch is committed, so consumers never see a
+ * change that is later dropped.
+ *
+ * The sink gets one record per event, little-endian: the sequence (8 bytes),
+ * the kind (1), the day number (4), the amount (4), then the batch and the
+ * user name, each preceded by its length (1 and 2 bytes) and empty when the
+ * change has none.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "changes.h"
+#include "alloc.h"
+#include "project.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Initializes an empty change feed.
+ *
+ * @param feed The change feed.
+ */
+void initializeChangeFeed(ChangeFeed *feed) {
+  feed->published = 0;
+  feed->consumerCount = 0;
+  feed->staged = NULL;
+  feed->stagedCount = 0;
+  feed->stagedCapacity = 0;
+  feed->marks = NULL;
+  feed->markCount = 0;
+  feed->markCapacity = 0;
+  feed->sink = NULL;
+}
+
+/**
+ * @brief Writes an integer to the sink in little-endian order.
+ *
+ * @param sink The sink file.
+ * @param value The integer.
+ * @param bytes The number of bytes to write.
+ */
+static void writeNumber(FILE *sink, unsigned long value, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    fputc((int)(value & 0xff), sink);
+    value >>= 8;
+  }
+}
+
+/**
+ * @brief Writes a string to the sink preceded by its length.
+ *
+ * @param sink The sink file.
+ * @param text The string (may be NULL).
+ * @param lengthBytes The number of bytes of the length.
+ */
+static void writeField(FILE *sink, const char *text, int lengthBytes) {
+  size_t length = text != NULL ? strlen(text) : 0;
+  writeNumber(sink, length, lengthBytes);
+  if (length > 0)
+    fwrite(text, 1, length, sink);
+}
+
+/**
+ * @brief Writes an event to the sink.
+ *
+ * @param sink The sink file.
+ * @param event The event.
+ */
+static void writeEvent(FILE *sink, const ChangeEvent *event) {
+  const char *batch = event->lot != NULL ? event->lot->lot : NULL;
+  char name[NUMERIC_NAME_SIZE];
+  const char *user =
+      event->user != NULL ? userNameText(event->user, name) : NULL;
+  writeNumber(sink, event->sequence, 8);
+  writeNumber(sink, (unsigned long)event->kind, 1);
+  writeNumber(sink, (unsigned int)event->day, 4);
+  writeNumber(sink, (unsigned int)event->amount, 4);
+  writeField(sink, batch, 1);
+  writeField(sink, user, 2);
+}
+
+/**
+ * @brief Publishes an event to the ring and the sink.
+ *
+ * @param feed The change feed.
+ * @param event The event.
+ */
+static void publishChange(ChangeFeed *feed, const ChangeEvent *event) {
+  ChangeEvent *slot = &feed->ring[feed->published & (CHANGE_RING_SIZE - 1)];
+  *slot = *event;
+  slot->sequence = ++feed->published;
+  if (feed->sink != NULL)
+    writeEvent(feed->sink, slot);
+}
+
+/**
+ * @brief Adds an event to the changes of the open branches.
+ *
+ * @param feed The change feed.
+ * @param event The event.
+ */
+static void stageChange(ChangeFeed *feed, const ChangeEvent *event) {
+  if (feed->stagedCount == feed->stagedCapacity) {
+    int capacity = feed->stagedCapacity > 0 ? feed->stagedCapacity * 2 : 16;
+    ChangeEvent *grown = (ChangeEvent *)reallocateOrExit(
+        feed->staged, capacity * sizeof(ChangeEvent));
+    feed->staged = grown;
+    feed->stagedCapacity = capacity;
+  }
+  feed->staged[feed->stagedCount++] = *event;
+}
+
+/**
+ * @brief Publishes a change, or stages it until its branches are committed.
+ *
+ * @param feed The change feed.
+ * @param kind The kind of change.
+ * @param day The day number the change took effect.
+ * @param amount The doses added, used or taken away.
+ * @param lot The lot that changed (may be NULL).
+ * @param user The user of the dose or deletion (may be NULL).
+ */
+void emitChange(ChangeFeed *feed, ChangeKind kind, int day, int amount,
+                const struct VaccineLot *lot, const struct UserIndex *user) {
+  ChangeEvent event = {.sequence = 0,
+                       .kind = kind,
+                       .day = day,
+                       .amount = amount,
+                       .lot = lot,
+                       .user = user};
+  if (feed->markCount > 0)
+    stageChange(feed, &event);
+  else
+    publishChange(feed, &event);
+}
+
+/**
+ * @brief Starts staging the changes of a new branch.
+ *
+ * @param feed The change feed.
+ */
+void openChangeBranch(ChangeFeed *feed) {
+  if (feed->markCount == feed->markCapacity) {
+    int capacity = feed->markCapacity > 0 ? feed->markCapacity * 2 : 8;
+    int *grown = (int *)reallocateOrExit(feed->marks, capacity * sizeof(int));
+    feed->marks = grown;
+    feed->markCapacity = capacity;
+  }
+  feed->marks[feed->markCount++] = feed->stagedCount;
+}
+
+/**
+ * @brief Discards the changes staged by the innermost branch.
+ *
+ * @param feed The change feed.
+ */
+void dropChangeBranch(ChangeFeed *feed) {
+  feed->stagedCount = feed->marks[--feed->markCount];
+}
+
+/**
+ * @brief Hands the innermost branch's changes to the enclosing branch, or
+ * publishes them if it was the outermost one.
+ *
+ * @param feed The change feed.
+ */
+void commitChangeBranch(ChangeFeed *feed) {
+  if (--feed->markCount > 0)
+    return;
+  for (int i = 0; i < feed->stagedCount; i++)
+    publishChange(feed, &feed->staged[i]);
+  feed->stagedCount = 0;
+}
+
+/**
+ * @brief Adds a consumer that reads the changes published from now on.
+ *
+ * @param feed The change feed.
+ * @return int The consumer's id, or -1 if there are too many consumers.
+ */
+int addChangeConsumer(ChangeFeed *feed) {
+  if (feed->consumerCount == CHANGE_MAX_CONSUMERS)
+    return -1;
+  feed->cursors[feed->consumerCount] = feed->published;
+  return feed->consumerCount++;
+}
+
+/**
+ * @brief Reads a consumer's next change.
+ *
+ * @param feed The change feed.
+ * @param consumer The consumer's id.
+ * @param event Pointer to store the change.
+ * @param lost Pointer to a counter of the changes overwritten before the
+ * consumer read them.
+ * @return int 1 if a change was read, 0 if the consumer is up to date.
+ */
+int readChange(ChangeFeed *feed, int consumer, ChangeEvent *event,
+               unsigned long *lost) {
+  unsigned long *cursor = &feed->cursors[consumer];
+  if (feed->published - *cursor > CHANGE_RING_SIZE) {
+    unsigned long oldest = feed->published - CHANGE_RING_SIZE;
+    *lost += oldest - *cursor;
+    *cursor = oldest;
+  }
+  if (*cursor == feed->published)
+    return 0;
+  *event = feed->ring[(*cursor)++ & (CHANGE_RING_SIZE - 1)];
+  return 1;
+}
+
+/**
+ * @brief Appends the changes published from now on to a binary file.
+ *
+ * @param feed The change feed.
+ * @param path The path of the sink file.
+ * @return int 1 on success, 0 if the file cannot be opened.
+ */
+int openChangeSink(ChangeFeed *feed, const char *path) {
+  FILE *sink = fopen(path, "ab");
+  if (sink == NULL)
+    return 0;
+  if (feed->sink != NULL)
+    fclose(feed->sink);
+  feed->sink = sink;
+  return 1;
+}
+
+/**
+ * @brief Flushes the changes written to the sink, if any.
+ *
+ * @param feed The change feed.
+ */
+void flushChangeSink(ChangeFeed *feed) {
+  if (feed->sink != NULL)
+    fflush(feed->sink);
+}
+
+/**
+ * @brief Frees the memory and closes the sink used by the change feed.
+ *
+ * @param feed The change feed.
+ */
+void freeChangeFeed(ChangeFeed *feed) {
+  if (feed->sink != NULL)
+    fclose(feed->sink);
+  free(feed->staged);
+  free(feed->marks);
+  initializeChangeFeed(feed);
+}
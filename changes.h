@@ -0,0 +1,143 @@
+/**
+ * @file changes.h
+ * @brief Header file for the change feed.
+ *
+ * This file contains the declarations of the change-data-capture feed. Every
+ * committed change is published as a small fixed-size event into a ring that
+ * any number of consumers read at their own pace through their own cursors,
+ * and can also be appended in binary to a sink file that other tools tail.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef CHANGES_H
+#define CHANGES_H
+
+#include <stdio.h>
+
+#define CHANGE_RING_SIZE 1024 // Must be a power of two
+#define CHANGE_MAX_CONSUMERS 8
+
+// Kinds of change published by the feed
+typedef enum {
+  CHANGE_DATE,          // The current date moved forward
+  CHANGE_LOT_CREATED,   // A lot was added
+  CHANGE_DOSE,          // A dose was applied
+  CHANGE_LOT_WITHDRAWN, // A lot without doses used was removed
+  CHANGE_LOT_REDUCED,   // A lot with doses used lost its remaining doses
+  CHANGE_DELETION       // An inoculation was deleted
+} ChangeKind;
+
+// Structure for one published change
+typedef struct {
+  unsigned long sequence;         // Position in the feed, from 1
+  ChangeKind kind;
+  int day;                        // Day number the change took effect
+  int amount;                     // Doses added, used or taken away
+  const struct VaccineLot *lot;   // Lot that changed, or NULL
+  const struct UserIndex *user;   // User of the dose or deletion, or NULL
+} ChangeEvent;
+
+// Structure for the change feed
+typedef struct {
+  ChangeEvent ring[CHANGE_RING_SIZE]; // The most recent events
+  unsigned long published;            // Events published so far
+  // Events each consumer has read
+  unsigned long cursors[CHANGE_MAX_CONSUMERS];
+  int consumerCount;                  // Number of consumers
+  ChangeEvent *staged;                // Events of the open branches
+  int stagedCount;                    // Number of staged events
+  int stagedCapacity;                 // Current capacity of staged
+  int *marks;                         // Staged count when each branch opened
+  int markCount;                      // Number of open branches
+  int markCapacity;                   // Current capacity of marks
+  FILE *sink;                         // Binary copy of the feed, or NULL
+} ChangeFeed;
+
+/**
+ * @brief Initializes an empty change feed.
+ *
+ * @param feed The change feed.
+ */
+void initializeChangeFeed(ChangeFeed *feed);
+
+/**
+ * @brief Publishes a change, or stages it until its branches are committed.
+ *
+ * @param feed The change feed.
+ * @param kind The kind of change.
+ * @param day The day number the change took effect.
+ * @param amount The doses added, used or taken away.
+ * @param lot The lot that changed (may be NULL).
+ * @param user The user of the dose or deletion (may be NULL).
+ */
+void emitChange(ChangeFeed *feed, ChangeKind kind, int day, int amount,
+                const struct VaccineLot *lot, const struct UserIndex *user);
+
+/**
+ * @brief Starts staging the changes of a new branch.
+ *
+ * @param feed The change feed.
+ */
+void openChangeBranch(ChangeFeed *feed);
+
+/**
+ * @brief Discards the changes staged by the innermost branch.
+ *
+ * @param feed The change feed.
+ */
+void dropChangeBranch(ChangeFeed *feed);
+
+/**
+ * @brief Hands the innermost branch's changes to the enclosing branch, or
+ * publishes them if it was the outermost one.
+ *
+ * @param feed The change feed.
+ */
+void commitChangeBranch(ChangeFeed *feed);
+
+/**
+ * @brief Adds a consumer that reads the changes published from now on.
+ *
+ * @param feed The change feed.
+ * @return int The consumer's id, or -1 if there are too many consumers.
+ */
+int addChangeConsumer(ChangeFeed *feed);
+
+/**
+ * @brief Reads a consumer's next change.
+ *
+ * @param feed The change feed.
+ * @param consumer The consumer's id.
+ * @param event Pointer to store the change.
+ * @param lost Pointer to a counter of the changes overwritten before the
+ * consumer read them.
+ * @return int 1 if a change was read, 0 if the consumer is up to date.
+ */
+int readChange(ChangeFeed *feed, int consumer, ChangeEvent *event,
+               unsigned long *lost);
+
+/**
+ * @brief Appends the changes published from now on to a binary file.
+ *
+ * @param feed The change feed.
+ * @param path The path of the sink file.
+ * @return int 1 on success, 0 if the file cannot be opened.
+ */
+int openChangeSink(ChangeFeed *feed, const char *path);
+
+/**
+ * @brief Flushes the changes written to the sink, if any.
+ *
+ * @param feed The change feed.
+ */
+void flushChangeSink(ChangeFeed *feed);
+
+/**
+ * @brief Frees the memory and closes the sink used by the change feed.
+ *
+ * @param feed The change feed.
+ */
+void freeChangeFeed(ChangeFeed *feed);
+
+#endif
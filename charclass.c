@@ -0,0 +1,56 @@
+/**
+ * @file charclass.c
+ * @brief Implementation of the character-class table used by the parsers.
+ *
+ * This file contains the table that classifies each byte by the engine's
+ * token rules and the helpers that scan whitespace and tokens with it.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "charclass.h"
+#include <stdio.h>
+
+/**
+ * @brief Gets the character-class table.
+ *
+ * The table is read-only and built at compile time.
+ *
+ * @return const unsigned char* Table with the class bits of each byte.
+ */
+const unsigned char *charClasses(void) {
+  static const unsigned char classes[256] = {
+      ['\0'] = CHAR_END,
+      ['\t'... '\r'] = CHAR_SPACE,
+      [' '] = CHAR_SPACE,
+      ['0'... '9'] = CHAR_BATCH,
+      ['A'... 'F'] = CHAR_BATCH,
+  };
+  return classes;
+}
+
+/**
+ * @brief Skips the whitespace at the start of a string.
+ *
+ * @param text The string.
+ * @return char* Pointer to the first byte that is not whitespace.
+ */
+char *skipSpaces(const char *text) {
+  const unsigned char *classes = charClasses();
+  while (classes[(unsigned char)*text] & CHAR_SPACE)
+    text++;
+  return (char *)text;
+}
+
+/**
+ * @brief Skips an unquoted token at the start of a string.
+ *
+ * @param text The string.
+ * @return char* Pointer to the whitespace or terminator after the token.
+ */
+char *skipToken(const char *text) {
+  const unsigned char *classes = charClasses();
+  while (!(classes[(unsigned char)*text] & CHAR_DELIMITER))
+    text++;
+  return (char *)text;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file charclass.h
+ * @brief Header file for the character-class table used by the parsers.
+ *
+ * This file contains the declarations of a 256-entry table that classifies
+ * each byte by the engine's token rules, and of the scanning helpers built on
+ * it, so parsers and validators test a byte with a single lookup.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef CHARCLASS_H
+#define CHARCLASS_H
+
+#define CHAR_SPACE 0x01 // Whitespace, as isspace in the C locale
+#define CHAR_END 0x02   // The string terminator
+#define CHAR_BATCH 0x04 // Digit or uppercase hexadecimal letter
+
+// Bytes that end an unquoted token
+#define CHAR_DELIMITER (CHAR_SPACE | CHAR_END)
+
+/**
+ * @brief Gets the character-class table.
+ *
+ * @return const unsigned char* Table with the class bits of each byte.
+ */
+const unsigned char *charClasses(void);
+
+/**
+ * @brief Skips the whitespace at the start of a string.
+ *
+ * @param text The string.
+ * @return char* Pointer to the first byte that is not whitespace.
+ */
+char *skipSpaces(const char *text);
+
+/**
+ * @brief Skips an unquoted token at the start of a string.
+ *
+ * @param text The string.
+ * @return char* Pointer to the whitespace or terminator after the token.
+ */
+char *skipToken(const char *text);
+
+#endif
@@ -0,0 +1,447 @@
+/**
+ * @file cohort.c
+ * @brief Implementation of compressed cohort bitmaps.
+ *
+ * Containers switch between a sorted array of low bits and a bitset as their
+ * cardinality crosses BITMAP_ARRAY_MAX, which keeps sparse cohorts small and
+ * dense cohorts at a fixed 8 KB per 65536 ids. Set operations work container
+ * by container, so containers present in only one operand are never expanded.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "cohort.h"
+#include "alloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Initializes an empty bitmap.
+ *
+ * @param bitmap The bitmap to initialize.
+ */
+void initializeBitmap(CohortBitmap *bitmap) {
+  bitmap->containers = NULL;
+  bitmap->count = 0;
+  bitmap->capacity = 0;
+}
+
+/**
+ * @brief Finds a container by key with a binary search.
+ *
+ * @param bitmap The bitmap.
+ * @param key The high 16 bits of an id.
+ * @param found Pointer to store 1 if the container exists, 0 otherwise.
+ * @return int The container's index, or where it should be inserted.
+ */
+static int findContainer(const CohortBitmap *bitmap, unsigned int key,
+                         int *found) {
+  int low = 0, high = bitmap->count - 1;
+  while (low <= high) {
+    int mid = low + (high - low) / 2;
+    if (bitmap->containers[mid].key == key) {
+      *found = 1;
+      return mid;
+    }
+    if (bitmap->containers[mid].key < key)
+      low = mid + 1;
+    else
+      high = mid - 1;
+  }
+  *found = 0;
+  return low;
+}
+
+/**
+ * @brief Finds a value in an array container with a binary search.
+ *
+ * @param container The array container.
+ * @param value The low 16 bits of an id.
+ * @param found Pointer to store 1 if the value exists, 0 otherwise.
+ * @return int The value's index, or where it should be inserted.
+ */
+static int findValue(const BitmapContainer *container, unsigned short value,
+                     int *found) {
+  int low = 0, high = container->cardinality - 1;
+  while (low <= high) {
+    int mid = low + (high - low) / 2;
+    if (container->values[mid] == value) {
+      *found = 1;
+      return mid;
+    }
+    if (container->values[mid] < value)
+      low = mid + 1;
+    else
+      high = mid - 1;
+  }
+  *found = 0;
+  return low;
+}
+
+/**
+ * @brief Appends an empty container at a position, keeping keys sorted.
+ *
+ * @param bitmap The bitmap.
+ * @param index The position of the new container.
+ * @param key The key of the new container.
+ * @return BitmapContainer* The new container.
+ */
+static BitmapContainer *insertContainer(CohortBitmap *bitmap, int index,
+                                        unsigned int key) {
+  if (bitmap->count >= bitmap->capacity) {
+    int newCapacity = bitmap->capacity ? bitmap->capacity * 2 : 4;
+    BitmapContainer *grown = (BitmapContainer *)reallocateOrExit(
+        bitmap->containers, newCapacity * sizeof(BitmapContainer));
+    bitmap->containers = grown;
+    bitmap->capacity = newCapacity;
+  }
+  memmove(bitmap->containers + index + 1, bitmap->containers + index,
+          (bitmap->count - index) * sizeof(BitmapContainer));
+  bitmap->count++;
+  BitmapContainer *container = &bitmap->containers[index];
+  container->key = key;
+  container->cardinality = 0;
+  container->arrayCapacity = 4;
+  container->values = (unsigned short *)allocateOrExit(4 * sizeof(short));
+  container->words = NULL;
+  return container;
+}
+
+/**
+ * @brief Doubles the values array of an array container.
+ *
+ * @param container The array container.
+ */
+static void growArray(BitmapContainer *container) {
+  int newCapacity = container->arrayCapacity * 2;
+  if (newCapacity > BITMAP_ARRAY_MAX)
+    newCapacity = BITMAP_ARRAY_MAX;
+  unsigned short *grown = (unsigned short *)reallocateOrExit(
+      container->values, newCapacity * sizeof(short));
+  container->values = grown;
+  container->arrayCapacity = newCapacity;
+}
+
+/**
+ * @brief Frees the storage of a container.
+ *
+ * @param container The container.
+ */
+static void freeContainer(BitmapContainer *container) {
+  free(container->values);
+  free(container->words);
+}
+
+/**
+ * @brief Converts a full array container into a bitset container.
+ *
+ * @param container The array container.
+ */
+static void convertToBitset(BitmapContainer *container) {
+  unsigned long long *words = (unsigned long long *)allocateOrExit(
+      BITMAP_WORDS * sizeof(unsigned long long));
+  memset(words, 0, BITMAP_WORDS * sizeof(unsigned long long));
+  for (int i = 0; i < container->cardinality; i++) {
+    unsigned short value = container->values[i];
+    words[value >> 6] |= 1ULL << (value & 63);
+  }
+  free(container->values);
+  container->values = NULL;
+  container->words = words;
+}
+
+/**
+ * @brief Extracts the values of a bitset into an ascending array.
+ *
+ * @param words The bitset.
+ * @param values Array to store the values.
+ * @return int The number of values stored.
+ */
+static int bitsetToValues(const unsigned long long *words,
+                          unsigned short *values) {
+  int count = 0;
+  for (int w = 0; w < BITMAP_WORDS; w++) {
+    unsigned long long word = words[w];
+    while (word) {
+      values[count++] = (unsigned short)(w * 64 + __builtin_ctzll(word));
+      word &= word - 1;
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief Converts a sparse bitset container back into an array container.
+ *
+ * @param container The bitset container.
+ */
+static void convertToArray(BitmapContainer *container) {
+  container->arrayCapacity = container->cardinality;
+  container->values =
+      (unsigned short *)allocateOrExit(container->cardinality * sizeof(short));
+  bitsetToValues(container->words, container->values);
+  free(container->words);
+  container->words = NULL;
+}
+
+/**
+ * @brief Adds an id to a bitmap.
+ *
+ * @param bitmap The bitmap.
+ * @param id The id to add.
+ */
+void bitmapAdd(CohortBitmap *bitmap, unsigned int id) {
+  int found;
+  int index = findContainer(bitmap, id >> 16, &found);
+  BitmapContainer *container = found ? &bitmap->containers[index]
+                                     : insertContainer(bitmap, index, id >> 16);
+  unsigned short value = (unsigned short)(id & 0xFFFF);
+
+  if (container->words != NULL) {
+    unsigned long long bit = 1ULL << (value & 63);
+    container->cardinality += !(container->words[value >> 6] & bit);
+    container->words[value >> 6] |= bit;
+    return;
+  }
+
+  int pos = findValue(container, value, &found);
+  if (found)
+    return;
+  if (container->cardinality == BITMAP_ARRAY_MAX) {
+    convertToBitset(container);
+    bitmapAdd(bitmap, id);
+    return;
+  }
+  if (container->cardinality == container->arrayCapacity)
+    growArray(container);
+  memmove(container->values + pos + 1, container->values + pos,
+          (container->cardinality - pos) * sizeof(short));
+  container->values[pos] = value;
+  container->cardinality++;
+}
+
+/**
+ * @brief Removes a value from a container.
+ *
+ * @param container The container.
+ * @param value The low 16 bits of the id.
+ */
+static void containerRemove(BitmapContainer *container, unsigned short value) {
+  if (container->words != NULL) {
+    unsigned long long bit = 1ULL << (value & 63);
+    if (container->words[value >> 6] & bit) {
+      container->words[value >> 6] &= ~bit;
+      if (--container->cardinality <= BITMAP_ARRAY_MAX / 2)
+        convertToArray(container);
+    }
+    return;
+  }
+
+  int found;
+  int pos = findValue(container, value, &found);
+  if (!found)
+    return;
+  memmove(container->values + pos, container->values + pos + 1,
+          (container->cardinality - pos - 1) * sizeof(short));
+  container->cardinality--;
+}
+
+/**
+ * @brief Removes an id from a bitmap.
+ *
+ * @param bitmap The bitmap.
+ * @param id The id to remove.
+ */
+void bitmapRemove(CohortBitmap *bitmap, unsigned int id) {
+  int found;
+  int index = findContainer(bitmap, id >> 16, &found);
+  if (!found)
+    return;
+
+  BitmapContainer *container = &bitmap->containers[index];
+  containerRemove(container, (unsigned short)(id & 0xFFFF));
+  if (container->cardinality == 0) {
+    freeContainer(container);
+    memmove(bitmap->containers + index, bitmap->containers + index + 1,
+            (bitmap->count - index - 1) * sizeof(BitmapContainer));
+    bitmap->count--;
+  }
+}
+
+/**
+ * @brief Checks if a bitmap contains an id.
+ *
+ * @param bitmap The bitmap.
+ * @param id The id to look for.
+ * @return int 1 if the id is in the bitmap, 0 otherwise.
+ */
+int bitmapContains(const CohortBitmap *bitmap, unsigned int id) {
+  int found;
+  int index = findContainer(bitmap, id >> 16, &found);
+  if (!found)
+    return 0;
+
+  const BitmapContainer *container = &bitmap->containers[index];
+  unsigned short value = (unsigned short)(id & 0xFFFF);
+  if (container->words != NULL)
+    return (container->words[value >> 6] >> (value & 63)) & 1;
+  findValue(container, value, &found);
+  return found;
+}
+
+/**
+ * @brief Expands a container into a bitset.
+ *
+ * @param container The container, or NULL for an empty one.
+ * @param words The bitset to fill.
+ */
+static void containerToWords(const BitmapContainer *container,
+                             unsigned long long *words) {
+  if (container != NULL && container->words != NULL) {
+    memcpy(words, container->words, BITMAP_WORDS * sizeof(unsigned long long));
+    return;
+  }
+  memset(words, 0, BITMAP_WORDS * sizeof(unsigned long long));
+  for (int i = 0; container != NULL && i < container->cardinality; i++) {
+    unsigned short value = container->values[i];
+    words[value >> 6] |= 1ULL << (value & 63);
+  }
+}
+
+/**
+ * @brief Appends the result of combining two containers to a bitmap with
+ * room for it, taking the container's storage from an arena.
+ *
+ * @param a The left container, or NULL if absent.
+ * @param b The right container, or NULL if absent.
+ * @param operation The set operation to apply.
+ * @param result The bitmap to append to.
+ * @param scratch The arena.
+ */
+static void combineContainers(const BitmapContainer *a,
+                              const BitmapContainer *b,
+                              CohortOperation operation, CohortBitmap *result,
+                              ScratchArena *scratch) {
+  unsigned long long left[BITMAP_WORDS], right[BITMAP_WORDS];
+  containerToWords(a, left);
+  containerToWords(b, right);
+
+  int cardinality = 0;
+  for (int w = 0; w < BITMAP_WORDS; w++) {
+    if (operation == COHORT_AND)
+      left[w] &= right[w];
+    else if (operation == COHORT_OR)
+      left[w] |= right[w];
+    else
+      left[w] &= ~right[w];
+    cardinality += __builtin_popcountll(left[w]);
+  }
+  if (cardinality == 0)
+    return;
+
+  BitmapContainer *container = &result->containers[result->count++];
+  container->key = a != NULL ? a->key : b->key;
+  container->cardinality = cardinality;
+  container->arrayCapacity = 0;
+  container->values = NULL;
+  container->words = NULL;
+  if (cardinality <= BITMAP_ARRAY_MAX) {
+    container->arrayCapacity = cardinality;
+    container->values = (unsigned short *)arenaAlloc(
+        scratch, cardinality * sizeof(short));
+    bitsetToValues(left, container->values);
+    return;
+  }
+  container->words = (unsigned long long *)arenaAlloc(scratch, sizeof(left));
+  memcpy(container->words, left, sizeof(left));
+}
+
+/**
+ * @brief Combines two bitmaps into a new one whose storage lives in an arena,
+ * so the result is only read and is never freed.
+ *
+ * @param a The left operand.
+ * @param b The right operand.
+ * @param operation The set operation to apply.
+ * @param result The bitmap to store the result (must not be an operand).
+ * @param scratch The arena the result is allocated from.
+ */
+void bitmapCombine(const CohortBitmap *a, const CohortBitmap *b,
+                   CohortOperation operation, CohortBitmap *result,
+                   ScratchArena *scratch) {
+  // The result never has more containers than both operands together
+  result->capacity = a->count + b->count;
+  result->containers = (BitmapContainer *)arenaAlloc(
+      scratch, result->capacity * sizeof(BitmapContainer));
+  result->count = 0;
+  int i = 0, j = 0;
+  while (i < a->count || j < b->count) {
+    const BitmapContainer *left = i < a->count ? &a->containers[i] : NULL;
+    const BitmapContainer *right = j < b->count ? &b->containers[j] : NULL;
+    if (left != NULL && (right == NULL || left->key < right->key)) {
+      right = NULL;
+      i++;
+    } else if (right != NULL && (left == NULL || right->key < left->key)) {
+      left = NULL;
+      j++;
+    } else {
+      i++;
+      j++;
+    }
+    // AND needs both sides, ANDNOT needs the left side
+    if ((operation == COHORT_AND && (left == NULL || right == NULL)) ||
+        (operation == COHORT_ANDNOT && left == NULL))
+      continue;
+    combineContainers(left, right, operation, result, scratch);
+  }
+}
+
+/**
+ * @brief Counts the ids in a bitmap.
+ *
+ * @param bitmap The bitmap.
+ * @return long The number of ids.
+ */
+long bitmapCardinality(const CohortBitmap *bitmap) {
+  long total = 0;
+  for (int i = 0; i < bitmap->count; i++) {
+    total += bitmap->containers[i].cardinality;
+  }
+  return total;
+}
+
+/**
+ * @brief Lists the ids of a bitmap in ascending order.
+ *
+ * @param bitmap The bitmap.
+ * @param ids Array with room for bitmapCardinality ids.
+ */
+void bitmapToArray(const CohortBitmap *bitmap, unsigned int *ids) {
+  unsigned short values[BITMAP_WORDS * 64];
+  long total = 0;
+  for (int i = 0; i < bitmap->count; i++) {
+    const BitmapContainer *container = &bitmap->containers[i];
+    const unsigned short *low = container->values;
+    if (container->words != NULL) {
+      bitsetToValues(container->words, values);
+      low = values;
+    }
+    for (int k = 0; k < container->cardinality; k++) {
+      ids[total++] = (container->key << 16) | low[k];
+    }
+  }
+}
+
+/**
+ * @brief Frees the memory used by a bitmap, leaving it empty.
+ *
+ * @param bitmap The bitmap.
+ */
+void freeBitmap(CohortBitmap *bitmap) {
+  for (int i = 0; i < bitmap->count; i++) {
+    freeContainer(&bitmap->containers[i]);
+  }
+  free(bitmap->containers);
+  initializeBitmap(bitmap);
+}
@@ -0,0 +1,109 @@
+/**
+ * @file cohort.h
+ * @brief Header file for compressed cohort bitmaps.
+ *
+ * This file contains the declarations of a roaring-style compressed bitmap of
+ * dense user ids. Ids are split by their high 16 bits into containers that
+ * hold the low 16 bits either as a sorted array (sparse) or as a 65536-bit
+ * bitset (dense).
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef COHORT_H
+#define COHORT_H
+
+#include "arena.h"
+
+#define BITMAP_ARRAY_MAX 4096
+#define BITMAP_WORDS 1024
+
+// Structure for a bitmap container with the ids sharing the same high bits
+typedef struct {
+  unsigned int key;          // High 16 bits of the ids in the container
+  int cardinality;           // Number of ids in the container
+  int arrayCapacity;         // Current capacity of the values array
+  unsigned short *values;    // Sorted low bits (array container), or NULL
+  unsigned long long *words; // Bitset of low bits (bitset container), or NULL
+} BitmapContainer;
+
+// Structure for a compressed bitmap of user ids
+typedef struct CohortBitmap {
+  BitmapContainer *containers; // Containers sorted by key
+  int count;                   // Number of containers
+  int capacity;                // Current capacity of the containers array
+} CohortBitmap;
+
+// Set operations that can combine two bitmaps
+typedef enum { COHORT_AND, COHORT_OR, COHORT_ANDNOT } CohortOperation;
+
+/**
+ * @brief Initializes an empty bitmap.
+ *
+ * @param bitmap The bitmap to initialize.
+ */
+void initializeBitmap(CohortBitmap *bitmap);
+
+/**
+ * @brief Adds an id to a bitmap.
+ *
+ * @param bitmap The bitmap.
+ * @param id The id to add.
+ */
+void bitmapAdd(CohortBitmap *bitmap, unsigned int id);
+
+/**
+ * @brief Removes an id from a bitmap.
+ *
+ * @param bitmap The bitmap.
+ * @param id The id to remove.
+ */
+void bitmapRemove(CohortBitmap *bitmap, unsigned int id);
+
+/**
+ * @brief Checks if a bitmap contains an id.
+ *
+ * @param bitmap The bitmap.
+ * @param id The id to look for.
+ * @return int 1 if the id is in the bitmap, 0 otherwise.
+ */
+int bitmapContains(const CohortBitmap *bitmap, unsigned int id);
+
+/**
+ * @brief Combines two bitmaps into a new one whose storage lives in an arena,
+ * so the result is only read and is never freed.
+ *
+ * @param a The left operand.
+ * @param b The right operand.
+ * @param operation The set operation to apply.
+ * @param result The bitmap to store the result (must not be an operand).
+ * @param scratch The arena the result is allocated from.
+ */
+void bitmapCombine(const CohortBitmap *a, const CohortBitmap *b,
+                   CohortOperation operation, CohortBitmap *result,
+                   ScratchArena *scratch);
+
+/**
+ * @brief Counts the ids in a bitmap.
+ *
+ * @param bitmap The bitmap.
+ * @return long The number of ids.
+ */
+long bitmapCardinality(const CohortBitmap *bitmap);
+
+/**
+ * @brief Lists the ids of a bitmap in ascending order.
+ *
+ * @param bitmap The bitmap.
+ * @param ids Array with room for bitmapCardinality ids.
+ */
+void bitmapToArray(const CohortBitmap *bitmap, unsigned int *ids);
+
+/**
+ * @brief Frees the memory used by a bitmap, leaving it empty.
+ *
+ * @param bitmap The bitmap.
+ */
+void freeBitmap(CohortBitmap *bitmap);
+
+#endif
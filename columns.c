@@ -0,0 +1,442 @@
+/**
+ * @file columns.c
+ * @brief Implementation of the columnar inoculation store.
+ *
+ * Rows are indexed by the inoculation's sequence number, so appending a dose
+ * and undoing the newest one only touch the end of the columns, and deleting
+ * or restoring an inoculation flips one bit. Dates are packed as
+ * year << 9 | month << 5 | day, which keeps them in date order as integers.
+ * Once no branch can undo them, full blocks of open rows are sealed: doses
+ * come in date order, so a segment is a few same-day runs whose dates are
+ * stored as small deltas, and the ids of each row take one to three bytes.
+ * Sealing frees the inoculation records of the sealed live rows: each user
+ * keeps a 16-byte sealed dose per row instead, and full scans decode the
+ * segments. Sealed rows are never rewritten; deleting one only sets its bit
+ * in the deletion bitmap, which covers every row, and moves the dose back
+ * into a record on the deleted list.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "alloc.h"
+#include "project.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Initializes an empty columnar store.
+ *
+ * @param columns The columnar store.
+ */
+void initializeColumns(InoculationColumns *columns) {
+  columns->enabled = 0;
+  columns->segments = NULL;
+  columns->segmentCount = 0;
+  columns->segmentCapacity = 0;
+  columns->sealedRows = 0;
+  columns->sealedBytes = 0;
+  columns->releasedBytes = 0;
+  columns->userIds = NULL;
+  columns->lotIds = NULL;
+  columns->dates = NULL;
+  columns->records = NULL;
+  columns->tailCapacity = 0;
+  columns->deleted = NULL;
+  columns->deletedWords = 0;
+  columns->rowCount = 0;
+  columns->lotsById = NULL;
+  columns->lotCount = 0;
+  columns->lotCapacity = 0;
+}
+
+/**
+ * @brief Packs a date into an integer that sorts in date order.
+ *
+ * @param day The day of the month.
+ * @param month The month.
+ * @param year The year.
+ * @return unsigned int The packed date.
+ */
+unsigned int packDate(int day, int month, int year) {
+  return (unsigned int)year << 9 | (unsigned int)month << 5 |
+         (unsigned int)day;
+}
+
+/**
+ * @brief Unpacks a date packed by packDate.
+ *
+ * @param packed The packed date.
+ * @param day Pointer to store the day of the month.
+ * @param month Pointer to store the month.
+ * @param year Pointer to store the year.
+ */
+void unpackDate(unsigned int packed, int *day, int *month, int *year) {
+  *day = (int)(packed & 31);
+  *month = (int)(packed >> 5 & 15);
+  *year = (int)(packed >> 9);
+}
+
+/**
+ * @brief Makes room for one more open row and its bit in the deletion
+ * bitmap.
+ *
+ * @param columns The columnar store.
+ */
+static void reserveRow(InoculationColumns *columns) {
+  if (columns->rowCount - columns->sealedRows >= columns->tailCapacity) {
+    columns->tailCapacity =
+        columns->tailCapacity ? columns->tailCapacity * 2 : 1024;
+    size_t size = columns->tailCapacity * sizeof(unsigned int);
+    columns->userIds = reallocateOrExit(columns->userIds, size);
+    columns->lotIds = reallocateOrExit(columns->lotIds, size);
+    columns->dates = reallocateOrExit(columns->dates, size);
+    columns->records = reallocateOrExit(
+        columns->records, columns->tailCapacity * sizeof(Inoculation *));
+  }
+  if (columns->rowCount / 64 >= columns->deletedWords) {
+    unsigned long words = columns->deletedWords ? columns->deletedWords * 2
+                                                : 16;
+    columns->deleted = reallocateOrExit(columns->deleted,
+                                        words * sizeof(unsigned long long));
+    memset(columns->deleted + columns->deletedWords, 0,
+           (words - columns->deletedWords) * sizeof(unsigned long long));
+    columns->deletedWords = words;
+  }
+}
+
+/**
+ * @brief Gives a lot the next dense id if it does not have one yet.
+ *
+ * @param columns The columnar store.
+ * @param lot The lot.
+ */
+static void assignLotId(InoculationColumns *columns, VaccineLot *lot) {
+  if (lot->id >= 0)
+    return;
+  if (columns->lotCount >= columns->lotCapacity) {
+    columns->lotCapacity = columns->lotCapacity ? columns->lotCapacity * 2 : 64;
+    columns->lotsById = reallocateOrExit(
+        columns->lotsById, columns->lotCapacity * sizeof(VaccineLot *));
+  }
+  lot->id = columns->lotCount;
+  columns->lotsById[columns->lotCount++] = lot;
+}
+
+/**
+ * @brief Appends the row of a new inoculation, giving its lot the next dense
+ * id if it does not have one yet.
+ *
+ * @param columns The columnar store.
+ * @param userId The dense id of the inoculation's user.
+ * @param lot The applied lot.
+ * @param inoc The new inoculation's record.
+ */
+void appendInoculationRow(InoculationColumns *columns, unsigned int userId,
+                          VaccineLot *lot, Inoculation *inoc) {
+  reserveRow(columns);
+  assignLotId(columns, lot);
+  unsigned long open = columns->rowCount++ - columns->sealedRows;
+  columns->userIds[open] = userId;
+  columns->lotIds[open] = (unsigned int)lot->id;
+  columns->dates[open] =
+      packDate(inoc->date.day, inoc->date.month, inoc->date.year);
+  columns->records[open] = inoc;
+}
+
+/**
+ * @brief Writes a number as a varint of 7 bits per byte, low bits first.
+ *
+ * @param out Where to write.
+ * @param value The number.
+ * @return unsigned char* The byte after the varint.
+ */
+static unsigned char *writeVarint(unsigned char *out, unsigned int value) {
+  while (value >= 128) {
+    *out++ = (unsigned char)(value | 128);
+    value >>= 7;
+  }
+  *out++ = (unsigned char)value;
+  return out;
+}
+
+/**
+ * @brief Reads a varint written by writeVarint.
+ *
+ * @param in Pointer to the next byte, advanced past the varint.
+ * @return unsigned int The number.
+ */
+static unsigned int readVarint(const unsigned char **in) {
+  unsigned int value = 0;
+  int shift = 0;
+  unsigned char byte;
+  do {
+    byte = *(*in)++;
+    value |= (unsigned int)(byte & 127) << shift;
+    shift += 7;
+  } while (byte & 128);
+  return value;
+}
+
+/**
+ * @brief Encodes the oldest COLUMN_SEGMENT_ROWS open rows as same-day runs.
+ *
+ * @param columns The columnar store.
+ * @param out Buffer with room for 20 bytes per row.
+ * @return unsigned long The number of encoded bytes.
+ */
+static unsigned long encodeSegment(const InoculationColumns *columns,
+                                   unsigned char *out) {
+  unsigned char *start = out;
+  unsigned int previous = 0;
+  int i = 0;
+  while (i < COLUMN_SEGMENT_ROWS) {
+    int run = 1;
+    while (i + run < COLUMN_SEGMENT_ROWS &&
+           columns->dates[i + run] == columns->dates[i])
+      run++;
+    out = writeVarint(out, columns->dates[i] - previous);
+    out = writeVarint(out, (unsigned int)run);
+    previous = columns->dates[i];
+    for (int j = i; j < i + run; j++) {
+      out = writeVarint(out, columns->userIds[j]);
+      out = writeVarint(out, columns->lotIds[j]);
+    }
+    i += run;
+  }
+  return (unsigned long)(out - start);
+}
+
+/**
+ * @brief Gives the users of the live rows about to be sealed a sealed dose
+ * for each of them.
+ *
+ * @param columns The columnar store.
+ * @param usersById The users indexed by their dense id.
+ */
+static void addSealedDoses(InoculationColumns *columns, UserIndex **usersById) {
+  for (int i = 0; i < COLUMN_SEGMENT_ROWS; i++) {
+    unsigned long row = columns->sealedRows + i;
+    if (isInoculationRowDeleted(columns, row))
+      continue;
+    UserIndex *user = usersById[columns->userIds[i]];
+    SealedDose dose = {.lot = columns->lotsById[columns->lotIds[i]],
+                       .row = (unsigned int)row,
+                       .date = columns->dates[i]};
+    insertSealedDose(user, user->sealedCount, &dose);
+  }
+}
+
+/**
+ * @brief Frees a user's live records older than a row, which are the first
+ * ones of the user's index.
+ *
+ * @param columns The columnar store.
+ * @param user The user's index entry.
+ * @param end The first row that stays open.
+ */
+static void releaseRecords(InoculationColumns *columns, UserIndex *user,
+                           unsigned long end) {
+  int count = 0;
+  while (count < user->inoculationCount &&
+         user->inoculations[count]->sequence < end) {
+    Inoculation *inoc = user->inoculations[count++];
+    columns->releasedBytes += sizeof(Inoculation) + sizeof(Inoculation *) +
+                              strlen(inoc->user) + strlen(inoc->lot) + 2;
+    freeInoculation(inoc);
+  }
+  user->inoculationCount -= count;
+  memmove(user->inoculations, user->inoculations + count,
+          user->inoculationCount * sizeof(Inoculation *));
+}
+
+/**
+ * @brief Frees the records of the live rows about to be sealed and ends the
+ * global list, which is newest first, at the oldest live row left open.
+ *
+ * @param columns The columnar store.
+ * @param usersById The users indexed by their dense id.
+ */
+static void releaseSealedRecords(InoculationColumns *columns,
+                                 UserIndex **usersById) {
+  unsigned long end = columns->sealedRows + COLUMN_SEGMENT_ROWS;
+  for (int i = 0; i < COLUMN_SEGMENT_ROWS; i++) {
+    if (!isInoculationRowDeleted(columns, columns->sealedRows + i))
+      releaseRecords(columns, usersById[columns->userIds[i]], end);
+  }
+  // The newest row is live, as sealing follows a dose
+  unsigned long open = COLUMN_SEGMENT_ROWS;
+  while (isInoculationRowDeleted(columns, columns->sealedRows + open))
+    open++;
+  columns->records[open]->next_global = NULL;
+}
+
+/**
+ * @brief Seals the oldest COLUMN_SEGMENT_ROWS open rows into a segment.
+ *
+ * @param columns The columnar store.
+ * @param usersById The users indexed by their dense id.
+ */
+static void sealSegment(InoculationColumns *columns, UserIndex **usersById) {
+  unsigned char *bytes = reallocateOrExit(NULL, COLUMN_SEGMENT_ROWS * 20);
+  unsigned long size = encodeSegment(columns, bytes);
+  if (columns->segmentCount >= columns->segmentCapacity) {
+    columns->segmentCapacity =
+        columns->segmentCapacity ? columns->segmentCapacity * 2 : 16;
+    columns->segments = reallocateOrExit(
+        columns->segments, columns->segmentCapacity * sizeof(ColumnSegment));
+  }
+  ColumnSegment *segment = &columns->segments[columns->segmentCount++];
+  segment->bytes = reallocateOrExit(bytes, size);
+  segment->size = size;
+  addSealedDoses(columns, usersById);
+  releaseSealedRecords(columns, usersById);
+  columns->sealedRows += COLUMN_SEGMENT_ROWS;
+  columns->sealedBytes += size;
+
+  unsigned long open = columns->rowCount - columns->sealedRows;
+  size_t moved = open * sizeof(unsigned int);
+  memmove(columns->userIds, columns->userIds + COLUMN_SEGMENT_ROWS, moved);
+  memmove(columns->lotIds, columns->lotIds + COLUMN_SEGMENT_ROWS, moved);
+  memmove(columns->dates, columns->dates + COLUMN_SEGMENT_ROWS, moved);
+  memmove(columns->records, columns->records + COLUMN_SEGMENT_ROWS,
+          open * sizeof(Inoculation *));
+}
+
+/**
+ * @brief Seals the oldest open rows into encoded segments while more than a
+ * segment of them is open, replacing the records of their live rows with
+ * sealed doses. The caller must make sure none of them can be undone.
+ *
+ * @param columns The columnar store.
+ * @param usersById The users indexed by their dense id.
+ */
+void sealInoculationRows(InoculationColumns *columns, UserIndex **usersById) {
+  while (columns->rowCount - columns->sealedRows > COLUMN_SEGMENT_ROWS)
+    sealSegment(columns, usersById);
+}
+
+/**
+ * @brief Removes the newest row after its dose was undone, releasing the
+ * lot's id if that dose was the lot's first.
+ *
+ * @param columns The columnar store.
+ */
+void removeLastInoculationRow(InoculationColumns *columns) {
+  unsigned long row = --columns->rowCount;
+  setInoculationRowDeleted(columns, row, 0);
+  VaccineLot *lot =
+      columns->lotsById[columns->lotIds[row - columns->sealedRows]];
+  // Undo is newest first, so a lot left with no doses holds the newest id
+  if (lot->dosesUsed == 0 && lot->id == columns->lotCount - 1) {
+    lot->id = -1;
+    columns->lotCount--;
+  }
+}
+
+/**
+ * @brief Marks a row as deleted or restores it.
+ *
+ * @param columns The columnar store.
+ * @param row The row (the inoculation's sequence number).
+ * @param deleted 1 to mark the row deleted, 0 to restore it.
+ */
+void setInoculationRowDeleted(InoculationColumns *columns, unsigned long row,
+                              int deleted) {
+  unsigned long long bit = 1ULL << (row & 63);
+  if (deleted)
+    columns->deleted[row / 64] |= bit;
+  else
+    columns->deleted[row / 64] &= ~bit;
+}
+
+/**
+ * @brief Checks if a row is deleted.
+ *
+ * @param columns The columnar store.
+ * @param row The row.
+ * @return int 1 if the row is deleted, 0 otherwise.
+ */
+int isInoculationRowDeleted(const InoculationColumns *columns,
+                            unsigned long row) {
+  return (columns->deleted[row / 64] >> (row & 63) & 1) != 0;
+}
+
+/**
+ * @brief Starts a cursor at the oldest row.
+ *
+ * @param cursor The cursor.
+ * @param columns The columnar store.
+ */
+void openColumnCursor(ColumnCursor *cursor, const InoculationColumns *columns) {
+  cursor->columns = columns;
+  cursor->row = 0;
+  cursor->next = NULL;
+  cursor->runLeft = 0;
+  cursor->date = 0;
+}
+
+/**
+ * @brief Reads the row under a cursor, live or not, and moves past it.
+ *
+ * @param cursor The cursor.
+ * @param row Pointer to store the row.
+ */
+static void readRow(ColumnCursor *cursor, ColumnRow *row) {
+  const InoculationColumns *columns = cursor->columns;
+  row->row = cursor->row++;
+  if (row->row >= columns->sealedRows) {
+    unsigned long open = row->row - columns->sealedRows;
+    row->userId = columns->userIds[open];
+    row->lotId = columns->lotIds[open];
+    row->date = columns->dates[open];
+    return;
+  }
+  // Runs never cross segments, and each segment's dates start from zero
+  if (row->row % COLUMN_SEGMENT_ROWS == 0) {
+    cursor->next = columns->segments[row->row / COLUMN_SEGMENT_ROWS].bytes;
+    cursor->date = 0;
+  }
+  if (cursor->runLeft == 0) {
+    cursor->date += readVarint(&cursor->next);
+    cursor->runLeft = readVarint(&cursor->next);
+  }
+  cursor->runLeft--;
+  row->userId = readVarint(&cursor->next);
+  row->lotId = readVarint(&cursor->next);
+  row->date = cursor->date;
+}
+
+/**
+ * @brief Reads the next live row, decoding sealed segments on the fly.
+ *
+ * @param cursor The cursor.
+ * @param row Pointer to store the row.
+ * @return int 1 if a row was read, 0 at the end.
+ */
+int nextColumnRow(ColumnCursor *cursor, ColumnRow *row) {
+  while (cursor->row < cursor->columns->rowCount) {
+    readRow(cursor, row);
+    if (!isInoculationRowDeleted(cursor->columns, row->row))
+      return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Frees the memory used by a columnar store, leaving it empty.
+ *
+ * @param columns The columnar store.
+ */
+void freeColumns(InoculationColumns *columns) {
+  for (int i = 0; i < columns->segmentCount; i++)
+    free(columns->segments[i].bytes);
+  free(columns->segments);
+  free(columns->userIds);
+  free(columns->lotIds);
+  free(columns->dates);
+  free(columns->records);
+  free(columns->deleted);
+  free(columns->lotsById);
+  initializeColumns(columns);
+}
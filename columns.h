@@ -0,0 +1,184 @@
+/**
+ * @file columns.h
+ * @brief Header file for the columnar inoculation store.
+ *
+ * This file contains the declarations of a packed copy of the inoculations
+ * kept as parallel columns of dense user ids, dense lot ids and packed dates,
+ * with one row per inoculation sequence number and a bitmap of the deleted
+ * rows. Full scans stream through 12 bytes per inoculation instead of
+ * following the global list and the strings of every record. Old rows are
+ * sealed into varint-encoded segments that are decoded on the fly by
+ * cursors, and sealing replaces the inoculation records of their live rows
+ * with a small sealed dose in each user's index. The store is optional: the
+ * engine only keeps it when it is switched on.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef COLUMNS_H
+#define COLUMNS_H
+
+#ifndef COLUMN_SEGMENT_ROWS
+#define COLUMN_SEGMENT_ROWS 4096 // Rows sealed together into one segment
+#endif
+
+struct UserIndex; // Declared in project.h
+
+// Structure for a dose whose row was sealed, kept in its user's index in
+// place of the freed inoculation record
+typedef struct {
+  struct VaccineLot *lot; // The applied lot
+  unsigned int row;       // The row (the inoculation's sequence number)
+  unsigned int date;      // Packed date of the dose
+} SealedDose;
+
+// Structure for a sealed segment of rows, stored as same-day runs of a
+// varint date delta and a varint run length followed by the varint user and
+// lot id of each row
+typedef struct {
+  unsigned char *bytes; // Encoded runs
+  unsigned long size;   // Number of encoded bytes
+} ColumnSegment;
+
+// Structure for the inoculations stored as columns
+typedef struct {
+  int enabled;                   // 1 if doses are kept in the store
+  ColumnSegment *segments;       // Sealed segments, oldest first
+  int segmentCount;              // Number of sealed segments
+  int segmentCapacity;           // Current capacity of segments
+  unsigned long sealedRows;      // Rows in the sealed segments
+  unsigned long sealedBytes;     // Encoded bytes of the sealed segments
+  unsigned long releasedBytes;   // Bytes of the records sealing freed
+  unsigned int *userIds;         // Dense user id of each open row
+  unsigned int *lotIds;          // Dense lot id of each open row
+  unsigned int *dates;           // Packed date of each open row
+  struct Inoculation **records;  // Inoculation record of each open row
+  unsigned long tailCapacity;    // Current capacity of the open rows
+  unsigned long long *deleted;   // Bitmap of the deleted rows, sealed or not
+  unsigned long deletedWords;    // Current capacity of the bitmap in words
+  unsigned long rowCount;        // Number of rows
+  struct VaccineLot **lotsById;  // Lots indexed by their dense id
+  int lotCount;                  // Number of lots with an id
+  int lotCapacity;               // Current capacity of lotsById
+} InoculationColumns;
+
+// Structure for one row read by a cursor
+typedef struct {
+  unsigned long row;   // The row (the inoculation's sequence number)
+  unsigned int userId; // Dense user id
+  unsigned int lotId;  // Dense lot id
+  unsigned int date;   // Packed date
+} ColumnRow;
+
+// Structure for a cursor over the live rows, oldest first
+typedef struct {
+  const InoculationColumns *columns;
+  unsigned long row;          // Next row to read
+  const unsigned char *next;  // Next byte of the segment being decoded
+  unsigned long runLeft;      // Rows left in the current same-day run
+  unsigned int date;          // Packed date of the current run
+} ColumnCursor;
+
+/**
+ * @brief Initializes an empty columnar store.
+ *
+ * @param columns The columnar store.
+ */
+void initializeColumns(InoculationColumns *columns);
+
+/**
+ * @brief Packs a date into an integer that sorts in date order.
+ *
+ * @param day The day of the month.
+ * @param month The month.
+ * @param year The year.
+ * @return unsigned int The packed date.
+ */
+unsigned int packDate(int day, int month, int year);
+
+/**
+ * @brief Unpacks a date packed by packDate.
+ *
+ * @param packed The packed date.
+ * @param day Pointer to store the day of the month.
+ * @param month Pointer to store the month.
+ * @param year Pointer to store the year.
+ */
+void unpackDate(unsigned int packed, int *day, int *month, int *year);
+
+/**
+ * @brief Appends the row of a new inoculation, giving its lot the next dense
+ * id if it does not have one yet.
+ *
+ * @param columns The columnar store.
+ * @param userId The dense id of the inoculation's user.
+ * @param lot The applied lot.
+ * @param inoc The new inoculation's record.
+ */
+void appendInoculationRow(InoculationColumns *columns, unsigned int userId,
+                          struct VaccineLot *lot, struct Inoculation *inoc);
+
+/**
+ * @brief Seals the oldest open rows into encoded segments while more than a
+ * segment of them is open, replacing the records of their live rows with
+ * sealed doses. The caller must make sure none of them can be undone.
+ *
+ * @param columns The columnar store.
+ * @param usersById The users indexed by their dense id.
+ */
+void sealInoculationRows(InoculationColumns *columns,
+                         struct UserIndex **usersById);
+
+/**
+ * @brief Removes the newest row after its dose was undone, releasing the
+ * lot's id if that dose was the lot's first.
+ *
+ * @param columns The columnar store.
+ */
+void removeLastInoculationRow(InoculationColumns *columns);
+
+/**
+ * @brief Marks a row as deleted or restores it.
+ *
+ * @param columns The columnar store.
+ * @param row The row (the inoculation's sequence number).
+ * @param deleted 1 to mark the row deleted, 0 to restore it.
+ */
+void setInoculationRowDeleted(InoculationColumns *columns, unsigned long row,
+                              int deleted);
+
+/**
+ * @brief Checks if a row is deleted.
+ *
+ * @param columns The columnar store.
+ * @param row The row.
+ * @return int 1 if the row is deleted, 0 otherwise.
+ */
+int isInoculationRowDeleted(const InoculationColumns *columns,
+                            unsigned long row);
+
+/**
+ * @brief Starts a cursor at the oldest row.
+ *
+ * @param cursor The cursor.
+ * @param columns The columnar store.
+ */
+void openColumnCursor(ColumnCursor *cursor, const InoculationColumns *columns);
+
+/**
+ * @brief Reads the next live row, decoding sealed segments on the fly.
+ *
+ * @param cursor The cursor.
+ * @param row Pointer to store the row.
+ * @return int 1 if a row was read, 0 at the end.
+ */
+int nextColumnRow(ColumnCursor *cursor, ColumnRow *row);
+
+/**
+ * @brief Frees the memory used by a columnar store, leaving it empty.
+ *
+ * @param columns The columnar store.
+ */
+void freeColumns(InoculationColumns *columns);
+
+#endif
@@ -11,35 +11,34 @@
  * Author: Vicente B. Duarte
  */
 
+#include "charclass.h"
 #include "constants.h"
+#include "engine.h"
 #include "project.h"
-#include <ctype.h>
+#include "series.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#define NO_LOT_KEY 0x7fffffff // Larger than any expiry day number
+
 /**
  * @brief Extracts the user name from a quoted argument.
  *
  * @param args The command arguments starting with a quote.
  * @param userName Pointer to store the extracted user name.
+ * @param scratch The per-command scratch arena.
  * @return const char* Pointer to the rest of the arguments after the quote, or
  * NULL on error.
  */
-static const char *extractQuotedName(const char *args, char **userName) {
+static const char *extractQuotedName(const char *args, char **userName,
+                                     ScratchArena *scratch) {
   const char *endQuote = strchr(args + 1, '"');
   if (endQuote == NULL) {
     return NULL; // Unclosed quotes
   }
 
-  size_t nameLen = endQuote - args - 1;
-  *userName = (char *)malloc(nameLen + 1);
-  if (*userName == NULL) {
-    return NULL; // Memory allocation failed
-  }
-
-  memcpy(*userName, args + 1, nameLen);
-  (*userName)[nameLen] = '\0';
+  *userName = arenaStrndup(scratch, args + 1, endQuote - args - 1);
   return endQuote + 1;
 }
 
@@ -48,23 +47,18 @@ static const char *extractQuotedName(const char *args, char **userName) {
  *
  * @param args The command arguments.
  * @param userName Pointer to store the extracted user name.
+ * @param scratch The per-command scratch arena.
  * @return const char* Pointer to the rest of the arguments after the space, or
  * NULL on error.
  */
-static const char *extractUnquotedName(const char *args, char **userName) {
+static const char *extractUnquotedName(const char *args, char **userName,
+                                       ScratchArena *scratch) {
   const char *space = strchr(args, ' ');
   if (space == NULL) {
     return NULL; // Missing vaccine name
   }
 
-  size_t nameLen = space - args;
-  *userName = (char *)malloc(nameLen + 1);
-  if (*userName == NULL) {
-    return NULL; // Memory allocation failed
-  }
-
-  memcpy(*userName, args, nameLen);
-  (*userName)[nameLen] = '\0';
+  *userName = arenaStrndup(scratch, args, space - args);
   return space + 1;
 }
 
@@ -73,19 +67,19 @@ static const char *extractUnquotedName(const char *args, char **userName) {
  *
  * @param rest The remaining command arguments.
  * @param vaccineName Pointer to store the extracted vaccine name.
+ * @param scratch The per-command scratch arena.
  * @return int 1 if successful, 0 otherwise.
  */
-static int extractVaccineName(const char *rest, char **vaccineName) {
-  while (*rest && isspace(*rest)) {
-    rest++;
-  }
+static int extractVaccineName(const char *rest, char **vaccineName,
+                              ScratchArena *scratch) {
+  rest = skipSpaces(rest);
 
   if (*rest == '\0') {
     return 0; // Missing vaccine name
   }
 
-  *vaccineName = strdup(rest);
-  return (*vaccineName != NULL);
+  *vaccineName = arenaStrdup(scratch, rest);
+  return 1;
 }
 
 /**
@@ -94,34 +88,23 @@ static int extractVaccineName(const char *rest, char **vaccineName) {
  * @param args The command arguments.
  * @param userName Pointer to store the extracted user name.
  * @param vaccineName Pointer to store the extracted vaccine name.
+ * @param scratch The per-command scratch arena for both names.
  * @return int 1 if extraction was successful, 0 otherwise.
  */
 static int extractArguments(const char *args, char **userName,
-                            char **vaccineName) {
+                            char **vaccineName, ScratchArena *scratch) {
   const char *rest;
   if (args[0] == '"') {
-    rest = extractQuotedName(args, userName);
-    if (rest == NULL) {
-      return 0;
-    }
-
+    rest = extractQuotedName(args, userName, scratch);
   } else {
-    rest = extractUnquotedName(args, userName);
-    if (rest == NULL) {
-      return 0;
-    }
+    rest = extractUnquotedName(args, userName, scratch);
   }
 
-  if (*userName == NULL) {
+  if (rest == NULL) {
     return 0;
   }
 
-  if (!extractVaccineName(rest, vaccineName)) {
-    free(*userName);
-    return 0;
-  }
-
-  return 1;
+  return extractVaccineName(rest, vaccineName, scratch);
 }
 
 /**
@@ -134,257 +117,329 @@ static int extractArguments(const char *args, char **userName,
  */
 static int inoculationMatches(const Inoculation *inoc, Date currentDate,
                               const VaccineNameIndex *vaccineEntry) {
-  if (inoc->date.day == currentDate.day &&
-      inoc->date.month == currentDate.month &&
-      inoc->date.year == currentDate.year) {
-    for (int j = 0; j < vaccineEntry->lotCount; j++) {
-      if (strcmp(inoc->lot, vaccineEntry->lots[j]->lot) == 0) {
-        return 1;
-      }
-    }
-  }
-  return 0;
+  return inoc->date.day == currentDate.day &&
+         inoc->date.month == currentDate.month &&
+         inoc->date.year == currentDate.year &&
+         vaccineHasLot(vaccineEntry, inoc->lot);
 }
 
 /**
  * @brief Checks if a user has already been vaccinated today with a specific
  * vaccine.
  *
- * @param userHashTable The hash table of user indexes.
- * @param nameHashTable The hash table of vaccine names.
- * @param userName The user's name.
- * @param vaccineName The vaccine name.
+ * @param userEntry The user's index entry (may be NULL).
+ * @param vaccineEntry The vaccine name entry.
  * @param currentDate The current date.
- * @param hashSize The size of the hash tables.
  * @return int 1 if already vaccinated today, 0 otherwise.
  */
-static int isAlreadyVaccinated(UserIndex **userHashTable,
-                               VaccineNameIndex **nameHashTable,
-                               const char *userName, const char *vaccineName,
-                               Date currentDate, int hashSize) {
-  UserIndex *userEntry = findUserByName(userHashTable, userName, hashSize);
+static int isAlreadyVaccinated(const UserIndex *userEntry,
+                               const VaccineNameIndex *vaccineEntry,
+                               Date currentDate) {
   if (userEntry == NULL)
     return 0;
 
-  VaccineNameIndex *vaccineEntry =
-      findVaccineByName(nameHashTable, vaccineName, hashSize);
-  if (vaccineEntry == NULL)
-    return 0;
-
   for (int i = 0; i < userEntry->inoculationCount; i++) {
     if (inoculationMatches(userEntry->inoculations[i], currentDate,
                            vaccineEntry)) {
       return 1;
     }
   }
+  // Sealed doses are oldest first, so only the last ones can be today's
+  unsigned int today =
+      packDate(currentDate.day, currentDate.month, currentDate.year);
+  for (int i = userEntry->sealedCount - 1;
+       i >= 0 && userEntry->sealed[i].date == today; i--) {
+    if (vaccineHasLot(vaccineEntry, userEntry->sealed[i].lot->lot))
+      return 1;
+  }
   return 0;
 }
 
 /**
- * @brief Checks if a vaccine lot is valid and has available doses.
+ * @brief Finds the earliest expiry day among the lots that are still valid
+ * and have doses left.
  *
- * @param lot The vaccine lot.
- * @param currentDate The current date.
- * @return int 1 if valid and available, 0 otherwise.
+ * The scan only reads the mirror arrays of a name entry or a site's shelf
+ * and has no branches in its body, so the compiler can vectorize it.
+ *
+ * @param expiry The expiry day number of each lot.
+ * @param remaining The doses each lot can still give.
+ * @param count The number of lots.
+ * @param today The current day number.
+ * @return int The earliest expiry day, or NO_LOT_KEY if no lot qualifies.
  */
-static int isLotValidAndAvailable(const VaccineLot *lot, Date currentDate) {
-  return !lot->isRemoved && lot->doses > lot->dosesUsed &&
-         compareDates(lot->validation, currentDate) >= 0;
+static int findEarliestExpiry(const int *expiry, const int *remaining,
+                              int count, int today) {
+  int earliest = NO_LOT_KEY;
+  for (int i = 0; i < count; i++) {
+    // All ones if the lot is usable, zero otherwise
+    int mask = -((remaining[i] > 0) & (expiry[i] >= today));
+    int key = (expiry[i] & mask) | (NO_LOT_KEY & ~mask);
+    earliest = key < earliest ? key : earliest;
+  }
+  return earliest;
 }
 
 /**
- * @brief Finds the oldest valid lot from a list of lots.
+ * @brief Finds the oldest valid lot with available doses among some lots.
  *
- * @param lots Array of vaccine lots.
- * @param lotCount Number of lots.
- * @param currentDate The current date.
+ * Lots expiring on the same day are ordered by their batch identifier.
+ *
+ * @param lots The lots.
+ * @param expiry The expiry day number of each lot.
+ * @param remaining The doses each lot can still give.
+ * @param count The number of lots.
+ * @param today The current day number.
  * @return VaccineLot* The oldest valid lot, or NULL if none found.
  */
-static VaccineLot *findOldestValidLotFromList(VaccineLot **lots, int lotCount,
-                                              Date currentDate) {
+static VaccineLot *findOldestValidLot(VaccineLot *const *lots,
+                                      const int *expiry, const int *remaining,
+                                      int count, int today) {
+  int earliest = findEarliestExpiry(expiry, remaining, count, today);
+  if (earliest == NO_LOT_KEY)
+    return NULL;
+
   VaccineLot *oldestValidLot = NULL;
-  for (int i = 0; i < lotCount; i++) {
+  for (int i = 0; i < count; i++) {
+    if (expiry[i] != earliest || remaining[i] <= 0)
+      continue;
     VaccineLot *lot = lots[i];
-    if (isLotValidAndAvailable(lot, currentDate)) {
-      if (oldestValidLot == NULL || compareVaccines(lot, oldestValidLot) < 0) {
-        oldestValidLot = lot;
-      }
-    }
+    if (oldestValidLot == NULL || strcmp(lot->lot, oldestValidLot->lot) < 0)
+      oldestValidLot = lot;
   }
   return oldestValidLot;
 }
 
 /**
- * @brief Finds the oldest valid lot of a specific vaccine with available doses.
+ * @brief Picks the lot a dose comes from: the oldest valid lot of the
+ * vaccine at any site, or at the first of the given sites that has one.
  *
- * @param nameHashTable The hash table of vaccine names.
- * @param vaccineName The vaccine name.
+ * @param vaccineEntry The vaccine name entry.
+ * @param sites The sites in order of preference, or none for any site.
  * @param currentDate The current date.
- * @param hashSize The size of the hash table.
- * @return VaccineLot* The oldest valid lot, or NULL if none found.
+ * @return VaccineLot* The lot, or NULL if there is no stock.
  */
-static VaccineLot *findOldestValidLot(VaccineNameIndex **nameHashTable,
-                                      const char *vaccineName, Date currentDate,
-                                      int hashSize) {
-  VaccineNameIndex *vaccineEntry =
-      findVaccineByName(nameHashTable, vaccineName, hashSize);
-  if (vaccineEntry == NULL || vaccineEntry->lotCount == 0) {
-    return NULL; // Vaccine not found
+static VaccineLot *pickLot(const VaccineNameIndex *vaccineEntry,
+                           const SiteList *sites, Date currentDate) {
+  int today = dateToDayNumber(currentDate);
+  if (vaccineEntry->stock.available == 0)
+    return NULL;
+  if (sites->count == 0)
+    return findOldestValidLot(vaccineEntry->lots, vaccineEntry->lotExpiry,
+                              vaccineEntry->lotRemaining,
+                              vaccineEntry->lotCount, today);
+  for (int i = 0; i < sites->count; i++) {
+    const SiteShelf *shelf =
+        findSiteShelf(&vaccineEntry->stock, sites->sites[i]);
+    if (shelf == NULL || shelf->available == 0)
+      continue; // No doses left at the site
+    VaccineLot *lot = findOldestValidLot(shelf->lots, shelf->lotExpiry,
+                                         shelf->lotRemaining,
+                                         shelf->lotCount, today);
+    if (lot != NULL)
+      return lot;
   }
-  return findOldestValidLotFromList(vaccineEntry->lots, vaccineEntry->lotCount,
-                                    currentDate);
+  return NULL;
 }
 
 /**
  * @brief Handles the case when arguments are invalid for command A.
  *
+ * @param json The JSON writer.
  * @param portuguese Flag indicating if output should be in Portuguese.
  */
-static void handleInvalidArguments(int portuguese) {
-  if (portuguese)
-    printf("argumentos inválidos\n");
-  else
-    printf("invalid arguments\n");
+static void handleInvalidArguments(JsonWriter *json, int portuguese) {
+  reportError(json, 'a', "invalid_arguments", NULL,
+              portuguese ? "argumentos inválidos" : "invalid arguments");
+}
+
+/**
+ * @brief Handles the case when the site list is invalid.
+ *
+ * @param json The JSON writer.
+ * @param portuguese Flag indicating if output should be in Portuguese.
+ */
+static void handleInvalidSite(JsonWriter *json, int portuguese) {
+  reportError(json, 'a', "invalid_site", NULL,
+              portuguese ? "local inválido" : "invalid site");
 }
 
 /**
  * @brief Handles the case when the user is already vaccinated today.
  *
+ * @param json The JSON writer.
  * @param portuguese Flag indicating if output should be in Portuguese.
  */
-static void handleAlreadyVaccinated(int portuguese) {
-  if (portuguese)
-    printf("já vacinado\n");
-  else
-    printf("already vaccinated\n");
+static void handleAlreadyVaccinated(JsonWriter *json, int portuguese) {
+  reportError(json, 'a', "already_vaccinated", NULL,
+              portuguese ? "já vacinado" : "already vaccinated");
 }
 
 /**
  * @brief Handles the case when there is no stock of the requested vaccine.
  *
+ * @param json The JSON writer.
  * @param portuguese Flag indicating if output should be in Portuguese.
  */
-static void handleNoStock(int portuguese) {
-  if (portuguese)
-    printf("esgotado\n");
-  else
-    printf("no stock\n");
+static void handleNoStock(JsonWriter *json, int portuguese) {
+  reportError(json, 'a', "no_stock", NULL,
+              portuguese ? "esgotado" : "no stock");
 }
 
 /**
- * @brief Handles memory allocation failure during command A.
+ * @brief Handles the case when the dose comes before the series spacing.
  *
+ * @param json The JSON writer.
  * @param portuguese Flag indicating if output should be in Portuguese.
  */
-static void handleMemoryError(int portuguese) {
-  if (portuguese)
-    printf("sem memória\n");
-  else
-    printf("No memory\n");
+static void handleTooSoon(JsonWriter *json, int portuguese) {
+  reportError(json, 'a', "too_soon", NULL,
+              portuguese ? "demasiado cedo" : "too soon");
 }
 
 /**
  * @brief Applies the vaccine and updates the data structures.
  *
  * @param userName The name of the user.
+ * @param user The resolved user.
  * @param lot The vaccine lot to use.
  * @param currentDate The current date.
- * @param userHashTable The hash table of user indices.
  * @param inoculationList Pointer to the list of inoculations.
- * @param portuguese Flag indicating if output should be in Portuguese.
+ * @param engine The engine-wide state.
  */
-static void applyVaccine(const char *userName, VaccineLot *lot,
-                         Date currentDate, UserIndex **userHashTable,
-                         Inoculation **inoculationList, int portuguese) {
+static void applyVaccine(const char *userName, UserHandle *user,
+                         VaccineLot *lot, Date currentDate,
+                         Inoculation **inoculationList, EngineState *engine) {
   Inoculation *newInoc = createInoculation(userName, lot->lot, currentDate);
-  if (newInoc == NULL) {
-    handleMemoryError(portuguese);
-    return;
-  }
-  addInoculationToUserIndex(userHashTable, newInoc,
-                            HASH_SIZE); // HASH_SIZE is a global constant
+  // Nothing changed the user table since the lookup, so the slot is valid
+  UserIndex *userEntry = engineInsertUser(engine, user, userName);
+  addInoculationToUser(userEntry, newInoc);
   newInoc->next_global = *inoculationList;
   *inoculationList = newInoc;
   lot->dosesUsed++;
-  printf("%s\n", lot->lot);
-}
-
-/**
- * @brief Frees the memory allocated for userName and vaccineName.
- *
- * @param userName Pointer to the user name.
- * @param vaccineName Pointer to the vaccine name.
- */
-static void freeCommandAResources(char *userName, char *vaccineName) {
-  if (userName != NULL)
-    free(userName);
-  if (vaccineName != NULL)
-    free(vaccineName);
+  syncLotHotFields(lot);
+  engineRecordDose(engine, userEntry, lot, newInoc,
+                   dateToDayNumber(currentDate), user->hash);
+  reportText(&engine->json, 'a', "batch", lot->lot);
 }
 
 /**
  * @brief Handles the vaccine application process.
  *
+ * The user and the vaccine entry are looked up once and carried through the
+ * checks and the update.
+ *
  * @param userName The name of the user.
  * @param vaccineName The name of the vaccine.
+ * @param sites The sites the dose may come from, or none for any site.
  * @param nameHashTable The hash table of vaccine names.
  * @param userHashTable The hash table of user indices.
  * @param inoculationList Pointer to the list of inoculations.
  * @param hashSize The size of the hash tables.
  * @param currentDate The current date.
+ * @param engine The engine-wide state.
  * @param portuguese Flag indicating if output should be in Portuguese.
  */
 static void processVaccineApplication(char *userName, char *vaccineName,
+                                      const SiteList *sites,
                                       VaccineNameIndex **nameHashTable,
                                       UserIndex **userHashTable,
                                       Inoculation **inoculationList,
                                       int hashSize, Date currentDate,
-                                      int portuguese) {
-  if (isAlreadyVaccinated(userHashTable, nameHashTable, userName, vaccineName,
-                          currentDate, hashSize)) {
-    handleAlreadyVaccinated(portuguese);
-    freeCommandAResources(userName, vaccineName);
+                                      EngineState *engine, int portuguese) {
+  UserHandle user;
+  engineResolveUser(engine, userHashTable, userName, hashSize, &user);
+  VaccineNameIndex *vaccineEntry =
+      findVaccineByName(nameHashTable, vaccineName, hashSize);
+  if (vaccineEntry == NULL) {
+    handleNoStock(&engine->json, portuguese); // An unknown vaccine has no stock
+    return;
+  }
+
+  if (isAlreadyVaccinated(user.user, vaccineEntry, currentDate)) {
+    handleAlreadyVaccinated(&engine->json, portuguese);
+    return;
+  }
+
+  if (isSeriesDoseTooSoon(user.user, vaccineEntry,
+                          dateToDayNumber(currentDate))) {
+    handleTooSoon(&engine->json, portuguese);
     return;
   }
 
-  VaccineLot *lot =
-      findOldestValidLot(nameHashTable, vaccineName, currentDate, hashSize);
+  VaccineLot *lot = pickLot(vaccineEntry, sites, currentDate);
 
   if (lot == NULL) {
-    handleNoStock(portuguese);
-    freeCommandAResources(userName, vaccineName);
+    handleNoStock(&engine->json, portuguese);
     return;
   }
 
-  applyVaccine(userName, lot, currentDate, userHashTable, inoculationList,
-               portuguese);
-  freeCommandAResources(userName, vaccineName);
+  applyVaccine(userName, &user, lot, currentDate, inoculationList, engine);
+}
+
+/**
+ * @brief Applies a vaccine dose to a user, from the sites of a trailing site
+ * argument if the vaccine name has one.
+ *
+ * @param userName The name of the user.
+ * @param vaccineName The name of the vaccine, cut before any site argument.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param userHashTable The hash table of user indices.
+ * @param inoculationList Pointer to the list of inoculations.
+ * @param hashSize The size of the hash tables.
+ * @param currentDate The current date.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if output should be in Portuguese.
+ */
+void applyDose(char *userName, char *vaccineName,
+               VaccineNameIndex **nameHashTable, UserIndex **userHashTable,
+               Inoculation **inoculationList, int hashSize, Date currentDate,
+               EngineState *engine, int portuguese) {
+  SiteList sites = {NULL, 0};
+
+  // Extract the sites the dose may come from
+  char *siteText = splitSiteArgument(vaccineName);
+  if (siteText != NULL &&
+      !parseSiteList(siteText, &sites, &engine->scratch)) {
+    handleInvalidSite(&engine->json, portuguese);
+    return;
+  }
+
+  // Process the vaccine application
+  processVaccineApplication(userName, vaccineName, &sites, nameHashTable,
+                            userHashTable, inoculationList, hashSize,
+                            currentDate, engine, portuguese);
 }
 
 /**
  * @brief Command A: Applies a vaccine dose to a user.
  *
+ * A trailing site argument, such as @3 or @3,1,2, takes the dose from the
+ * first of the listed sites that has a valid lot. It must follow the vaccine
+ * name, so `a user @3` applies the vaccine named @3.
+ *
  * @param args The command arguments.
  * @param nameHashTable The hash table of vaccine names.
  * @param userHashTable The hash table of user indices.
  * @param inoculationList Pointer to the list of inoculations.
  * @param hashSize The size of the hash tables.
  * @param currentDate The current date.
+ * @param engine The engine-wide state.
  * @param portuguese Flag indicating if output should be in Portuguese.
  */
 void commandA(char *args, VaccineNameIndex **nameHashTable,
               UserIndex **userHashTable, Inoculation **inoculationList,
-              int hashSize, Date currentDate, int portuguese) {
+              int hashSize, Date currentDate, EngineState *engine,
+              int portuguese) {
   char *userName = NULL;
   char *vaccineName = NULL;
 
   // Extract user name and vaccine name from the arguments
-  if (!extractArguments(args, &userName, &vaccineName)) {
-    handleInvalidArguments(portuguese);
+  if (!extractArguments(args, &userName, &vaccineName, &engine->scratch)) {
+    handleInvalidArguments(&engine->json, portuguese);
     return;
   }
 
-  // Process the vaccine application
-  processVaccineApplication(userName, vaccineName, nameHashTable, userHashTable,
-                            inoculationList, hashSize, currentDate, portuguese);
-}
\ No newline at end of file
+  applyDose(userName, vaccineName, nameHashTable, userHashTable,
+            inoculationList, hashSize, currentDate, engine, portuguese);
+}
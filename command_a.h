@@ -13,6 +13,25 @@
  
  #include "project.h"
  
+ /**
+  * @brief Applies a vaccine dose to a user, from the sites of a trailing site
+  * argument if the vaccine name has one.
+  * 
+  * @param userName The name of the user.
+  * @param vaccineName The name of the vaccine, cut before any site argument.
+  * @param nameHashTable The hash table of vaccine names.
+  * @param userHashTable The hash table of user indices.
+  * @param inoculationList Pointer to the list of inoculations.
+  * @param hashSize The size of the hash tables.
+  * @param currentDate The current date.
+  * @param engine The engine-wide state.
+  * @param portuguese Flag indicating if output should be in Portuguese.
+  */
+ void applyDose(char* userName, char* vaccineName,
+                VaccineNameIndex** nameHashTable, UserIndex** userHashTable,
+                Inoculation** inoculationList, int hashSize, Date currentDate,
+                EngineState* engine, int portuguese);
+
  /**
   * @brief Applies a vaccine dose to a user.
   * 
@@ -26,10 +45,12 @@
   * @param inoculationList Pointer to the list of inoculations.
   * @param hashSize The size of the hash tables.
   * @param currentDate The current date.
+  * @param engine The engine-wide state.
   * @param portuguese Flag indicating if output should be in Portuguese.
   */
  void commandA(char* args, VaccineNameIndex** nameHashTable, 
                UserIndex** userHashTable, Inoculation** inoculationList, 
-               int hashSize, Date currentDate, int portuguese);
+               int hashSize, Date currentDate, EngineState* engine,
+               int portuguese);
  
  #endif
\ No newline at end of file
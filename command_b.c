@@ -0,0 +1,42 @@
+/**
+ * @file command_b.c
+ * @brief Implementation of command B functionality to open a what-if branch.
+ *
+ * This file contains the implementation of the commandB function. Opening a
+ * branch only marks the undo journal, so it takes constant time whatever the
+ * size of the system. Branches nest, and the new depth is printed.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "command_b.h"
+#include "constants.h"
+#include "journal.h"
+#include "project.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Command B: Opens a what-if branch.
+ *
+ * A branch is not a separate copy of the system: its changes are made to the
+ * live state and undone from the journal when the branch is dropped, so
+ * every command run until then sees them as if they were final. For the same
+ * reason a primary holds the commands of open branches back from its log,
+ * and its replicas only replay them once the branch is committed.
+ *
+ * @param args The command arguments (must be empty).
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandB(char *args, EngineState *engine, int portuguese) {
+  JsonWriter *json = &engine->json;
+  if (args != NULL && *args != '\0') {
+    reportError(json, 'b', "invalid_arguments", NULL,
+                portuguese ? "argumentos inválidos" : "invalid arguments");
+    return;
+  }
+  openBranch(engine);
+  reportNumber(json, 'b', "branches", engine->branchCount);
+}
@@ -0,0 +1,31 @@
+/**
+ * @file command_b.h
+ * @brief Header file for command B functionality to open a what-if branch.
+ *
+ * This file contains the declaration of the commandB function which opens a
+ * branch whose changes can later be dropped with command X.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef COMMAND_B_H
+#define COMMAND_B_H
+
+#include "project.h"
+
+/**
+ * @brief Opens a what-if branch.
+ *
+ * A branch is not a separate copy of the system: its changes are made to the
+ * live state and undone from the journal when the branch is dropped, so
+ * every command run until then sees them as if they were final. For the same
+ * reason a primary holds the commands of open branches back from its log,
+ * and its replicas only replay them once the branch is committed.
+ *
+ * @param args The command arguments (must be empty).
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandB(char *args, EngineState *engine, int portuguese);
+
+#endif
@@ -11,39 +11,23 @@
  */
 
 #include "constants.h"
+#include "journal.h"
 #include "project.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-/**
- * @brief Frees allocated memory for batch and name in case of parsing failure.
- *
- * @param batch Pointer to the batch identifier.
- * @param name Pointer to the vaccine name.
- */
-static void freeParseResources(char **batch, char **name) {
-  if (*batch) {
-    free(*batch);
-    *batch = NULL;
-  }
-
-  if (*name) {
-    free(*name);
-    *name = NULL;
-  }
-}
-
 /**
  * @brief Parses the batch identifier from the arguments.
  *
  * @param token The current token from the arguments.
  * @param batch Pointer to store the batch identifier.
+ * @param scratch The per-command scratch arena.
  * @return int 1 if successful, 0 otherwise.
  */
-static int parseBatch(char *token, char **batch) {
-  *batch = strdup(token);
-  return *batch != NULL;
+static int parseBatch(char *token, char **batch, ScratchArena *scratch) {
+  *batch = arenaStrdup(scratch, token);
+  return 1;
 }
 
 /**
@@ -66,43 +50,34 @@ static int parseValidationDate(char *token, Date *validation) {
  * @param validation Pointer to store the validation date.
  * @param doses Pointer to store the number of doses.
  * @param name Pointer to store the vaccine name.
+ * @param scratch The per-command scratch arena for the batch and name.
  * @return int 1 if the arguments were successfully parsed, 0 otherwise.
  */
 static int parseArgumentsC(char *args, char **batch, Date *validation,
-                           int *doses, char **name) {
+                           int *doses, char **name, ScratchArena *scratch) {
   char *token;
   char *rest = args;
 
   // Parse batch identifier
   token = strtok_r(rest, " ", &rest);
-  if (!token || !parseBatch(token, batch))
+  if (!token || !parseBatch(token, batch, scratch))
     return 0;
 
   // Parse validation date
   token = strtok_r(NULL, " ", &rest);
-  if (!token || !parseValidationDate(token, validation)) {
-    freeParseResources(batch, name);
+  if (!token || !parseValidationDate(token, validation))
     return 0;
-  }
 
   // Parse doses
   token = strtok_r(NULL, " ", &rest);
-  if (!token) {
-    freeParseResources(batch, name);
+  if (!token)
     return 0;
-  }
   *doses = atoi(token);
 
   // Parse vaccine name
-  if (!rest || *rest == '\0') {
-    freeParseResources(batch, name);
-    return 0;
-  }
-  *name = strdup(rest);
-  if (!*name) {
-    freeParseResources(batch, name);
+  if (!rest || *rest == '\0')
     return 0;
-  }
+  *name = arenaStrdup(scratch, rest);
 
   return 1;
 }
@@ -115,28 +90,34 @@ static int parseArgumentsC(char *args, char **batch, Date *validation,
  * @param doses The number of doses.
  * @param name The vaccine name.
  * @param currentDate The current date.
+ * @param json The JSON writer.
  * @param portuguese Flag indicating if the output should be in Portuguese.
  * @return int 1 if the arguments are valid, 0 otherwise.
  */
 static int validateNewVaccine(char *batch, Date validation, int doses,
-                              char *name, Date currentDate, int portuguese) {
+                              char *name, Date currentDate, JsonWriter *json,
+                              int portuguese) {
   if (!isValidBatch(batch)) {
-    printf("%s\n", portuguese ? "lote inválido" : "invalid batch");
+    reportError(json, 'c', "invalid_batch", NULL,
+                portuguese ? "lote inválido" : "invalid batch");
     return 0;
   }
 
   if (!isValidName(name)) {
-    printf("%s\n", portuguese ? "nome inválido" : "invalid name");
+    reportError(json, 'c', "invalid_name", NULL,
+                portuguese ? "nome inválido" : "invalid name");
     return 0;
   }
 
   if (!isValidDate(validation, currentDate)) {
-    printf("%s\n", portuguese ? "data inválida" : "invalid date");
+    reportError(json, 'c', "invalid_date", NULL,
+                portuguese ? "data inválida" : "invalid date");
     return 0;
   }
 
   if (doses <= 0) {
-    printf("%s\n", portuguese ? "quantidade inválida" : "invalid quantity");
+    reportError(json, 'c', "invalid_quantity", NULL,
+                portuguese ? "quantidade inválida" : "invalid quantity");
     return 0;
   }
 
@@ -150,36 +131,39 @@ static int validateNewVaccine(char *batch, Date validation, int doses,
  * @param name The vaccine name.
  * @param validation The validation date.
  * @param doses The number of doses.
+ * @param site The id of the site holding the lot.
  * @param hashTable The hash table of vaccine lots.
  * @param nameHashTable The hash table of vaccine names.
  * @param vaccineList The list of vaccine lots.
  * @param hashSize The size of the hash table.
  * @param vaccineCount The current count of vaccine lots.
  * @param maxVaccines The maximum number of vaccine lots allowed.
+ * @param json The JSON writer.
  * @param portuguese Flag indicating if the output should be in Portuguese.
+ * @return VaccineLot* The new lot, or NULL if it was not added.
  */
-static void addNewVaccineToSystem(char *batch, char *name, Date validation,
-                                  int doses, VaccineLot **hashTable,
-                                  VaccineNameIndex **nameHashTable,
-                                  VaccineLot **vaccineList, int hashSize,
-                                  int *vaccineCount, int maxVaccines,
-                                  int portuguese) {
+static VaccineLot *
+addNewVaccineToSystem(char *batch, char *name, Date validation, int doses,
+                      int site, VaccineLot **hashTable,
+                      VaccineNameIndex **nameHashTable,
+                      VaccineLot **vaccineList, int hashSize,
+                      int *vaccineCount, int maxVaccines, JsonWriter *json,
+                      int portuguese) {
   if (*vaccineCount >= maxVaccines) {
-    printf("%s\n", portuguese ? "demasiadas vacinas" : "too many vaccines");
-    return;
+    reportError(json, 'c', "too_many_vaccines", NULL,
+                portuguese ? "demasiadas vacinas" : "too many vaccines");
+    return NULL;
   }
   if (findVaccineByBatch(hashTable, batch, hashSize) != NULL) {
-    printf("%s\n",
-           portuguese ? "número de lote duplicado" : "duplicate batch number");
-    return;
+    reportError(json, 'c', "duplicate_batch", NULL,
+                portuguese ? "número de lote duplicado"
+                           : "duplicate batch number");
+    return NULL;
   }
 
   VaccineLot *newLot = createVaccineLot(batch, name, validation, doses);
-  if (!newLot) {
-    printf("%s\n", portuguese ? "sem memória" : "No memory");
-    return;
-  }
 
+  newLot->site = site;
   addVaccineLotToHash(hashTable, newLot, hashSize);
   addVaccineLotToNameIndex(nameHashTable, newLot, hashSize);
 
@@ -187,7 +171,70 @@ static void addNewVaccineToSystem(char *batch, char *name, Date validation,
   *vaccineList = newLot;
 
   (*vaccineCount)++;
-  printf("%s\n", batch);
+  reportText(json, 'c', "batch", batch);
+  return newLot;
+}
+
+/**
+ * @brief Reads the optional site argument after the vaccine name.
+ *
+ * @param name The vaccine name, cut before the site argument.
+ * @param site Pointer to store the site id, 0 if there is no site argument.
+ * @param json The JSON writer.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ * @return int 1 if the site is valid, 0 otherwise.
+ */
+static int parseLotSite(char *name, int *site, JsonWriter *json,
+                        int portuguese) {
+  char *siteText = splitSiteArgument(name);
+  *site = 0;
+  if (siteText == NULL || parseSiteId(siteText, site))
+    return 1;
+  reportError(json, 'c', "invalid_site", NULL,
+              portuguese ? "local inválido" : "invalid site");
+  return 0;
+}
+
+/**
+ * @brief Adds a vaccine batch with parsed arguments to the system.
+ *
+ * @param batch The batch identifier.
+ * @param validation The validation date.
+ * @param doses The number of doses.
+ * @param name The vaccine name, with any site argument after it.
+ * @param hashTable The hash table of vaccine lots.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param vaccineList The list of vaccine lots.
+ * @param hashSize The size of the hash table.
+ * @param vaccineCount The current count of vaccine lots.
+ * @param maxVaccines The maximum number of vaccine lots allowed.
+ * @param currentDate The current date.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void addVaccineLot(char *batch, Date validation, int doses, char *name,
+                   VaccineLot **hashTable, VaccineNameIndex **nameHashTable,
+                   VaccineLot **vaccineList, int hashSize, int *vaccineCount,
+                   int maxVaccines, Date currentDate, EngineState *engine,
+                   int portuguese) {
+  int site = 0;
+  if (!parseLotSite(name, &site, &engine->json, portuguese) ||
+      !validateNewVaccine(batch, validation, doses, name, currentDate,
+                          &engine->json, portuguese))
+    return;
+
+  int nameCreated = findVaccineByName(nameHashTable, name, hashSize) == NULL;
+  VaccineLot *newLot = addNewVaccineToSystem(
+      batch, name, validation, doses, site, hashTable, nameHashTable,
+      vaccineList, hashSize, vaccineCount, maxVaccines, &engine->json,
+      portuguese);
+  if (newLot != NULL) {
+    newLot->createdDay = dateToDayNumber(currentDate);
+    journalLotCreated(engine, newLot, nameCreated);
+    emitChange(&engine->changes, CHANGE_LOT_CREATED, newLot->createdDay,
+               doses, newLot, NULL);
+    engine->catalogEpoch++;
+  }
 }
 
 /**
@@ -201,33 +248,26 @@ static void addNewVaccineToSystem(char *batch, char *name, Date validation,
  * @param vaccineCount The current count of vaccine lots.
  * @param maxVaccines The maximum number of vaccine lots allowed.
  * @param currentDate The current date.
+ * @param engine The engine-wide state.
  * @param portuguese Flag indicating if the output should be in Portuguese.
  */
 void commandC(char *args, VaccineLot **hashTable,
               VaccineNameIndex **nameHashTable, VaccineLot **vaccineList,
               int hashSize, int *vaccineCount, int maxVaccines,
-              Date currentDate, int portuguese) {
+              Date currentDate, EngineState *engine, int portuguese) {
   char *batch = NULL;
   Date validation;
   int doses = 0;
   char *name = NULL;
 
-  if (!parseArgumentsC(args, &batch, &validation, &doses, &name)) {
-    printf("%s\n", portuguese ? "sem memória" : "No memory");
-    return;
-  }
-
-  if (!validateNewVaccine(batch, validation, doses, name, currentDate,
-                          portuguese)) {
-    free(batch);
-    free(name);
+  if (!parseArgumentsC(args, &batch, &validation, &doses, &name,
+                       &engine->scratch)) {
+    reportError(&engine->json, 'c', "invalid_arguments", NULL,
+                portuguese ? "sem memória" : "No memory");
     return;
   }
 
-  addNewVaccineToSystem(batch, name, validation, doses, hashTable,
-                        nameHashTable, vaccineList, hashSize, vaccineCount,
-                        maxVaccines, portuguese);
-
-  free(batch);
-  free(name);
-}
\ No newline at end of file
+  addVaccineLot(batch, validation, doses, name, hashTable, nameHashTable,
+                vaccineList, hashSize, vaccineCount, maxVaccines, currentDate,
+                engine, portuguese);
+}
@@ -13,6 +13,29 @@
 
 #include "project.h"
 
+ /**
+  * @brief Adds a vaccine batch with parsed arguments to the system.
+  * 
+  * @param batch The batch identifier.
+  * @param validation The validation date.
+  * @param doses The number of doses.
+  * @param name The vaccine name, with any site argument after it.
+  * @param hashTable The hash table of vaccine lots.
+  * @param nameHashTable The hash table of vaccine names.
+  * @param vaccineList The list of vaccine lots.
+  * @param hashSize The size of the hash table.
+  * @param vaccineCount The current count of vaccine lots.
+  * @param maxVaccines The maximum number of vaccine lots allowed.
+  * @param currentDate The current date.
+  * @param engine The engine-wide state.
+  * @param portuguese Flag indicating if the output should be in Portuguese.
+  */
+void addVaccineLot(char *batch, Date validation, int doses, char *name,
+                   VaccineLot **hashTable, VaccineNameIndex **nameHashTable,
+                   VaccineLot **vaccineList, int hashSize, int *vaccineCount,
+                   int maxVaccines, Date currentDate, EngineState *engine,
+                   int portuguese);
+
  /**
   * @brief Adds a new vaccine batch to the system.
   * 
@@ -24,10 +47,12 @@
   * @param vaccineCount The current count of vaccine lots.
   * @param maxVaccines The maximum number of vaccine lots allowed.
   * @param currentDate The current date.
+  * @param engine The engine-wide state.
   * @param portuguese Flag indicating if the output should be in Portuguese.
   */
 void commandC(char *args, VaccineLot **hashTable, VaccineNameIndex **nameHashTable,
               VaccineLot **vaccineList, int hashSize, int *vaccineCount,
-              int maxVaccines, Date currentDate, int portuguese);
+              int maxVaccines, Date currentDate, EngineState *engine,
+              int portuguese);
 
 #endif
\ No newline at end of file
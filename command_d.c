@@ -11,20 +11,16 @@
  */
 
 #include "command_d.h"
+#include "charclass.h"
 #include "constants.h"
+#include "engine.h"
+#include "history.h"
+#include "journal.h"
 #include "project.h"
-#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-/**
- * @brief Frees the memory allocated for the arguments.
- *
- * @param args The processed arguments.
- */
-static void freeDeleteArgs(DeleteArgs *args);
-
 /**
  * @brief Checks if a date has a valid format.
  *
@@ -71,39 +67,33 @@ static int isDateFuture(Date date, Date currentDate) {
  * @param currentDate The current date for comparison.
  * @param valid Pointer to an integer flag to indicate if parsing and validation
  * were successful.
+ * @param json The JSON writer.
  * @param portuguese Flag indicating if error messages should be in Portuguese.
+ * @param scratch The per-command scratch arena.
  * @return Date* A pointer to the parsed Date structure, or NULL if parsing
  * fails or the date is invalid.
  */
 static Date *parseDateString(const char *dateStr, Date currentDate, int *valid,
-                             int portuguese) {
+                             JsonWriter *json, int portuguese,
+                             ScratchArena *scratch) {
   if (!dateStr) {
     return NULL;
   }
-  Date *date = (Date *)malloc(sizeof(Date));
-  if (!date) {
-    return NULL;
-  }
+  Date *date = (Date *)arenaAlloc(scratch, sizeof(Date));
 
   // Attempt to parse the date string using sscanf
   if (sscanf(dateStr, "%d-%d-%d", &date->day, &date->month, &date->year) != 3) {
-    free(date);
     *valid = 0;
-    if (portuguese)
-      printf("data inválida\n");
-    else
-      printf("invalid date\n");
+    reportError(json, 'd', "invalid_date", NULL,
+                portuguese ? "data inválida" : "invalid date");
     return NULL;
   }
 
   // Validate the parsed date format and ensure it's not in the future
   if (!isDateFormatValid(*date) || isDateFuture(*date, currentDate)) {
-    free(date);
     *valid = 0;
-    if (portuguese)
-      printf("data inválida\n");
-    else
-      printf("invalid date\n");
+    reportError(json, 'd', "invalid_date", NULL,
+                portuguese ? "data inválida" : "invalid date");
     return NULL;
   }
   return date;
@@ -116,14 +106,14 @@ static Date *parseDateString(const char *dateStr, Date currentDate, int *valid,
  * @param args A working copy of the command arguments string.
  * @param deleteArgs A pointer to the DeleteArgs structure to store the parsed
  * user name.
+ * @param scratch The per-command scratch arena.
  * @return char* A pointer to the rest of the arguments string after the user
  * name, or NULL on error.
  */
-static char *parseUserName(char *args, DeleteArgs *deleteArgs) {
-  char *ptr = args;
+static char *parseUserName(char *args, DeleteArgs *deleteArgs,
+                           ScratchArena *scratch) {
   // Skip leading whitespace
-  while (*ptr && isspace(*ptr))
-    ptr++;
+  char *ptr = skipSpaces(args);
   char *username_start;
   char *username_end;
   // Handle quoted user name
@@ -137,27 +127,14 @@ static char *parseUserName(char *args, DeleteArgs *deleteArgs) {
   } else {
     // Handle unquoted user name
     username_start = ptr;
-    while (*ptr && !isspace(*ptr))
-      ptr++;
+    ptr = skipToken(ptr);
     if (*ptr)
       *ptr++ = '\0'; // Terminate the user name
     username_end = ptr;
   }
 
-  // Allocate memory and copy the extracted user name
-  deleteArgs->userName = strdup(username_start);
-  return ptr;
-}
-
-/**
- * @brief Skips leading whitespace in the input string.
- *
- * @param ptr Pointer to the input string.
- * @return char* Pointer to the first non-whitespace character.
- */
-static char *skipWhitespace(char *ptr) {
-  while (*ptr && isspace(*ptr))
-    ptr++;
+  // Copy the extracted user name
+  deleteArgs->userName = arenaStrdup(scratch, username_start);
   return ptr;
 }
 
@@ -171,8 +148,7 @@ static char *skipWhitespace(char *ptr) {
  */
 static char *extractDateString(char *ptr, char *date_str, int *valid) {
   char *date_start = ptr;
-  while (*ptr && !isspace(*ptr))
-    ptr++;
+  ptr = skipToken(ptr);
   size_t date_len = ptr - date_start;
   if (date_len >= 32) { // Ensure the date string fits in the buffer
     *valid = 0;
@@ -188,14 +164,12 @@ static char *extractDateString(char *ptr, char *date_str, int *valid) {
  *
  * @param ptr Pointer to the input string.
  * @param deleteArgs Pointer to the DeleteArgs structure to store the lot ID.
- * @param valid Pointer to the validity flag.
+ * @param scratch The per-command scratch arena.
  */
-static void extractLotId(char *ptr, DeleteArgs *deleteArgs, int *valid) {
-  if (*ptr) {
-    deleteArgs->lotId = strdup(ptr);
-    if (!deleteArgs->lotId)
-      *valid = 0; // Memory allocation failure
-  }
+static void extractLotId(char *ptr, DeleteArgs *deleteArgs,
+                         ScratchArena *scratch) {
+  if (*ptr)
+    deleteArgs->lotId = arenaStrdup(scratch, ptr);
 }
 
 /**
@@ -207,31 +181,37 @@ static void extractLotId(char *ptr, DeleteArgs *deleteArgs, int *valid) {
  * date and lot ID.
  * @param currentDate The current date for date validation.
  * @param valid Pointer to an integer flag to indicate validity.
+ * @param json The JSON writer.
  * @param portuguese Flag indicating if error messages should be in Portuguese.
+ * @param scratch The per-command scratch arena.
  */
 static void parseDateAndLotId(char *ptr, DeleteArgs *deleteArgs,
-                              Date currentDate, int *valid, int portuguese) {
+                              Date currentDate, int *valid, JsonWriter *json,
+                              int portuguese, ScratchArena *scratch) {
   // Skip leading whitespace
-  ptr = skipWhitespace(ptr);
+  ptr = skipSpaces(ptr);
 
   // Check if there is a date argument
   if (*ptr) {
     char date_str[32]; // Buffer to hold the date string
     ptr = extractDateString(ptr, date_str, valid);
-    if (!*valid || !ptr)
+    if (!*valid || !ptr) {
+      reportError(json, 'd', "invalid_date", NULL, NULL);
       return;
+    }
 
     // Parse the date string
     deleteArgs->date =
-        parseDateString(date_str, currentDate, valid, portuguese);
+        parseDateString(date_str, currentDate, valid, json, portuguese,
+                        scratch);
     if (!*valid || !deleteArgs->date)
       return;
 
     // Skip whitespace to find the lot ID
-    ptr = skipWhitespace(ptr);
+    ptr = skipSpaces(ptr);
 
     // Extract the lot ID
-    extractLotId(ptr, deleteArgs, valid);
+    extractLotId(ptr, deleteArgs, scratch);
   }
 }
 
@@ -243,41 +223,36 @@ static void parseDateAndLotId(char *ptr, DeleteArgs *deleteArgs,
  * @param currentDate The current date for validation.
  * @param valid Pointer to an integer flag to indicate if the arguments are
  * valid.
+ * @param json The JSON writer.
  * @param portuguese Flag indicating if error messages should be in Portuguese.
+ * @param scratch The per-command scratch arena for the arguments.
  * @return DeleteArgs* A pointer to the structure containing the processed
  * arguments, or NULL if invalid.
  */
 static DeleteArgs *processDeleteArgs(char *args, Date currentDate, int *valid,
-                                     int portuguese) {
+                                     JsonWriter *json, int portuguese,
+                                     ScratchArena *scratch) {
   *valid = 1;
-  DeleteArgs *deleteArgs = (DeleteArgs *)malloc(sizeof(DeleteArgs));
-  if (!deleteArgs)
-    return NULL;
+  DeleteArgs *deleteArgs =
+      (DeleteArgs *)arenaAlloc(scratch, sizeof(DeleteArgs));
   deleteArgs->userName = NULL;
   deleteArgs->date = NULL;
   deleteArgs->lotId = NULL;
   // Create a working copy of the arguments to avoid modifying the original
-  char *args_copy = strdup(args);
-  if (!args_copy) {
-    free(deleteArgs);
-    return NULL;
-  }
+  char *args_copy = arenaStrdup(scratch, args);
   // Parse the user name
-  char *ptr = parseUserName(args_copy, deleteArgs);
+  char *ptr = parseUserName(args_copy, deleteArgs, scratch);
   if (!deleteArgs->userName || !ptr) {
-    free(args_copy);
-    freeDeleteArgs(deleteArgs);
     *valid = 0;
+    reportError(json, 'd', "invalid_arguments", NULL, NULL);
     return NULL;
   }
   // Parse the date and lot ID
-  parseDateAndLotId(ptr, deleteArgs, currentDate, valid, portuguese);
-  free(args_copy);
-  // If any parsing or validation failed, free allocated memory and return NULL
-  if (!*valid) {
-    freeDeleteArgs(deleteArgs);
+  parseDateAndLotId(ptr, deleteArgs, currentDate, valid, json, portuguese,
+                    scratch);
+  // If any parsing or validation failed, return NULL
+  if (!*valid)
     return NULL;
-  }
   return deleteArgs;
 }
 
@@ -319,23 +294,25 @@ static int inoculationMatchesCriteria(const Inoculation *inoc,
 }
 
 /**
- * @brief Removes an inoculation record from the user's index.
+ * @brief Removes an inoculation record from the user's index, keeping the
+ * rest in chronological order.
  *
  * @param userEntry Pointer to the user's index.
  * @param toRemove Pointer to the inoculation record to remove.
+ * @return int The index the record had in the user's array, or -1.
  */
-static void removeInoculationFromUser(UserIndex *userEntry,
-                                      Inoculation *toRemove) {
+static int removeInoculationFromUser(UserIndex *userEntry,
+                                     Inoculation *toRemove) {
   for (int i = 0; i < userEntry->inoculationCount; i++) {
     if (userEntry->inoculations[i] == toRemove) {
-      // Replace the removed element with the last element and decrement the
-      // count
-      userEntry->inoculations[i] =
-          userEntry->inoculations[userEntry->inoculationCount - 1];
+      // Shift the later records down, as command U prints them in this order
       userEntry->inoculationCount--;
-      break;
+      memmove(&userEntry->inoculations[i], &userEntry->inoculations[i + 1],
+              (userEntry->inoculationCount - i) * sizeof(Inoculation *));
+      return i;
     }
   }
+  return -1;
 }
 
 /**
@@ -346,69 +323,163 @@ static void removeInoculationFromUser(UserIndex *userEntry,
  * @param curr Pointer to the current inoculation in the list.
  * @return Inoculation* Pointer to the next inoculation in the list.
  */
-static Inoculation *
-removeInoculationFromGlobalList(Inoculation **inoculationList,
-                                Inoculation *prev, Inoculation *curr) {
+static Inoculation *removeInoculationFromGlobalList(
+    Inoculation **inoculationList, Inoculation *prev, Inoculation *curr) {
   if (prev)
     prev->next_global = curr->next_global;
   else
     *inoculationList = curr->next_global;
+  return curr->next_global;
+}
 
-  Inoculation *next = curr->next_global;
-  freeInoculation(curr);
-  return next;
+/**
+ * @brief Records the vaccine of a deleted inoculation's lot, once per vaccine.
+ *
+ * @param lot The lot of the deleted inoculation (may be NULL).
+ * @param affected Array of the vaccines recorded so far.
+ * @param affectedCount Pointer to the number of vaccines recorded so far.
+ * @return VaccineNameIndex* The vaccine of the lot, or NULL if unknown.
+ */
+static VaccineNameIndex *noteAffectedVaccine(const VaccineLot *lot,
+                                             VaccineNameIndex **affected,
+                                             int *affectedCount) {
+  if (lot == NULL || lot->nameEntry == NULL)
+    return NULL;
+  for (int i = 0; i < *affectedCount; i++) {
+    if (affected[i] == lot->nameEntry)
+      return lot->nameEntry;
+  }
+  affected[(*affectedCount)++] = lot->nameEntry;
+  return lot->nameEntry;
+}
+
+/**
+ * @brief Keeps an inoculation, already taken out of the user's index, in the
+ * user's deleted records and updates the indexes that counted it.
+ *
+ * @param engine The engine-wide state.
+ * @param userEntry The user's index entry.
+ * @param inoc The deleted inoculation.
+ * @param position The index it had in the user's array, or in the user's
+ * sealed doses if its row was sealed.
+ * @param lot The inoculation's lot (may be NULL).
+ * @param affected Array of the vaccines of the deleted inoculations.
+ * @param affectedCount Pointer to the number of affected vaccines.
+ * @param today The current day number.
+ */
+static void retireDeletedInoculation(EngineState *engine,
+                                     UserIndex *userEntry, Inoculation *inoc,
+                                     int position, VaccineLot *lot,
+                                     VaccineNameIndex **affected,
+                                     int *affectedCount, int today) {
+  VaccineNameIndex *vaccine = noteAffectedVaccine(lot, affected,
+                                                  affectedCount);
+  journalDeletion(engine, userEntry, inoc, position, lot);
+  if (vaccine != NULL)
+    engineRecordDeletion(engine, vaccine, dateToDayNumber(inoc->date));
+  emitChange(&engine->changes, CHANGE_DELETION, today, 1, lot, userEntry);
+  retireInoculation(engine, userEntry, inoc, today);
 }
 
 /**
- * @brief Removes inoculation records that match the deletion criteria.
+ * @brief Checks if a sealed dose of the user named in the deletion criteria
+ * matches them.
+ *
+ * @param dose The sealed dose.
+ * @param args A pointer to the DeleteArgs structure containing the deletion
+ * criteria.
+ * @return int 1 if the dose matches the criteria, 0 otherwise.
+ */
+static int sealedDoseMatchesCriteria(const SealedDose *dose,
+                                     const DeleteArgs *args) {
+  if (!args->date)
+    return 1;
+  if (dose->date !=
+      packDate(args->date->day, args->date->month, args->date->year))
+    return 0;
+  return !args->lotId || strcmp(dose->lot->lot, args->lotId) == 0;
+}
+
+/**
+ * @brief Removes the user's sealed doses that match the deletion criteria,
+ * newest first, turning each back into a record kept with the deleted ones.
+ *
+ * @param userEntry The index entry of the user named in the criteria.
+ * @param args A pointer to the DeleteArgs structure containing the deletion
+ * criteria.
+ * @param affected Array to store the vaccines of the removed doses.
+ * @param affectedCount Pointer to store the number of affected vaccines.
+ * @param engine The engine-wide state.
+ * @param today The current day number.
+ * @return int The number of sealed doses that were removed.
+ */
+static int removeMatchingSealedDoses(UserIndex *userEntry, DeleteArgs *args,
+                                     VaccineNameIndex **affected,
+                                     int *affectedCount, EngineState *engine,
+                                     int today) {
+  int count = 0;
+  for (int i = userEntry->sealedCount - 1; i >= 0; i--) {
+    SealedDose dose = userEntry->sealed[i];
+    if (!sealedDoseMatchesCriteria(&dose, args))
+      continue;
+    Date date;
+    unpackDate(dose.date, &date.day, &date.month, &date.year);
+    Inoculation *inoc =
+        createInoculation(args->userName, dose.lot->lot, date);
+    inoc->sequence = dose.row;
+    removeSealedDose(userEntry, i);
+    retireDeletedInoculation(engine, userEntry, inoc, i, dose.lot, affected,
+                             affectedCount, today);
+    count++;
+  }
+  return count;
+}
+
+/**
+ * @brief Removes inoculation records that match the deletion criteria, and
+ * then the matching sealed doses.
  *
  * @param inoculationList A pointer to the head of the global inoculation list.
- * @param userHashTable The hash table of user indices.
+ * @param userEntry The index entry of the user named in the criteria.
+ * @param hashTable The hash table of vaccine lots.
  * @param args A pointer to the DeleteArgs structure containing the deletion
  * criteria.
  * @param hashSize The size of the hash table.
- * @return int The number of inoculation records that were removed.
+ * @param affected Array to store the vaccines of the removed records.
+ * @param affectedCount Pointer to store the number of affected vaccines.
+ * @param engine The engine-wide state.
+ * @param today The current day number.
+ * @return int The number of records and sealed doses that were removed.
  */
 static int removeMatchingInoculations(Inoculation **inoculationList,
-                                      UserIndex **userHashTable,
-                                      DeleteArgs *args, int hashSize) {
+                                      UserIndex *userEntry,
+                                      VaccineLot **hashTable, DeleteArgs *args,
+                                      int hashSize, VaccineNameIndex **affected,
+                                      int *affectedCount, EngineState *engine,
+                                      int today) {
   int count = 0;
   Inoculation *curr = *inoculationList;
   Inoculation *prev = NULL;
 
-  // Find the user entry in the hash table
-  UserIndex *userEntry =
-      findUserByName(userHashTable, args->userName, hashSize);
-  if (!userEntry)
-    return 0; // User not found (shouldn't happen at this point)
-
   // Iterate through the global inoculation list
   while (curr) {
     if (inoculationMatchesCriteria(curr, args)) {
       count++;
-      removeInoculationFromUser(userEntry, curr);
-      curr = removeInoculationFromGlobalList(inoculationList, prev, curr);
+      VaccineLot *lot = findVaccineByBatch(hashTable, curr->lot, hashSize);
+      int position = removeInoculationFromUser(userEntry, curr);
+      Inoculation *next =
+          removeInoculationFromGlobalList(inoculationList, prev, curr);
+      retireDeletedInoculation(engine, userEntry, curr, position, lot,
+                               affected, affectedCount, today);
+      curr = next;
     } else {
       prev = curr;
       curr = curr->next_global;
     }
   }
 
-  return count;
-}
-
-/**
- * @brief Frees the memory allocated for the DeleteArgs structure.
- *
- * @param args A pointer to the DeleteArgs structure.
- */
-static void freeDeleteArgs(DeleteArgs *args) {
-  if (args) {
-    free(args->userName);
-    free(args->date);
-    free(args->lotId);
-    free(args);
-  }
+  return count + removeMatchingSealedDoses(userEntry, args, affected,
+                                           affectedCount, engine, today);
 }
 
 /**
@@ -416,16 +487,16 @@ static void freeDeleteArgs(DeleteArgs *args) {
  *
  * @param userEntry Pointer to the user's index.
  * @param deleteArgs Pointer to the DeleteArgs structure.
+ * @param json The JSON writer.
  * @param portuguese Flag indicating if the output should be in Portuguese.
  * @return int 1 if valid, 0 otherwise.
  */
 static int validateUser(UserIndex *userEntry, DeleteArgs *deleteArgs,
-                        int portuguese) {
-  if (!userEntry || userEntry->inoculationCount == 0) {
-    if (portuguese)
-      printf("%s: utente inexistente\n", deleteArgs->userName);
-    else
-      printf("%s: no such user\n", deleteArgs->userName);
+                        JsonWriter *json, int portuguese) {
+  if (!userEntry ||
+      userEntry->inoculationCount + userEntry->sealedCount == 0) {
+    reportError(json, 'd', "no_such_user", deleteArgs->userName,
+                portuguese ? "utente inexistente" : "no such user");
     return 0;
   }
   return 1;
@@ -437,17 +508,16 @@ static int validateUser(UserIndex *userEntry, DeleteArgs *deleteArgs,
  * @param deleteArgs Pointer to the DeleteArgs structure.
  * @param hashTable The hash table of vaccine lots.
  * @param hashSize The size of the hash table.
+ * @param json The JSON writer.
  * @param portuguese Flag indicating if the output should be in Portuguese.
  * @return int 1 if valid, 0 otherwise.
  */
 static int validateLot(DeleteArgs *deleteArgs, VaccineLot **hashTable,
-                       int hashSize, int portuguese) {
+                       int hashSize, JsonWriter *json, int portuguese) {
   if (deleteArgs->lotId != NULL &&
       !findVaccineByBatch(hashTable, deleteArgs->lotId, hashSize)) {
-    if (portuguese)
-      printf("%s: lote inexistente\n", deleteArgs->lotId);
-    else
-      printf("%s: no such batch\n", deleteArgs->lotId);
+    reportError(json, 'd', "no_such_batch", deleteArgs->lotId,
+                portuguese ? "lote inexistente" : "no such batch");
     return 0;
   }
   return 1;
@@ -463,40 +533,45 @@ static int validateLot(DeleteArgs *deleteArgs, VaccineLot **hashTable,
  * @param hashTable The hash table of vaccine lots.
  * @param hashSize The size of the hash tables.
  * @param currentDate The current date.
+ * @param engine The engine-wide state.
  * @param portuguese Flag indicating if the output should be in Portuguese.
  */
 void commandD(char *args, Inoculation **inoculationList,
               UserIndex **userHashTable, VaccineLot **hashTable, int hashSize,
-              Date currentDate, int portuguese) {
+              Date currentDate, EngineState *engine, int portuguese) {
   int valid = 1;
 
   // Process the command arguments
   DeleteArgs *deleteArgs =
-      processDeleteArgs(args, currentDate, &valid, portuguese);
+      processDeleteArgs(args, currentDate, &valid, &engine->json, portuguese,
+                        &engine->scratch);
   if (!valid || !deleteArgs)
     return;
 
   // Validate user existence
   UserIndex *userEntry =
-      findUserByName(userHashTable, deleteArgs->userName, hashSize);
-  if (!validateUser(userEntry, deleteArgs, portuguese)) {
-    freeDeleteArgs(deleteArgs);
+      engineFindUser(engine, userHashTable, deleteArgs->userName, hashSize);
+  if (!validateUser(userEntry, deleteArgs, &engine->json, portuguese))
     return;
-  }
 
   // Validate vaccine lot existence
-  if (!validateLot(deleteArgs, hashTable, hashSize, portuguese)) {
-    freeDeleteArgs(deleteArgs);
+  if (!validateLot(deleteArgs, hashTable, hashSize, &engine->json,
+                   portuguese))
     return;
-  }
 
   // Remove the inoculations that match the criteria
-  int removed = removeMatchingInoculations(inoculationList, userHashTable,
-                                           deleteArgs, hashSize);
+  VaccineNameIndex **affected = (VaccineNameIndex **)arenaAlloc(
+      &engine->scratch,
+      (userEntry->inoculationCount + userEntry->sealedCount) *
+          sizeof(VaccineNameIndex *));
+  int affectedCount = 0;
+  int removed = removeMatchingInoculations(inoculationList, userEntry,
+                                           hashTable, deleteArgs, hashSize,
+                                           affected, &affectedCount, engine,
+                                           dateToDayNumber(currentDate));
+  if (removed > 0)
+    engineRefreshUser(engine, userEntry, affected, affectedCount);
 
   // Print the number of removed records
-  printf("%d\n", removed);
-
-  // Free the memory allocated for the arguments
-  freeDeleteArgs(deleteArgs);
+  reportNumber(&engine->json, 'd', "deleted", removed);
 }
\ No newline at end of file
@@ -31,10 +31,12 @@
   * @param hashTable The hash table of vaccine lots.
   * @param hashSize The size of the hash tables.
   * @param currentDate The current date.
+  * @param engine The engine-wide state.
   * @param portuguese Flag indicating if the output should be in Portuguese.
   */
  void commandD(char *args, Inoculation **inoculationList,
                UserIndex **userHashTable, VaccineLot **hashTable,
-               int hashSize, Date currentDate, int portuguese);
+               int hashSize, Date currentDate, EngineState *engine,
+               int portuguese);
  
  #endif
\ No newline at end of file
@@ -0,0 +1,141 @@
+/**
+ * @file command_e.c
+ * @brief Implementation of command E functionality to consume the change
+ * feed.
+ *
+ * This file contains the implementation of the commandE function. The input
+ * is `e` to add a consumer, whose id is printed, `e <id>` to print the
+ * changes that consumer has not read yet, one per line as
+ * `<sequence> <kind> <date> <batch> <user> <amount>` with `-` for a missing
+ * field, or `e sink <file>` to append the changes to a binary file. The
+ * number of changes already published is printed when the sink is attached.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "command_e.h"
+#include "changes.h"
+#include "charclass.h"
+#include "constants.h"
+#include "project.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Prints a change, or writes it as an element of the JSON changes
+ * array, with an empty batch or user when it has none.
+ *
+ * @param json The JSON writer.
+ * @param event The change.
+ */
+static void printChange(JsonWriter *json, const ChangeEvent *event) {
+  static const char *const kinds[] = {
+      [CHANGE_DATE] = "date",           [CHANGE_LOT_CREATED] = "lot",
+      [CHANGE_DOSE] = "dose",           [CHANGE_LOT_WITHDRAWN] = "withdrawn",
+      [CHANGE_LOT_REDUCED] = "reduced", [CHANGE_DELETION] = "deleted"};
+  const char *none = json->enabled ? "" : "-";
+  const char *batch = event->lot != NULL ? event->lot->lot : none;
+  char name[NUMERIC_NAME_SIZE];
+  const char *user =
+      event->user != NULL ? userNameText(event->user, name) : none;
+  Date date = dayNumberToDate(event->day);
+  if (!json->enabled) {
+    fprintf(json->out, "%lu %s %02d-%02d-%d %s %s %d\n", event->sequence,
+            kinds[event->kind], date.day, date.month, date.year, batch, user,
+            event->amount);
+    return;
+  }
+  jsonOpen(json, NULL, '{');
+  jsonInteger(json, "sequence", (long)event->sequence);
+  jsonString(json, "kind", kinds[event->kind]);
+  jsonDate(json, "date", date.day, date.month, date.year);
+  jsonString(json, "batch", batch);
+  jsonString(json, "user", user);
+  jsonInteger(json, "amount", event->amount);
+  jsonClose(json, '}');
+}
+
+/**
+ * @brief Prints the changes a consumer has not read yet, or writes them as
+ * the fields of a JSON object.
+ *
+ * @param json The JSON writer.
+ * @param feed The change feed.
+ * @param consumer The consumer's id.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+static void printUnreadChanges(JsonWriter *json, ChangeFeed *feed,
+                               int consumer, int portuguese) {
+  ChangeEvent event;
+  unsigned long lost = 0;
+  int read = readChange(feed, consumer, &event, &lost);
+  if (json->enabled) {
+    jsonBegin(json, 'e');
+    jsonInteger(json, "lost", (long)lost);
+    jsonOpen(json, "changes", '[');
+  } else if (lost > 0) {
+    fprintf(json->out, "%s %lu\n", portuguese ? "perdidos" : "lost", lost);
+  }
+  for (; read; read = readChange(feed, consumer, &event, &lost))
+    printChange(json, &event);
+  if (json->enabled) {
+    jsonClose(json, ']');
+    jsonEnd(json);
+  }
+}
+
+/**
+ * @brief Attaches a binary sink file to the change feed.
+ *
+ * @param json The JSON writer.
+ * @param feed The change feed.
+ * @param path The path of the sink file.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+static void attachSink(JsonWriter *json, ChangeFeed *feed, const char *path,
+                       int portuguese) {
+  if (*path == '\0')
+    reportError(json, 'e', "invalid_arguments", NULL,
+                portuguese ? "argumentos inválidos" : "invalid arguments");
+  else if (!openChangeSink(feed, path))
+    reportError(json, 'e', "cannot_open_file", path,
+                portuguese ? "impossível abrir" : "cannot open file");
+  else
+    reportNumber(json, 'e', "published", (long)feed->published);
+}
+
+/**
+ * @brief Command E: Adds, reads or attaches a sink to the change feed.
+ *
+ * @param args The command arguments.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandE(char *args, EngineState *engine, int portuguese) {
+  JsonWriter *json = &engine->json;
+  ChangeFeed *feed = &engine->changes;
+  char *rest = skipToken(args);
+  if (*rest != '\0')
+    *rest++ = '\0';
+  rest = skipSpaces(rest);
+  int consumer, length = 0;
+  if (*args == '\0') {
+    consumer = addChangeConsumer(feed);
+    if (consumer < 0)
+      reportError(json, 'e', "too_many_consumers", NULL,
+                  portuguese ? "demasiados consumidores"
+                             : "too many consumers");
+    else
+      reportNumber(json, 'e', "consumer", consumer);
+  } else if (strcmp(args, "sink") == 0) {
+    attachSink(json, feed, rest, portuguese);
+  } else if (sscanf(args, "%d%n", &consumer, &length) == 1 &&
+             args[length] == '\0' && *rest == '\0' && consumer >= 0 &&
+             consumer < feed->consumerCount) {
+    printUnreadChanges(json, feed, consumer, portuguese);
+  } else {
+    reportError(json, 'e', "unknown_consumer", NULL,
+                portuguese ? "consumidor desconhecido" : "unknown consumer");
+  }
+}
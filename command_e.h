@@ -0,0 +1,26 @@
+/**
+ * @file command_e.h
+ * @brief Header file for command E functionality to consume the change feed.
+ *
+ * This file contains the declaration of the commandE function which adds
+ * change feed consumers, prints what a consumer has not read yet, or attaches
+ * a binary sink file to the feed.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef COMMAND_E_H
+#define COMMAND_E_H
+
+#include "project.h"
+
+/**
+ * @brief Adds, reads or attaches a sink to the change feed.
+ *
+ * @param args The command arguments.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandE(char *args, EngineState *engine, int portuguese);
+
+#endif
@@ -0,0 +1,167 @@
+/**
+ * @file command_f.c
+ * @brief Implementation of command F functionality to forecast vaccine stock.
+ *
+ * This file contains the implementation of the commandF function. The input
+ * is `f [<vaccine>...]`; without names every vaccine with lots is forecast,
+ * in name order. Each line holds the vaccine, its doses that have not
+ * expired, its weighted doses per day, the days those doses last at that
+ * rate (`-` if none are used) and the doses that will expire before they are
+ * used. Every figure comes from counts kept per vaccine, so no lot or
+ * inoculation is read.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "command_f.h"
+#include "constants.h"
+#include "forecast.h"
+#include "project.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Writes the stock forecast of a vaccine as an element of the JSON
+ * forecasts array, with -1 days when the doses are not used up.
+ *
+ * @param json The JSON writer.
+ * @param vaccine The vaccine name entry.
+ * @param forecast The forecast.
+ */
+static void writeJsonForecast(JsonWriter *json,
+                              const VaccineNameIndex *vaccine,
+                              const StockForecast *forecast) {
+  jsonOpen(json, NULL, '{');
+  jsonString(json, "name", vaccine->name);
+  jsonInteger(json, "usable", forecast->usable);
+  jsonFixed(json, "rate", forecast->rate, 2);
+  jsonFixed(json, "days", forecast->days < 0 ? -1 : forecast->days, 1);
+  jsonInteger(json, "expiring", forecast->expiring);
+  jsonClose(json, '}');
+}
+
+/**
+ * @brief Writes a vaccine name that has no lots as an element of the JSON
+ * forecasts array.
+ *
+ * @param json The JSON writer.
+ * @param name The vaccine name.
+ */
+static void writeMissingVaccine(JsonWriter *json, const char *name) {
+  jsonOpen(json, NULL, '{');
+  jsonString(json, "name", name);
+  jsonString(json, "error", "no_such_vaccine");
+  jsonClose(json, '}');
+}
+
+/**
+ * @brief Prints the stock forecast of a vaccine, or writes it as an element
+ * of the JSON forecasts array.
+ *
+ * @param json The JSON writer.
+ * @param vaccine The vaccine name entry.
+ * @param today The current day number.
+ */
+static void printForecast(JsonWriter *json, const VaccineNameIndex *vaccine,
+                          int today) {
+  StockForecast forecast;
+  forecastStock(&vaccine->stock.expiries, dailyRate(&vaccine->doseRate, today),
+                today, &forecast);
+  if (json->enabled) {
+    writeJsonForecast(json, vaccine, &forecast);
+    return;
+  }
+  FILE *out = json->out;
+  fprintf(out, "%s %ld %.2f ", vaccine->name, forecast.usable, forecast.rate);
+  if (forecast.days < 0)
+    fprintf(out, "-");
+  else
+    fprintf(out, "%.1f", forecast.days);
+  fprintf(out, " %ld\n", forecast.expiring);
+}
+
+/**
+ * @brief Compares two vaccine name entries by name.
+ *
+ * @param a The first entry.
+ * @param b The second entry.
+ * @return int Negative if a < b, zero if equal, positive if a > b.
+ */
+static int compareVaccineNames(const void *a, const void *b) {
+  return strcmp(((const VaccineNameIndex *)a)->name,
+                ((const VaccineNameIndex *)b)->name);
+}
+
+/**
+ * @brief Prints the stock forecast of every vaccine with lots, in name order.
+ *
+ * @param json The JSON writer.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param hashSize The size of the hash table.
+ * @param today The current day number.
+ * @param scratch The per-command scratch arena.
+ */
+static void forecastAllVaccines(JsonWriter *json,
+                                VaccineNameIndex **nameHashTable,
+                                int hashSize, int today,
+                                ScratchArena *scratch) {
+  int count = 0;
+  for (int i = 0; i < hashSize; i++)
+    for (VaccineNameIndex *entry = nameHashTable[i]; entry != NULL;
+         entry = entry->next_hash)
+      count += entry->lotCount > 0;
+  VaccineNameIndex **vaccines = (VaccineNameIndex **)arenaAlloc(
+      scratch, count * sizeof(VaccineNameIndex *));
+  count = 0;
+  for (int i = 0; i < hashSize; i++)
+    for (VaccineNameIndex *entry = nameHashTable[i]; entry != NULL;
+         entry = entry->next_hash)
+      if (entry->lotCount > 0)
+        vaccines[count++] = entry;
+  sortPointers((void **)vaccines, count, compareVaccineNames, scratch);
+  for (int i = 0; i < count; i++)
+    printForecast(json, vaccines[i], today);
+}
+
+/**
+ * @brief Command F: Prints the stock forecast of every vaccine, or of the
+ * named ones.
+ *
+ * @param args The command arguments.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param hashSize The size of the hash table.
+ * @param currentDate The current date.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandF(char *args, VaccineNameIndex **nameHashTable, int hashSize,
+              Date currentDate, EngineState *engine, int portuguese) {
+  JsonWriter *json = &engine->json;
+  int today = dateToDayNumber(currentDate);
+  char *rest = args;
+  char *name = strtok_r(rest, " \t", &rest);
+  if (json->enabled) {
+    jsonBegin(json, 'f');
+    jsonOpen(json, "forecasts", '[');
+  }
+  if (name == NULL)
+    forecastAllVaccines(json, nameHashTable, hashSize, today,
+                        &engine->scratch);
+  for (; name != NULL; name = strtok_r(NULL, " \t", &rest)) {
+    VaccineNameIndex *vaccine =
+        findVaccineByName(nameHashTable, name, hashSize);
+    if (vaccine != NULL && vaccine->lotCount > 0)
+      printForecast(json, vaccine, today);
+    else if (json->enabled)
+      writeMissingVaccine(json, name);
+    else
+      fprintf(json->out,
+              portuguese ? "%s: vacina inexistente\n" : "%s: no such vaccine\n",
+              name);
+  }
+  if (json->enabled) {
+    jsonClose(json, ']');
+    jsonEnd(json);
+  }
+}
@@ -0,0 +1,29 @@
+/**
+ * @file command_f.h
+ * @brief Header file for command F functionality to forecast vaccine stock.
+ *
+ * This file contains the declaration of the commandF function which forecasts
+ * how long the stock of each vaccine lasts at its recent daily rate.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef COMMAND_F_H
+#define COMMAND_F_H
+
+#include "project.h"
+
+/**
+ * @brief Prints the stock forecast of every vaccine, or of the named ones.
+ *
+ * @param args The command arguments.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param hashSize The size of the hash table.
+ * @param currentDate The current date.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandF(char *args, VaccineNameIndex **nameHashTable, int hashSize,
+              Date currentDate, EngineState *engine, int portuguese);
+
+#endif
@@ -0,0 +1,94 @@
+/**
+ * @file command_g.c
+ * @brief Implementation of command G functionality to manage replication.
+ *
+ * This file contains the implementation of the commandG function. The input
+ * is `g primary <file>`, `g replica <file>` or `g promote`. Either role
+ * starts from an empty system, since the log must hold every change for a
+ * replica to rebuild it, unless the log is the one the system replayed, as
+ * when a promoted replica goes on as a primary. No role starts while a
+ * what-if branch is open. A replica is promoted only once it has applied
+ * every record it could read. The LSN of the last change executed or
+ * applied is printed.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "command_g.h"
+#include "charclass.h"
+#include "constants.h"
+#include "project.h"
+#include "replication.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Starts shipping or replaying the log at a path.
+ *
+ * @param json The JSON writer.
+ * @param engine The engine-wide state.
+ * @param replica 1 to become a replica, 0 to become a primary.
+ * @param path The path of the log file.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ * @return int 1 on success, 0 otherwise.
+ */
+static int startRole(JsonWriter *json, EngineState *engine, int replica,
+                     const char *path, int portuguese) {
+  Replication *replication = &engine->replication;
+  if (replication->role != ROLE_STANDALONE) {
+    reportError(json, 'g', "already_replicating", NULL,
+                portuguese ? "já em replicação" : "already replicating");
+    return 0;
+  }
+  if (engine->branchCount > 0) {
+    reportError(json, 'g', "branch_open", NULL,
+                portuguese ? "ramo aberto" : "branch open");
+    return 0;
+  }
+  if (!continuesLog(replication, path)) {
+    reportError(json, 'g', "system_not_empty", NULL,
+                portuguese ? "sistema não vazio" : "system not empty");
+    return 0;
+  }
+  if (!(replica ? startReplica(replication, path)
+                : startPrimary(replication, path))) {
+    reportError(json, 'g', "cannot_open_file", path,
+                portuguese ? "impossível abrir" : "cannot open file");
+    return 0;
+  }
+  return 1;
+}
+
+/**
+ * @brief Command G: Changes the replication role of the system.
+ *
+ * @param args The command arguments.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandG(char *args, EngineState *engine, int portuguese) {
+  JsonWriter *json = &engine->json;
+  Replication *replication = &engine->replication;
+  char *path = skipToken(args);
+  if (*path != '\0')
+    *path++ = '\0';
+  path = skipSpaces(path);
+  int changed = 0;
+  if ((strcmp(args, "primary") == 0 || strcmp(args, "replica") == 0) &&
+      *path != '\0') {
+    changed = startRole(json, engine, args[0] == 'r', path, portuguese);
+  } else if (strcmp(args, "promote") == 0 && *path == '\0') {
+    changed = replication->role == ROLE_REPLICA;
+    if (changed)
+      promoteReplica(replication);
+    else
+      reportError(json, 'g', "not_a_replica", NULL,
+                  portuguese ? "não é réplica" : "not a replica");
+  } else {
+    reportError(json, 'g', "invalid_arguments", NULL,
+                portuguese ? "argumentos inválidos" : "invalid arguments");
+  }
+  if (changed)
+    reportNumber(json, 'g', "lsn", (long)replication->lsn);
+}
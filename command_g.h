@@ -0,0 +1,26 @@
+/**
+ * @file command_g.h
+ * @brief Header file for command G functionality to manage replication.
+ *
+ * This file contains the declaration of the commandG function which makes the
+ * system a primary that ships its changes, a replica that replays them, or
+ * promotes a replica after its primary is gone.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef COMMAND_G_H
+#define COMMAND_G_H
+
+#include "project.h"
+
+/**
+ * @brief Changes the replication role of the system.
+ *
+ * @param args The command arguments.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandG(char *args, EngineState *engine, int portuguese);
+
+#endif
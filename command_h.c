@@ -0,0 +1,128 @@
+/**
+ * @file command_h.c
+ * @brief Implementation of command H functionality to estimate distinct
+ * users.
+ *
+ * This file contains the implementation of the commandH function. The input
+ * is `h <vaccine>|* [<from> [<to>]]`, where `*` stands for every vaccine.
+ * Without dates the running sketch is used; with dates the daily sketches
+ * of the range are merged. The output is the estimate followed by its error
+ * bound at two standard errors (about 95% confidence).
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "command_h.h"
+#include "constants.h"
+#include "project.h"
+#include "sketch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Finds the sketch series selected by the first argument.
+ *
+ * @param name The vaccine name, or "*" for every vaccine.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param hashSize The size of the hash table.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ * @return const SketchSeries* The series, or NULL if there is no vaccine.
+ */
+static const SketchSeries *findSketchSeries(const char *name,
+                                            VaccineNameIndex **nameHashTable,
+                                            int hashSize, EngineState *engine,
+                                            int portuguese) {
+  if (strcmp(name, "*") == 0)
+    return &engine->dailySketches;
+  VaccineNameIndex *vaccine = findVaccineByName(nameHashTable, name, hashSize);
+  if (vaccine == NULL || vaccine->lotCount == 0) {
+    reportError(&engine->json, 'h', "no_such_vaccine", name,
+                portuguese ? "vacina inexistente" : "no such vaccine");
+    return NULL;
+  }
+  return &vaccine->recipientSketches;
+}
+
+/**
+ * @brief Parses the optional date range of command H.
+ *
+ * @param rest The tokenizer state, positioned after the first argument.
+ * @param fromDay Pointer to store the first day number of the range.
+ * @param toDay Pointer to store the last day number of the range.
+ * @return int 1 if a valid range was given, 0 if none, -1 if invalid.
+ */
+static int parseDayRange(char **rest, int *fromDay, int *toDay) {
+  char *from = strtok_r(NULL, " \t", rest);
+  if (from == NULL)
+    return 0;
+  char *to = strtok_r(NULL, " \t", rest);
+  Date fromDate, toDate;
+  if (!parseCalendarDate(from, &fromDate) ||
+      (to != NULL && !parseCalendarDate(to, &toDate)))
+    return -1;
+  *fromDay = dateToDayNumber(fromDate);
+  *toDay = to != NULL ? dateToDayNumber(toDate) : *fromDay;
+  return *fromDay <= *toDay ? 1 : -1;
+}
+
+/**
+ * @brief Prints an estimate with its error bound, or writes them as the
+ * fields of a JSON object.
+ *
+ * @param json The JSON writer.
+ * @param sketch The sketch to estimate.
+ */
+static void printEstimate(JsonWriter *json, const HyperLogLog *sketch) {
+  double estimate = sketchEstimate(sketch);
+  double bound = 2 * sketchStandardError() * estimate;
+  if (!json->enabled) {
+    fprintf(json->out, "%ld +-%ld\n", (long)(estimate + 0.5),
+            (long)(bound + 0.5));
+    return;
+  }
+  jsonBegin(json, 'h');
+  jsonInteger(json, "estimate", (long)(estimate + 0.5));
+  jsonInteger(json, "bound", (long)(bound + 0.5));
+  jsonEnd(json);
+}
+
+/**
+ * @brief Command H: Prints the estimated number of distinct vaccinated users.
+ *
+ * @param args The command arguments.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param hashSize The size of the hash table.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandH(char *args, VaccineNameIndex **nameHashTable, int hashSize,
+              EngineState *engine, int portuguese) {
+  JsonWriter *json = &engine->json;
+  char *rest = args;
+  char *name = strtok_r(rest, " \t", &rest);
+  if (name == NULL) {
+    reportError(json, 'h', "invalid_arguments", NULL,
+                portuguese ? "argumentos inválidos" : "invalid arguments");
+    return;
+  }
+  const SketchSeries *series =
+      findSketchSeries(name, nameHashTable, hashSize, engine, portuguese);
+  if (series == NULL)
+    return;
+
+  int fromDay, toDay;
+  int range = parseDayRange(&rest, &fromDay, &toDay);
+  if (range < 0) {
+    reportError(json, 'h', "invalid_date", NULL,
+                portuguese ? "data inválida" : "invalid date");
+  } else if (range == 0) {
+    printEstimate(json, &series->total);
+  } else {
+    HyperLogLog merged;
+    memset(&merged, 0, sizeof(merged));
+    sketchSeriesMergeRange(series, fromDay, toDay, &merged);
+    printEstimate(json, &merged);
+  }
+}
@@ -0,0 +1,28 @@
+/**
+ * @file command_h.h
+ * @brief Header file for command H functionality to estimate distinct users.
+ *
+ * This file contains the declaration of the commandH function which estimates
+ * the number of distinct users vaccinated overall or within a date range.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef COMMAND_H_H
+#define COMMAND_H_H
+
+#include "project.h"
+
+/**
+ * @brief Prints the estimated number of distinct vaccinated users.
+ *
+ * @param args The command arguments.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param hashSize The size of the hash table.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandH(char *args, VaccineNameIndex **nameHashTable, int hashSize,
+              EngineState *engine, int portuguese);
+
+#endif
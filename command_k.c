@@ -0,0 +1,174 @@
+/**
+ * @file command_k.c
+ * @brief Implementation of command K functionality to query vaccine cohorts.
+ *
+ * This file contains the implementation of the commandK function. The
+ * expression `<vaccine> { <op> <vaccine> }` is evaluated from left to right
+ * over the vaccines' recipient bitmaps, where `&` keeps the users in both
+ * operands, `|` the users in either and `-` the users in the left operand
+ * only. A leading `#` prints the number of users instead of their names.
+ * Inoculation records are never read.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "command_k.h"
+#include "cohort.h"
+#include "constants.h"
+#include "project.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Reports an "invalid arguments" error.
+ *
+ * @param json The JSON writer.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+static void handleInvalidExpression(JsonWriter *json, int portuguese) {
+  reportError(json, 'k', "invalid_arguments", NULL,
+              portuguese ? "argumentos inválidos" : "invalid arguments");
+}
+
+/**
+ * @brief Finds the recipients of a vaccine named in the expression.
+ *
+ * @param json The JSON writer.
+ * @param name The vaccine name.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param hashSize The size of the hash table.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ * @return const CohortBitmap* The recipients, or NULL if there is no vaccine.
+ */
+static const CohortBitmap *findRecipients(JsonWriter *json, const char *name,
+                                          VaccineNameIndex **nameHashTable,
+                                          int hashSize, int portuguese) {
+  if (name == NULL) {
+    handleInvalidExpression(json, portuguese);
+    return NULL;
+  }
+  VaccineNameIndex *vaccine = findVaccineByName(nameHashTable, name, hashSize);
+  if (vaccine == NULL || vaccine->lotCount == 0) {
+    reportError(json, 'k', "no_such_vaccine", name,
+                portuguese ? "vacina inexistente" : "no such vaccine");
+    return NULL;
+  }
+  return &vaccine->recipients;
+}
+
+/**
+ * @brief Parses a cohort operator token.
+ *
+ * @param token The operator token.
+ * @param operation Pointer to store the parsed operation.
+ * @return int 1 if the token is an operator, 0 otherwise.
+ */
+static int parseOperation(const char *token, CohortOperation *operation) {
+  if (strcmp(token, "&") == 0)
+    *operation = COHORT_AND;
+  else if (strcmp(token, "|") == 0)
+    *operation = COHORT_OR;
+  else if (strcmp(token, "-") == 0)
+    *operation = COHORT_ANDNOT;
+  else
+    return 0;
+  return 1;
+}
+
+/**
+ * @brief Evaluates the remaining expression tokens into a bitmap.
+ *
+ * @param rest The tokenizer state, positioned after the first operand.
+ * @param result Pointer to the bitmap of the first operand, replaced by each
+ * combined bitmap, which lives in the scratch arena.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param hashSize The size of the hash table.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ * @return int 1 if the expression is valid, 0 otherwise.
+ */
+static int evaluateOperations(char **rest, const CohortBitmap **result,
+                              VaccineNameIndex **nameHashTable, int hashSize,
+                              EngineState *engine, int portuguese) {
+  JsonWriter *json = &engine->json;
+  char *token;
+  while ((token = strtok_r(NULL, " \t", rest)) != NULL) {
+    CohortOperation operation;
+    if (!parseOperation(token, &operation)) {
+      handleInvalidExpression(json, portuguese);
+      return 0;
+    }
+    const CohortBitmap *operand =
+        findRecipients(json, strtok_r(NULL, " \t", rest), nameHashTable,
+                       hashSize, portuguese);
+    if (operand == NULL)
+      return 0;
+
+    CohortBitmap *combined =
+        (CohortBitmap *)arenaAlloc(&engine->scratch, sizeof(CohortBitmap));
+    bitmapCombine(*result, operand, operation, combined, &engine->scratch);
+    *result = combined;
+  }
+  return 1;
+}
+
+/**
+ * @brief Prints the names of the users in a cohort, by ascending id, or
+ * writes them as the JSON users array.
+ *
+ * @param cohort The cohort bitmap.
+ * @param engine The engine-wide state.
+ */
+static void printCohortUsers(const CohortBitmap *cohort, EngineState *engine) {
+  JsonWriter *json = &engine->json;
+  long count = bitmapCardinality(cohort);
+  unsigned int *ids = (unsigned int *)arenaAlloc(
+      &engine->scratch, count * sizeof(unsigned int));
+  bitmapToArray(cohort, ids);
+  if (json->enabled) {
+    jsonBegin(json, 'k');
+    jsonOpen(json, "users", '[');
+  }
+  char buffer[NUMERIC_NAME_SIZE];
+  for (long i = 0; i < count; i++) {
+    const char *name = userNameText(engine->usersById[ids[i]], buffer);
+    if (json->enabled)
+      jsonString(json, NULL, name);
+    else
+      fprintf(json->out, "%s\n", name);
+  }
+  if (json->enabled) {
+    jsonClose(json, ']');
+    jsonEnd(json);
+  }
+}
+
+/**
+ * @brief Command K: Evaluates a cohort expression and prints its count or
+ * its users.
+ *
+ * @param args The command arguments.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param hashSize The size of the hash table.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandK(char *args, VaccineNameIndex **nameHashTable, int hashSize,
+              EngineState *engine, int portuguese) {
+  char *rest = args;
+  char *token = strtok_r(rest, " \t", &rest);
+  int countOnly = token != NULL && strcmp(token, "#") == 0;
+  if (countOnly)
+    token = strtok_r(NULL, " \t", &rest);
+
+  const CohortBitmap *result =
+      findRecipients(&engine->json, token, nameHashTable, hashSize, portuguese);
+  if (result == NULL || !evaluateOperations(&rest, &result, nameHashTable,
+                                            hashSize, engine, portuguese))
+    return;
+  if (countOnly)
+    reportNumber(&engine->json, 'k', "count", bitmapCardinality(result));
+  else
+    printCohortUsers(result, engine);
+}
@@ -0,0 +1,28 @@
+/**
+ * @file command_k.h
+ * @brief Header file for command K functionality to query vaccine cohorts.
+ *
+ * This file contains the declaration of the commandK function which evaluates
+ * set expressions over the recipients of vaccines.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef COMMAND_K_H
+#define COMMAND_K_H
+
+#include "project.h"
+
+/**
+ * @brief Evaluates a cohort expression and prints its count or its users.
+ *
+ * @param args The command arguments.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param hashSize The size of the hash table.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandK(char *args, VaccineNameIndex **nameHashTable, int hashSize,
+              EngineState *engine, int portuguese);
+
+#endif
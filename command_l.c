@@ -5,26 +5,113 @@
  * This file contains the implementation of the commandL function and its helper
  * functions. It handles listing all vaccine lots or specific lots based on the
  * provided arguments. The listing can be sorted by validation date and lot ID.
+ * The output is built in a buffer so that it can be kept in the listing cache
+ * and written again while no lot changes. A first argument of @<site> lists
+ * the lots of one site, and @* lists the doses available per vaccine and
+ * site. Vaccine names may start with @ too, so a first argument that is the
+ * name of a vaccine always lists that vaccine, as it did before sites.
  *
  * Author: Vicente B. Duarte
  */
 
+#include "charclass.h"
 #include "constants.h"
+#include "history.h"
 #include "project.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#define LOT_LINE_FORMAT "%s %s %02d-%02d-%d %d %d"
+#define ANY_SITE -1 // Lists the lots of every site
+
 /**
- * @brief Prints the details of a single vaccine lot.
+ * @brief Appends a number with a printf format.
  *
+ * @param out The output buffer.
+ * @param format The format, with one %ld conversion.
+ * @param value The number.
+ */
+static void appendNumber(TextBuffer *out, const char *format, long value) {
+  int length = snprintf(NULL, 0, format, value);
+  snprintf(reserveText(out, length), length + 1, format, value);
+  out->length += length;
+}
+
+/**
+ * @brief Appends the details of a vaccine lot with the given dose counts,
+ * followed by its site unless it is the default site 0.
+ *
+ * @param out The output buffer.
+ * @param vaccine The vaccine lot.
+ * @param available The number of doses available.
+ * @param used The number of doses used.
+ */
+static void appendLotLine(TextBuffer *out, const VaccineLot *vaccine,
+                          int available, int used) {
+  int length = snprintf(NULL, 0, LOT_LINE_FORMAT, vaccine->name, vaccine->lot,
+                        vaccine->validation.day, vaccine->validation.month,
+                        vaccine->validation.year, available, used);
+  snprintf(reserveText(out, length), length + 1, LOT_LINE_FORMAT,
+           vaccine->name, vaccine->lot, vaccine->validation.day,
+           vaccine->validation.month, vaccine->validation.year, available,
+           used);
+  out->length += length;
+  if (vaccine->site != 0)
+    appendNumber(out, " @%ld", vaccine->site);
+  appendText(out, "\n");
+}
+
+/**
+ * @brief Writes a vaccine lot with the given dose counts as a JSON object.
+ *
+ * @param json The JSON writer.
+ * @param vaccine The vaccine lot.
+ * @param available The number of doses available.
+ * @param used The number of doses used.
+ */
+static void writeJsonLot(JsonWriter *json, const VaccineLot *vaccine,
+                         int available, int used) {
+  jsonOpen(json, NULL, '{');
+  jsonString(json, "name", vaccine->name);
+  jsonString(json, "batch", vaccine->lot);
+  jsonDate(json, "expires", vaccine->validation.day,
+           vaccine->validation.month, vaccine->validation.year);
+  jsonInteger(json, "available", available);
+  jsonInteger(json, "used", used);
+  jsonInteger(json, "site", vaccine->site);
+  jsonClose(json, '}');
+}
+
+/**
+ * @brief Writes a vaccine name that has no lots as a JSON object.
+ *
+ * @param json The JSON writer.
+ * @param vaccineName The name of the vaccine.
+ */
+static void writeJsonMissing(JsonWriter *json, const char *vaccineName) {
+  jsonOpen(json, NULL, '{');
+  jsonString(json, "name", vaccineName);
+  jsonString(json, "error", "no_such_vaccine");
+  jsonClose(json, '}');
+}
+
+/**
+ * @brief Appends the details of a single vaccine lot, or writes it as a JSON
+ * object.
+ *
+ * @param out The output buffer.
  * @param vaccine The vaccine lot to print.
+ * @param json The JSON writer.
  */
-static void printVaccine(VaccineLot *vaccine) {
-  printf("%s %s %02d-%02d-%d %d %d\n", vaccine->name, vaccine->lot,
-         vaccine->validation.day, vaccine->validation.month,
-         vaccine->validation.year, vaccine->doses - vaccine->dosesUsed,
-         vaccine->dosesUsed);
+static void printVaccine(TextBuffer *out, VaccineLot *vaccine,
+                         JsonWriter *json) {
+  if (json->enabled)
+    writeJsonLot(json, vaccine, vaccine->doses - vaccine->dosesUsed,
+                 vaccine->dosesUsed);
+  else
+    appendLotLine(out, vaccine, vaccine->doses - vaccine->dosesUsed,
+                  vaccine->dosesUsed);
 }
 
 /**
@@ -133,19 +220,24 @@ static void quickSort(VaccineLot **array, int low, int high) {
 }
 
 /**
- * @brief Fills an array with all vaccine lots from the linked list.
+ * @brief Fills an array with the vaccine lots of a site from the linked list.
  *
  * @param vaccineList The head of the vaccine lot linked list.
- * @param vaccineArray The array to fill.
- * @return int The total number of vaccines in the linked list.
+ * @param site The site id, or ANY_SITE for every lot.
+ * @param vaccineArray The array to fill, or NULL to only count.
+ * @return int The number of lots of the site in the linked list.
  */
-static int fillVaccineArray(VaccineLot *vaccineList,
+static int fillVaccineArray(VaccineLot *vaccineList, int site,
                             VaccineLot **vaccineArray) {
   int count = 0;
   VaccineLot *current = vaccineList;
   // Iterate through the linked list and add each vaccine to the array
   while (current != NULL) {
-    vaccineArray[count++] = current;
+    if (site == ANY_SITE || current->site == site) {
+      if (vaccineArray != NULL)
+        vaccineArray[count] = current;
+      count++;
+    }
     current = current->next_vaccine;
   }
   return count;
@@ -154,170 +246,672 @@ static int fillVaccineArray(VaccineLot *vaccineList,
 /**
  * @brief Prints all vaccines from a given array.
  *
+ * @param out The output buffer.
  * @param vaccineArray The array of vaccine lots to print.
  * @param count The number of vaccines in the array.
+ * @param json The JSON writer.
  */
-static void printAllVaccines(VaccineLot **vaccineArray, int count) {
+static void printAllVaccines(TextBuffer *out, VaccineLot **vaccineArray,
+                             int count, JsonWriter *json) {
   // Iterate through the array and print each vaccine
   for (int i = 0; i < count; i++) {
-    printVaccine(vaccineArray[i]);
+    printVaccine(out, vaccineArray[i], json);
   }
 }
 
 /**
- * @brief Lists all vaccines in the system, sorted by validation date and lot
- * ID.
+ * @brief Lists all vaccines in the system, or at one site, sorted by
+ * validation date and lot ID.
  *
+ * @param out The output buffer.
  * @param vaccineList The head of the vaccine lot linked list.
+ * @param site The site id, or ANY_SITE for every lot.
+ * @param scratch The per-command scratch arena.
+ * @param json The JSON writer.
  */
-static void listAllVaccines(VaccineLot *vaccineList) {
-  // Count the total number of vaccines in the linked list
-  int count = 0;
-  VaccineLot *current = vaccineList;
-  while (current != NULL) {
-    count++;
-    current = current->next_vaccine;
-  }
+static void listAllVaccines(TextBuffer *out, VaccineLot *vaccineList,
+                            int site, ScratchArena *scratch,
+                            JsonWriter *json) {
+  // Count the vaccines to list in the linked list
+  int count = fillVaccineArray(vaccineList, site, NULL);
   if (count == 0)
     return; // No vaccines to list
 
   // Allocate memory for an array to hold all vaccine pointers
   VaccineLot **vaccineArray =
-      (VaccineLot **)malloc(count * sizeof(VaccineLot *));
-  if (vaccineArray == NULL) {
-    printf("No memory\n");
-    exit(1);
-  }
+      (VaccineLot **)arenaAlloc(scratch, count * sizeof(VaccineLot *));
 
   // Fill the array with vaccine pointers from the linked list
-  fillVaccineArray(vaccineList, vaccineArray);
+  fillVaccineArray(vaccineList, site, vaccineArray);
 
   // Sort the array using quicksort
   quickSort(vaccineArray, 0, count - 1);
 
   // Print all the vaccines from the sorted array
-  printAllVaccines(vaccineArray, count);
-
-  // Free the allocated memory
-  free(vaccineArray);
+  printAllVaccines(out, vaccineArray, count, json);
 }
 
 /**
  * @brief Handles the output when a specified vaccine name is not found.
  *
+ * @param out The output buffer.
  * @param vaccineName The name of the vaccine that was not found.
  * @param portuguese Flag indicating if the output should be in Portuguese.
+ * @param json The JSON writer.
  */
-static void handleVaccineNotFound(const char *vaccineName, int portuguese) {
-  if (portuguese)
-    printf("%s: vacina inexistente\n", vaccineName);
-  else
-    printf("%s: no such vaccine\n", vaccineName);
+static void handleVaccineNotFound(TextBuffer *out, const char *vaccineName,
+                                  int portuguese, JsonWriter *json) {
+  if (json->enabled) {
+    writeJsonMissing(json, vaccineName);
+    return;
+  }
+  appendText(out, vaccineName);
+  appendText(out,
+             portuguese ? ": vacina inexistente\n" : ": no such vaccine\n");
 }
 
 /**
- * @brief Prints all lots associated with a given vaccine name.
+ * @brief Finds the lots of a vaccine at a site.
  *
- * @param nameEntry The VaccineNameIndex entry containing the list of lots.
+ * @param nameEntry The vaccine's name entry, or NULL if it does not exist.
+ * @param site The site id, or ANY_SITE for every lot.
+ * @param lots Pointer to store the lots.
+ * @return int The number of lots.
  */
-static void printVaccineLots(VaccineNameIndex *nameEntry) {
-  // Iterate through the list of lots and print each one
-  for (int i = 0; i < nameEntry->lotCount; i++) {
-    printVaccine(nameEntry->lots[i]);
+static int findSiteLots(const VaccineNameIndex *nameEntry, int site,
+                        VaccineLot *const **lots) {
+  if (nameEntry == NULL)
+    return 0;
+  if (site == ANY_SITE) {
+    *lots = nameEntry->lots;
+    return nameEntry->lotCount;
   }
+  const SiteShelf *shelf = findSiteShelf(&nameEntry->stock, site);
+  if (shelf == NULL)
+    return 0;
+  *lots = shelf->lots;
+  return shelf->lotCount;
 }
 
 /**
  * @brief Lists all vaccine lots for a specific vaccine name, sorted.
  *
- * @param nameHashTable The hash table of vaccine names.
+ * @param out The output buffer.
+ * @param nameEntry The vaccine's name entry, or NULL if it does not exist.
  * @param vaccineName The name of the vaccine to list.
- * @param hashSize The size of the hash table.
+ * @param site The site id, or ANY_SITE for every lot.
  * @param portuguese Flag indicating if the output should be in Portuguese.
+ * @param scratch The per-command scratch arena.
+ * @param json The JSON writer.
  */
-static void listVaccinesByName(VaccineNameIndex **nameHashTable,
-                               const char *vaccineName, int hashSize,
-                               int portuguese) {
-  // Find the entry for the given vaccine name in the hash table
-  VaccineNameIndex *nameEntry =
-      findVaccineByName(nameHashTable, vaccineName, hashSize);
-
+static void listVaccinesByName(TextBuffer *out, VaccineNameIndex *nameEntry,
+                               const char *vaccineName, int site,
+                               int portuguese, ScratchArena *scratch,
+                               JsonWriter *json) {
+  VaccineLot *const *lots = NULL;
+  int validCount = findSiteLots(nameEntry, site, &lots);
   // If the vaccine name is not found or has no associated lots
-  if (nameEntry == NULL || nameEntry->lotCount == 0) {
-    handleVaccineNotFound(vaccineName, portuguese);
-    return;
-  }
-
-  int validCount = nameEntry->lotCount;
   if (validCount == 0) {
-    handleVaccineNotFound(vaccineName, portuguese);
+    handleVaccineNotFound(out, vaccineName, portuguese, json);
     return;
   }
 
   // Allocate memory to hold the pointers to the vaccine lots
   VaccineLot **validLots =
-      (VaccineLot **)malloc(validCount * sizeof(VaccineLot *));
-  if (validLots == NULL) {
-    printf("No memory\n");
-    exit(1);
-  }
+      (VaccineLot **)arenaAlloc(scratch, validCount * sizeof(VaccineLot *));
 
   // Fill the array with the vaccine lots
-  for (int i = 0; i < nameEntry->lotCount; i++) {
-    validLots[i] = nameEntry->lots[i];
+  for (int i = 0; i < validCount; i++) {
+    validLots[i] = lots[i];
   }
 
   // Sort the array of vaccine lots
   quickSort(validLots, 0, validCount - 1);
 
-  // Print all the vaccine lots for the given name
-  printVaccineLots(nameEntry);
+  // Print all the vaccine lots for the given name, in sorted order
+  if (json->enabled) {
+    jsonOpen(json, NULL, '{');
+    jsonString(json, "name", vaccineName);
+    jsonOpen(json, "lots", '[');
+  }
+  printAllVaccines(out, validLots, validCount, json);
+  if (json->enabled) {
+    jsonClose(json, ']');
+    jsonClose(json, '}');
+  }
+}
+
+/**
+ * @brief Splits the arguments into vaccine names in place.
+ *
+ * @param args The command arguments string, terminated after each name.
+ * @param names Array to store the names, or NULL to only count them.
+ * @return int The number of names.
+ */
+static int splitVaccineNames(char *args, char **names) {
+  int count = 0;
+  char *name = skipSpaces(args);
+  while (*name != '\0') {
+    char *end = skipToken(name);
+    char *next = skipSpaces(end);
+    if (names != NULL) {
+      *end = '\0';
+      names[count] = name;
+    }
+    count++;
+    name = next;
+  }
+  return count;
+}
+
+/**
+ * @brief Appends a copy of text already in the output buffer.
+ *
+ * @param out The output buffer.
+ * @param start The offset of the text in the buffer.
+ * @param length The length of the text.
+ */
+static void repeatText(TextBuffer *out, size_t start, size_t length) {
+  char *copy = reserveText(out, length); // May move the buffer's data
+  memcpy(copy, out->data + start, length);
+  out->length += length;
+  out->data[out->length] = '\0';
+}
 
-  // Free the allocated memory
-  free(validLots);
+/**
+ * @brief Appends a copy of the listing made for an earlier name. In the JSON
+ * output mode, the listing of the first name has no comma before it, so one
+ * is added.
+ *
+ * @param out The output buffer.
+ * @param starts The offsets of the listings made so far.
+ * @param first The position of the earlier name.
+ * @param json The JSON writer.
+ */
+static void repeatListing(TextBuffer *out, const size_t *starts, int first,
+                          const JsonWriter *json) {
+  if (first == 0 && json->enabled && !json->binary)
+    appendText(out, ",");
+  repeatText(out, starts[first], starts[first + 1] - starts[first]);
+}
+
+/**
+ * @brief Finds the earlier name that resolved to the same vaccine.
+ *
+ * @param found The resolved name entries.
+ * @param index The position of the current name.
+ * @return int The position of the earlier name, or -1 if there is none.
+ */
+static int findRepeatedName(VaccineNameIndex **found, int index) {
+  if (found[index] == NULL)
+    return -1; // Unknown names are cheap to list again
+  for (int i = 0; i < index; i++) {
+    if (found[i] == found[index])
+      return i;
+  }
+  return -1;
 }
 
 /**
  * @brief Processes the command arguments to list specific vaccines by name.
  *
+ * All names are looked up in one batch, and a name repeated in the arguments
+ * copies the listing made for its first occurrence.
+ *
+ * @param out The output buffer.
  * @param args The command arguments string containing space-separated vaccine
  * names.
+ * @param site The site id, or ANY_SITE for every lot.
  * @param nameHashTable The hash table of vaccine names.
  * @param hashSize The size of the hash table.
  * @param portuguese Flag indicating if the output should be in Portuguese.
+ * @param scratch The per-command scratch arena.
+ * @param json The JSON writer.
  */
-static void processSpecificVaccines(char *args,
+static void processSpecificVaccines(TextBuffer *out, char *args, int site,
                                     VaccineNameIndex **nameHashTable,
-                                    int hashSize, int portuguese) {
-  char buffer[SIZE_COMMAND];
-  char *token =
-      strtok(args, " \t"); // Tokenize the input string by space or tab
-  while (token != NULL) {
-    strncpy(buffer, token, SIZE_COMMAND - 1); // Copy the token to a buffer
-    buffer[SIZE_COMMAND - 1] = '\0';          // Ensure null termination
-    listVaccinesByName(nameHashTable, buffer, hashSize,
-                       portuguese); // List vaccines with the extracted name
-    token = strtok(NULL, " \t");    // Get the next token
+                                    int hashSize, int portuguese,
+                                    ScratchArena *scratch, JsonWriter *json) {
+  int count = splitVaccineNames(args, NULL);
+  char **names = (char **)arenaAlloc(scratch, count * sizeof(char *));
+  VaccineNameIndex **found = (VaccineNameIndex **)arenaAlloc(
+      scratch, count * sizeof(VaccineNameIndex *));
+  size_t *starts = (size_t *)arenaAlloc(scratch, count * sizeof(size_t));
+  splitVaccineNames(args, names);
+  findVaccinesByNames(nameHashTable, (const char **)names, count, hashSize,
+                      found);
+  for (int i = 0; i < count; i++) {
+    int first = findRepeatedName(found, i);
+    starts[i] = out->length;
+    if (first >= 0)
+      repeatListing(out, starts, first, json);
+    else
+      listVaccinesByName(out, found[i], names[i], site, portuguese, scratch,
+                         json);
+  }
+}
+
+/**
+ * @brief Lists the lots of every vaccine, or of the named vaccines, at a
+ * site or at every site.
+ *
+ * @param out The output buffer.
+ * @param args The vaccine names, or an empty string for every vaccine.
+ * @param site The site id, or ANY_SITE for every lot.
+ * @param vaccineList The head of the vaccine lot linked list.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param hashSize The size of the hash table.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+static void listLots(TextBuffer *out, char *args, int site,
+                     VaccineLot *vaccineList,
+                     VaccineNameIndex **nameHashTable, int hashSize,
+                     EngineState *engine, int portuguese) {
+  JsonWriter *json = &engine->json;
+  if (json->enabled) {
+    jsonBegin(json, 'l');
+    jsonOpen(json, *args == '\0' ? "lots" : "vaccines", '[');
+  }
+  // If no vaccine names are provided, list all vaccines
+  if (*args == '\0') {
+    listAllVaccines(out, vaccineList, site, &engine->scratch, json);
+  } else {
+    // Otherwise, process the arguments as specific vaccine names to list
+    processSpecificVaccines(out, args, site, nameHashTable, hashSize,
+                            portuguese, &engine->scratch, json);
+  }
+  if (json->enabled)
+    jsonClose(json, ']');
+}
+
+/**
+ * @brief Appends the doses a vaccine has available at one site.
+ *
+ * @param out The output buffer.
+ * @param site The site.
+ * @param available The available doses at the site.
+ * @param json The JSON writer.
+ */
+static void appendSiteStock(TextBuffer *out, int site, long available,
+                            JsonWriter *json) {
+  if (json->enabled) {
+    jsonOpen(json, NULL, '{');
+    jsonInteger(json, "site", site);
+    jsonInteger(json, "available", available);
+    jsonClose(json, '}');
+  } else {
+    appendNumber(out, " @%ld", site);
+    appendNumber(out, ":%ld", available);
+  }
+}
+
+/**
+ * @brief Appends the doses a vaccine has available overall and at each site
+ * with its lots.
+ *
+ * @param out The output buffer.
+ * @param nameEntry The vaccine's name entry.
+ * @param json The JSON writer.
+ */
+static void appendStock(TextBuffer *out, const VaccineNameIndex *nameEntry,
+                        JsonWriter *json) {
+  const SiteStock *stock = &nameEntry->stock;
+  if (json->enabled) {
+    jsonOpen(json, NULL, '{');
+    jsonString(json, "name", nameEntry->name);
+    jsonInteger(json, "available", stock->available);
+    jsonOpen(json, "sites", '[');
+  } else {
+    appendText(out, nameEntry->name);
+    appendNumber(out, " %ld", stock->available);
+  }
+  for (int site = 0; site < stock->siteCount; site++) {
+    const SiteShelf *shelf = stock->shelves[site];
+    if (shelf == NULL || shelf->lotCount == 0)
+      continue;
+    appendSiteStock(out, site, shelf->available, json);
+  }
+  if (json->enabled) {
+    jsonClose(json, ']');
+    jsonClose(json, '}');
+  } else {
+    appendText(out, "\n");
   }
 }
 
+/**
+ * @brief Compares two vaccine name entries by name.
+ *
+ * @param a The first entry.
+ * @param b The second entry.
+ * @return int Negative if a < b, zero if equal, positive if a > b.
+ */
+static int compareNameEntries(const void *a, const void *b) {
+  return strcmp(((const VaccineNameIndex *)a)->name,
+                ((const VaccineNameIndex *)b)->name);
+}
+
+/**
+ * @brief Appends the stock of every vaccine with lots, sorted by name.
+ *
+ * @param out The output buffer.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param hashSize The size of the hash table.
+ * @param scratch The per-command scratch arena.
+ * @param json The JSON writer.
+ */
+static void listAllStock(TextBuffer *out, VaccineNameIndex **nameHashTable,
+                         int hashSize, ScratchArena *scratch,
+                         JsonWriter *json) {
+  int count = 0;
+  for (int i = 0; i < hashSize; i++)
+    for (VaccineNameIndex *entry = nameHashTable[i]; entry != NULL;
+         entry = entry->next_hash)
+      count += entry->lotCount > 0;
+  VaccineNameIndex **entries = (VaccineNameIndex **)arenaAlloc(
+      scratch, count * sizeof(VaccineNameIndex *));
+  count = 0;
+  for (int i = 0; i < hashSize; i++)
+    for (VaccineNameIndex *entry = nameHashTable[i]; entry != NULL;
+         entry = entry->next_hash)
+      if (entry->lotCount > 0)
+        entries[count++] = entry;
+  sortPointers((void **)entries, count, compareNameEntries, scratch);
+  for (int i = 0; i < count; i++)
+    appendStock(out, entries[i], json);
+}
+
+/**
+ * @brief Lists the doses available per site of every vaccine, or of the
+ * named vaccines.
+ *
+ * @param out The output buffer.
+ * @param args The vaccine names, or an empty string for every vaccine.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param hashSize The size of the hash table.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+static void listStock(TextBuffer *out, char *args,
+                      VaccineNameIndex **nameHashTable, int hashSize,
+                      EngineState *engine, int portuguese) {
+  JsonWriter *json = &engine->json;
+  ScratchArena *scratch = &engine->scratch;
+  if (json->enabled) {
+    jsonBegin(json, 'l');
+    jsonOpen(json, "stock", '[');
+  }
+  if (*args == '\0')
+    listAllStock(out, nameHashTable, hashSize, scratch, json);
+  int count = splitVaccineNames(args, NULL);
+  char **names = (char **)arenaAlloc(scratch, count * sizeof(char *));
+  splitVaccineNames(args, names);
+  for (int i = 0; i < count; i++) {
+    VaccineNameIndex *nameEntry =
+        findVaccineByName(nameHashTable, names[i], hashSize);
+    if (nameEntry == NULL || nameEntry->lotCount == 0)
+      handleVaccineNotFound(out, names[i], portuguese, json);
+    else
+      appendStock(out, nameEntry, json);
+  }
+  if (json->enabled)
+    jsonClose(json, ']');
+}
+
+/**
+ * @brief Lists by site, after the site mark: the lots of one site, or with
+ * * the stock of every site.
+ *
+ * @param out The output buffer.
+ * @param args The arguments after the site mark.
+ * @param vaccineList The head of the vaccine lot linked list.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param hashSize The size of the hash table.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ * @return int 1 if a listing was made, 0 if the site is invalid.
+ */
+static int listBySite(TextBuffer *out, char *args, VaccineLot *vaccineList,
+                      VaccineNameIndex **nameHashTable, int hashSize,
+                      EngineState *engine, int portuguese) {
+  char *end = skipToken(args);
+  char *rest = skipSpaces(end);
+  *end = '\0';
+  int site;
+  if (strcmp(args, "*") == 0)
+    listStock(out, rest, nameHashTable, hashSize, engine, portuguese);
+  else if (parseSiteId(args, &site))
+    listLots(out, rest, site, vaccineList, nameHashTable, hashSize, engine,
+             portuguese);
+  else {
+    reportError(&engine->json, 'l', "invalid_site", NULL,
+                portuguese ? "local inválido" : "invalid site");
+    return 0;
+  }
+  return 1;
+}
+
+/**
+ * @brief Checks if the first argument of a listing names a vaccine.
+ *
+ * @param args The command arguments.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param hashSize The size of the hash table.
+ * @param scratch The per-command scratch arena.
+ * @return int 1 if a vaccine has the first argument as its name, 0 otherwise.
+ */
+static int namesVaccine(const char *args, VaccineNameIndex **nameHashTable,
+                        int hashSize, ScratchArena *scratch) {
+  char *name = arenaStrdup(scratch, args);
+  *skipToken(name) = '\0';
+  return findVaccineByName(nameHashTable, name, hashSize) != NULL;
+}
+
 /**
  * @brief Command L: Lists vaccine batches based on the provided arguments.
  *
+ * The same arguments at the same catalog epoch always give the same output,
+ * so repeated listings are written straight from the listing cache. In the
+ * JSON output mode, the whole listing is built by the JSON writer as one
+ * object, or as one response frame in binary mode, and that is what is cached.
+ *
  * @param args The command arguments. If NULL or empty, lists all vaccines.
- * Otherwise, lists vaccines by name.
+ * Otherwise, lists vaccines by name, after an optional site argument. A
+ * first argument starting with @ is the site argument unless a vaccine has
+ * it as its name.
  * @param vaccineList The head of the vaccine lot linked list.
  * @param nameHashTable The hash table of vaccine names.
  * @param hashSize The size of the hash table.
+ * @param engine The engine-wide state.
  * @param portuguese Flag indicating if the output should be in Portuguese.
  */
 void commandL(char *args, VaccineLot *vaccineList,
-              VaccineNameIndex **nameHashTable, int hashSize, int portuguese) {
-  // If no arguments are provided, list all vaccines
-  if (args == NULL || *args == '\0') {
-    listAllVaccines(vaccineList);
+              VaccineNameIndex **nameHashTable, int hashSize,
+              EngineState *engine, int portuguese) {
+  char *key = args == NULL ? "" : args;
+  const TextBuffer *cached =
+      findCachedListing(&engine->listCache, key, engine->catalogEpoch);
+  JsonWriter *json = &engine->json;
+  if (cached != NULL) {
+    writeAnswer(json, cached->data, cached->length);
+    return;
+  }
+
+  // The arguments are tokenized in place
+  char *savedKey = arenaStrdup(&engine->scratch, key);
+  TextBuffer text;
+  initializeTextBuffer(&text);
+  TextBuffer *out = json->enabled ? &json->line : &text;
+  int listed = 1;
+  if (*key == SITE_MARK &&
+      !namesVaccine(key, nameHashTable, hashSize, &engine->scratch))
+    listed = listBySite(out, key + 1, vaccineList, nameHashTable, hashSize,
+                        engine, portuguese);
+  else
+    listLots(out, key, ANY_SITE, vaccineList, nameHashTable, hashSize,
+             engine, portuguese);
+  if (!listed)
+    return;
+  if (json->enabled)
+    jsonFinish(json);
+  writeAnswer(json, out->data, out->length);
+  storeCachedListing(&engine->listCache, savedKey, engine->catalogEpoch, out);
+}
+
+/**
+ * @brief Appends a vaccine lot as it was at the end of a day, or writes it as
+ * a JSON object.
+ *
+ * @param out The output buffer.
+ * @param json The JSON writer.
+ * @param vaccine The vaccine lot to print.
+ * @param day The day number.
+ */
+static void printVaccineAsOf(TextBuffer *out, JsonWriter *json,
+                             VaccineLot *vaccine, int day) {
+  int available = lotDosesAvailableAsOf(vaccine, day);
+  int used = lotDosesUsedAsOf(vaccine, day);
+  if (json->enabled)
+    writeJsonLot(json, vaccine, available, used);
+  else
+    appendLotLine(out, vaccine, available, used);
+}
+
+/**
+ * @brief Appends the lots of a list that existed at the end of a day.
+ *
+ * @param list The head of a lot list linked by next_vaccine.
+ * @param nameEntry The vaccine to keep, or NULL to keep every lot.
+ * @param day The day number.
+ * @param array The array to append to (NULL to only count).
+ * @return int The number of lots appended.
+ */
+static int collectLotsAsOf(VaccineLot *list, VaccineNameIndex *nameEntry,
+                           int day, VaccineLot **array) {
+  int count = 0;
+  for (VaccineLot *lot = list; lot != NULL; lot = lot->next_vaccine) {
+    if ((nameEntry == NULL || lot->nameEntry == nameEntry) &&
+        lotExistsAsOf(lot, day)) {
+      if (array != NULL)
+        array[count] = lot;
+      count++;
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief Prints the lots of a vaccine, or of every vaccine, as of a day. In
+ * the JSON output mode, the lots of a vaccine are the lots array of an
+ * object naming it.
+ *
+ * @param out The output buffer.
+ * @param vaccineList The head of the vaccine lot linked list.
+ * @param nameEntry The vaccine to list, or NULL to list every vaccine.
+ * @param engine The engine-wide state.
+ * @param day The day number.
+ * @return int The number of lots printed.
+ */
+static int listLotsAsOf(TextBuffer *out, VaccineLot *vaccineList,
+                        VaccineNameIndex *nameEntry, EngineState *engine,
+                        int day) {
+  JsonWriter *json = &engine->json;
+  int live = collectLotsAsOf(vaccineList, nameEntry, day, NULL);
+  int count =
+      live + collectLotsAsOf(engine->retiredLots, nameEntry, day, NULL);
+  if (count == 0)
+    return 0;
+
+  VaccineLot **lots =
+      (VaccineLot **)arenaAlloc(&engine->scratch, count * sizeof(VaccineLot *));
+  collectLotsAsOf(vaccineList, nameEntry, day, lots);
+  collectLotsAsOf(engine->retiredLots, nameEntry, day, lots + live);
+  quickSort(lots, 0, count - 1);
+  int named = json->enabled && nameEntry != NULL;
+  if (named) {
+    jsonOpen(json, NULL, '{');
+    jsonString(json, "name", nameEntry->name);
+    jsonOpen(json, "lots", '[');
+  }
+  for (int i = 0; i < count; i++)
+    printVaccineAsOf(out, json, lots[i], day);
+  if (named) {
+    jsonClose(json, ']');
+    jsonClose(json, '}');
+  }
+  return count;
+}
+
+/**
+ * @brief Prints the lots of the named vaccines as of a day, or that a
+ * vaccine had no lots then.
+ *
+ * @param out The output buffer.
+ * @param names The vaccine names, tokenized in place.
+ * @param vaccineList The head of the vaccine lot linked list.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param hashSize The size of the hash table.
+ * @param engine The engine-wide state.
+ * @param day The day number.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+static void listNamedLotsAsOf(TextBuffer *out, char *names,
+                              VaccineLot *vaccineList,
+                              VaccineNameIndex **nameHashTable, int hashSize,
+                              EngineState *engine, int day, int portuguese) {
+  char *rest = names;
+  char *name;
+  while ((name = strtok_r(rest, " \t", &rest)) != NULL) {
+    VaccineNameIndex *nameEntry =
+        findVaccineByName(nameHashTable, name, hashSize);
+    if (nameEntry != NULL &&
+        listLotsAsOf(out, vaccineList, nameEntry, engine, day) > 0)
+      continue;
+    handleVaccineNotFound(out, name, portuguese, &engine->json);
+  }
+}
+
+/**
+ * @brief Command L with a date: Lists vaccine batches as they were at the end
+ * of a past day.
+ *
+ * @param args The command arguments (the date, then optional vaccine names).
+ * @param vaccineList The head of the vaccine lot linked list.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param hashSize The size of the hash table.
+ * @param currentDate The current date.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandLAsOf(char *args, VaccineLot *vaccineList,
+                  VaccineNameIndex **nameHashTable, int hashSize,
+                  Date currentDate, EngineState *engine, int portuguese) {
+  JsonWriter *json = &engine->json;
+  char *rest = args;
+  int day;
+  if (!parseAsOfDay(strtok_r(rest, " \t", &rest), currentDate, &day)) {
+    reportError(json, 'L', "invalid_date", NULL,
+                portuguese ? "data inválida" : "invalid date");
+    return;
+  }
+
+  TextBuffer out;
+  initializeScratchText(&out, &engine->scratch);
+  rest = skipSpaces(rest);
+  if (json->enabled) {
+    jsonBegin(json, 'L');
+    jsonOpen(json, *rest == '\0' ? "lots" : "vaccines", '[');
+  }
+  if (*rest == '\0')
+    listLotsAsOf(&out, vaccineList, NULL, engine, day);
+  else
+    listNamedLotsAsOf(&out, rest, vaccineList, nameHashTable, hashSize,
+                      engine, day, portuguese);
+  if (json->enabled) {
+    jsonClose(json, ']');
+    jsonEnd(json);
   } else {
-    // Otherwise, process the arguments as specific vaccine names to list
-    processSpecificVaccines(args, nameHashTable, hashSize, portuguese);
+    writeAnswer(json, out.data, out.length); // The text is in the arena
   }
-}
\ No newline at end of file
+}
@@ -20,9 +20,25 @@
   * @param vaccineList The list of vaccine lots.
   * @param nameHashTable The hash table of vaccine names.
   * @param hashSize The size of the hash table.
+  * @param engine The engine-wide state.
   * @param portuguese Flag indicating if the output should be in Portuguese.
   */
 void commandL(char *args, VaccineLot *vaccineList, VaccineNameIndex **nameHashTable,
-              int hashSize, int portuguese);
+              int hashSize, EngineState *engine, int portuguese);
+
+/**
+ * @brief Lists vaccine batches as they were at the end of a past day.
+ *
+ * @param args The command arguments (the date, then optional vaccine names).
+ * @param vaccineList The list of vaccine lots.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param hashSize The size of the hash table.
+ * @param currentDate The current date.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandLAsOf(char *args, VaccineLot *vaccineList,
+                  VaccineNameIndex **nameHashTable, int hashSize,
+                  Date currentDate, EngineState *engine, int portuguese);
 
 #endif
\ No newline at end of file
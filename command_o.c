@@ -0,0 +1,101 @@
+/**
+ * @file command_o.c
+ * @brief Implementation of command O functionality to list due series doses.
+ *
+ * This file contains the implementation of the commandO function. It reads
+ * the vaccine's due index, so only the users that are due or overdue are
+ * visited, and prints them by due date and user name.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "command_o.h"
+#include "constants.h"
+#include "project.h"
+#include "series.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Prints a user that is due for the next dose of a series, or writes
+ * it as an element of the JSON due array.
+ *
+ * @param json The JSON writer.
+ * @param progress The user's series progress entry.
+ */
+static void printDueSeries(JsonWriter *json, const SeriesProgress *progress) {
+  Date due = dayNumberToDate(progress->lastDoseDay +
+                             progress->vaccine->seriesSpacing);
+  char buffer[NUMERIC_NAME_SIZE];
+  const char *name = userNameText(progress->user, buffer);
+  if (!json->enabled) {
+    fprintf(json->out, "%s %d %02d-%02d-%d\n", name,
+            progress->dosesTaken + 1, due.day, due.month, due.year);
+    return;
+  }
+  jsonOpen(json, NULL, '{');
+  jsonString(json, "user", name);
+  jsonInteger(json, "dose", progress->dosesTaken + 1);
+  jsonDate(json, "date", due.day, due.month, due.year);
+  jsonClose(json, '}');
+}
+
+/**
+ * @brief Validates that a vaccine exists and has a dose series.
+ *
+ * @param json The JSON writer.
+ * @param vaccine The vaccine name entry (may be NULL).
+ * @param name The vaccine name.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ * @return int 1 if valid, 0 otherwise.
+ */
+static int validateSeriesVaccine(JsonWriter *json,
+                                 const VaccineNameIndex *vaccine,
+                                 const char *name, int portuguese) {
+  if (vaccine == NULL || (vaccine->lotCount == 0 && !vaccine->seriesDoses)) {
+    reportError(json, 'o', "no_such_vaccine", name,
+                portuguese ? "vacina inexistente" : "no such vaccine");
+    return 0;
+  }
+  if (vaccine->seriesDoses == 0) {
+    reportError(json, 'o', "no_series", name,
+                portuguese ? "sem série" : "no series");
+    return 0;
+  }
+  return 1;
+}
+
+/**
+ * @brief Command O: Lists the users due or overdue for a vaccine's next dose.
+ *
+ * @param args The command arguments (the vaccine name).
+ * @param nameHashTable The hash table of vaccine names.
+ * @param hashSize The size of the hash table.
+ * @param currentDate The current date.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandO(char *args, VaccineNameIndex **nameHashTable, int hashSize,
+              Date currentDate, EngineState *engine, int portuguese) {
+  JsonWriter *json = &engine->json;
+  args[strcspn(args, " \t")] = '\0';
+  VaccineNameIndex *vaccine = findVaccineByName(nameHashTable, args, hashSize);
+  if (!validateSeriesVaccine(json, vaccine, args, portuguese))
+    return;
+
+  int count;
+  SeriesProgress **due = collectDueSeries(
+      vaccine, dateToDayNumber(currentDate), &count, &engine->scratch);
+  if (json->enabled) {
+    jsonBegin(json, 'o');
+    jsonOpen(json, "due", '[');
+  }
+  for (int i = 0; i < count; i++) {
+    printDueSeries(json, due[i]);
+  }
+  if (json->enabled) {
+    jsonClose(json, ']');
+    jsonEnd(json);
+  }
+}
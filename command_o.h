@@ -0,0 +1,29 @@
+/**
+ * @file command_o.h
+ * @brief Header file for command O functionality to list due series doses.
+ *
+ * This file contains the declaration of the commandO function which lists the
+ * users whose next dose of a vaccine series is due today or overdue.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef COMMAND_O_H
+#define COMMAND_O_H
+
+#include "project.h"
+
+/**
+ * @brief Lists the users that are due or overdue for a vaccine's next dose.
+ *
+ * @param args The command arguments (the vaccine name).
+ * @param nameHashTable The hash table of vaccine names.
+ * @param hashSize The size of the hash table.
+ * @param currentDate The current date.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandO(char *args, VaccineNameIndex **nameHashTable, int hashSize,
+              Date currentDate, EngineState *engine, int portuguese);
+
+#endif
@@ -10,7 +10,10 @@
  * Author: Vicente B. Duarte
  */
 
+#include "command_r.h"
 #include "constants.h"
+#include "history.h"
+#include "journal.h"
 #include "project.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -63,9 +66,8 @@ void removeVaccineFromHash(VaccineLot **hashTable, const char *batch,
 
   // If the batch to remove is the first in the list at this index
   if (strcmp(hashTable[index]->lot, batch) == 0) {
-    VaccineLot *temp = hashTable[index];
     hashTable[index] = hashTable[index]->next_hash;
-    freeVaccineLot(temp);
+    // Memory is not freed here as the lot is kept for history
     return;
   }
 
@@ -75,7 +77,7 @@ void removeVaccineFromHash(VaccineLot **hashTable, const char *batch,
     if (strcmp(current->next_hash->lot, batch) == 0) {
       VaccineLot *temp = current->next_hash;
       current->next_hash = temp->next_hash;
-      freeVaccineLot(temp);
+      // Memory is not freed here
       return;
     }
     current = current->next_hash;
@@ -98,10 +100,8 @@ static void removeVaccineFromNameIndex(VaccineNameIndex **nameHashTable,
   if (nameEntry != NULL) {
     for (int i = 0; i < nameEntry->lotCount; i++) {
       if (strcmp(nameEntry->lots[i]->lot, batch) == 0) {
-        // Replace this slot with the last lot in the array and decrease the
-        // count
-        nameEntry->lots[i] = nameEntry->lots[nameEntry->lotCount - 1];
-        nameEntry->lotCount--;
+        // Replace this slot with the last lot in the array
+        removeLotFromName(nameEntry, i);
         break;
       }
     }
@@ -117,15 +117,25 @@ static void removeVaccineFromNameIndex(VaccineNameIndex **nameHashTable,
  * @param nameHashTable The hash table of vaccine names.
  * @param vaccineList The list of vaccine lots.
  * @param hashSize The size of the hash table.
+ * @param vaccineCount The current count of vaccine lots.
+ * @param today The current day number.
+ * @param engine The engine-wide state.
  */
 static void handleUnusedVaccineLot(const char *batch, VaccineLot **hashTable,
                                    VaccineNameIndex **nameHashTable,
-                                   VaccineLot **vaccineList, int hashSize) {
+                                   VaccineLot **vaccineList, int hashSize,
+                                   int *vaccineCount, int today,
+                                   EngineState *engine) {
   VaccineLot *lot = findVaccineByBatch(hashTable, batch, hashSize);
   if (lot != NULL) {
+    journalLotRetired(engine, lot);
     removeVaccineFromNameIndex(nameHashTable, batch, lot->name, hashSize);
     removeVaccineFromList(vaccineList, batch);
     removeVaccineFromHash(hashTable, batch, hashSize);
+    (*vaccineCount)--; // Its place can be taken by a new lot
+    retireLot(engine, lot, today);
+    emitChange(&engine->changes, CHANGE_LOT_WITHDRAWN, today, lot->doses, lot,
+               NULL);
   }
 }
 
@@ -134,10 +144,20 @@ static void handleUnusedVaccineLot(const char *batch, VaccineLot **hashTable,
  * removed.
  *
  * @param lot The vaccine lot to mark as removed.
+ * @param today The current day number.
+ * @param engine The engine-wide state.
  */
-static void handleUsedVaccineLot(VaccineLot *lot) {
+static void handleUsedVaccineLot(VaccineLot *lot, int today,
+                                 EngineState *engine) {
+  if (lot->isRemoved)
+    return; // Already removed, keep the day it was first removed
+  journalLotClosed(engine, lot);
+  emitChange(&engine->changes, CHANGE_LOT_REDUCED, today,
+             lot->doses - lot->dosesUsed, lot, NULL);
   lot->isRemoved = 1;
+  lot->removedDay = today;
   lot->doses = lot->dosesUsed; // Ensure no more doses can be used
+  syncLotHotFields(lot);
 }
 
 /**
@@ -148,17 +168,19 @@ static void handleUsedVaccineLot(VaccineLot *lot) {
  * @param nameHashTable The hash table of vaccine names.
  * @param vaccineList The list of vaccine lots.
  * @param hashSize The size of the hash table.
+ * @param vaccineCount The current count of vaccine lots.
+ * @param currentDate The current date.
+ * @param engine The engine-wide state.
  * @param portuguese Flag indicating if the output should be in Portuguese.
  */
 void commandR(char *args, VaccineLot **hashTable,
               VaccineNameIndex **nameHashTable, VaccineLot **vaccineList,
-              int hashSize, int portuguese) {
+              int hashSize, int *vaccineCount, Date currentDate,
+              EngineState *engine, int portuguese) {
   // Check if a batch argument is provided
   if (args == NULL || *args == '\0') {
-    if (portuguese)
-      printf("lote em falta\n");
-    else
-      printf("missing batch\n");
+    reportError(&engine->json, 'r', "missing_batch", NULL,
+                portuguese ? "lote em falta" : "missing batch");
     return;
   }
 
@@ -167,24 +189,24 @@ void commandR(char *args, VaccineLot **hashTable,
 
   // Check if the vaccine lot exists
   if (lot == NULL) {
-    if (portuguese)
-      printf("%s: lote inexistente\n", args);
-    else
-      printf("%s: no such batch\n", args);
+    reportError(&engine->json, 'r', "no_such_batch", args,
+                portuguese ? "lote inexistente" : "no such batch");
     return;
   }
 
   // Print the number of doses already used for this lot
-  printf("%d\n", lot->dosesUsed);
+  reportNumber(&engine->json, 'r', "used", lot->dosesUsed);
+  engine->catalogEpoch++;
 
   // If no doses have been used, remove the lot completely from all data
   // structures
   if (lot->dosesUsed == 0) {
     handleUnusedVaccineLot(args, hashTable, nameHashTable, vaccineList,
-                           hashSize);
+                           hashSize, vaccineCount, dateToDayNumber(currentDate),
+                           engine);
   } else {
     // If doses have been used, mark the lot as removed and ensure no more doses
     // are available
-    handleUsedVaccineLot(lot);
+    handleUsedVaccineLot(lot, dateToDayNumber(currentDate), engine);
   }
 }
\ No newline at end of file
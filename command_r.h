@@ -13,6 +13,24 @@
 
 #include "project.h"
 
+/**
+ * @brief Removes a vaccine lot from the linked list.
+ *
+ * @param vaccineList The list of vaccine lots.
+ * @param batch The batch identifier.
+ */
+void removeVaccineFromList(VaccineLot **vaccineList, const char *batch);
+
+/**
+ * @brief Removes a vaccine lot from the hash table.
+ *
+ * @param hashTable The hash table of vaccine lots.
+ * @param batch The batch identifier.
+ * @param size The size of the hash table.
+ */
+void removeVaccineFromHash(VaccineLot **hashTable, const char *batch,
+                           int size);
+
 /**
  * @brief Removes the availability of a vaccine lot.
  * 
@@ -21,9 +39,13 @@
  * @param nameHashTable The hash table of vaccine names.
  * @param vaccineList The list of vaccine lots.
  * @param hashSize The size of the hash table.
+ * @param vaccineCount The current count of vaccine lots.
+ * @param currentDate The current date.
+ * @param engine The engine-wide state.
  * @param portuguese Flag indicating if the output should be in Portuguese.
  */
 void commandR(char *args, VaccineLot **hashTable, VaccineNameIndex **nameHashTable,
-              VaccineLot **vaccineList, int hashSize, int portuguese);
+              VaccineLot **vaccineList, int hashSize, int *vaccineCount,
+              Date currentDate, EngineState *engine, int portuguese);
 
 #endif
\ No newline at end of file
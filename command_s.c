@@ -0,0 +1,352 @@
+/**
+ * @file command_s.c
+ * @brief Implementation of command S functionality to print engine
+ * statistics.
+ *
+ * This file contains the implementation of the commandS function. Each line
+ * names a cache and gives its size and bound followed by its counters.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "command_s.h"
+#include "cache.h"
+#include "changes.h"
+#include "constants.h"
+#include "filter.h"
+#include "project.h"
+#include "replication.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Prints the statistics of the l listing cache.
+ *
+ * @param json The JSON writer.
+ * @param cache The listing cache.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+static void printListCacheStats(JsonWriter *json, const ListCache *cache,
+                                int portuguese) {
+  size_t bytes;
+  int used = listCacheUsage(cache, &bytes);
+  if (json->enabled) {
+    jsonOpen(json, "listCache", '{');
+    jsonInteger(json, "entries", used);
+    jsonInteger(json, "capacity", LIST_CACHE_SIZE);
+    jsonInteger(json, "bytes", (long)bytes);
+    jsonInteger(json, "hits", (long)cache->hits);
+    jsonInteger(json, "misses", (long)cache->misses);
+    jsonClose(json, '}');
+  } else if (portuguese) {
+    fprintf(json->out,
+            "cache-l: %d/%d entradas, %lu bytes, %lu acertos, %lu falhas\n",
+            used, LIST_CACHE_SIZE, (unsigned long)bytes, cache->hits,
+            cache->misses);
+  } else {
+    fprintf(json->out,
+            "l-cache: %d/%d entries, %lu bytes, %lu hits, %lu misses\n",
+            used, LIST_CACHE_SIZE, (unsigned long)bytes, cache->hits,
+            cache->misses);
+  }
+}
+
+/**
+ * @brief Prints the statistics of the user name filter. The false-positive
+ * rate is the share of lookups for unknown users that still probed the hash
+ * table.
+ *
+ * @param json The JSON writer.
+ * @param filter The user name filter.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+static void printUserFilterStats(JsonWriter *json, const UserFilter *filter,
+                                 int portuguese) {
+  unsigned long unknown = filter->rejected + filter->falsePositives;
+  double rate =
+      unknown ? 100.0 * (double)filter->falsePositives / (double)unknown : 0.0;
+  if (json->enabled) {
+    jsonOpen(json, "userFilter", '{');
+    jsonInteger(json, "bits", (long)filter->bitCount);
+    jsonInteger(json, "users", (long)filter->members);
+    jsonInteger(json, "lookups", (long)filter->lookups);
+    jsonInteger(json, "rejected", (long)filter->rejected);
+    jsonInteger(json, "falsePositives", (long)filter->falsePositives);
+    jsonClose(json, '}');
+  } else if (portuguese) {
+    fprintf(json->out,
+            "filtro-utentes: %lu bits, %lu utentes, %lu consultas, %lu "
+            "rejeitadas, %lu falsos positivos (%.2f%%)\n",
+            filter->bitCount, filter->members, filter->lookups,
+            filter->rejected, filter->falsePositives, rate);
+  } else {
+    fprintf(json->out,
+            "user-filter: %lu bits, %lu users, %lu lookups, %lu rejected, "
+            "%lu false positives (%.2f%%)\n",
+            filter->bitCount, filter->members, filter->lookups,
+            filter->rejected, filter->falsePositives, rate);
+  }
+}
+
+/**
+ * @brief Prints the statistics of the recent user cache.
+ *
+ * @param json The JSON writer.
+ * @param cache The user cache.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+static void printUserCacheStats(JsonWriter *json, const UserCache *cache,
+                                int portuguese) {
+  unsigned long lookups = cache->hits + cache->misses;
+  double rate = lookups ? 100.0 * (double)cache->hits / (double)lookups : 0.0;
+  if (json->enabled) {
+    jsonOpen(json, "userCache", '{');
+    jsonInteger(json, "entries", userCacheUsage(cache));
+    jsonInteger(json, "capacity", USER_CACHE_SIZE);
+    jsonInteger(json, "hits", (long)cache->hits);
+    jsonInteger(json, "misses", (long)cache->misses);
+    jsonClose(json, '}');
+  } else if (portuguese) {
+    fprintf(json->out,
+            "cache-utentes: %d/%d entradas, %lu acertos, %lu falhas "
+            "(%.2f%% acertos)\n",
+            userCacheUsage(cache), USER_CACHE_SIZE, cache->hits, cache->misses,
+            rate);
+  } else {
+    fprintf(json->out,
+            "user-cache: %d/%d entries, %lu hits, %lu misses (%.2f%% hit "
+            "rate)\n",
+            userCacheUsage(cache), USER_CACHE_SIZE, cache->hits, cache->misses,
+            rate);
+  }
+}
+
+/**
+ * @brief Prints the statistics of the per-command scratch arena.
+ *
+ * @param json The JSON writer.
+ * @param arena The scratch arena.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+static void printArenaStats(JsonWriter *json, const ScratchArena *arena,
+                            int portuguese) {
+  if (json->enabled) {
+    jsonOpen(json, "arena", '{');
+    jsonInteger(json, "bytes", (long)arena->capacity);
+    jsonInteger(json, "peak", (long)arena->peak);
+    jsonClose(json, '}');
+  } else {
+    fprintf(json->out,
+            portuguese ? "arena: %lu bytes, pico %lu bytes\n"
+                       : "arena: %lu bytes, peak %lu bytes\n",
+            (unsigned long)arena->capacity, (unsigned long)arena->peak);
+  }
+}
+
+/**
+ * @brief Writes the replication role and how far the log has been applied as
+ * a JSON object. A replica's gap is the last record received, or 0 when no
+ * record is missing.
+ *
+ * @param json The JSON writer.
+ * @param replication The replication state.
+ */
+static void writeJsonReplication(JsonWriter *json,
+                                 const Replication *replication) {
+  static const char *const roles[] = {[ROLE_STANDALONE] = "standalone",
+                                      [ROLE_PRIMARY] = "primary",
+                                      [ROLE_REPLICA] = "replica"};
+  jsonOpen(json, "replication", '{');
+  jsonString(json, "role", roles[replication->role]);
+  jsonInteger(json, "lsn", (long)replication->lsn);
+  if (replication->role == ROLE_REPLICA) {
+    jsonInteger(json, "received", (long)replication->receivedLsn);
+    jsonInteger(json, "lag",
+                (long)(replication->receivedLsn - replication->lsn));
+    jsonInteger(json, "gap",
+                replication->gap ? (long)replication->receivedLsn : 0);
+  }
+  jsonClose(json, '}');
+}
+
+/**
+ * @brief Prints the replication role and how far the log has been applied.
+ *
+ * A replica's lag is the number of records received but not applied yet. A
+ * replica that read a record past the next one is missing records it can
+ * never apply, so the gap after the last record received is shown.
+ *
+ * @param json The JSON writer.
+ * @param replication The replication state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+static void printReplicationStats(JsonWriter *json,
+                                  const Replication *replication,
+                                  int portuguese) {
+  FILE *out = json->out;
+  if (json->enabled) {
+    writeJsonReplication(json, replication);
+  } else if (replication->role == ROLE_REPLICA) {
+    unsigned long received = replication->receivedLsn;
+    unsigned long lag = received - replication->lsn;
+    fprintf(out,
+            portuguese ? "replicação: réplica, aplicados %lu, "
+                         "recebidos %lu, atraso %lu"
+                       : "replication: replica, applied %lu, received %lu, "
+                         "lag %lu",
+            replication->lsn, received, lag);
+    if (replication->gap)
+      fprintf(out, portuguese ? ", falha após %lu" : ", gap after %lu",
+              received);
+    fprintf(out, "\n");
+  } else {
+    const char *role = replication->role == ROLE_PRIMARY
+                           ? (portuguese ? "primário" : "primary")
+                           : (portuguese ? "autónomo" : "standalone");
+    fprintf(out, "%s: %s, lsn %lu\n",
+            portuguese ? "replicação" : "replication", role,
+            replication->lsn);
+  }
+}
+
+/**
+ * @brief Prints the statistics of the change feed.
+ *
+ * @param json The JSON writer.
+ * @param feed The change feed.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+static void printChangeFeedStats(JsonWriter *json, const ChangeFeed *feed,
+                                 int portuguese) {
+  if (json->enabled) {
+    jsonOpen(json, "changeFeed", '{');
+    jsonInteger(json, "published", (long)feed->published);
+    jsonInteger(json, "staged", feed->stagedCount);
+    jsonInteger(json, "consumers", feed->consumerCount);
+    jsonInteger(json, "capacity", CHANGE_MAX_CONSUMERS);
+    jsonClose(json, '}');
+  } else if (portuguese) {
+    fprintf(json->out,
+            "alterações: %lu publicadas, %d pendentes, %d/%d consumidores\n",
+            feed->published, feed->stagedCount, feed->consumerCount,
+            CHANGE_MAX_CONSUMERS);
+  } else {
+    fprintf(json->out,
+            "change-feed: %lu published, %d staged, %d/%d consumers\n",
+            feed->published, feed->stagedCount, feed->consumerCount,
+            CHANGE_MAX_CONSUMERS);
+  }
+}
+
+/**
+ * @brief Writes the statistics of the columnar store and of its sealed
+ * segments as a JSON object.
+ *
+ * @param json The JSON writer.
+ * @param columns The columnar store.
+ * @param deleted The number of deleted rows.
+ * @param bytes The bytes of the store.
+ * @param sealed The bytes of the segments and of the sealed doses.
+ */
+static void writeJsonColumns(JsonWriter *json,
+                             const InoculationColumns *columns,
+                             unsigned long deleted, unsigned long bytes,
+                             unsigned long sealed) {
+  jsonOpen(json, "columns", '{');
+  jsonInteger(json, "rows", (long)columns->rowCount);
+  jsonInteger(json, "deleted", (long)deleted);
+  jsonInteger(json, "lots", columns->lotCount);
+  jsonInteger(json, "bytes", (long)bytes);
+  jsonInteger(json, "segments", columns->segmentCount);
+  jsonInteger(json, "sealedRows", (long)columns->sealedRows);
+  jsonInteger(json, "sealedBytes", (long)sealed);
+  jsonInteger(json, "releasedBytes", (long)columns->releasedBytes);
+  jsonClose(json, '}');
+}
+
+/**
+ * @brief Counts the bytes of the sealed segments and of the users' sealed
+ * doses.
+ *
+ * @param engine The engine-wide state.
+ * @return unsigned long The number of bytes.
+ */
+static unsigned long countSealedBytes(const EngineState *engine) {
+  unsigned long sealed = engine->columns.sealedBytes;
+  for (int id = 0; id < engine->userCount; id++)
+    sealed += engine->usersById[id]->sealedCount * sizeof(SealedDose);
+  return sealed;
+}
+
+/**
+ * @brief Prints the statistics of the columnar inoculation store and of its
+ * sealed segments.
+ *
+ * Sealing frees the records of the sealed live rows, so the segments and the
+ * users' sealed doses are shown against the bytes those records held.
+ *
+ * @param json The JSON writer.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+static void printColumnStats(JsonWriter *json, const EngineState *engine,
+                             int portuguese) {
+  const InoculationColumns *columns = &engine->columns;
+  unsigned long deleted = 0;
+  for (unsigned long i = 0; i < columns->deletedWords; i++)
+    deleted += (unsigned long)__builtin_popcountll(columns->deleted[i]);
+  unsigned long bytes =
+      columns->tailCapacity *
+          (3 * sizeof(unsigned int) + sizeof(Inoculation *)) +
+      columns->deletedWords * sizeof(unsigned long long) +
+      columns->sealedBytes;
+  unsigned long sealed = countSealedBytes(engine);
+  if (json->enabled) {
+    writeJsonColumns(json, columns, deleted, bytes, sealed);
+    return;
+  }
+  fprintf(json->out,
+          portuguese
+              ? "colunas: %lu linhas, %lu apagadas, %d lotes, %lu bytes\n"
+              : "columns: %lu rows, %lu deleted, %d lots, %lu bytes\n",
+          columns->rowCount, deleted, columns->lotCount, bytes);
+  fprintf(json->out,
+          portuguese ? "segmentos: %d selados, %lu linhas, %lu bytes em vez "
+                       "de %lu, %.2f:1\n"
+                     : "segments: %d sealed, %lu rows, %lu bytes instead "
+                       "of %lu, %.2f:1\n",
+          columns->segmentCount, columns->sealedRows, sealed,
+          columns->releasedBytes,
+          sealed ? (double)columns->releasedBytes / sealed : 0);
+}
+
+/**
+ * @brief Command S: Prints the engine statistics.
+ *
+ * The columnar store's lines are only printed when the store is kept.
+ *
+ * @param args The command arguments (must be empty).
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandS(char *args, EngineState *engine, int portuguese) {
+  JsonWriter *json = &engine->json;
+  if (args != NULL && *args != '\0') {
+    reportError(json, 's', "invalid_arguments", NULL,
+                portuguese ? "argumentos inválidos" : "invalid arguments");
+    return;
+  }
+  if (json->enabled)
+    jsonBegin(json, 's');
+  printListCacheStats(json, &engine->listCache, portuguese);
+  printUserCacheStats(json, &engine->userCache, portuguese);
+  printUserFilterStats(json, &engine->userFilter, portuguese);
+  printArenaStats(json, &engine->scratch, portuguese);
+  printReplicationStats(json, &engine->replication, portuguese);
+  printChangeFeedStats(json, &engine->changes, portuguese);
+  if (engine->columns.enabled)
+    printColumnStats(json, engine, portuguese);
+  if (json->enabled)
+    jsonEnd(json);
+}
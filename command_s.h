@@ -0,0 +1,25 @@
+/**
+ * @file command_s.h
+ * @brief Header file for command S functionality to print engine statistics.
+ *
+ * This file contains the declaration of the commandS function which prints
+ * the usage counters of the engine's caches.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef COMMAND_S_H
+#define COMMAND_S_H
+
+#include "project.h"
+
+/**
+ * @brief Prints the engine statistics.
+ *
+ * @param args The command arguments (must be empty).
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandS(char *args, EngineState *engine, int portuguese);
+
+#endif
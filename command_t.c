@@ -11,6 +11,7 @@
  */
 
 #include "constants.h"
+#include "journal.h"
 #include "project.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -77,24 +78,55 @@ static int isDateFormatValid(Date date) {
  * @brief Prints the current date in DD-MM-YYYY format.
  *
  * @param currentDate The current date to print.
+ * @param json The JSON writer.
  */
-static void printCurrentDate(Date currentDate) {
-  printf("%02d-%02d-%d\n", currentDate.day, currentDate.month,
-         currentDate.year);
+static void printCurrentDate(Date currentDate, JsonWriter *json) {
+  reportDate(json, 't', "date", currentDate.day, currentDate.month,
+             currentDate.year);
 }
 
 /**
  * @brief Prints an "invalid date" message based on the language setting.
  *
+ * @param json The JSON writer.
  * @param portuguese Flag indicating if the output should be in Portuguese (1)
  * or English (0).
  */
-static void printInvalidDateMessage(int portuguese) {
-  if (portuguese) {
-    printf("data inválida\n");
-  } else {
-    printf("invalid date\n");
+static void printInvalidDateMessage(JsonWriter *json, int portuguese) {
+  reportError(json, 't', "invalid_date", NULL,
+              portuguese ? "data inválida" : "invalid date");
+}
+
+/**
+ * @brief Advances the simulation time to a new date.
+ *
+ * @param newDate The new date, which may be invalid.
+ * @param currentDate A pointer to the current date structure to be updated.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese (1)
+ * or English (0).
+ */
+void setCurrentDate(Date newDate, Date *currentDate, EngineState *engine,
+                    int portuguese) {
+  // First, check if the format of the new date is valid
+  if (!isDateFormatValid(newDate)) {
+    printInvalidDateMessage(&engine->json, portuguese);
+    return;
+  }
+
+  // Check if the new date is not before the current date
+  if (compareDates(*currentDate, newDate) > 0) {
+    printInvalidDateMessage(&engine->json, portuguese);
+    return;
   }
+
+  // Update the current date to the new date
+  journalDateChange(engine, *currentDate);
+  *currentDate = newDate;
+  emitChange(&engine->changes, CHANGE_DATE, dateToDayNumber(newDate), 0, NULL,
+             NULL);
+  // Print the updated current date
+  printCurrentDate(*currentDate, &engine->json);
 }
 
 /**
@@ -103,37 +135,24 @@ static void printInvalidDateMessage(int portuguese) {
  * @param args The command arguments. If NULL or empty, prints the current date.
  * Otherwise, it should contain the new date in DD-MM-YYYY format.
  * @param currentDate A pointer to the current date structure to be updated.
+ * @param engine The engine-wide state.
  * @param portuguese Flag indicating if the output should be in Portuguese (1)
  * or English (0).
  */
-void commandT(char *args, Date *currentDate, int portuguese) {
+void commandT(char *args, Date *currentDate, EngineState *engine,
+              int portuguese) {
   // If no arguments are provided, just print the current date
   if (args == NULL || *args == '\0') {
-    printCurrentDate(*currentDate);
+    printCurrentDate(*currentDate, &engine->json);
     return;
   }
 
   // Parse the new date from the arguments
   Date newDate;
   if (!parseDate(args, &newDate)) {
-    printInvalidDateMessage(portuguese);
+    printInvalidDateMessage(&engine->json, portuguese);
     return;
   }
 
-  // First, check if the format of the new date is valid
-  if (!isDateFormatValid(newDate)) {
-    printInvalidDateMessage(portuguese);
-    return;
-  }
-
-  // Check if the new date is not before the current date
-  if (compareDates(*currentDate, newDate) > 0) {
-    printInvalidDateMessage(portuguese);
-    return;
-  }
-
-  // Update the current date to the new date
-  *currentDate = newDate;
-  // Print the updated current date
-  printCurrentDate(*currentDate);
-}
\ No newline at end of file
+  setCurrentDate(newDate, currentDate, engine, portuguese);
+}
@@ -13,13 +13,26 @@
 
 #include "project.h"
 
+/**
+ * @brief Advances the simulation time to a new date.
+ * 
+ * @param newDate The new date, which may be invalid.
+ * @param currentDate The current date.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void setCurrentDate(Date newDate, Date *currentDate, EngineState *engine,
+                    int portuguese);
+
 /**
  * @brief Advances the simulation time or prints the current date.
  * 
  * @param args The command arguments.
  * @param currentDate The current date.
+ * @param engine The engine-wide state.
  * @param portuguese Flag indicating if the output should be in Portuguese.
  */
-void commandT(char *args, Date *currentDate, int portuguese);
+void commandT(char *args, Date *currentDate, EngineState *engine,
+              int portuguese);
 
 #endif
\ No newline at end of file
@@ -9,9 +9,11 @@
  * Author: Vicente B. Duarte
  */
 
+#include "charclass.h"
 #include "constants.h"
+#include "engine.h"
+#include "history.h"
 #include "project.h"
-#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,11 +21,51 @@
 /**
  * @brief Prints an inoculation record.
  *
+ * @param out The stream to print to.
  * @param inoc The inoculation record to print.
  */
-static void printInoculation(Inoculation *inoc) {
-  printf("%s %s %02d-%02d-%d\n", inoc->user, inoc->lot, inoc->date.day,
-         inoc->date.month, inoc->date.year);
+static void printInoculation(FILE *out, Inoculation *inoc) {
+  fprintf(out, "%s %s %02d-%02d-%d\n", inoc->user, inoc->lot, inoc->date.day,
+          inoc->date.month, inoc->date.year);
+}
+
+/**
+ * @brief Writes an inoculation as an element of the JSON inoculations array.
+ *
+ * @param json The JSON writer.
+ * @param user The user's name.
+ * @param batch The batch identifier.
+ * @param day The day of the month.
+ * @param month The month.
+ * @param year The year.
+ */
+static void writeJsonInoculation(JsonWriter *json, const char *user,
+                                 const char *batch, int day, int month,
+                                 int year) {
+  jsonOpen(json, NULL, '{');
+  jsonString(json, "user", user);
+  jsonString(json, "batch", batch);
+  jsonDate(json, "date", day, month, year);
+  jsonClose(json, '}');
+}
+
+/**
+ * @brief Prints an inoculation, or writes it as an element of the JSON
+ * inoculations array.
+ *
+ * @param json The JSON writer.
+ * @param user The user's name.
+ * @param batch The batch identifier.
+ * @param date The packed date of the inoculation.
+ */
+static void writeInoculation(JsonWriter *json, const char *user,
+                             const char *batch, unsigned int date) {
+  int day, month, year;
+  unpackDate(date, &day, &month, &year);
+  if (json->enabled)
+    writeJsonInoculation(json, user, batch, day, month, year);
+  else
+    fprintf(json->out, "%s %s %02d-%02d-%d\n", user, batch, day, month, year);
 }
 
 /**
@@ -66,82 +108,122 @@ static int extractUserName(const char *args, char *buffer, size_t bufSize) {
 }
 
 /**
- * @brief Lists all inoculations in chronological order.
+ * @brief Lists all inoculations in chronological order by streaming the
+ * columnar store, resolving the user and lot of each live row by id.
  *
- * @param inoculationList The head of the global inoculation list.
+ * @param engine The engine-wide state.
  */
-static void listAllInoculations(Inoculation *inoculationList) {
-  if (inoculationList == NULL) {
-    return; // No inoculations to list
+static void streamInoculationColumns(EngineState *engine) {
+  ColumnCursor cursor;
+  ColumnRow row;
+  char name[NUMERIC_NAME_SIZE];
+  openColumnCursor(&cursor, &engine->columns);
+  while (nextColumnRow(&cursor, &row)) {
+    const char *user = userNameText(engine->usersById[row.userId], name);
+    writeInoculation(&engine->json, user,
+                     engine->columns.lotsById[row.lotId]->lot, row.date);
   }
+}
 
-  // Count the total number of inoculations
+/**
+ * @brief Lists the inoculations of the global list in chronological order.
+ *
+ * @param inoculationList The head of the global inoculation list, newest
+ * first.
+ * @param engine The engine-wide state.
+ */
+static void walkInoculationList(Inoculation *inoculationList,
+                                EngineState *engine) {
   int count = 0;
-  Inoculation *current = inoculationList;
-  while (current != NULL) {
+  for (Inoculation *inoc = inoculationList; inoc != NULL;
+       inoc = inoc->next_global)
     count++;
-    current = current->next_global;
-  }
-
   if (count == 0)
     return;
-
-  // Create an array to store inoculation pointers for sorting
-  Inoculation **inocArray =
-      (Inoculation **)malloc(count * sizeof(Inoculation *));
-  if (inocArray == NULL) {
-    printf("No memory\n");
-    exit(1);
+  Inoculation **oldestFirst = (Inoculation **)arenaAlloc(
+      &engine->scratch, (size_t)count * sizeof(Inoculation *));
+  int index = count;
+  for (Inoculation *inoc = inoculationList; inoc != NULL;
+       inoc = inoc->next_global)
+    oldestFirst[--index] = inoc;
+  for (int i = 0; i < count; i++) {
+    Inoculation *inoc = oldestFirst[i];
+    if (engine->json.enabled)
+      writeJsonInoculation(&engine->json, inoc->user, inoc->lot,
+                           inoc->date.day, inoc->date.month, inoc->date.year);
+    else
+      printInoculation(engine->json.out, inoc);
   }
+}
 
-  // Fill the array with inoculations in reverse order to maintain chronological
-  // order
-  current = inoculationList;
-  int index = count - 1; // Start from the end of the array
-  while (current != NULL) {
-    inocArray[index--] = current; // Fill from back to front
-    current = current->next_global;
+/**
+ * @brief Lists all inoculations in chronological order, from the columnar
+ * store if it is kept and from the global list otherwise.
+ *
+ * @param inoculationList The head of the global inoculation list.
+ * @param engine The engine-wide state.
+ */
+static void listAllInoculations(Inoculation *inoculationList,
+                                EngineState *engine) {
+  JsonWriter *json = &engine->json;
+  if (json->enabled) {
+    jsonBegin(json, 'u');
+    jsonOpen(json, "inoculations", '[');
   }
-
-  // Print inoculations in chronological order (oldest first)
-  for (int i = 0; i < count; i++) {
-    printInoculation(inocArray[i]);
+  if (engine->columns.enabled)
+    streamInoculationColumns(engine);
+  else
+    walkInoculationList(inoculationList, engine);
+  if (json->enabled) {
+    jsonClose(json, ']');
+    jsonEnd(json);
   }
-
-  free(inocArray);
 }
 
 /**
- * @brief Lists all inoculations for a specific user in chronological order.
+ * @brief Lists all inoculations for a specific user in chronological order:
+ * the sealed doses, decoded from the user's index, and then the records.
  *
  * @param userName The name of the user.
  * @param userHashTable The hash table of user indices.
  * @param hashSize The size of the hash table.
+ * @param engine The engine-wide state.
  * @param portuguese Flag indicating if the output should be in Portuguese.
  */
 static void listInoculationsByUser(const char *userName,
                                    UserIndex **userHashTable, int hashSize,
-                                   int portuguese) {
+                                   EngineState *engine, int portuguese) {
   // Find the user entry in the hash table
-  UserIndex *userEntry = findUserByName(userHashTable, userName, hashSize);
+  UserIndex *userEntry =
+      engineFindUser(engine, userHashTable, userName, hashSize);
 
   // If the user does not exist or has no inoculations
-  if (userEntry == NULL || userEntry->inoculationCount == 0) {
-    if (portuguese) {
-      printf("%s: utente inexistente\n", userName);
-    } else {
-      printf("%s: no such user\n", userName);
-    }
+  if (userEntry == NULL ||
+      userEntry->inoculationCount + userEntry->sealedCount == 0) {
+    reportError(&engine->json, 'u', "no_such_user", userName,
+                portuguese ? "utente inexistente" : "no such user");
     return;
   }
 
-  // Get the count of user's inoculations
-  int count = userEntry->inoculationCount;
-
+  JsonWriter *json = &engine->json;
+  if (json->enabled) {
+    jsonBegin(json, 'u');
+    jsonOpen(json, "inoculations", '[');
+  }
   // Print inoculations in the order they appear in the user's index
   // (chronological)
-  for (int i = 0; i < count; i++) {
-    printInoculation(userEntry->inoculations[i]);
+  for (int i = 0; i < userEntry->sealedCount; i++)
+    writeInoculation(json, userName, userEntry->sealed[i].lot->lot,
+                     userEntry->sealed[i].date);
+  for (int i = 0; i < userEntry->inoculationCount; i++) {
+    Inoculation *inoc = userEntry->inoculations[i];
+    writeInoculation(json, inoc->user, inoc->lot,
+                     packDate(inoc->date.day, inoc->date.month,
+                              inoc->date.year));
+  }
+  if (json->enabled) {
+    jsonClose(json, ']');
+    jsonEnd(json);
   }
 }
 
@@ -153,19 +235,273 @@ static void listInoculationsByUser(const char *userName,
  * @param inoculationList The head of the global inoculation list.
  * @param userHashTable The hash table of user indices.
  * @param hashSize The size of the hash tables.
+ * @param engine The engine-wide state.
  * @param portuguese Flag indicating if the output should be in Portuguese.
  */
 void commandU(char *args, Inoculation *inoculationList,
-              UserIndex **userHashTable, int hashSize, int portuguese) {
+              UserIndex **userHashTable, int hashSize, EngineState *engine,
+              int portuguese) {
   char userNameBuffer[SIZE_COMMAND];
   int hasUserName =
       extractUserName(args, userNameBuffer, sizeof(userNameBuffer));
 
   // If no user name is provided, list all inoculations
   if (!hasUserName) {
-    listAllInoculations(inoculationList);
+    listAllInoculations(inoculationList, engine);
   } else {
     // If a user name is provided, list inoculations for that user
-    listInoculationsByUser(userNameBuffer, userHashTable, hashSize, portuguese);
+    listInoculationsByUser(userNameBuffer, userHashTable, hashSize, engine,
+                           portuguese);
+  }
+}
+
+/**
+ * @brief Appends the inoculations of an array that existed at a day.
+ *
+ * @param source The inoculations to filter.
+ * @param count The number of inoculations in source.
+ * @param day The day number.
+ * @param array The array to append to.
+ * @return int The number of inoculations appended.
+ */
+static int collectArrayAsOf(Inoculation **source, int count, int day,
+                            Inoculation **array) {
+  int kept = 0;
+  for (int i = 0; i < count; i++) {
+    if (inoculationExistsAsOf(source[i], day))
+      array[kept++] = source[i];
+  }
+  return kept;
+}
+
+/**
+ * @brief Appends the inoculations of a global list that existed at a day.
+ *
+ * @param list The head of a list linked by next_global.
+ * @param day The day number.
+ * @param array The array to append to (NULL to only count).
+ * @return int The number of inoculations appended.
+ */
+static int collectListAsOf(Inoculation *list, int day, Inoculation **array) {
+  int count = 0;
+  for (Inoculation *inoc = list; inoc != NULL; inoc = inoc->next_global) {
+    if (inoculationExistsAsOf(inoc, day)) {
+      if (array != NULL)
+        array[count] = inoc;
+      count++;
+    }
   }
-}
\ No newline at end of file
+  return count;
+}
+
+/**
+ * @brief Gets a user's name as text that lives until the end of the command.
+ *
+ * @param user The user's index entry.
+ * @param scratch The per-command scratch arena.
+ * @return char* The name.
+ */
+static char *scratchUserName(UserIndex *user, ScratchArena *scratch) {
+  if (user->userName != NULL)
+    return user->userName;
+  char *name = (char *)arenaAlloc(scratch, NUMERIC_NAME_SIZE);
+  userNameText(user, name);
+  return name;
+}
+
+/**
+ * @brief Decodes a sealed row into an inoculation record that lives until the
+ * end of the command.
+ *
+ * @param user The user's name.
+ * @param batch The batch identifier.
+ * @param date The packed date.
+ * @param row The row (the inoculation's sequence number).
+ * @param scratch The per-command scratch arena.
+ * @return Inoculation* The record.
+ */
+static Inoculation *decodeSealedRow(char *user, char *batch, unsigned int date,
+                                    unsigned long row,
+                                    ScratchArena *scratch) {
+  Inoculation *inoc = (Inoculation *)arenaAlloc(scratch, sizeof(Inoculation));
+  inoc->user = user;
+  inoc->lot = batch;
+  unpackDate(date, &inoc->date.day, &inoc->date.month, &inoc->date.year);
+  inoc->sequence = row;
+  inoc->deletedDay = -1;
+  inoc->next_global = NULL;
+  return inoc;
+}
+
+/**
+ * @brief Appends a user's sealed doses that existed at a day.
+ *
+ * @param user The user's index entry.
+ * @param day The day number.
+ * @param array The array to append to.
+ * @param scratch The per-command scratch arena.
+ * @return int The number of doses appended.
+ */
+static int collectSealedAsOf(UserIndex *user, int day, Inoculation **array,
+                             ScratchArena *scratch) {
+  int kept = 0;
+  char *name = scratchUserName(user, scratch);
+  for (; kept < user->sealedCount; kept++) {
+    const SealedDose *dose = &user->sealed[kept];
+    Inoculation *inoc = decodeSealedRow(name, dose->lot->lot, dose->date,
+                                        dose->row, scratch);
+    if (dateToDayNumber(inoc->date) > day)
+      break; // Sealed doses are oldest first
+    array[kept] = inoc;
+  }
+  return kept;
+}
+
+/**
+ * @brief Appends the live sealed rows that existed at a day, decoding the
+ * segments. The deleted ones are on the deleted list.
+ *
+ * @param engine The engine-wide state.
+ * @param day The day number.
+ * @param array The array to append to.
+ * @return int The number of rows appended.
+ */
+static int collectSealedRowsAsOf(EngineState *engine, int day,
+                                 Inoculation **array) {
+  const InoculationColumns *columns = &engine->columns;
+  ColumnCursor cursor;
+  ColumnRow row;
+  int count = 0;
+  openColumnCursor(&cursor, columns);
+  while (nextColumnRow(&cursor, &row) && row.row < columns->sealedRows) {
+    Inoculation *inoc = decodeSealedRow(
+        scratchUserName(engine->usersById[row.userId], &engine->scratch),
+        columns->lotsById[row.lotId]->lot, row.date, row.row,
+        &engine->scratch);
+    if (dateToDayNumber(inoc->date) > day)
+      break; // Rows are in date order
+    array[count++] = inoc;
+  }
+  return count;
+}
+
+/**
+ * @brief Prints inoculations in the order they were made, or writes them as
+ * the JSON inoculations array.
+ *
+ * @param json The JSON writer.
+ * @param array The inoculations to print.
+ * @param count The number of inoculations.
+ * @param scratch The per-command scratch arena.
+ */
+static void printInOrder(JsonWriter *json, Inoculation **array, int count,
+                         ScratchArena *scratch) {
+  sortPointers((void **)array, count, compareInoculationSequence, scratch);
+  if (json->enabled) {
+    jsonBegin(json, 'U');
+    jsonOpen(json, "inoculations", '[');
+  }
+  for (int i = 0; i < count; i++) {
+    Inoculation *inoc = array[i];
+    if (json->enabled)
+      writeJsonInoculation(json, inoc->user, inoc->lot, inoc->date.day,
+                           inoc->date.month, inoc->date.year);
+    else
+      printInoculation(json->out, inoc);
+  }
+  if (json->enabled) {
+    jsonClose(json, ']');
+    jsonEnd(json);
+  }
+}
+
+/**
+ * @brief Lists all inoculations that existed at the end of a day.
+ *
+ * @param inoculationList The head of the global inoculation list.
+ * @param engine The engine-wide state.
+ * @param day The day number.
+ */
+static void listAllInoculationsAsOf(Inoculation *inoculationList,
+                                    EngineState *engine, int day) {
+  int live = collectListAsOf(inoculationList, day, NULL);
+  int count = live + collectListAsOf(engine->deletedInoculations, day, NULL);
+  Inoculation **array = (Inoculation **)arenaAlloc(
+      &engine->scratch,
+      (count + engine->columns.sealedRows) * sizeof(Inoculation *));
+  collectListAsOf(inoculationList, day, array);
+  collectListAsOf(engine->deletedInoculations, day, array + live);
+  count += collectSealedRowsAsOf(engine, day, array + count);
+  printInOrder(&engine->json, array, count, &engine->scratch);
+}
+
+/**
+ * @brief Lists a user's inoculations that existed at the end of a day.
+ *
+ * @param userName The name of the user.
+ * @param userHashTable The hash table of user indices.
+ * @param hashSize The size of the hash table.
+ * @param day The day number.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+static void listUserInoculationsAsOf(const char *userName,
+                                     UserIndex **userHashTable, int hashSize,
+                                     int day, EngineState *engine,
+                                     int portuguese) {
+  UserIndex *userEntry =
+      engineFindUser(engine, userHashTable, userName, hashSize);
+  int count = 0;
+  int held = userEntry == NULL ? 0
+                               : userEntry->inoculationCount +
+                                     userEntry->sealedCount +
+                                     userEntry->deletedCount;
+  Inoculation **array = NULL;
+  if (held > 0) {
+    array = (Inoculation **)arenaAlloc(&engine->scratch,
+                                       held * sizeof(Inoculation *));
+    count = collectSealedAsOf(userEntry, day, array, &engine->scratch);
+    count += collectArrayAsOf(userEntry->inoculations,
+                              userEntry->inoculationCount, day,
+                              array + count);
+    count += collectArrayAsOf(userEntry->deleted, userEntry->deletedCount,
+                              day, array + count);
+  }
+  if (count == 0)
+    reportError(&engine->json, 'U', "no_such_user", userName,
+                portuguese ? "utente inexistente" : "no such user");
+  else
+    printInOrder(&engine->json, array, count, &engine->scratch);
+}
+
+/**
+ * @brief Command U with a date: Lists inoculations as they were at the end of
+ * a past day.
+ *
+ * @param args The command arguments (the date, then an optional user name).
+ * @param inoculationList The head of the global inoculation list.
+ * @param userHashTable The hash table of user indices.
+ * @param hashSize The size of the hash tables.
+ * @param currentDate The current date.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandUAsOf(char *args, Inoculation *inoculationList,
+                  UserIndex **userHashTable, int hashSize, Date currentDate,
+                  EngineState *engine, int portuguese) {
+  char *rest = args;
+  int day;
+  if (!parseAsOfDay(strtok_r(rest, " \t", &rest), currentDate, &day)) {
+    reportError(&engine->json, 'U', "invalid_date", NULL,
+                portuguese ? "data inválida" : "invalid date");
+    return;
+  }
+
+  rest = skipSpaces(rest);
+  char userNameBuffer[SIZE_COMMAND];
+  if (!extractUserName(rest, userNameBuffer, sizeof(userNameBuffer)))
+    listAllInoculationsAsOf(inoculationList, engine, day);
+  else
+    listUserInoculationsAsOf(userNameBuffer, userHashTable, hashSize, day,
+                             engine, portuguese);
+}
@@ -20,9 +20,26 @@
  * @param inoculationList The list of inoculations.
  * @param userHashTable The hash table of user indices.
  * @param hashSize The size of the hash tables.
+ * @param engine The engine-wide state.
  * @param portuguese Flag indicating if the output should be in Portuguese.
  */
-void commandU(char* args, Inoculation* inoculationList, UserIndex** userHashTable,
-              int hashSize, int portuguese);
+void commandU(char* args, Inoculation* inoculationList,
+              UserIndex** userHashTable, int hashSize, EngineState *engine,
+              int portuguese);
+
+/**
+ * @brief Lists inoculations as they were at the end of a past day.
+ *
+ * @param args The command arguments.
+ * @param inoculationList The list of inoculations.
+ * @param userHashTable The hash table of user indices.
+ * @param hashSize The size of the hash tables.
+ * @param currentDate The current date.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandUAsOf(char *args, Inoculation *inoculationList,
+                  UserIndex **userHashTable, int hashSize, Date currentDate,
+                  EngineState *engine, int portuguese);
 
 #endif
\ No newline at end of file
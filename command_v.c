@@ -0,0 +1,104 @@
+/**
+ * @file command_v.c
+ * @brief Implementation of command V functionality to define vaccine series.
+ *
+ * This file contains the implementation of the commandV function and its
+ * helper functions. It handles parsing the command arguments, validating the
+ * input, and registering the dose series of the vaccine.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "command_v.h"
+#include "constants.h"
+#include "journal.h"
+#include "project.h"
+#include "series.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Parses the arguments of command V.
+ *
+ * @param args The command arguments.
+ * @param name Buffer to store the vaccine name.
+ * @param doses Pointer to store the number of doses.
+ * @param spacing Pointer to store the minimum spacing in days.
+ * @return int 1 if the arguments were successfully parsed, 0 otherwise.
+ */
+static int parseArgumentsV(const char *args, char *name, int *doses,
+                           int *spacing) {
+  return sscanf(args, "%" MAX_NAME_FORMAT "s %d %d", name, doses, spacing) ==
+         3;
+}
+
+/**
+ * @brief Validates the parsed arguments of command V.
+ *
+ * @param json The JSON writer.
+ * @param name The vaccine name.
+ * @param doses The number of doses.
+ * @param spacing The minimum spacing in days.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ * @return int 1 if the arguments are valid, 0 otherwise.
+ */
+static int validateSeries(JsonWriter *json, const char *name, int doses,
+                          int spacing, int portuguese) {
+  if (!isValidName(name)) {
+    reportError(json, 'v', "invalid_name", NULL,
+                portuguese ? "nome inválido" : "invalid name");
+    return 0;
+  }
+
+  if (doses <= 0 || spacing < 0) {
+    reportError(json, 'v', "invalid_quantity", NULL,
+                portuguese ? "quantidade inválida" : "invalid quantity");
+    return 0;
+  }
+
+  return 1;
+}
+
+/**
+ * @brief Command V: Defines the dose series of a vaccine.
+ *
+ * @param args The command arguments.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param userHashTable The hash table of user indices.
+ * @param hashSize The size of the hash tables.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandV(char *args, VaccineNameIndex **nameHashTable,
+              UserIndex **userHashTable, int hashSize, EngineState *engine,
+              int portuguese) {
+  JsonWriter *json = &engine->json;
+  char name[MAX_NAME_LENGTH + 2];
+  int doses, spacing;
+
+  if (!parseArgumentsV(args, name, &doses, &spacing)) {
+    reportError(json, 'v', "invalid_arguments", NULL,
+                portuguese ? "argumentos inválidos" : "invalid arguments");
+    return;
+  }
+
+  if (!validateSeries(json, name, doses, spacing, portuguese))
+    return;
+
+  VaccineNameIndex *vaccine = findVaccineByName(nameHashTable, name, hashSize);
+  if (vaccine == NULL || (vaccine->lotCount == 0 && !vaccine->seriesDoses)) {
+    reportError(json, 'v', "no_such_vaccine", name,
+                portuguese ? "vacina inexistente" : "no such vaccine");
+    return;
+  }
+  if (vaccine->seriesDoses > 0) {
+    reportError(json, 'v', "duplicate_series", NULL,
+                portuguese ? "série duplicada" : "duplicate series");
+    return;
+  }
+
+  journalSeries(engine, vaccine);
+  defineVaccineSeries(vaccine, doses, spacing, userHashTable, hashSize);
+  reportText(json, 'v', "name", name);
+}
@@ -0,0 +1,30 @@
+/**
+ * @file command_v.h
+ * @brief Header file for command V functionality to define vaccine series.
+ *
+ * This file contains the declaration of the commandV function which defines
+ * the number of doses and the minimum spacing of a vaccine's dose series.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef COMMAND_V_H
+#define COMMAND_V_H
+
+#include "project.h"
+
+/**
+ * @brief Defines the dose series of a vaccine.
+ *
+ * @param args The command arguments.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param userHashTable The hash table of user indices.
+ * @param hashSize The size of the hash tables.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandV(char *args, VaccineNameIndex **nameHashTable,
+              UserIndex **userHashTable, int hashSize, EngineState *engine,
+              int portuguese);
+
+#endif
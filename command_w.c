@@ -0,0 +1,272 @@
+/**
+ * @file command_w.c
+ * @brief Implementation of command W functionality to export the doses per
+ * day.
+ *
+ * This file contains the implementation of the commandW function. The input
+ * is `w csv|bin <from> <to> [<file>]`; the range is cut to the days from the
+ * first dose to the current date, and the columns to the vaccines with doses
+ * in it. Rows and cells are read straight from the per-day dose table, so the
+ * cost only depends on the days and vaccines exported. CSV goes to the file,
+ * or as the command's answer without one, with a header naming the vaccines
+ * and a YYYY-MM-DD date per row. The binary series needs a file and holds,
+ * little-endian: u32 packed first date, u32 day count, u16 vaccine count,
+ * every vaccine name as u16 length and bytes, then the u32 doses of every
+ * vaccine, day after day. With a file, the days and vaccines written are
+ * printed. In the JSON output mode, an export without a file answers with the
+ * vaccines and the doses of every day as fields instead of CSV.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "command_w.h"
+#include "columns.h"
+#include "constants.h"
+#include "daily.h"
+#include "project.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Structure for the part of the per-day dose table being exported
+typedef struct {
+  const DailyDoses *table;
+  int firstDay;    // Day number of the first day exported
+  int days;        // Number of days exported
+  int columns;     // Number of vaccine columns exported
+  int binary;      // Written as a binary series instead of CSV
+} DailyExport;
+
+/**
+ * @brief Writes an integer in little-endian order.
+ *
+ * @param out The output stream.
+ * @param value The integer.
+ * @param bytes The number of bytes to write.
+ */
+static void writeNumber(FILE *out, unsigned long value, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    fputc((int)(value & 0xff), out);
+    value >>= 8;
+  }
+}
+
+/**
+ * @brief Writes a vaccine name as a CSV field, quoted if it needs to be.
+ *
+ * @param out The output stream.
+ * @param name The vaccine name.
+ */
+static void writeCsvName(FILE *out, const char *name) {
+  if (strpbrk(name, ",\"") == NULL) {
+    fputs(name, out);
+    return;
+  }
+  fputc('"', out);
+  for (; *name != '\0'; name++) {
+    if (*name == '"')
+      fputc('"', out);
+    fputc(*name, out);
+  }
+  fputc('"', out);
+}
+
+/**
+ * @brief Writes the header naming the exported vaccines.
+ *
+ * @param out The output stream.
+ * @param export The export.
+ */
+static void writeHeader(FILE *out, const DailyExport *export) {
+  if (export->binary) {
+    Date first = dayNumberToDate(export->firstDay);
+    writeNumber(out, export->days > 0
+                         ? packDate(first.day, first.month, first.year)
+                         : 0,
+                4);
+    writeNumber(out, (unsigned long)export->days, 4);
+    writeNumber(out, (unsigned long)export->columns, 2);
+  } else {
+    fputs("date", out);
+  }
+  for (int column = 0; column < export->columns; column++) {
+    const char *name = export->table->columns[column];
+    if (export->binary) {
+      writeNumber(out, strlen(name), 2);
+      fputs(name, out);
+    } else {
+      fputc(',', out);
+      writeCsvName(out, name);
+    }
+  }
+  if (!export->binary)
+    fputc('\n', out);
+}
+
+/**
+ * @brief Writes the doses of every exported vaccine, day after day.
+ *
+ * @param out The output stream.
+ * @param export The export.
+ */
+static void writeRows(FILE *out, const DailyExport *export) {
+  for (int day = export->firstDay; day < export->firstDay + export->days;
+       day++) {
+    if (!export->binary) {
+      Date date = dayNumberToDate(day);
+      fprintf(out, "%04d-%02d-%02d", date.year, date.month, date.day);
+    }
+    for (int column = 0; column < export->columns; column++) {
+      int doses = dailyDoseCount(export->table, day, column);
+      if (export->binary)
+        writeNumber(out, (unsigned int)doses, 4);
+      else
+        fprintf(out, ",%d", doses);
+    }
+    if (!export->binary)
+      fputc('\n', out);
+  }
+}
+
+/**
+ * @brief Cuts a range of days to the days with rows or up to today, and
+ * finds the vaccines with doses in it.
+ *
+ * @param export The export, with the table set.
+ * @param fromDay The first day number asked for.
+ * @param toDay The last day number asked for.
+ * @param today The current day number.
+ */
+static void clipExport(DailyExport *export, int fromDay, int toDay,
+                       int today) {
+  const DailyDoses *table = export->table;
+  int first = fromDay > table->firstDay ? fromDay : table->firstDay;
+  int last = toDay < today ? toDay : today;
+  export->firstDay = first;
+  export->days = table->dayCount > 0 && first <= last ? last - first + 1 : 0;
+  export->columns = 0;
+  for (int day = first; day < first + export->days; day++) {
+    int width = dailyRowWidth(table, day);
+    if (width > export->columns)
+      export->columns = width;
+  }
+}
+
+/**
+ * @brief Parses the arguments of command W.
+ *
+ * @param args The command arguments.
+ * @param export The export, to store the format.
+ * @param fromDay Pointer to store the first day number.
+ * @param toDay Pointer to store the last day number.
+ * @param path Pointer to store the file path, or NULL if there is none.
+ * @return int 1 if the arguments are valid, 0 otherwise.
+ */
+static int parseExportArgs(char *args, DailyExport *export, int *fromDay,
+                           int *toDay, char **path) {
+  char *rest = args;
+  char *format = strtok_r(rest, " \t", &rest);
+  char *from = strtok_r(NULL, " \t", &rest);
+  char *to = strtok_r(NULL, " \t", &rest);
+  *path = strtok_r(NULL, " \t", &rest);
+  Date fromDate, toDate;
+  if (format == NULL || to == NULL || strtok_r(NULL, " \t", &rest) != NULL ||
+      !parseCalendarDate(from, &fromDate) || !parseCalendarDate(to, &toDate))
+    return 0;
+  export->binary = strcmp(format, "bin") == 0;
+  *fromDay = dateToDayNumber(fromDate);
+  *toDay = dateToDayNumber(toDate);
+  return (export->binary ? *path != NULL : strcmp(format, "csv") == 0) &&
+         *fromDay <= *toDay;
+}
+
+/**
+ * @brief Writes the exported doses as the fields of a JSON object: the
+ * vaccines, then every day with its date and doses.
+ *
+ * @param json The JSON writer.
+ * @param export The export.
+ */
+static void writeJsonExport(JsonWriter *json, const DailyExport *export) {
+  jsonBegin(json, 'w');
+  jsonOpen(json, "vaccines", '[');
+  for (int column = 0; column < export->columns; column++)
+    jsonString(json, NULL, export->table->columns[column]);
+  jsonClose(json, ']');
+  jsonOpen(json, "days", '[');
+  for (int day = export->firstDay; day < export->firstDay + export->days;
+       day++) {
+    Date date = dayNumberToDate(day);
+    jsonOpen(json, NULL, '{');
+    jsonDate(json, "date", date.day, date.month, date.year);
+    jsonOpen(json, "doses", '[');
+    for (int column = 0; column < export->columns; column++)
+      jsonInteger(json, NULL, dailyDoseCount(export->table, day, column));
+    jsonClose(json, ']');
+    jsonClose(json, '}');
+  }
+  jsonClose(json, ']');
+  jsonEnd(json);
+}
+
+/**
+ * @brief Writes an export to a file, answering with the days and vaccines
+ * written.
+ *
+ * @param json The JSON writer.
+ * @param export The export.
+ * @param path The path of the file.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+static void exportToFile(JsonWriter *json, const DailyExport *export,
+                         const char *path, int portuguese) {
+  FILE *out = fopen(path, export->binary ? "wb" : "w");
+  if (out == NULL) {
+    reportError(json, 'w', "cannot_open_file", path,
+                portuguese ? "impossível abrir" : "cannot open file");
+    return;
+  }
+  writeHeader(out, export);
+  writeRows(out, export);
+  fclose(out);
+  if (!json->enabled) {
+    fprintf(json->out, "%d %d\n", export->days, export->columns);
+    return;
+  }
+  jsonBegin(json, 'w');
+  jsonInteger(json, "days", export->days);
+  jsonInteger(json, "vaccines", export->columns);
+  jsonEnd(json);
+}
+
+/**
+ * @brief Command W: Exports the doses given per day and per vaccine over a
+ * range of days.
+ *
+ * @param args The command arguments.
+ * @param currentDate The current date.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandW(char *args, Date currentDate, EngineState *engine,
+              int portuguese) {
+  JsonWriter *json = &engine->json;
+  DailyExport export;
+  int fromDay, toDay;
+  char *path;
+  export.table = &engine->dailyDoses;
+  if (!parseExportArgs(args, &export, &fromDay, &toDay, &path)) {
+    reportError(json, 'w', "invalid_arguments", NULL,
+                portuguese ? "argumentos inválidos" : "invalid arguments");
+    return;
+  }
+  clipExport(&export, fromDay, toDay, dateToDayNumber(currentDate));
+  if (path != NULL) {
+    exportToFile(json, &export, path, portuguese);
+  } else if (json->enabled) {
+    writeJsonExport(json, &export);
+  } else {
+    writeHeader(json->out, &export);
+    writeRows(json->out, &export);
+  }
+}
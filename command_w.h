@@ -0,0 +1,29 @@
+/**
+ * @file command_w.h
+ * @brief Header file for command W functionality to export the doses per day.
+ *
+ * This file contains the declaration of the commandW function which exports
+ * the doses given per day and per vaccine over a range of days, as CSV or as
+ * a binary time series.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef COMMAND_W_H
+#define COMMAND_W_H
+
+#include "project.h"
+
+/**
+ * @brief Exports the doses given per day and per vaccine over a range of
+ * days.
+ *
+ * @param args The command arguments.
+ * @param currentDate The current date.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandW(char *args, Date currentDate, EngineState *engine,
+              int portuguese);
+
+#endif
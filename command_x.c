@@ -0,0 +1,61 @@
+/**
+ * @file command_x.c
+ * @brief Implementation of command X functionality to drop a what-if branch.
+ *
+ * This file contains the implementation of the commandX function. It undoes
+ * the journal entries of the innermost branch, newest first, and prints the
+ * depth of the branches still open.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "command_x.h"
+#include "constants.h"
+#include "journal.h"
+#include "project.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Command X: Drops the innermost what-if branch.
+ *
+ * @param args The command arguments (must be empty).
+ * @param hashTable The hash table of vaccine lots.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param userHashTable The hash table of user indices.
+ * @param vaccineList The list of vaccine lots.
+ * @param inoculationList The list of inoculations.
+ * @param hashSize The size of the hash tables.
+ * @param vaccineCount The current count of vaccine lots.
+ * @param currentDate The current date.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandX(char *args, VaccineLot **hashTable,
+              VaccineNameIndex **nameHashTable, UserIndex **userHashTable,
+              VaccineLot **vaccineList, Inoculation **inoculationList,
+              int hashSize, int *vaccineCount, Date *currentDate,
+              EngineState *engine, int portuguese) {
+  JsonWriter *json = &engine->json;
+  if (args != NULL && *args != '\0') {
+    reportError(json, 'x', "invalid_arguments", NULL,
+                portuguese ? "argumentos inválidos" : "invalid arguments");
+    return;
+  }
+  if (engine->branchCount == 0) {
+    reportError(json, 'x', "no_branch", NULL,
+                portuguese ? "sem ramo" : "no branch");
+    return;
+  }
+  UndoContext context = {.hashTable = hashTable,
+                         .nameHashTable = nameHashTable,
+                         .userHashTable = userHashTable,
+                         .vaccineList = vaccineList,
+                         .inoculationList = inoculationList,
+                         .hashSize = hashSize,
+                         .vaccineCount = vaccineCount,
+                         .currentDate = currentDate};
+  dropBranch(engine, &context);
+  reportNumber(json, 'x', "branches", engine->branchCount);
+}
@@ -0,0 +1,37 @@
+/**
+ * @file command_x.h
+ * @brief Header file for command X functionality to drop a what-if branch.
+ *
+ * This file contains the declaration of the commandX function which undoes
+ * every change made since the innermost branch was opened.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef COMMAND_X_H
+#define COMMAND_X_H
+
+#include "project.h"
+
+/**
+ * @brief Drops the innermost what-if branch.
+ *
+ * @param args The command arguments (must be empty).
+ * @param hashTable The hash table of vaccine lots.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param userHashTable The hash table of user indices.
+ * @param vaccineList The list of vaccine lots.
+ * @param inoculationList The list of inoculations.
+ * @param hashSize The size of the hash tables.
+ * @param vaccineCount The current count of vaccine lots.
+ * @param currentDate The current date.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandX(char *args, VaccineLot **hashTable,
+              VaccineNameIndex **nameHashTable, UserIndex **userHashTable,
+              VaccineLot **vaccineList, Inoculation **inoculationList,
+              int hashSize, int *vaccineCount, Date *currentDate,
+              EngineState *engine, int portuguese);
+
+#endif
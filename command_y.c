@@ -0,0 +1,44 @@
+/**
+ * @file command_y.c
+ * @brief Implementation of command Y functionality to commit a what-if branch.
+ *
+ * This file contains the implementation of the commandY function. Together
+ * with commands B and X it makes a branch a transaction: its changes are
+ * applied as they are made, so commands inside it see them, and committing
+ * only closes the branch. A nested commit hands the changes to the enclosing
+ * branch, which can still drop them; the outermost one forgets the journal.
+ * The depth of the branches still open is printed.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "command_y.h"
+#include "constants.h"
+#include "journal.h"
+#include "project.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Command Y: Commits the innermost what-if branch.
+ *
+ * @param args The command arguments (must be empty).
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandY(char *args, EngineState *engine, int portuguese) {
+  JsonWriter *json = &engine->json;
+  if (args != NULL && *args != '\0') {
+    reportError(json, 'y', "invalid_arguments", NULL,
+                portuguese ? "argumentos inválidos" : "invalid arguments");
+    return;
+  }
+  if (engine->branchCount == 0) {
+    reportError(json, 'y', "no_branch", NULL,
+                portuguese ? "sem ramo" : "no branch");
+    return;
+  }
+  commitBranch(engine);
+  reportNumber(json, 'y', "branches", engine->branchCount);
+}
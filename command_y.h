@@ -0,0 +1,25 @@
+/**
+ * @file command_y.h
+ * @brief Header file for command Y functionality to commit a what-if branch.
+ *
+ * This file contains the declaration of the commandY function which keeps the
+ * changes of a branch opened with command B instead of dropping them.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef COMMAND_Y_H
+#define COMMAND_Y_H
+
+#include "project.h"
+
+/**
+ * @brief Commits the innermost what-if branch.
+ *
+ * @param args The command arguments (must be empty).
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void commandY(char *args, EngineState *engine, int portuguese);
+
+#endif
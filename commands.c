@@ -9,20 +9,35 @@
  */
 
 #include "command_a.h"
+#include "command_b.h"
 #include "command_c.h"
 #include "command_d.h"
+#include "command_e.h"
+#include "command_f.h"
+#include "command_g.h"
+#include "command_h.h"
+#include "command_k.h"
 #include "command_l.h"
+#include "command_o.h"
 #include "command_r.h"
+#include "command_s.h"
 #include "command_t.h"
 #include "command_u.h"
+#include "command_v.h"
+#include "command_w.h"
+#include "command_x.h"
+#include "command_y.h"
+#include "charclass.h"
 #include "constants.h"
+#include "invariants.h"
 #include "project.h"
+#include "replication.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 /**
- * @brief Executes the appropriate command based on the command character.
+ * @brief Runs the function of a command.
  *
  * @param cmd The command character.
  * @param args The command arguments.
@@ -35,39 +50,321 @@
  * @param maxVaccines The maximum number of vaccine lots allowed.
  * @param currentDate The current date.
  * @param inoculationList The list of inoculations.
+ * @param engine The engine-wide state.
  * @param portuguese Flag indicating if the output should be in Portuguese.
  */
-void handleCommand(char cmd, char *args, VaccineLot **hashTable,
-                   VaccineNameIndex **nameHashTable, UserIndex **userHashTable,
-                   VaccineLot **vaccineList, int hashSize, int *vaccineCount,
-                   int maxVaccines, Date *currentDate,
-                   Inoculation **inoculationList, int portuguese) {
+static void dispatchCommand(char cmd, char *args, VaccineLot **hashTable,
+                            VaccineNameIndex **nameHashTable,
+                            UserIndex **userHashTable,
+                            VaccineLot **vaccineList, int hashSize,
+                            int *vaccineCount, int maxVaccines,
+                            Date *currentDate, Inoculation **inoculationList,
+                            EngineState *engine, int portuguese) {
   switch (cmd) {
   case 'c':
     commandC(args, hashTable, nameHashTable, vaccineList, hashSize,
-             vaccineCount, maxVaccines, *currentDate, portuguese);
+             vaccineCount, maxVaccines, *currentDate, engine, portuguese);
     break;
   case 'l':
-    commandL(args, *vaccineList, nameHashTable, hashSize, portuguese);
+    commandL(args, *vaccineList, nameHashTable, hashSize, engine, portuguese);
     break;
   case 't':
-    commandT(args, currentDate, portuguese);
+    commandT(args, currentDate, engine, portuguese);
     break;
   case 'a':
     commandA(args, nameHashTable, userHashTable, inoculationList, hashSize,
-             *currentDate, portuguese);
+             *currentDate, engine, portuguese);
     break;
   case 'u':
-    commandU(args, *inoculationList, userHashTable, hashSize, portuguese);
+    commandU(args, *inoculationList, userHashTable, hashSize, engine,
+             portuguese);
     break;
   case 'r':
-    commandR(args, hashTable, nameHashTable, vaccineList, hashSize, portuguese);
+    commandR(args, hashTable, nameHashTable, vaccineList, hashSize,
+             vaccineCount, *currentDate, engine, portuguese);
     break;
   case 'd':
     commandD(args, inoculationList, userHashTable, hashTable, hashSize,
-             *currentDate, portuguese);
+             *currentDate, engine, portuguese);
+    break;
+  case 'v':
+    commandV(args, nameHashTable, userHashTable, hashSize, engine,
+             portuguese);
+    break;
+  case 'o':
+    commandO(args, nameHashTable, hashSize, *currentDate, engine, portuguese);
+    break;
+  case 'k':
+    commandK(args, nameHashTable, hashSize, engine, portuguese);
+    break;
+  case 'h':
+    commandH(args, nameHashTable, hashSize, engine, portuguese);
+    break;
+  case 'L':
+    commandLAsOf(args, *vaccineList, nameHashTable, hashSize, *currentDate,
+                 engine, portuguese);
+    break;
+  case 'U':
+    commandUAsOf(args, *inoculationList, userHashTable, hashSize,
+                 *currentDate, engine, portuguese);
+    break;
+  case 'b':
+    commandB(args, engine, portuguese);
+    break;
+  case 's':
+    commandS(args, engine, portuguese);
+    break;
+  case 'x':
+    commandX(args, hashTable, nameHashTable, userHashTable, vaccineList,
+             inoculationList, hashSize, vaccineCount, currentDate, engine,
+             portuguese);
+    break;
+  case 'y':
+    commandY(args, engine, portuguese);
+    break;
+  case 'g':
+    commandG(args, engine, portuguese);
+    break;
+  case 'e':
+    commandE(args, engine, portuguese);
+    break;
+  case 'f':
+    commandF(args, nameHashTable, hashSize, *currentDate, engine, portuguese);
+    break;
+  case 'w':
+    commandW(args, *currentDate, engine, portuguese);
     break;
   default:
+    reportError(&engine->json, cmd, "unknown_command", NULL, NULL);
     break;
   }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Checks if a field of a request holds a token as the text front end
+ * splits it, with no quotes keeping spaces inside.
+ *
+ * @param field The field.
+ * @return int 1 if the field is a plain token, 0 otherwise.
+ */
+static int isPlainField(const FrameField *field) {
+  return memchr(field->text, '"', field->length) == NULL;
+}
+
+/**
+ * @brief Ends a field's text inside the decoded command line.
+ *
+ * @param field The field.
+ * @return char* The field's text, now terminated.
+ */
+static char *cutField(const FrameField *field) {
+  field->text[field->length] = '\0';
+  return field->text;
+}
+
+/**
+ * @brief Unpacks a date field of a request.
+ *
+ * @param field The field.
+ * @return Date The date.
+ */
+static Date fieldDate(const FrameField *field) {
+  Date date;
+  unpackDate((unsigned int)field->value, &date.day, &date.month, &date.year);
+  return date;
+}
+
+/**
+ * @brief Checks if the fields of a request are the batch, validation date,
+ * doses and name a new lot takes.
+ *
+ * @param request The typed fields of the request.
+ * @return int 1 if the fields have those types, 0 otherwise.
+ */
+static int isTypedLot(const FrameRequest *request) {
+  const FrameField *fields = request->fields;
+  return request->count >= 4 && isPlainField(&fields[0]) &&
+         fields[1].type == FRAME_DATE && fields[2].type == FRAME_NUMBER;
+}
+
+/**
+ * @brief Runs the typed entry point of a command sent as a binary request,
+ * if the command has one and its fields have the types it takes.
+ *
+ * @param cmd The command character.
+ * @param request The typed fields of the request, or NULL for a text line.
+ * @param hashTable The hash table of vaccine lots.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param userHashTable The hash table of user indices.
+ * @param vaccineList The list of vaccine lots.
+ * @param hashSize The size of the hash tables.
+ * @param vaccineCount The current count of vaccine lots.
+ * @param maxVaccines The maximum number of vaccine lots allowed.
+ * @param currentDate The current date.
+ * @param inoculationList The list of inoculations.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ * @return int 1 if the command ran, 0 if it must run from its text.
+ */
+static int dispatchRequest(char cmd, const FrameRequest *request,
+                           VaccineLot **hashTable,
+                           VaccineNameIndex **nameHashTable,
+                           UserIndex **userHashTable,
+                           VaccineLot **vaccineList, int hashSize,
+                           int *vaccineCount, int maxVaccines,
+                           Date *currentDate, Inoculation **inoculationList,
+                           EngineState *engine, int portuguese) {
+  if (request == NULL)
+    return 0;
+  const FrameField *fields = request->fields;
+  int count = request->count;
+  if (cmd == 't' && count == 1 && fields[0].type == FRAME_DATE)
+    setCurrentDate(fieldDate(&fields[0]), currentDate, engine, portuguese);
+  else if (cmd == 'a' && count >= 2 && isPlainField(&fields[0]))
+    applyDose(cutField(&fields[0]), fields[1].text, nameHashTable,
+              userHashTable, inoculationList, hashSize, *currentDate, engine,
+              portuguese);
+  else if (cmd == 'c' && isTypedLot(request))
+    addVaccineLot(cutField(&fields[0]), fieldDate(&fields[1]),
+                  (int)fields[2].value, fields[3].text, hashTable,
+                  nameHashTable, vaccineList, hashSize, vaccineCount,
+                  maxVaccines, *currentDate, engine, portuguese);
+  else
+    return 0;
+  return 1;
+}
+
+/**
+ * @brief Replays the commands a replica has received, hiding their output.
+ *
+ * @param hashTable The hash table of vaccine lots.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param userHashTable The hash table of user indices.
+ * @param vaccineList The list of vaccine lots.
+ * @param hashSize The size of the hash tables.
+ * @param vaccineCount The current count of vaccine lots.
+ * @param maxVaccines The maximum number of vaccine lots allowed.
+ * @param currentDate The current date.
+ * @param inoculationList The list of inoculations.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+static void applyPendingRecords(VaccineLot **hashTable,
+                                VaccineNameIndex **nameHashTable,
+                                UserIndex **userHashTable,
+                                VaccineLot **vaccineList, int hashSize,
+                                int *vaccineCount, int maxVaccines,
+                                Date *currentDate,
+                                Inoculation **inoculationList,
+                                EngineState *engine, int portuguese) {
+  Replication *replication = &engine->replication;
+  engine->json.discard = 1;
+  for (int i = 0; i < replication->pendingCount; i++) {
+    char *record = replication->pending[i];
+    dispatchCommand(record[0], skipSpaces(record + 1), hashTable,
+                    nameHashTable, userHashTable, vaccineList, hashSize,
+                    vaccineCount, maxVaccines, currentDate, inoculationList,
+                    engine, portuguese);
+    replication->lsn++;
+    resetArena(&engine->scratch);
+  }
+  engine->json.discard = 0;
+  clearPendingRecords(replication);
+}
+
+/**
+ * @brief Receives the log on a replica and replays it before a command that
+ * reads, or refuses a command that changes the system.
+ *
+ * @param cmd The command character.
+ * @param args The command arguments.
+ * @param hashTable The hash table of vaccine lots.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param userHashTable The hash table of user indices.
+ * @param vaccineList The list of vaccine lots.
+ * @param hashSize The size of the hash tables.
+ * @param vaccineCount The current count of vaccine lots.
+ * @param maxVaccines The maximum number of vaccine lots allowed.
+ * @param currentDate The current date.
+ * @param inoculationList The list of inoculations.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ * @return int 1 if the command may run, 0 if it was refused.
+ */
+static int catchUpReplica(char cmd, const char *args, VaccineLot **hashTable,
+                          VaccineNameIndex **nameHashTable,
+                          UserIndex **userHashTable, VaccineLot **vaccineList,
+                          int hashSize, int *vaccineCount, int maxVaccines,
+                          Date *currentDate, Inoculation **inoculationList,
+                          EngineState *engine, int portuguese) {
+  receiveRecords(&engine->replication);
+  if (isChangingCommand(cmd, args)) {
+    reportError(&engine->json, cmd, "read_only_replica", NULL,
+                portuguese ? "réplica só de leitura" : "read-only replica");
+    return 0;
+  }
+  if (cmd != 's') // Statistics show the lag, so they do not catch up
+    applyPendingRecords(hashTable, nameHashTable, userHashTable, vaccineList,
+                        hashSize, vaccineCount, maxVaccines, currentDate,
+                        inoculationList, engine, portuguese);
+  return 1;
+}
+
+/**
+ * @brief Executes the appropriate command based on the command character.
+ *
+ * A replica first replays the log and refuses changes, and a primary logs
+ * each change once it is made, holding those of open branches back. A binary
+ * request runs a command's typed entry point when it has one. The change
+ * feed's sink is flushed and the engine's scratch arena is reset after every
+ * command.
+ *
+ * @param cmd The command character.
+ * @param args The command arguments.
+ * @param hashTable The hash table of vaccine lots.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param userHashTable The hash table of user indices.
+ * @param vaccineList The list of vaccine lots.
+ * @param hashSize The size of the hash tables.
+ * @param vaccineCount The current count of vaccine lots.
+ * @param maxVaccines The maximum number of vaccine lots allowed.
+ * @param currentDate The current date.
+ * @param inoculationList The list of inoculations.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void handleCommand(char cmd, char *args, VaccineLot **hashTable,
+                   VaccineNameIndex **nameHashTable, UserIndex **userHashTable,
+                   VaccineLot **vaccineList, int hashSize, int *vaccineCount,
+                   int maxVaccines, Date *currentDate,
+                   Inoculation **inoculationList, EngineState *engine,
+                   int portuguese) {
+  Replication *replication = &engine->replication;
+  int changes = isReplicatedCommand(cmd, args);
+  int branches = engine->branchCount;
+  if (replication->role == ROLE_REPLICA &&
+      !catchUpReplica(cmd, args, hashTable, nameHashTable, userHashTable,
+                      vaccineList, hashSize, vaccineCount, maxVaccines,
+                      currentDate, inoculationList, engine, portuguese))
+    return;
+  char *record = NULL;
+  if (changes && replication->role == ROLE_PRIMARY)
+    record = arenaStrdup(&engine->scratch, args); // Commands edit their args
+  if (!dispatchRequest(cmd, engine->request, hashTable, nameHashTable,
+                       userHashTable, vaccineList, hashSize, vaccineCount,
+                       maxVaccines, currentDate, inoculationList, engine,
+                       portuguese))
+    dispatchCommand(cmd, args, hashTable, nameHashTable, userHashTable,
+                    vaccineList, hashSize, vaccineCount, maxVaccines,
+                    currentDate, inoculationList, engine, portuguese);
+  if (replication->role == ROLE_PRIMARY)
+    logCommand(replication, cmd, record, engine->branchCount - branches);
+  else
+    replication->lsn += changes;
+  flushChangeSink(&engine->changes);
+#ifdef CHECK_INVARIANTS
+  checkInvariants(hashTable, nameHashTable, userHashTable, *vaccineList,
+                  *inoculationList, hashSize, *vaccineCount, engine);
+#endif
+  resetArena(&engine->scratch); // Nothing allocated from it outlives a command
+}
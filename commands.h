@@ -27,12 +27,14 @@
   * @param maxVaccines The maximum number of vaccine lots allowed.
   * @param currentDate The current date.
   * @param inoculationList The list of inoculations.
+  * @param engine The engine-wide state.
   * @param portuguese Flag indicating if the output should be in Portuguese.
   */
 void handleCommand(char cmd, char *args, VaccineLot **hashTable,
                  VaccineNameIndex **nameHashTable, UserIndex **userHashTable,
                  VaccineLot **vaccineList, int hashSize,
                  int *vaccineCount, int maxVaccines, Date *currentDate,
-                 Inoculation **inoculationList, int portuguese);
+                 Inoculation **inoculationList, EngineState *engine,
+                 int portuguese);
 
 #endif
\ No newline at end of file
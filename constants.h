@@ -14,5 +14,9 @@
 #define SIZE_COMMAND 65535
 #define HASH_SIZE 1009
 #define MAX_VACCINES 1000
+#define MAX_NAME_LENGTH 50
+#define MAX_BATCH_LENGTH 20
+#define LOOKUP_BATCH 16
+#define MAX_NAME_FORMAT "51"
 
 #endif
@@ -0,0 +1,201 @@
+/**
+ * @file daily.c
+ * @brief Implementation of the per-day dose table.
+ *
+ * Rows are stored one after the other in a single array, with the offset of
+ * each row kept apart, so a day's row is found by subtracting the first day.
+ * Doses are only applied on the current day, so only the last row ever gets
+ * wider; the rows of days without doses are empty. Undoing a branch cuts the
+ * table back to a saved size, since the rows and columns added last are the
+ * first undone.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "daily.h"
+#include "alloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Initializes an empty per-day dose table.
+ *
+ * @param table The per-day dose table.
+ */
+void initializeDailyDoses(DailyDoses *table) {
+  table->firstDay = 0;
+  table->dayCount = 0;
+  table->rowStart = NULL;
+  table->rowCapacity = 0;
+  table->counts = NULL;
+  table->countCapacity = 0;
+  table->columns = NULL;
+  table->columnCount = 0;
+  table->columnCapacity = 0;
+}
+
+/**
+ * @brief Grows an array of integers to hold at least a number of elements.
+ *
+ * @param array Pointer to the array.
+ * @param capacity Pointer to the array's capacity.
+ * @param needed The number of elements needed.
+ */
+static void reserveIntegers(int **array, int *capacity, int needed) {
+  if (needed <= *capacity)
+    return;
+  int grown = *capacity ? *capacity : 16;
+  while (grown < needed)
+    grown *= 2;
+  int *resized = (int *)reallocateOrExit(*array, (size_t)grown * sizeof(int));
+  *array = resized;
+  *capacity = grown;
+}
+
+/**
+ * @brief Adds a vaccine's column to a per-day dose table.
+ *
+ * @param table The per-day dose table.
+ * @param name The vaccine name.
+ * @return int The column.
+ */
+int addDailyColumn(DailyDoses *table, const char *name) {
+  if (table->columnCount == table->columnCapacity) {
+    int capacity = table->columnCapacity ? 2 * table->columnCapacity : 8;
+    char **columns = (char **)reallocateOrExit(table->columns,
+                                      (size_t)capacity * sizeof(char *));
+    table->columns = columns;
+    table->columnCapacity = capacity;
+  }
+  table->columns[table->columnCount] = duplicateOrExit(name);
+  return table->columnCount++;
+}
+
+/**
+ * @brief Adds empty rows up to a day.
+ *
+ * @param table The per-day dose table.
+ * @param day The day number of the last row to add.
+ */
+static void addRowsUpTo(DailyDoses *table, int day) {
+  if (table->dayCount == 0) {
+    table->firstDay = day;
+    reserveIntegers(&table->rowStart, &table->rowCapacity, 1);
+    table->rowStart[0] = 0;
+  }
+  int rows = day - table->firstDay + 1;
+  if (rows <= table->dayCount)
+    return;
+  reserveIntegers(&table->rowStart, &table->rowCapacity, rows + 1);
+  int end = table->rowStart[table->dayCount];
+  for (int row = table->dayCount + 1; row <= rows; row++)
+    table->rowStart[row] = end;
+  table->dayCount = rows;
+}
+
+/**
+ * @brief Widens the last row to hold a column.
+ *
+ * @param table The per-day dose table.
+ * @param column The column.
+ */
+static void widenLastRow(DailyDoses *table, int column) {
+  int start = table->rowStart[table->dayCount - 1];
+  int end = table->rowStart[table->dayCount];
+  if (column < end - start)
+    return;
+  reserveIntegers(&table->counts, &table->countCapacity, start + column + 1);
+  memset(&table->counts[end], 0,
+         (size_t)(start + column + 1 - end) * sizeof(int));
+  table->rowStart[table->dayCount] = start + column + 1;
+}
+
+/**
+ * @brief Changes the doses of a vaccine on a day, adding the rows up to the
+ * day if it is past the last row.
+ *
+ * @param table The per-day dose table.
+ * @param day The day number.
+ * @param column The vaccine's column.
+ * @param change The change in doses.
+ */
+void countDailyDoses(DailyDoses *table, int day, int column, int change) {
+  if (column < 0 || (table->dayCount > 0 && day < table->firstDay))
+    return;
+  addRowsUpTo(table, day);
+  int row = day - table->firstDay;
+  if (row == table->dayCount - 1)
+    widenLastRow(table, column);
+  if (column < dailyRowWidth(table, day))
+    table->counts[table->rowStart[row] + column] += change;
+}
+
+/**
+ * @brief Finds the number of columns a day's row holds.
+ *
+ * @param table The per-day dose table.
+ * @param day The day number.
+ * @return int The number of columns, or 0 if the day has no row.
+ */
+int dailyRowWidth(const DailyDoses *table, int day) {
+  int row = day - table->firstDay;
+  if (row < 0 || row >= table->dayCount)
+    return 0;
+  return table->rowStart[row + 1] - table->rowStart[row];
+}
+
+/**
+ * @brief Finds the doses given of a vaccine on a day.
+ *
+ * @param table The per-day dose table.
+ * @param day The day number.
+ * @param column The vaccine's column.
+ * @return int The number of doses.
+ */
+int dailyDoseCount(const DailyDoses *table, int day, int column) {
+  if (column >= dailyRowWidth(table, day))
+    return 0;
+  return table->counts[table->rowStart[day - table->firstDay] + column];
+}
+
+/**
+ * @brief Saves the size of a per-day dose table.
+ *
+ * @param table The per-day dose table.
+ * @param shape Pointer to store the size.
+ */
+void saveDailyShape(const DailyDoses *table, DailyShape *shape) {
+  shape->dayCount = table->dayCount;
+  shape->used = table->dayCount > 0 ? table->rowStart[table->dayCount] : 0;
+  shape->columnCount = table->columnCount;
+}
+
+/**
+ * @brief Cuts a per-day dose table back to a size it had, dropping the rows,
+ * counts and columns added since.
+ *
+ * @param table The per-day dose table.
+ * @param shape The saved size.
+ */
+void restoreDailyShape(DailyDoses *table, const DailyShape *shape) {
+  table->dayCount = shape->dayCount;
+  if (shape->dayCount > 0)
+    table->rowStart[shape->dayCount] = shape->used;
+  while (table->columnCount > shape->columnCount)
+    free(table->columns[--table->columnCount]);
+}
+
+/**
+ * @brief Frees the memory used by a per-day dose table.
+ *
+ * @param table The per-day dose table.
+ */
+void freeDailyDoses(DailyDoses *table) {
+  for (int i = 0; i < table->columnCount; i++)
+    free(table->columns[i]);
+  free(table->columns);
+  free(table->rowStart);
+  free(table->counts);
+  initializeDailyDoses(table);
+}
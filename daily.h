@@ -0,0 +1,108 @@
+/**
+ * @file daily.h
+ * @brief Header file for the per-day dose table.
+ *
+ * This file contains the declarations of a materialized table of the doses
+ * given per day and per vaccine, kept up to date as doses are applied and
+ * deleted so that any range of days can be exported without reading the
+ * inoculations. Every vaccine with doses has a column, and every day from
+ * the first dose on has a row holding the columns up to the last one with
+ * doses that day; the columns past a row's end hold no doses.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef DAILY_H
+#define DAILY_H
+
+// Structure for the doses given per day and per vaccine
+typedef struct {
+  int firstDay;       // Day number of the first row
+  int dayCount;       // Number of rows, one per day
+  int *rowStart;      // Offset of each row in counts, then the end of the last
+  int rowCapacity;    // Current capacity of rowStart
+  int *counts;        // Doses per column of each row, row after row
+  int countCapacity;  // Current capacity of counts
+  char **columns;     // Vaccine name of each column
+  int columnCount;    // Number of columns
+  int columnCapacity; // Current capacity of columns
+} DailyDoses;
+
+// Structure for the size of a per-day dose table, to cut it back to
+typedef struct {
+  int dayCount;    // Number of rows
+  int used;        // Number of counts used by the rows
+  int columnCount; // Number of columns
+} DailyShape;
+
+/**
+ * @brief Initializes an empty per-day dose table.
+ *
+ * @param table The per-day dose table.
+ */
+void initializeDailyDoses(DailyDoses *table);
+
+/**
+ * @brief Adds a vaccine's column to a per-day dose table.
+ *
+ * @param table The per-day dose table.
+ * @param name The vaccine name.
+ * @return int The column.
+ */
+int addDailyColumn(DailyDoses *table, const char *name);
+
+/**
+ * @brief Changes the doses of a vaccine on a day, adding the rows up to the
+ * day if it is past the last row.
+ *
+ * @param table The per-day dose table.
+ * @param day The day number.
+ * @param column The vaccine's column.
+ * @param change The change in doses.
+ */
+void countDailyDoses(DailyDoses *table, int day, int column, int change);
+
+/**
+ * @brief Finds the number of columns a day's row holds.
+ *
+ * @param table The per-day dose table.
+ * @param day The day number.
+ * @return int The number of columns, or 0 if the day has no row.
+ */
+int dailyRowWidth(const DailyDoses *table, int day);
+
+/**
+ * @brief Finds the doses given of a vaccine on a day.
+ *
+ * @param table The per-day dose table.
+ * @param day The day number.
+ * @param column The vaccine's column.
+ * @return int The number of doses.
+ */
+int dailyDoseCount(const DailyDoses *table, int day, int column);
+
+/**
+ * @brief Saves the size of a per-day dose table.
+ *
+ * @param table The per-day dose table.
+ * @param shape Pointer to store the size.
+ */
+void saveDailyShape(const DailyDoses *table, DailyShape *shape);
+
+/**
+ * @brief Cuts a per-day dose table back to a size it had, dropping the rows,
+ * counts and columns added since.
+ *
+ * @param table The per-day dose table.
+ * @param shape The saved size.
+ */
+void restoreDailyShape(DailyDoses *table, const DailyShape *shape);
+
+/**
+ * @brief Frees the memory used by a per-day dose table.
+ *
+ * @param table The per-day dose table.
+ */
+void freeDailyDoses(DailyDoses *table);
+
+#endif
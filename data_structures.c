@@ -9,8 +9,10 @@
  * Author: Vicente B. Duarte
  */
 
+#include "alloc.h"
 #include "constants.h"
 #include "project.h"
+#include "series.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -22,11 +24,8 @@
  * @return VaccineLot** The initialized hash table.
  */
 VaccineLot **initializeVaccineHashTable(int size) {
-  VaccineLot **hashTable = (VaccineLot **)malloc(size * sizeof(VaccineLot *));
-  if (hashTable == NULL) {
-    printf("No memory\n");
-    exit(1);
-  }
+  VaccineLot **hashTable =
+      (VaccineLot **)allocateOrExit(size * sizeof(VaccineLot *));
 
   for (int i = 0; i < size; i++) {
     hashTable[i] = NULL;
@@ -42,11 +41,7 @@ VaccineLot **initializeVaccineHashTable(int size) {
  */
 VaccineNameIndex **initializeVaccineNameHashTable(int size) {
   VaccineNameIndex **nameHashTable =
-      (VaccineNameIndex **)malloc(size * sizeof(VaccineNameIndex *));
-  if (nameHashTable == NULL) {
-    printf("No memory\n");
-    exit(1);
-  }
+      (VaccineNameIndex **)allocateOrExit(size * sizeof(VaccineNameIndex *));
 
   for (int i = 0; i < size; i++) {
     nameHashTable[i] = NULL;
@@ -61,13 +56,10 @@ VaccineNameIndex **initializeVaccineNameHashTable(int size) {
  * @return UserIndex** The initialized hash table.
  */
 UserIndex **initializeUserHashTable(int size) {
-  UserIndex **userHashTable = (UserIndex **)malloc(size * sizeof(UserIndex *));
-  if (userHashTable == NULL) {
-    printf("No memory\n");
-    exit(1);
-  }
+  UserIndex **userHashTable = (UserIndex **)allocateOrExit(
+      USER_TABLE_BUCKETS(size) * sizeof(UserIndex *));
 
-  for (int i = 0; i < size; i++) {
+  for (int i = 0; i < USER_TABLE_BUCKETS(size); i++) {
     userHashTable[i] = NULL;
   }
   return userHashTable;
@@ -117,6 +109,56 @@ VaccineNameIndex *findVaccineByName(VaccineNameIndex **nameHashTable,
   return NULL;
 }
 
+/**
+ * @brief Finds the vaccine name entries of a batch of at most LOOKUP_BATCH
+ * names.
+ *
+ * @param nameHashTable The hash table of vaccine names.
+ * @param names The names to look up.
+ * @param count The number of names.
+ * @param size The size of the hash table.
+ * @param found Array to store each name's entry, or NULL if not found.
+ */
+static void findVaccineBatch(VaccineNameIndex **nameHashTable,
+                             const char **names, int count, int size,
+                             VaccineNameIndex **found) {
+  VaccineNameIndex **buckets[LOOKUP_BATCH];
+  for (int i = 0; i < count; i++) {
+    buckets[i] = &nameHashTable[hashString(names[i], size)];
+    __builtin_prefetch(buckets[i]);
+  }
+  for (int i = 0; i < count; i++) {
+    found[i] = *buckets[i];
+    if (found[i] != NULL)
+      __builtin_prefetch(found[i]);
+  }
+  for (int i = 0; i < count; i++) {
+    while (found[i] != NULL && strcmp(found[i]->name, names[i]) != 0)
+      found[i] = found[i]->next_hash;
+  }
+}
+
+/**
+ * @brief Finds the vaccine name entries of several names in batches.
+ *
+ * Every name of a batch is hashed and its bucket prefetched before any chain
+ * is walked, so the cache misses of the different lookups overlap instead of
+ * following one another.
+ *
+ * @param nameHashTable The hash table of vaccine names.
+ * @param names The names to look up.
+ * @param count The number of names.
+ * @param size The size of the hash table.
+ * @param found Array to store each name's entry, or NULL if not found.
+ */
+void findVaccinesByNames(VaccineNameIndex **nameHashTable, const char **names,
+                         int count, int size, VaccineNameIndex **found) {
+  for (int i = 0; i < count; i += LOOKUP_BATCH) {
+    int batch = count - i < LOOKUP_BATCH ? count - i : LOOKUP_BATCH;
+    findVaccineBatch(nameHashTable, names + i, batch, size, found + i);
+  }
+}
+
 /**
  * @brief Finds a user by name in the hash table.
  *
@@ -127,16 +169,7 @@ VaccineNameIndex *findVaccineByName(VaccineNameIndex **nameHashTable,
  */
 UserIndex *findUserByName(UserIndex **userHashTable, const char *user,
                           int size) {
-  unsigned int index = hashString(user, size);
-  UserIndex *current = userHashTable[index];
-
-  while (current != NULL) {
-    if (strcmp(current->userName, user) == 0) {
-      return current;
-    }
-    current = current->next_hash;
-  }
-  return NULL;
+  return *findUserSlot(userHashTable, user, hashUserName64(user), size);
 }
 
 /**
@@ -147,12 +180,7 @@ UserIndex *findUserByName(UserIndex **userHashTable, const char *user,
  * @return char* Pointer to the allocated memory block.
  */
 static char *allocateVaccineLotMemory(size_t batch_len, size_t name_len) {
-  char *mem_block = (char *)malloc(sizeof(VaccineLot) + batch_len + name_len);
-  if (mem_block == NULL) {
-    printf("No memory\n");
-    exit(1);
-  }
-  return mem_block;
+  return (char *)allocateOrExit(sizeof(VaccineLot) + batch_len + name_len);
 }
 
 /**
@@ -168,6 +196,16 @@ static void initializeVaccineLotFields(VaccineLot *lot, Date validation,
   lot->doses = doses;
   lot->dosesUsed = 0;
   lot->isRemoved = 0;
+  lot->initialDoses = doses;
+  lot->createdDay = 0;
+  lot->removedDay = -1;
+  lot->id = -1;
+  lot->site = 0;
+  lot->siteSlot = -1;
+  lot->checkpoints = NULL;
+  lot->checkpointCount = 0;
+  lot->checkpointCapacity = 0;
+  lot->nameEntry = NULL;
   lot->next_hash = NULL;
   lot->next_vaccine = NULL;
 }
@@ -209,12 +247,7 @@ VaccineLot *createVaccineLot(const char *batch, const char *name,
  * @return char* Pointer to the allocated memory block.
  */
 static char *allocateInoculationMemory(size_t user_len, size_t lot_len) {
-  char *mem_block = (char *)malloc(sizeof(Inoculation) + user_len + lot_len);
-  if (mem_block == NULL) {
-    printf("No memory\n");
-    exit(1);
-  }
-  return mem_block;
+  return (char *)allocateOrExit(sizeof(Inoculation) + user_len + lot_len);
 }
 
 /**
@@ -240,6 +273,8 @@ Inoculation *createInoculation(const char *user, const char *lot, Date date) {
   memcpy(newInoc->lot, lot, lot_len);
 
   newInoc->date = date;
+  newInoc->sequence = 0;
+  newInoc->deletedDay = -1;
   newInoc->next_global = NULL;
 
   return newInoc;
@@ -292,27 +327,26 @@ static VaccineNameIndex *
 createNameIndexEntry(const char *name, unsigned int index,
                      VaccineNameIndex **nameHashTable) {
   VaccineNameIndex *newNameEntry =
-      (VaccineNameIndex *)malloc(sizeof(VaccineNameIndex));
-  if (newNameEntry == NULL) {
-    printf("No memory\n");
-    exit(1);
-  }
-  newNameEntry->name = strdup(name);
-  if (newNameEntry->name == NULL) {
-    free(newNameEntry);
-    printf("No memory\n");
-    exit(1);
-  }
+      (VaccineNameIndex *)allocateOrExit(sizeof(VaccineNameIndex));
+  newNameEntry->name = duplicateOrExit(name);
   newNameEntry->capacity = 4;
-  newNameEntry->lots =
-      (VaccineLot **)malloc(newNameEntry->capacity * sizeof(VaccineLot *));
-  if (newNameEntry->lots == NULL) {
-    free(newNameEntry->name);
-    free(newNameEntry);
-    printf("No memory\n");
-    exit(1);
-  }
+  newNameEntry->lots = (VaccineLot **)allocateOrExit(newNameEntry->capacity *
+                                                     sizeof(VaccineLot *));
+  newNameEntry->lotExpiry =
+      (int *)allocateOrExit(newNameEntry->capacity * sizeof(int));
+  newNameEntry->lotRemaining =
+      (int *)allocateOrExit(newNameEntry->capacity * sizeof(int));
   newNameEntry->lotCount = 0;
+  newNameEntry->seriesDoses = 0;
+  newNameEntry->seriesSpacing = 0;
+  newNameEntry->dueHeap = NULL;
+  newNameEntry->dueCount = 0;
+  newNameEntry->dueCapacity = 0;
+  initializeBitmap(&newNameEntry->recipients);
+  initializeSketchSeries(&newNameEntry->recipientSketches);
+  initializeSiteStock(&newNameEntry->stock);
+  initializeDoseRate(&newNameEntry->doseRate);
+  newNameEntry->dailyColumn = -1;
   newNameEntry->next_hash = nameHashTable[index];
   nameHashTable[index] = newNameEntry;
   return newNameEntry;
@@ -339,22 +373,115 @@ findOrCreateNameIndexEntry(VaccineNameIndex **nameHashTable, const char *name,
 }
 
 /**
- * @brief Helper function to resize the lots array in VaccineNameIndex.
+ * @brief Helper function to resize the lots array in VaccineNameIndex, along
+ * with the arrays that mirror the lots' hot fields.
  *
  * @param nameEntry The VaccineNameIndex entry.
  */
 static void resizeNameIndexLots(VaccineNameIndex *nameEntry) {
   int newCapacity = nameEntry->capacity * 2;
-  VaccineLot **newLots = (VaccineLot **)realloc(
+  VaccineLot **newLots = (VaccineLot **)reallocateOrExit(
       nameEntry->lots, newCapacity * sizeof(VaccineLot *));
-  if (newLots == NULL) {
-    printf("No memory\n");
-    exit(1);
-  }
+  int *newExpiry = (int *)reallocateOrExit(nameEntry->lotExpiry,
+                                           newCapacity * sizeof(int));
+  int *newRemaining = (int *)reallocateOrExit(nameEntry->lotRemaining,
+                                              newCapacity * sizeof(int));
   nameEntry->lots = newLots;
+  nameEntry->lotExpiry = newExpiry;
+  nameEntry->lotRemaining = newRemaining;
   nameEntry->capacity = newCapacity;
 }
 
+/**
+ * @brief Places a lot at a position of its name entry and copies its hot
+ * fields into the mirror arrays.
+ *
+ * @param nameEntry The vaccine name entry.
+ * @param lot The vaccine lot.
+ * @param position The position in the lots array.
+ */
+static void placeLotInName(VaccineNameIndex *nameEntry, VaccineLot *lot,
+                           int position) {
+  nameEntry->lots[position] = lot;
+  lot->nameSlot = position;
+  nameEntry->lotExpiry[position] = dateToDayNumber(lot->validation);
+  syncLotHotFields(lot);
+}
+
+/**
+ * @brief Copies the doses a lot can still give into its name entry's mirror
+ * and its site's shelf.
+ *
+ * Must be called whenever the lot's doses, doses used or removal flag change.
+ *
+ * @param lot The vaccine lot, in a name entry.
+ */
+void syncLotHotFields(VaccineLot *lot) {
+  int remaining = lot->isRemoved ? 0 : lot->doses - lot->dosesUsed;
+  lot->nameEntry->lotRemaining[lot->nameSlot] = remaining;
+  setSiteRemaining(&lot->nameEntry->stock, lot, remaining);
+}
+
+/**
+ * @brief Removes the lot at a position of a name entry, moving the last lot
+ * into its place, and takes it off its site's shelf.
+ *
+ * @param nameEntry The vaccine name entry.
+ * @param position The position of the lot to remove.
+ */
+void removeLotFromName(VaccineNameIndex *nameEntry, int position) {
+  removeLotFromSite(&nameEntry->stock, nameEntry->lots[position]);
+  int last = --nameEntry->lotCount;
+  if (position != last)
+    placeLotInName(nameEntry, nameEntry->lots[last], position);
+}
+
+/**
+ * @brief Puts a lot back at the position it was removed from, reversing
+ * removeLotFromName.
+ *
+ * @param nameEntry The vaccine name entry.
+ * @param lot The vaccine lot.
+ * @param position The position the lot was removed from.
+ */
+void restoreLotInName(VaccineNameIndex *nameEntry, VaccineLot *lot,
+                      int position) {
+  int last = nameEntry->lotCount++;
+  if (position != last)
+    placeLotInName(nameEntry, nameEntry->lots[position], last);
+  addLotToSite(&nameEntry->stock, lot);
+  placeLotInName(nameEntry, lot, position);
+}
+
+/**
+ * @brief Finds the name index entry of a vaccine, creating it if needed.
+ *
+ * @param nameHashTable The hash table of vaccine names.
+ * @param name The vaccine name.
+ * @param size The size of the hash table.
+ * @return VaccineNameIndex* The found or newly created entry.
+ */
+VaccineNameIndex *findOrCreateVaccineName(VaccineNameIndex **nameHashTable,
+                                          const char *name, int size) {
+  return findOrCreateNameIndexEntry(nameHashTable, name, size);
+}
+
+/**
+ * @brief Checks if a batch belongs to the lots of a vaccine.
+ *
+ * @param nameEntry The vaccine name entry.
+ * @param batch The batch identifier.
+ * @return int 1 if the batch is one of the vaccine's lots, 0 otherwise.
+ */
+int vaccineHasLot(const VaccineNameIndex *nameEntry, const char *batch) {
+  for (int i = 0; i < nameEntry->lotCount; i++) {
+    if (strcmp(nameEntry->lots[i]->lot, batch) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
 /**
  * @brief Adds a vaccine lot to the name index.
  *
@@ -369,82 +496,155 @@ void addVaccineLotToNameIndex(VaccineNameIndex **nameHashTable, VaccineLot *lot,
   if (nameEntry->lotCount >= nameEntry->capacity) {
     resizeNameIndexLots(nameEntry);
   }
-  nameEntry->lots[nameEntry->lotCount++] = lot;
+  lot->nameEntry = nameEntry;
+  addLotToSite(&nameEntry->stock, lot);
+  placeLotInName(nameEntry, lot, nameEntry->lotCount++);
 }
 
 /**
- * @brief Helper function to find an existing UserIndex entry.
+ * @brief Reads a user name made only of digits as a number.
+ *
+ * @param userName The user name.
+ * @param number Pointer to store the number.
+ * @return int The number of digits, or 0 if the name is kept as text.
+ */
+static int parseNumericName(const char *userName, unsigned long long *number) {
+  unsigned long long value = 0;
+  int digits = 0;
+  for (; userName[digits] >= '0' && userName[digits] <= '9'; digits++) {
+    if (digits == MAX_NUMERIC_NAME)
+      return 0;
+    value = value * 10 + (unsigned long long)(userName[digits] - '0');
+  }
+  if (digits == 0 || userName[digits] != '\0')
+    return 0;
+  *number = value;
+  return digits;
+}
+
+/**
+ * @brief Hashes a user name kept as a number.
+ *
+ * @param number The number.
+ * @param size The size of the hash table.
+ * @return unsigned int The bucket in the numeric half of the table.
+ */
+static unsigned int hashNumericName(unsigned long long number, int size) {
+  // Fibonacci hashing spreads consecutive numbers over the buckets
+  return (unsigned int)((number * 0x9E3779B97F4A7C15ULL) >> 32) %
+         (unsigned int)size;
+}
+
+/**
+ * @brief Finds the link that holds a user in the hash table, or the link at
+ * the end of the user's bucket where the user would be inserted.
  *
  * @param userHashTable The hash table of user indices.
  * @param userName The user name.
+ * @param hash The user name's hash, from hashUserName64.
  * @param size The size of the hash table.
- * @return UserIndex* The found entry, or NULL if not found.
+ * @return UserIndex** The link; it points to the user, or to NULL if the user
+ * is not in the table.
  */
-static UserIndex *findExistingUserIndexEntry(UserIndex **userHashTable,
-                                             const char *userName, int size) {
-  unsigned int index = hashString(userName, size);
-  UserIndex *current = userHashTable[index];
-  while (current != NULL) {
-    if (strcmp(current->userName, userName) == 0) {
-      return current;
-    }
-    current = current->next_hash;
+UserIndex **findUserSlot(UserIndex **userHashTable, const char *userName,
+                         unsigned long long hash, int size) {
+  unsigned long long number = 0;
+  int digits = parseNumericName(userName, &number);
+  UserIndex **link;
+  if (digits == 0) {
+    link = &userHashTable[hash % (unsigned int)size];
+    while (*link != NULL && strcmp((*link)->userName, userName) != 0)
+      link = &(*link)->next_hash;
+    return link;
   }
-  return NULL;
+  link = &userHashTable[size + hashNumericName(number, size)];
+  while (*link != NULL &&
+         ((*link)->number != number || (*link)->digits != digits))
+    link = &(*link)->next_hash;
+  return link;
 }
 
 /**
- * @brief Helper function to create a new UserIndex entry.
+ * @brief Creates a user entry at a free link found by findUserSlot.
  *
+ * @param slot The link, which must point to NULL.
  * @param userName The user name.
- * @param index The hash index for the new entry.
- * @param userHashTable The hash table.
  * @return UserIndex* The newly created entry.
  */
-static UserIndex *createUserIndexEntry(const char *userName, unsigned int index,
-                                       UserIndex **userHashTable) {
-  UserIndex *newUserEntry = (UserIndex *)malloc(sizeof(UserIndex));
-  if (newUserEntry == NULL) {
-    printf("No memory\n");
-    exit(1);
-  }
-  newUserEntry->userName = strdup(userName);
-  if (newUserEntry->userName == NULL) {
-    free(newUserEntry);
-    printf("No memory\n");
-    exit(1);
+UserIndex *insertUserAtSlot(UserIndex **slot, const char *userName) {
+  UserIndex *newUserEntry = (UserIndex *)allocateOrExit(sizeof(UserIndex));
+  newUserEntry->number = 0;
+  newUserEntry->digits = parseNumericName(userName, &newUserEntry->number);
+  newUserEntry->userName = NULL;
+  if (newUserEntry->digits == 0) {
+    newUserEntry->userName = duplicateOrExit(userName);
   }
+  newUserEntry->id = -1;
   newUserEntry->capacity = 4;
-  newUserEntry->inoculations =
-      (Inoculation **)malloc(newUserEntry->capacity * sizeof(Inoculation *));
-  if (newUserEntry->inoculations == NULL) {
-    free(newUserEntry->userName);
-    free(newUserEntry);
-    printf("No memory\n");
-    exit(1);
-  }
+  newUserEntry->inoculations = (Inoculation **)allocateOrExit(
+      newUserEntry->capacity * sizeof(Inoculation *));
   newUserEntry->inoculationCount = 0;
-  newUserEntry->next_hash = userHashTable[index];
-  userHashTable[index] = newUserEntry;
+  newUserEntry->sealed = NULL;
+  newUserEntry->sealedCount = 0;
+  newUserEntry->sealedCapacity = 0;
+  newUserEntry->series = NULL;
+  newUserEntry->seriesCount = 0;
+  newUserEntry->deleted = NULL;
+  newUserEntry->deletedCount = 0;
+  newUserEntry->deletedCapacity = 0;
+  newUserEntry->next_hash = *slot;
+  *slot = newUserEntry;
   return newUserEntry;
 }
 
 /**
- * @brief Helper function to find or create a UserIndex entry.
+ * @brief Gets a user's name as text.
  *
- * @param userHashTable The hash table of user indices.
- * @param userName The user name.
- * @param size The size of the hash table.
- * @return UserIndex* The found or newly created UserIndex entry.
+ * @param user The user's index entry.
+ * @param buffer Room for NUMERIC_NAME_SIZE bytes, used if the name is kept as
+ * a number.
+ * @return const char* The name.
  */
-static UserIndex *findOrCreateUserIndexEntry(UserIndex **userHashTable,
-                                             const char *userName, int size) {
-  unsigned int index = hashString(userName, size);
-  UserIndex *entry = findExistingUserIndexEntry(userHashTable, userName, size);
-  if (entry == NULL) {
-    entry = createUserIndexEntry(userName, index, userHashTable);
+const char *userNameText(const UserIndex *user, char *buffer) {
+  if (user->userName != NULL)
+    return user->userName;
+  unsigned long long number = user->number;
+  for (int i = user->digits - 1; i >= 0; i--) {
+    buffer[i] = (char)('0' + number % 10);
+    number /= 10;
   }
-  return entry;
+  buffer[user->digits] = '\0';
+  return buffer;
+}
+
+/**
+ * @brief Checks if a user has a name.
+ *
+ * @param user The user's index entry.
+ * @param userName The name.
+ * @return int 1 if the names are equal, 0 otherwise.
+ */
+int userHasName(const UserIndex *user, const char *userName) {
+  if (user->userName != NULL)
+    return strcmp(user->userName, userName) == 0;
+  unsigned long long number = 0;
+  return parseNumericName(userName, &number) == user->digits &&
+         number == user->number;
+}
+
+/**
+ * @brief Compares the names of two users as strcmp would.
+ *
+ * @param a The first user.
+ * @param b The second user.
+ * @return int Negative if a < b, zero if equal, positive if a > b.
+ */
+int compareUserNames(const UserIndex *a, const UserIndex *b) {
+  // Numbers of as many digits sort as their text does
+  if (a->digits != 0 && a->digits == b->digits)
+    return (a->number > b->number) - (a->number < b->number);
+  char left[NUMERIC_NAME_SIZE], right[NUMERIC_NAME_SIZE];
+  return strcmp(userNameText(a, left), userNameText(b, right));
 }
 
 /**
@@ -454,33 +654,60 @@ static UserIndex *findOrCreateUserIndexEntry(UserIndex **userHashTable,
  */
 static void resizeUserIndexInocs(UserIndex *userEntry) {
   int newCapacity = userEntry->capacity * 2;
-  Inoculation **newInocs = (Inoculation **)realloc(
+  Inoculation **newInocs = (Inoculation **)reallocateOrExit(
       userEntry->inoculations, newCapacity * sizeof(Inoculation *));
-  if (newInocs == NULL) {
-    printf("No memory\n");
-    exit(1);
-  }
   userEntry->inoculations = newInocs;
   userEntry->capacity = newCapacity;
 }
 
 /**
- * @brief Adds an inoculation to the user index.
+ * @brief Adds an inoculation to a user's index entry.
  *
- * @param userHashTable The hash table of user indices.
+ * @param userEntry The user's index entry.
  * @param inoc The inoculation to add.
- * @param size The size of the hash table.
  */
-void addInoculationToUserIndex(UserIndex **userHashTable, Inoculation *inoc,
-                               int size) {
-  UserIndex *userEntry =
-      findOrCreateUserIndexEntry(userHashTable, inoc->user, size);
+void addInoculationToUser(UserIndex *userEntry, Inoculation *inoc) {
   if (userEntry->inoculationCount >= userEntry->capacity) {
     resizeUserIndexInocs(userEntry);
   }
   userEntry->inoculations[userEntry->inoculationCount++] = inoc;
 }
 
+/**
+ * @brief Inserts a sealed dose into a user's index entry.
+ *
+ * @param userEntry The user's index entry.
+ * @param position The index the dose takes in the user's sealed doses.
+ * @param dose The sealed dose.
+ */
+void insertSealedDose(UserIndex *userEntry, int position,
+                      const SealedDose *dose) {
+  if (userEntry->sealedCount >= userEntry->sealedCapacity) {
+    int newCapacity =
+        userEntry->sealedCapacity ? userEntry->sealedCapacity * 2 : 4;
+    userEntry->sealed = (SealedDose *)reallocateOrExit(
+        userEntry->sealed, newCapacity * sizeof(SealedDose));
+    userEntry->sealedCapacity = newCapacity;
+  }
+  memmove(&userEntry->sealed[position + 1], &userEntry->sealed[position],
+          (userEntry->sealedCount - position) * sizeof(SealedDose));
+  userEntry->sealed[position] = *dose;
+  userEntry->sealedCount++;
+}
+
+/**
+ * @brief Removes a sealed dose from a user's index entry, keeping the rest
+ * in order.
+ *
+ * @param userEntry The user's index entry.
+ * @param position The index of the dose in the user's sealed doses.
+ */
+void removeSealedDose(UserIndex *userEntry, int position) {
+  userEntry->sealedCount--;
+  memmove(&userEntry->sealed[position], &userEntry->sealed[position + 1],
+          (userEntry->sealedCount - position) * sizeof(SealedDose));
+}
+
 /**
  * @brief Hash function for strings.
  *
@@ -505,6 +732,7 @@ unsigned int hashString(const char *str, int size) {
  */
 void freeVaccineLot(VaccineLot *lot) {
   if (lot != NULL) {
+    free(lot->checkpoints);
     free(lot);
   }
 }
@@ -530,6 +758,40 @@ void freeVaccineHashTable(VaccineLot **hashTable, int size) {
   free(hashTable);
 }
 
+/**
+ * @brief Frees a vaccine name entry and everything it owns but its lots.
+ *
+ * @param entry The vaccine name entry.
+ */
+static void freeVaccineNameEntry(VaccineNameIndex *entry) {
+  free(entry->name);
+  free(entry->lots);
+  free(entry->lotExpiry);
+  free(entry->lotRemaining);
+  free(entry->dueHeap);
+  freeBitmap(&entry->recipients);
+  freeSketchSeries(&entry->recipientSketches);
+  freeSiteStock(&entry->stock);
+  free(entry);
+}
+
+/**
+ * @brief Unlinks a vaccine name entry from the hash table and frees it.
+ *
+ * @param nameHashTable The hash table of vaccine names.
+ * @param entry The vaccine name entry, with no lots left.
+ * @param size The size of the hash table.
+ */
+void removeVaccineName(VaccineNameIndex **nameHashTable,
+                       VaccineNameIndex *entry, int size) {
+  VaccineNameIndex **link = &nameHashTable[hashString(entry->name, size)];
+  while (*link != NULL && *link != entry)
+    link = &(*link)->next_hash;
+  if (*link != NULL)
+    *link = entry->next_hash;
+  freeVaccineNameEntry(entry);
+}
+
 /**
  * @brief Frees the memory used by the vaccine name hash table.
  *
@@ -544,15 +806,46 @@ void freeVaccineNameHashTable(VaccineNameIndex **nameHashTable, int size) {
     VaccineNameIndex *current = nameHashTable[i];
     while (current != NULL) {
       VaccineNameIndex *next = current->next_hash;
-      free(current->name);
-      free(current->lots);
-      free(current);
+      freeVaccineNameEntry(current);
       current = next;
     }
   }
   free(nameHashTable);
 }
 
+/**
+ * @brief Frees a user entry and everything it owns but its inoculations.
+ *
+ * @param entry The user's index entry.
+ */
+static void freeUserEntry(UserIndex *entry) {
+  free(entry->userName);
+  free(entry->inoculations);
+  free(entry->sealed);
+  freeUserSeries(entry);
+  free(entry->deleted);
+  free(entry);
+}
+
+/**
+ * @brief Unlinks a user entry from the hash table and frees it.
+ *
+ * @param userHashTable The hash table of user indices.
+ * @param entry The user's index entry, with no inoculations left.
+ * @param size The size of the hash table.
+ */
+void removeUserEntry(UserIndex **userHashTable, UserIndex *entry, int size) {
+  UserIndex **link =
+      entry->userName != NULL
+          ? &userHashTable[hashUserName64(entry->userName) % (unsigned int)size]
+          : &userHashTable[size + hashNumericName(entry->number, size)];
+  while (*link != NULL && *link != entry)
+    link = &(*link)->next_hash;
+  if (*link != NULL)
+    *link = entry->next_hash;
+  freeUserEntry(entry);
+}
+
 /**
  * @brief Frees the memory used by the user hash table.
  *
@@ -563,13 +856,11 @@ void freeUserHashTable(UserIndex **userHashTable, int size) {
   if (userHashTable == NULL)
     return;
 
-  for (int i = 0; i < size; i++) {
+  for (int i = 0; i < USER_TABLE_BUCKETS(size); i++) {
     UserIndex *current = userHashTable[i];
     while (current != NULL) {
       UserIndex *next = current->next_hash;
-      free(current->userName);
-      free(current->inoculations);
-      free(current);
+      freeUserEntry(current);
       current = next;
     }
   }
@@ -0,0 +1,227 @@
+/**
+ * @file generate.c
+ * @brief Workload generator for differential testing.
+ *
+ * This file contains a generator of random command sequences for the
+ * program and the reference model. Batches, vaccines and users are drawn
+ * from small pools so that commands keep hitting the same lots and users,
+ * and a share of the arguments is wrong on purpose to exercise the errors.
+ * The same seed always gives the same workload.
+ *
+ * Usage: `./generate <seed> <commands>`.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BATCH_COUNT 12
+#define MAX_SEEN 8
+
+// Batches, two of them invalid and one too long
+static const char *const BATCHES[BATCH_COUNT] = {
+    "A1", "B2", "C3", "D4", "E5",  "F6",
+    "A10", "FF", "0C", "b7", "12G", "1F2E3D4C5B6A7F8E9D0CC"};
+static const char *const VACCINES[] = {"pfizer", "moderna", "flu", "bcg",
+                                       "polio"};
+static const char *const USERS[] = {"ana", "bruno", "carla", "dinis",
+                                    "eva", "filipe", "gil"};
+
+// Structure for a date
+typedef struct {
+  int day, month, year;
+} Day;
+
+// Structure for the dates of the workload
+typedef struct {
+  Day today;          // Current date of the system
+  Day seen[MAX_SEEN]; // Recent dates the system has been on
+  int seenCount;      // Number of recent dates
+} Clock;
+
+/**
+ * @brief Draws the next random number.
+ *
+ * @param state The generator state.
+ * @param bound The number of possible values.
+ * @return int A number from 0 to bound - 1.
+ */
+static int draw(unsigned long long *state, int bound) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return (int)(*state % (unsigned long long)bound);
+}
+
+/**
+ * @brief Picks one of a list of words.
+ *
+ * @param state The generator state.
+ * @param words The words.
+ * @param count The number of words.
+ * @return const char* The word.
+ */
+static const char *pick(unsigned long long *state, const char *const *words,
+                        int count) {
+  return words[draw(state, count)];
+}
+
+/**
+ * @brief Moves a date forward by some days.
+ *
+ * @param date The date.
+ * @param days The number of days.
+ * @return Day The later date.
+ */
+static Day addDays(Day date, int days) {
+  int lengths[] = {0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  while (days-- > 0) {
+    int leap = date.year % 4 == 0 &&
+               (date.year % 100 != 0 || date.year % 400 == 0);
+    if (++date.day > lengths[date.month] + (date.month == 2 && leap)) {
+      date.day = 1;
+      if (++date.month > 12) {
+        date.month = 1;
+        date.year++;
+      }
+    }
+  }
+  return date;
+}
+
+/**
+ * @brief Prints a date.
+ *
+ * @param date The date.
+ */
+static void printDay(Day date) {
+  printf("%02d-%02d-%d", date.day, date.month, date.year);
+}
+
+/**
+ * @brief Prints a date for a command, sometimes one that does not exist or
+ * that is already past.
+ *
+ * @param state The generator state.
+ * @param date The date to print most of the time.
+ */
+static void printArgumentDate(unsigned long long *state, Day date) {
+  int odd = draw(state, 20);
+  if (odd == 0)
+    printf("%d-%d-%d", 29 + draw(state, 3), 2 + 2 * draw(state, 2),
+           date.year);
+  else if (odd == 1)
+    printf("31-12-2024");
+  else
+    printDay(date);
+}
+
+/**
+ * @brief Prints a command c.
+ *
+ * @param state The generator state.
+ * @param clock The dates.
+ */
+static void printAddLot(unsigned long long *state, const Clock *clock) {
+  printf("c %s ", pick(state, BATCHES, BATCH_COUNT));
+  printArgumentDate(state, addDays(clock->today, draw(state, 60)));
+  printf(" %d %s\n", draw(state, 12) - 1,
+         draw(state, 25) == 0 ? "two words" : pick(state, VACCINES, 5));
+}
+
+/**
+ * @brief Prints a command d, usually for a day the system has been on.
+ *
+ * @param state The generator state.
+ * @param clock The dates.
+ */
+static void printDelete(unsigned long long *state, const Clock *clock) {
+  printf("d %s", pick(state, USERS, 7));
+  if (draw(state, 3) > 0) {
+    printf(" ");
+    Day date = clock->seen[draw(state, clock->seenCount)];
+    if (draw(state, 8) == 0)
+      date = addDays(clock->today, 1); // Not reached yet, so invalid
+    printArgumentDate(state, date);
+    if (draw(state, 2) == 0)
+      printf(" %s", pick(state, BATCHES, BATCH_COUNT));
+  }
+  printf("\n");
+}
+
+/**
+ * @brief Prints a command t and keeps track of the dates it moves to.
+ *
+ * @param state The generator state.
+ * @param clock The dates.
+ */
+static void printAdvance(unsigned long long *state, Clock *clock) {
+  int odd = draw(state, 8);
+  if (odd == 0) {
+    printf("t\n");
+  } else if (odd == 1) {
+    printf("t 01-01-2025\n"); // Back to the start, so usually invalid
+  } else {
+    clock->today = addDays(clock->today, 1 + draw(state, 3));
+    clock->seen[clock->seenCount++ % MAX_SEEN] = clock->today;
+    if (clock->seenCount > MAX_SEEN)
+      clock->seenCount = MAX_SEEN;
+    printf("t ");
+    printDay(clock->today);
+    printf("\n");
+  }
+}
+
+/**
+ * @brief Prints one random command.
+ *
+ * @param state The generator state.
+ * @param clock The dates, moved forward by the t commands.
+ */
+static void printCommand(unsigned long long *state, Clock *clock) {
+  int kind = draw(state, 100);
+  if (kind < 20) {
+    printAddLot(state, clock);
+  } else if (kind < 50) {
+    printf("a %s %s\n", pick(state, USERS, 7), pick(state, VACCINES, 5));
+  } else if (kind < 58) {
+    printf("l");
+    for (int n = draw(state, 4); n > 0; n--)
+      printf(" %s", draw(state, 6) == 0 ? "tetano" : pick(state, VACCINES, 5));
+    printf("\n");
+  } else if (kind < 66) {
+    if (draw(state, 3) == 0)
+      printf("u\n");
+    else
+      printf("u %s\n", pick(state, USERS, 7));
+  } else if (kind < 74) {
+    printf("r %s\n", pick(state, BATCHES, BATCH_COUNT));
+  } else if (kind < 88) {
+    printDelete(state, clock);
+  } else {
+    printAdvance(state, clock);
+  }
+}
+
+/**
+ * @brief Main function of the generator.
+ *
+ * @param argc Argument count.
+ * @param argv Argument vector.
+ * @return int Exit status.
+ */
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    printf("usage: %s <seed> <commands>\n", argv[0]);
+    return 1;
+  }
+  unsigned long long state = strtoull(argv[1], NULL, 10) * 2654435761ULL + 1;
+  int commands = atoi(argv[2]);
+  Clock clock = {.today = {1, 1, 2025}, .seenCount = 1};
+  clock.seen[0] = clock.today;
+  for (int i = 0; i < commands; i++)
+    printCommand(&state, &clock);
+  printf("q\n");
+  return 0;
+}
@@ -0,0 +1,470 @@
+/**
+ * @file reference.c
+ * @brief Reference model of the vaccine system for differential testing.
+ *
+ * This file contains a deliberately simple model of commands c, l, a, r, d,
+ * u and t, kept in plain arrays that are searched linearly, with none of the
+ * indexes of the real program. Its output must match the program's exactly
+ * on the workloads written by generate.c, including the order in which the
+ * program reports errors. It reads the commands from standard input and
+ * only supports the English messages and unquoted names.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LINE_SIZE 65536
+#define FIELD_SIZE 64
+#define MAX_LOTS 4096
+#define MAX_DOSES 65536
+#define MAX_VACCINES 1000
+#define MAX_BATCH_LENGTH 20
+#define MAX_NAME_LENGTH 50
+
+// Structure for a date
+typedef struct {
+  int day, month, year;
+} Day;
+
+// Structure for a lot, kept after it is removed
+typedef struct {
+  char batch[FIELD_SIZE];
+  char name[FIELD_SIZE];
+  Day validity;
+  int doses;
+  int used;
+  int gone; // Removed without doses used, so no longer known
+} Lot;
+
+// Structure for an inoculation, kept after it is deleted
+typedef struct {
+  char user[FIELD_SIZE];
+  char batch[FIELD_SIZE];
+  Day date;
+  int deleted;
+} Dose;
+
+// Structure for the whole model
+typedef struct {
+  Lot lots[MAX_LOTS];
+  int lotCount;
+  Dose doses[MAX_DOSES];
+  int doseCount;
+  Day today;
+} Model;
+
+/**
+ * @brief Orders two dates.
+ *
+ * @param a The first date.
+ * @param b The second date.
+ * @return int Negative, zero or positive as a is before, on or after b.
+ */
+static int compareDays(Day a, Day b) {
+  return (a.year * 10000 + a.month * 100 + a.day) -
+         (b.year * 10000 + b.month * 100 + b.day);
+}
+
+/**
+ * @brief Reads a date and checks that it exists in the calendar.
+ *
+ * @param text The date as `<day>-<month>-<year>`.
+ * @param date Pointer to store the date.
+ * @return int 1 if the date exists, 0 otherwise.
+ */
+static int readDay(const char *text, Day *date) {
+  int days[] = {0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  if (sscanf(text, "%d-%d-%d", &date->day, &date->month, &date->year) != 3 ||
+      date->month < 1 || date->month > 12)
+    return 0;
+  int year = date->year;
+  if (year % 4 == 0 && (year % 100 != 0 || year % 400 == 0))
+    days[2] = 29;
+  return date->day >= 1 && date->day <= days[date->month];
+}
+
+/**
+ * @brief Finds a lot that is still known by its batch.
+ *
+ * @param model The model.
+ * @param batch The batch.
+ * @return Lot* The lot, or NULL.
+ */
+static Lot *findLot(Model *model, const char *batch) {
+  for (int i = 0; i < model->lotCount; i++)
+    if (!model->lots[i].gone && strcmp(model->lots[i].batch, batch) == 0)
+      return &model->lots[i];
+  return NULL;
+}
+
+/**
+ * @brief Counts the lots that are still known.
+ *
+ * @param model The model.
+ * @return int The number of lots.
+ */
+static int countLots(const Model *model) {
+  int count = 0;
+  for (int i = 0; i < model->lotCount; i++)
+    count += !model->lots[i].gone;
+  return count;
+}
+
+/**
+ * @brief Checks the arguments of command c, in the program's order.
+ *
+ * @param model The model.
+ * @param batch The batch.
+ * @param date The validity.
+ * @param dateExists 1 if the validity exists in the calendar.
+ * @param doses The number of doses.
+ * @param name The vaccine name.
+ * @return const char* The error, or NULL if there is none.
+ */
+static const char *lotError(Model *model, const char *batch, Day date,
+                            int dateExists, int doses, const char *name) {
+  size_t batchLength = strlen(batch);
+  if (batchLength > MAX_BATCH_LENGTH ||
+      strspn(batch, "0123456789ABCDEF") != batchLength)
+    return "invalid batch";
+  if (strlen(name) > MAX_NAME_LENGTH || strpbrk(name, " \t") != NULL)
+    return "invalid name";
+  if (!dateExists || compareDays(date, model->today) < 0)
+    return "invalid date";
+  if (doses <= 0)
+    return "invalid quantity";
+  if (countLots(model) >= MAX_VACCINES)
+    return "too many vaccines";
+  if (findLot(model, batch) != NULL)
+    return "duplicate batch number";
+  return NULL;
+}
+
+/**
+ * @brief Command c: adds a lot.
+ *
+ * @param model The model.
+ * @param args The command arguments.
+ */
+static void addLot(Model *model, const char *args) {
+  char batch[LINE_SIZE], date[LINE_SIZE], doses[LINE_SIZE];
+  int offset = 0;
+  Day validity;
+  sscanf(args, "%s %s %s %n", batch, date, doses, &offset);
+  const char *name = args + offset;
+  int exists = readDay(date, &validity);
+  const char *error =
+      lotError(model, batch, validity, exists, atoi(doses), name);
+  if (error != NULL) {
+    printf("%s\n", error);
+    return;
+  }
+  Lot *lot = &model->lots[model->lotCount++];
+  strcpy(lot->batch, batch);
+  strcpy(lot->name, name);
+  lot->validity = validity;
+  lot->doses = atoi(doses);
+  lot->used = 0;
+  lot->gone = 0;
+  printf("%s\n", batch);
+}
+
+/**
+ * @brief Orders two lots by validity and then by batch.
+ *
+ * @param a The first lot.
+ * @param b The second lot.
+ * @return int Negative, zero or positive as a comes before, with or after b.
+ */
+static int compareLots(const Lot *a, const Lot *b) {
+  int byDay = compareDays(a->validity, b->validity);
+  return byDay != 0 ? byDay : strcmp(a->batch, b->batch);
+}
+
+/**
+ * @brief Prints the known lots, all of them or those of one vaccine, in
+ * order of validity and batch.
+ *
+ * @param model The model.
+ * @param name The vaccine name, or NULL for every vaccine.
+ * @return int The number of lots printed.
+ */
+static int printLots(Model *model, const char *name) {
+  const Lot *sorted[MAX_LOTS];
+  int count = 0;
+  for (int i = 0; i < model->lotCount; i++) {
+    const Lot *lot = &model->lots[i];
+    if (lot->gone || (name != NULL && strcmp(lot->name, name) != 0))
+      continue;
+    int j = count++;
+    for (; j > 0 && compareLots(sorted[j - 1], lot) > 0; j--)
+      sorted[j] = sorted[j - 1];
+    sorted[j] = lot;
+  }
+  for (int i = 0; i < count; i++)
+    printf("%s %s %02d-%02d-%d %d %d\n", sorted[i]->name, sorted[i]->batch,
+           sorted[i]->validity.day, sorted[i]->validity.month,
+           sorted[i]->validity.year, sorted[i]->doses - sorted[i]->used,
+           sorted[i]->used);
+  return count;
+}
+
+/**
+ * @brief Command l: lists every lot or the lots of the named vaccines.
+ *
+ * @param model The model.
+ * @param args The command arguments.
+ */
+static void listLots(Model *model, char *args) {
+  if (*args == '\0') {
+    printLots(model, NULL);
+    return;
+  }
+  for (char *name = strtok(args, " "); name != NULL; name = strtok(NULL, " "))
+    if (printLots(model, name) == 0)
+      printf("%s: no such vaccine\n", name);
+}
+
+/**
+ * @brief Picks the lot a dose of a vaccine comes from: the one with the
+ * earliest validity, not yet expired, with doses left, and the smallest
+ * batch among equals.
+ *
+ * @param model The model.
+ * @param name The vaccine name.
+ * @return Lot* The lot, or NULL if there is no stock.
+ */
+static Lot *pickLot(Model *model, const char *name) {
+  Lot *best = NULL;
+  for (int i = 0; i < model->lotCount; i++) {
+    Lot *lot = &model->lots[i];
+    if (lot->gone || strcmp(lot->name, name) != 0 ||
+        lot->used >= lot->doses ||
+        compareDays(lot->validity, model->today) < 0)
+      continue;
+    if (best == NULL || compareLots(lot, best) < 0)
+      best = lot;
+  }
+  return best;
+}
+
+/**
+ * @brief Checks if a user already had a dose of a vaccine today.
+ *
+ * @param model The model.
+ * @param user The user name.
+ * @param name The vaccine name.
+ * @return int 1 if so, 0 otherwise.
+ */
+static int vaccinatedToday(Model *model, const char *user, const char *name) {
+  for (int i = 0; i < model->doseCount; i++) {
+    Dose *dose = &model->doses[i];
+    Lot *lot = findLot(model, dose->batch);
+    if (!dose->deleted && strcmp(dose->user, user) == 0 && lot != NULL &&
+        strcmp(lot->name, name) == 0 &&
+        compareDays(dose->date, model->today) == 0)
+      return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Command a: applies a dose of a vaccine to a user.
+ *
+ * @param model The model.
+ * @param args The command arguments.
+ */
+static void applyDose(Model *model, const char *args) {
+  char user[LINE_SIZE], name[LINE_SIZE];
+  sscanf(args, "%s %s", user, name);
+  if (vaccinatedToday(model, user, name)) {
+    printf("already vaccinated\n");
+    return;
+  }
+  Lot *lot = pickLot(model, name);
+  if (lot == NULL) {
+    printf("no stock\n");
+    return;
+  }
+  lot->used++;
+  Dose *dose = &model->doses[model->doseCount++];
+  strcpy(dose->user, user);
+  strcpy(dose->batch, lot->batch);
+  dose->date = model->today;
+  dose->deleted = 0;
+  printf("%s\n", lot->batch);
+}
+
+/**
+ * @brief Command r: removes the availability of a lot.
+ *
+ * @param model The model.
+ * @param args The command arguments.
+ */
+static void removeLot(Model *model, const char *args) {
+  Lot *lot = findLot(model, args);
+  if (lot == NULL) {
+    printf("%s: no such batch\n", args);
+    return;
+  }
+  printf("%d\n", lot->used);
+  if (lot->used == 0)
+    lot->gone = 1;
+  else
+    lot->doses = lot->used;
+}
+
+/**
+ * @brief Counts a user's inoculations that were not deleted.
+ *
+ * @param model The model.
+ * @param user The user name.
+ * @return int The number of inoculations.
+ */
+static int countDoses(const Model *model, const char *user) {
+  int count = 0;
+  for (int i = 0; i < model->doseCount; i++)
+    count += !model->doses[i].deleted &&
+             strcmp(model->doses[i].user, user) == 0;
+  return count;
+}
+
+/**
+ * @brief Command d: deletes a user's inoculations, all of them, those of a
+ * day or those of a day and a lot. The program checks the date before the
+ * user, so the model does too.
+ *
+ * @param model The model.
+ * @param args The command arguments.
+ */
+static void deleteDoses(Model *model, const char *args) {
+  char user[LINE_SIZE], date[LINE_SIZE] = "", batch[LINE_SIZE] = "";
+  Day day;
+  int fields = sscanf(args, "%s %s %s", user, date, batch);
+  if (fields >= 2 && (!readDay(date, &day) ||
+                      compareDays(day, model->today) > 0)) {
+    printf("invalid date\n");
+    return;
+  }
+  if (countDoses(model, user) == 0) {
+    printf("%s: no such user\n", user);
+    return;
+  }
+  if (fields == 3 && findLot(model, batch) == NULL) {
+    printf("%s: no such batch\n", batch);
+    return;
+  }
+  int deleted = 0;
+  for (int i = 0; i < model->doseCount; i++) {
+    Dose *dose = &model->doses[i];
+    if (dose->deleted || strcmp(dose->user, user) != 0 ||
+        (fields >= 2 && compareDays(dose->date, day) != 0) ||
+        (fields == 3 && strcmp(dose->batch, batch) != 0))
+      continue;
+    dose->deleted = 1;
+    deleted++;
+  }
+  printf("%d\n", deleted);
+}
+
+/**
+ * @brief Command u: lists every inoculation or those of a user, oldest
+ * first.
+ *
+ * @param model The model.
+ * @param args The command arguments.
+ */
+static void listDoses(Model *model, const char *args) {
+  if (*args != '\0' && countDoses(model, args) == 0) {
+    printf("%s: no such user\n", args);
+    return;
+  }
+  for (int i = 0; i < model->doseCount; i++) {
+    Dose *dose = &model->doses[i];
+    if (!dose->deleted && (*args == '\0' || strcmp(dose->user, args) == 0))
+      printf("%s %s %02d-%02d-%d\n", dose->user, dose->batch, dose->date.day,
+             dose->date.month, dose->date.year);
+  }
+}
+
+/**
+ * @brief Command t: prints the current date or moves it forward.
+ *
+ * @param model The model.
+ * @param args The command arguments.
+ */
+static void advanceDate(Model *model, const char *args) {
+  Day date;
+  if (*args != '\0') {
+    if (!readDay(args, &date) || compareDays(date, model->today) < 0) {
+      printf("invalid date\n");
+      return;
+    }
+    model->today = date;
+  }
+  printf("%02d-%02d-%d\n", model->today.day, model->today.month,
+         model->today.year);
+}
+
+/**
+ * @brief Runs one command.
+ *
+ * @param model The model.
+ * @param cmd The command character.
+ * @param args The command arguments.
+ */
+static void runCommand(Model *model, char cmd, char *args) {
+  switch (cmd) {
+  case 'c':
+    addLot(model, args);
+    break;
+  case 'l':
+    listLots(model, args);
+    break;
+  case 'a':
+    applyDose(model, args);
+    break;
+  case 'r':
+    removeLot(model, args);
+    break;
+  case 'd':
+    deleteDoses(model, args);
+    break;
+  case 'u':
+    listDoses(model, args);
+    break;
+  case 't':
+    advanceDate(model, args);
+    break;
+  default:
+    break;
+  }
+}
+
+/**
+ * @brief Main function of the reference model.
+ *
+ * @return int Exit status.
+ */
+int main(void) {
+  Model *model = (Model *)calloc(1, sizeof(Model));
+  char *line = (char *)malloc(LINE_SIZE);
+  if (model == NULL || line == NULL) {
+    printf("No memory\n");
+    return 1;
+  }
+  model->today = (Day){1, 1, 2025};
+  while (fgets(line, LINE_SIZE, stdin) && line[0] != 'q') {
+    line[strcspn(line, "\n")] = '\0';
+    char *args = line + 1;
+    while (*args == ' ')
+      args++;
+    runCommand(model, line[0], args);
+  }
+  free(line);
+  free(model);
+  return 0;
+}
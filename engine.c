@@ -0,0 +1,295 @@
+/**
+ * @file engine.c
+ * @brief Implementation of the engine-wide state and its mutation hooks.
+ *
+ * The commands that add or delete inoculations call these hooks once per
+ * mutation, so every secondary index is updated in a single place.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "engine.h"
+#include "alloc.h"
+#include "cohort.h"
+#include "constants.h"
+#include "filter.h"
+#include "history.h"
+#include "journal.h"
+#include "project.h"
+#include "series.h"
+#include "sketch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Initializes the engine-wide state.
+ *
+ * @param engine The engine state to initialize.
+ */
+void initializeEngineState(EngineState *engine) {
+  engine->usersById = NULL;
+  engine->userCount = 0;
+  engine->userCapacity = 0;
+  initializeSketchSeries(&engine->dailySketches);
+  engine->nextSequence = 0;
+  engine->retiredLots = NULL;
+  engine->deletedInoculations = NULL;
+  engine->journal = NULL;
+  engine->journalCount = 0;
+  engine->journalCapacity = 0;
+  engine->branchMarks = NULL;
+  engine->branchCount = 0;
+  engine->branchCapacity = 0;
+  engine->branchEpoch = 0;
+  engine->catalogEpoch = 0;
+  initializeListCache(&engine->listCache);
+  initializeUserFilter(&engine->userFilter);
+  initializeUserCache(&engine->userCache);
+  initializeArena(&engine->scratch);
+  initializeReplication(&engine->replication);
+  initializeChangeFeed(&engine->changes);
+  initializeColumns(&engine->columns);
+  initializeJsonWriter(&engine->json);
+  initializeDailyDoses(&engine->dailyDoses);
+  engine->request = NULL;
+}
+
+/**
+ * @brief Adds a user that was just given an id to the user name filter,
+ * sizing the filter again from every user with an id when it is full.
+ *
+ * @param engine The engine state.
+ * @param userHash The user name's 64-bit hash.
+ */
+static void addKnownUser(EngineState *engine, unsigned long long userHash) {
+  UserFilter *filter = &engine->userFilter;
+  if (!userFilterFull(filter)) {
+    userFilterAdd(filter, userHash);
+    return;
+  }
+  resizeUserFilter(filter, 2 * (unsigned long)engine->userCount);
+  char name[NUMERIC_NAME_SIZE];
+  for (int i = 0; i < engine->userCount; i++)
+    userFilterAdd(filter,
+                  hashUserName64(userNameText(engine->usersById[i], name)));
+}
+
+/**
+ * @brief Gives a user the next dense id if it does not have one yet.
+ *
+ * @param engine The engine state.
+ * @param user The user's index entry.
+ * @param userHash The user name's 64-bit hash.
+ */
+static void assignUserId(EngineState *engine, UserIndex *user,
+                         unsigned long long userHash) {
+  if (user->id >= 0)
+    return;
+  if (engine->userCount >= engine->userCapacity) {
+    int newCapacity = engine->userCapacity ? engine->userCapacity * 2 : 64;
+    UserIndex **grown = (UserIndex **)reallocateOrExit(
+        engine->usersById, newCapacity * sizeof(UserIndex *));
+    engine->usersById = grown;
+    engine->userCapacity = newCapacity;
+  }
+  user->id = engine->userCount;
+  engine->usersById[engine->userCount++] = user;
+  addKnownUser(engine, userHash);
+}
+
+/**
+ * @brief Updates the secondary indexes after a dose is applied.
+ *
+ * @param engine The engine state.
+ * @param user The user's index entry.
+ * @param lot The applied lot, after its dose counter changed.
+ * @param inoc The new inoculation, already on the global list.
+ * @param today The current day number.
+ * @param userHash The user name's 64-bit hash (see hashUserName64).
+ */
+void engineRecordDose(EngineState *engine, UserIndex *user, VaccineLot *lot,
+                      Inoculation *inoc, int today,
+                      unsigned long long userHash) {
+  VaccineNameIndex *vaccine = lot->nameEntry;
+  journalDose(engine, user, lot, inoc);
+  changeRateDoses(&vaccine->doseRate, today, 1);
+  if (vaccine->dailyColumn < 0)
+    vaccine->dailyColumn = addDailyColumn(&engine->dailyDoses, vaccine->name);
+  countDailyDoses(&engine->dailyDoses, today, vaccine->dailyColumn, 1);
+  emitChange(&engine->changes, CHANGE_DOSE, today, 1, lot, user);
+  journalSketch(engine, &vaccine->recipientSketches);
+  journalSketch(engine, &engine->dailySketches);
+  assignUserId(engine, user, userHash);
+  engine->catalogEpoch++;
+  inoc->sequence = engine->nextSequence++;
+  if (engine->columns.enabled) {
+    appendInoculationRow(&engine->columns, (unsigned int)user->id, lot, inoc);
+    if (engine->branchCount == 0)
+      sealInoculationRows(&engine->columns, engine->usersById);
+  }
+  recordLotCheckpoint(lot, today);
+  recordSeriesDose(user, vaccine, today);
+  bitmapAdd(&vaccine->recipients, (unsigned int)user->id);
+  sketchSeriesAdd(&vaccine->recipientSketches, today, userHash);
+  sketchSeriesAdd(&engine->dailySketches, today, userHash);
+}
+
+/**
+ * @brief Takes a deleted dose off its vaccine's daily rate and per-day
+ * counts.
+ *
+ * @param engine The engine state.
+ * @param vaccine The vaccine of the deleted inoculation.
+ * @param day The day number of the deleted inoculation.
+ */
+void engineRecordDeletion(EngineState *engine, VaccineNameIndex *vaccine,
+                          int day) {
+  changeRateDoses(&vaccine->doseRate, day, -1);
+  countDailyDoses(&engine->dailyDoses, day, vaccine->dailyColumn, -1);
+}
+
+/**
+ * @brief Checks if a user still has a dose of a vaccine.
+ *
+ * @param user The user's index entry.
+ * @param vaccine The vaccine name entry.
+ * @return int 1 if the user has at least one dose, 0 otherwise.
+ */
+static int userHasVaccine(const UserIndex *user,
+                          const VaccineNameIndex *vaccine) {
+  for (int i = 0; i < user->inoculationCount; i++) {
+    if (vaccineHasLot(vaccine, user->inoculations[i]->lot))
+      return 1;
+  }
+  for (int i = 0; i < user->sealedCount; i++) {
+    if (vaccineHasLot(vaccine, user->sealed[i].lot->lot))
+      return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Updates the secondary indexes after a user's doses are deleted.
+ *
+ * @param engine The engine state.
+ * @param user The user's index entry.
+ * @param affected The vaccines of the deleted doses.
+ * @param affectedCount The number of affected vaccines.
+ */
+void engineRefreshUser(EngineState *engine, UserIndex *user,
+                       VaccineNameIndex **affected, int affectedCount) {
+  (void)engine;
+  refreshUserSeries(user);
+  for (int i = 0; i < affectedCount; i++) {
+    if (!userHasVaccine(user, affected[i]))
+      bitmapRemove(&affected[i]->recipients, (unsigned int)user->id);
+  }
+}
+
+/**
+ * @brief Recomputes a user's secondary index entries for one vaccine after
+ * the user's inoculations of it were restored or withdrawn.
+ *
+ * @param engine The engine state.
+ * @param user The user's index entry.
+ * @param vaccine The vaccine name entry.
+ */
+void engineResyncUser(EngineState *engine, UserIndex *user,
+                      VaccineNameIndex *vaccine) {
+  (void)engine;
+  syncUserSeries(user, vaccine);
+  if (userHasVaccine(user, vaccine))
+    bitmapAdd(&vaccine->recipients, (unsigned int)user->id);
+  else
+    bitmapRemove(&vaccine->recipients, (unsigned int)user->id);
+}
+
+/**
+ * @brief Resolves a user name through the recent user cache, then the user
+ * hash table.
+ *
+ * @param engine The engine state.
+ * @param userHashTable The hash table of user indices.
+ * @param userName The user's name.
+ * @param hashSize The size of the hash table.
+ * @param handle The handle to fill in.
+ */
+void engineResolveUser(EngineState *engine, UserIndex **userHashTable,
+                       const char *userName, int hashSize, UserHandle *handle) {
+  handle->hash = hashUserName64(userName);
+  handle->slot = NULL;
+  handle->user = findCachedUser(&engine->userCache, handle->hash, userName);
+  if (handle->user != NULL)
+    return;
+  handle->slot = findUserSlot(userHashTable, userName, handle->hash, hashSize);
+  handle->user = *handle->slot;
+  if (handle->user != NULL)
+    storeCachedUser(&engine->userCache, handle->hash, handle->user);
+}
+
+/**
+ * @brief Gets the user of a handle, inserting it into the user hash table if
+ * it does not exist yet.
+ *
+ * @param engine The engine state.
+ * @param handle The handle, from engineResolveUser with no insertion since.
+ * @param userName The user's name.
+ * @return UserIndex* The user entry.
+ */
+UserIndex *engineInsertUser(EngineState *engine, UserHandle *handle,
+                            const char *userName) {
+  if (handle->user == NULL) {
+    handle->user = insertUserAtSlot(handle->slot, userName);
+    storeCachedUser(&engine->userCache, handle->hash, handle->user);
+  }
+  return handle->user;
+}
+
+/**
+ * @brief Finds a user by name, checking the recent user cache first and
+ * skipping the hash table probe when the user name filter knows the user
+ * does not exist.
+ *
+ * @param engine The engine state.
+ * @param userHashTable The hash table of user indices.
+ * @param userName The user's name.
+ * @param hashSize The size of the hash table.
+ * @return UserIndex* The user's index entry, or NULL if not found.
+ */
+UserIndex *engineFindUser(EngineState *engine, UserIndex **userHashTable,
+                          const char *userName, int hashSize) {
+  unsigned long long hash = hashUserName64(userName);
+  UserIndex *user = findCachedUser(&engine->userCache, hash, userName);
+  if (user != NULL)
+    return user;
+  if (!userFilterMayContain(&engine->userFilter, hash))
+    return NULL;
+  user = *findUserSlot(userHashTable, userName, hash, hashSize);
+  if (user == NULL)
+    engine->userFilter.falsePositives++;
+  else
+    storeCachedUser(&engine->userCache, hash, user);
+  return user;
+}
+
+/**
+ * @brief Frees the memory used by the engine-wide state.
+ *
+ * @param engine The engine state.
+ */
+void freeEngineState(EngineState *engine) {
+  free(engine->usersById);
+  freeSketchSeries(&engine->dailySketches);
+  freeHistory(engine);
+  freeJournal(engine);
+  freeListCache(&engine->listCache);
+  freeUserFilter(&engine->userFilter);
+  freeArena(&engine->scratch);
+  freeReplication(&engine->replication);
+  freeChangeFeed(&engine->changes);
+  freeColumns(&engine->columns);
+  freeJsonWriter(&engine->json);
+  freeDailyDoses(&engine->dailyDoses);
+  initializeEngineState(engine);
+}
@@ -0,0 +1,125 @@
+/**
+ * @file engine.h
+ * @brief Header file for the engine-wide state and its mutation hooks.
+ *
+ * This file contains the declarations of the functions that manage the
+ * EngineState and keep the secondary indexes (dose series, cohort bitmaps,
+ * distinct-count sketches) in step with the inoculations recorded and
+ * deleted by the commands.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "project.h"
+
+// Structure for a user name resolved once per command
+typedef struct {
+  unsigned long long hash; // 64-bit hash of the user name
+  UserIndex *user;         // User entry, or NULL if the user does not exist
+  UserIndex **slot;        // Link to insert a new user at, if probed
+} UserHandle;
+
+/**
+ * @brief Initializes the engine-wide state.
+ *
+ * @param engine The engine state to initialize.
+ */
+void initializeEngineState(EngineState *engine);
+
+/**
+ * @brief Updates the secondary indexes after a dose is applied.
+ *
+ * @param engine The engine state.
+ * @param user The user's index entry.
+ * @param lot The applied lot, after its dose counter changed.
+ * @param inoc The new inoculation, already on the global list.
+ * @param today The current day number.
+ * @param userHash The user name's 64-bit hash (see hashUserName64).
+ */
+void engineRecordDose(EngineState *engine, UserIndex *user, VaccineLot *lot,
+                      Inoculation *inoc, int today,
+                      unsigned long long userHash);
+
+/**
+ * @brief Takes a deleted dose off its vaccine's daily rate and per-day
+ * counts.
+ *
+ * @param engine The engine state.
+ * @param vaccine The vaccine of the deleted inoculation.
+ * @param day The day number of the deleted inoculation.
+ */
+void engineRecordDeletion(EngineState *engine, VaccineNameIndex *vaccine,
+                          int day);
+
+/**
+ * @brief Updates the secondary indexes after a user's doses are deleted.
+ *
+ * @param engine The engine state.
+ * @param user The user's index entry.
+ * @param affected The vaccines of the deleted doses.
+ * @param affectedCount The number of affected vaccines.
+ */
+void engineRefreshUser(EngineState *engine, UserIndex *user,
+                       VaccineNameIndex **affected, int affectedCount);
+
+/**
+ * @brief Recomputes a user's secondary index entries for one vaccine after
+ * the user's inoculations of it were restored or withdrawn.
+ *
+ * @param engine The engine state.
+ * @param user The user's index entry.
+ * @param vaccine The vaccine name entry.
+ */
+void engineResyncUser(EngineState *engine, UserIndex *user,
+                      VaccineNameIndex *vaccine);
+
+/**
+ * @brief Resolves a user name through the recent user cache, then the user
+ * hash table.
+ *
+ * @param engine The engine state.
+ * @param userHashTable The hash table of user indices.
+ * @param userName The user's name.
+ * @param hashSize The size of the hash table.
+ * @param handle The handle to fill in.
+ */
+void engineResolveUser(EngineState *engine, UserIndex **userHashTable,
+                       const char *userName, int hashSize, UserHandle *handle);
+
+/**
+ * @brief Gets the user of a handle, inserting it into the user hash table if
+ * it does not exist yet.
+ *
+ * @param engine The engine state.
+ * @param handle The handle, from engineResolveUser with no insertion since.
+ * @param userName The user's name.
+ * @return UserIndex* The user entry.
+ */
+UserIndex *engineInsertUser(EngineState *engine, UserHandle *handle,
+                            const char *userName);
+
+/**
+ * @brief Finds a user by name, checking the recent user cache first and
+ * skipping the hash table probe when the user name filter knows the user
+ * does not exist.
+ *
+ * @param engine The engine state.
+ * @param userHashTable The hash table of user indices.
+ * @param userName The user's name.
+ * @param hashSize The size of the hash table.
+ * @return UserIndex* The user's index entry, or NULL if not found.
+ */
+UserIndex *engineFindUser(EngineState *engine, UserIndex **userHashTable,
+                          const char *userName, int hashSize);
+
+/**
+ * @brief Frees the memory used by the engine-wide state.
+ *
+ * @param engine The engine state.
+ */
+void freeEngineState(EngineState *engine);
+
+#endif
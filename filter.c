@@ -0,0 +1,113 @@
+/**
+ * @file filter.c
+ * @brief Implementation of the Bloom filter over known user names.
+ *
+ * This file contains the implementation of the user name filter. The bit
+ * positions of a name come from double hashing its 64-bit hash.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "filter.h"
+#include "alloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Initializes an empty filter, allocating its bits on first use.
+ *
+ * @param filter The filter to initialize.
+ */
+void initializeUserFilter(UserFilter *filter) {
+  filter->words = NULL;
+  filter->bitCount = 0;
+  filter->members = 0;
+  filter->lookups = 0;
+  filter->rejected = 0;
+  filter->falsePositives = 0;
+}
+
+/**
+ * @brief Checks if the filter must be sized again before another name is
+ * added.
+ *
+ * @param filter The filter.
+ * @return int 1 if the filter is full, 0 otherwise.
+ */
+int userFilterFull(const UserFilter *filter) {
+  return (filter->members + 1) * FILTER_BITS_PER_USER > filter->bitCount;
+}
+
+/**
+ * @brief Clears the filter and sizes it for a number of names, keeping its
+ * counters.
+ *
+ * @param filter The filter.
+ * @param users The number of names it must hold.
+ */
+void resizeUserFilter(UserFilter *filter, unsigned long users) {
+  unsigned long bits = FILTER_MIN_BITS;
+  while (bits < users * FILTER_BITS_PER_USER)
+    bits *= 2;
+  free(filter->words);
+  filter->words = (unsigned long long *)zeroAllocateOrExit(
+      bits / 64, sizeof(unsigned long long));
+  filter->bitCount = bits;
+  filter->members = 0;
+}
+
+/**
+ * @brief Adds a name to the filter.
+ *
+ * @param filter The filter.
+ * @param hash The name's 64-bit hash (see hashUserName64).
+ */
+void userFilterAdd(UserFilter *filter, unsigned long long hash) {
+  unsigned long mask = filter->bitCount - 1;
+  unsigned long position = (unsigned long)hash;
+  unsigned long step = (unsigned long)(hash >> 32) | 1;
+  for (int i = 0; i < FILTER_HASHES; i++) {
+    unsigned long bit = position & mask;
+    filter->words[bit / 64] |= 1ULL << (bit % 64);
+    position += step;
+  }
+  filter->members++;
+}
+
+/**
+ * @brief Checks if a name may be in the filter, counting the lookup.
+ *
+ * @param filter The filter.
+ * @param hash The name's 64-bit hash (see hashUserName64).
+ * @return int 0 if the name was never added, 1 if it may have been.
+ */
+int userFilterMayContain(UserFilter *filter, unsigned long long hash) {
+  filter->lookups++;
+  if (filter->words == NULL) {
+    filter->rejected++;
+    return 0; // No name was ever added
+  }
+  unsigned long mask = filter->bitCount - 1;
+  unsigned long position = (unsigned long)hash;
+  unsigned long step = (unsigned long)(hash >> 32) | 1;
+  for (int i = 0; i < FILTER_HASHES; i++) {
+    unsigned long bit = position & mask;
+    if (!(filter->words[bit / 64] & (1ULL << (bit % 64)))) {
+      filter->rejected++;
+      return 0;
+    }
+    position += step;
+  }
+  return 1;
+}
+
+/**
+ * @brief Frees the memory used by the filter, leaving it empty.
+ *
+ * @param filter The filter.
+ */
+void freeUserFilter(UserFilter *filter) {
+  free(filter->words);
+  initializeUserFilter(filter);
+}
@@ -0,0 +1,79 @@
+/**
+ * @file filter.h
+ * @brief Header file for the Bloom filter over known user names.
+ *
+ * This file contains the declarations of a Bloom filter that answers "this
+ * user is certainly unknown" without probing the user hash table. Users are
+ * never taken out of the filter; a user removed by undo only adds to its
+ * false positives.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#define FILTER_BITS_PER_USER 10
+#define FILTER_HASHES 5
+#define FILTER_MIN_BITS 1024
+
+// Structure for a Bloom filter of user name hashes
+typedef struct {
+  unsigned long long *words; // Bit array
+  unsigned long bitCount;    // Number of bits (a power of two)
+  unsigned long members;     // Names added since the filter was last sized
+  unsigned long lookups;     // Lookups checked against the filter
+  unsigned long rejected;    // Lookups the filter answered as unknown
+  unsigned long falsePositives; // Unknown names the filter let through
+} UserFilter;
+
+/**
+ * @brief Initializes an empty filter, allocating its bits on first use.
+ *
+ * @param filter The filter to initialize.
+ */
+void initializeUserFilter(UserFilter *filter);
+
+/**
+ * @brief Checks if the filter must be sized again before another name is
+ * added.
+ *
+ * @param filter The filter.
+ * @return int 1 if the filter is full, 0 otherwise.
+ */
+int userFilterFull(const UserFilter *filter);
+
+/**
+ * @brief Clears the filter and sizes it for a number of names, keeping its
+ * counters.
+ *
+ * @param filter The filter.
+ * @param users The number of names it must hold.
+ */
+void resizeUserFilter(UserFilter *filter, unsigned long users);
+
+/**
+ * @brief Adds a name to the filter.
+ *
+ * @param filter The filter.
+ * @param hash The name's 64-bit hash (see hashUserName64).
+ */
+void userFilterAdd(UserFilter *filter, unsigned long long hash);
+
+/**
+ * @brief Checks if a name may be in the filter, counting the lookup.
+ *
+ * @param filter The filter.
+ * @param hash The name's 64-bit hash (see hashUserName64).
+ * @return int 0 if the name was never added, 1 if it may have been.
+ */
+int userFilterMayContain(UserFilter *filter, unsigned long long hash);
+
+/**
+ * @brief Frees the memory used by the filter, leaving it empty.
+ *
+ * @param filter The filter.
+ */
+void freeUserFilter(UserFilter *filter);
+
+#endif
@@ -0,0 +1,201 @@
+/**
+ * @file forecast.c
+ * @brief Implementation of stock depletion forecasting.
+ *
+ * A daily rate keeps the weighted average of the days before the latest day
+ * with doses apart from that day's count, so doses of the current day only
+ * add to the count, and the average of any later day is the count folded in
+ * and decayed once per day passed. Deleting a dose of an earlier day takes
+ * its decayed weight off the average. The expiry calendar is a sorted array
+ * adjusted by every change in a lot's remaining doses; a forecast walks its
+ * days from today, letting the rate use the doses that expire first first.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "forecast.h"
+#include "alloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Initializes a daily rate with no doses.
+ *
+ * @param rate The daily rate.
+ */
+void initializeDoseRate(DoseRate *rate) {
+  rate->average = 0;
+  rate->day = -1;
+  rate->doses = 0;
+}
+
+/**
+ * @brief Computes the weight a day keeps after some days have passed.
+ *
+ * @param days The number of days passed.
+ * @return double (1 - RATE_WEIGHT) to the power of days.
+ */
+static double decayFactor(int days) {
+  double factor = 1, base = 1 - RATE_WEIGHT;
+  for (; days > 0 && factor > 0; days >>= 1) {
+    if (days & 1)
+      factor *= base;
+    base *= base;
+  }
+  return factor;
+}
+
+/**
+ * @brief Computes a daily rate over the days before a day.
+ *
+ * @param rate The daily rate.
+ * @param today The current day number.
+ * @return double The weighted doses per day up to the day before today.
+ */
+double dailyRate(const DoseRate *rate, int today) {
+  double average = rate->average;
+  if (today > rate->day)
+    average = ((1 - RATE_WEIGHT) * average + RATE_WEIGHT * rate->doses) *
+              decayFactor(today - 1 - rate->day);
+  return average > 0 ? average : 0;
+}
+
+/**
+ * @brief Adds doses given on a day to a daily rate, or removes them with a
+ * negative change.
+ *
+ * @param rate The daily rate.
+ * @param day The day number of the doses.
+ * @param change The number of doses added.
+ */
+void changeRateDoses(DoseRate *rate, int day, int change) {
+  if (day > rate->day) {
+    rate->average = dailyRate(rate, day);
+    rate->day = day;
+    rate->doses = 0;
+  }
+  if (day == rate->day)
+    rate->doses += change;
+  else
+    rate->average +=
+        change * RATE_WEIGHT * decayFactor(rate->day - 1 - day);
+}
+
+/**
+ * @brief Initializes an empty expiry calendar.
+ *
+ * @param calendar The expiry calendar.
+ */
+void initializeExpiryCalendar(ExpiryCalendar *calendar) {
+  calendar->days = NULL;
+  calendar->doses = NULL;
+  calendar->count = 0;
+  calendar->capacity = 0;
+}
+
+/**
+ * @brief Finds the first expiry day of a calendar not before a day.
+ *
+ * @param calendar The expiry calendar.
+ * @param day The day number.
+ * @return int The position of the expiry day, or the count if there is none.
+ */
+static int findExpiryDay(const ExpiryCalendar *calendar, int day) {
+  int low = 0, high = calendar->count;
+  while (low < high) {
+    int middle = (low + high) / 2;
+    if (calendar->days[middle] < day)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return low;
+}
+
+/**
+ * @brief Inserts an expiry day with no doses into a calendar.
+ *
+ * @param calendar The expiry calendar.
+ * @param position The position of the day.
+ * @param day The expiry day number.
+ */
+static void insertExpiryDay(ExpiryCalendar *calendar, int position, int day) {
+  if (calendar->count == calendar->capacity) {
+    int capacity = calendar->capacity ? 2 * calendar->capacity : 4;
+    calendar->days = (int *)reallocateOrExit(
+        calendar->days, (size_t)capacity * sizeof(int));
+    calendar->doses = (long *)reallocateOrExit(
+        calendar->doses, (size_t)capacity * sizeof(long));
+    calendar->capacity = capacity;
+  }
+  int after = calendar->count - position;
+  memmove(&calendar->days[position + 1], &calendar->days[position],
+          (size_t)after * sizeof(int));
+  memmove(&calendar->doses[position + 1], &calendar->doses[position],
+          (size_t)after * sizeof(long));
+  calendar->days[position] = day;
+  calendar->doses[position] = 0;
+  calendar->count++;
+}
+
+/**
+ * @brief Changes the doses available that expire on a day.
+ *
+ * @param calendar The expiry calendar.
+ * @param day The expiry day number.
+ * @param change The change in doses.
+ */
+void changeExpiringDoses(ExpiryCalendar *calendar, int day, long change) {
+  if (change == 0)
+    return;
+  int position = findExpiryDay(calendar, day);
+  if (position == calendar->count || calendar->days[position] != day)
+    insertExpiryDay(calendar, position, day);
+  calendar->doses[position] += change;
+  if (calendar->doses[position] != 0)
+    return;
+  // Days without doses are dropped, so forecasts only walk days with doses
+  int after = --calendar->count - position;
+  memmove(&calendar->days[position], &calendar->days[position + 1],
+          (size_t)after * sizeof(int));
+  memmove(&calendar->doses[position], &calendar->doses[position + 1],
+          (size_t)after * sizeof(long));
+}
+
+/**
+ * @brief Forecasts how long the doses of an expiry calendar last at a daily
+ * rate, using the doses that expire first first.
+ *
+ * @param calendar The expiry calendar.
+ * @param rate The doses given per day.
+ * @param today The current day number.
+ * @param forecast Pointer to store the forecast.
+ */
+void forecastStock(const ExpiryCalendar *calendar, double rate, int today,
+                   StockForecast *forecast) {
+  long usable = 0;
+  double used = 0;
+  for (int i = findExpiryDay(calendar, today); i < calendar->count; i++) {
+    usable += calendar->doses[i];
+    // Doses the rate uses by the end of the day, less those expiring earlier
+    double room = rate * (calendar->days[i] - today + 1) - used;
+    if (room > 0)
+      used += room < calendar->doses[i] ? room : calendar->doses[i];
+  }
+  forecast->rate = rate;
+  forecast->usable = usable;
+  forecast->days = rate > 0 ? used / rate : -1;
+  forecast->expiring = (long)(usable - used + 0.5);
+}
+
+/**
+ * @brief Frees the memory used by an expiry calendar.
+ *
+ * @param calendar The expiry calendar.
+ */
+void freeExpiryCalendar(ExpiryCalendar *calendar) {
+  free(calendar->days);
+  free(calendar->doses);
+  initializeExpiryCalendar(calendar);
+}
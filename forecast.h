@@ -0,0 +1,104 @@
+/**
+ * @file forecast.h
+ * @brief Header file for stock depletion forecasting.
+ *
+ * This file contains the declarations of the exponentially weighted daily
+ * rate at which a vaccine is administered, kept up to date as doses are
+ * applied and deleted, and of the calendar of the doses still available per
+ * expiry day. Together with the doses available they forecast how many days
+ * a vaccine's stock lasts and how many of its doses will expire unused,
+ * without looking at lots or inoculations.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef FORECAST_H
+#define FORECAST_H
+
+#define RATE_WEIGHT 0.25 // Weight of the latest day in a daily rate
+
+// Structure for the exponentially weighted doses per day of a vaccine
+typedef struct {
+  double average; // Weighted doses per day up to the day before day
+  int day;        // Day number of the latest day with doses (-1 if none)
+  int doses;      // Doses given on that day
+} DoseRate;
+
+// Structure for the doses still available per expiry day
+typedef struct {
+  int *days;    // Expiry day numbers with doses, ascending
+  long *doses;  // Doses available that expire on each day
+  int count;    // Number of expiry days
+  int capacity; // Current capacity of the arrays
+} ExpiryCalendar;
+
+// Structure for the forecast of a vaccine's stock
+typedef struct {
+  double rate;   // Doses given per day
+  long usable;   // Doses available that have not expired
+  double days;   // Days the usable doses last, or -1 if they are not used
+  long expiring; // Usable doses that will expire before they are used
+} StockForecast;
+
+/**
+ * @brief Initializes a daily rate with no doses.
+ *
+ * @param rate The daily rate.
+ */
+void initializeDoseRate(DoseRate *rate);
+
+/**
+ * @brief Adds doses given on a day to a daily rate, or removes them with a
+ * negative change.
+ *
+ * @param rate The daily rate.
+ * @param day The day number of the doses.
+ * @param change The number of doses added.
+ */
+void changeRateDoses(DoseRate *rate, int day, int change);
+
+/**
+ * @brief Computes a daily rate over the days before a day.
+ *
+ * @param rate The daily rate.
+ * @param today The current day number.
+ * @return double The weighted doses per day up to the day before today.
+ */
+double dailyRate(const DoseRate *rate, int today);
+
+/**
+ * @brief Initializes an empty expiry calendar.
+ *
+ * @param calendar The expiry calendar.
+ */
+void initializeExpiryCalendar(ExpiryCalendar *calendar);
+
+/**
+ * @brief Changes the doses available that expire on a day.
+ *
+ * @param calendar The expiry calendar.
+ * @param day The expiry day number.
+ * @param change The change in doses.
+ */
+void changeExpiringDoses(ExpiryCalendar *calendar, int day, long change);
+
+/**
+ * @brief Forecasts how long the doses of an expiry calendar last at a daily
+ * rate, using the doses that expire first first.
+ *
+ * @param calendar The expiry calendar.
+ * @param rate The doses given per day.
+ * @param today The current day number.
+ * @param forecast Pointer to store the forecast.
+ */
+void forecastStock(const ExpiryCalendar *calendar, double rate, int today,
+                   StockForecast *forecast);
+
+/**
+ * @brief Frees the memory used by an expiry calendar.
+ *
+ * @param calendar The expiry calendar.
+ */
+void freeExpiryCalendar(ExpiryCalendar *calendar);
+
+#endif
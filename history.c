@@ -0,0 +1,189 @@
+/**
+ * @file history.c
+ * @brief Implementation of the stamped history used by as-of queries.
+ *
+ * Every mutation happens on the current date and the date never moves back,
+ * so the state at the end of a past day follows from the stamps alone:
+ * lots carry their creation and removal days and one dose checkpoint per day
+ * with doses applied, and inoculations carry their date and deletion day.
+ * Lots removed without doses and deleted inoculations are kept aside instead
+ * of being freed, so nothing has to be replayed to answer a query.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "history.h"
+#include "alloc.h"
+#include "constants.h"
+#include "project.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Records the doses used by a lot at the end of a day.
+ *
+ * @param lot The vaccine lot, after its dose counter changed.
+ * @param today The current day number.
+ */
+void recordLotCheckpoint(VaccineLot *lot, int today) {
+  int last = lot->checkpointCount - 1;
+  if (last >= 0 && lot->checkpoints[last].day == today) {
+    lot->checkpoints[last].dosesUsed = lot->dosesUsed;
+    return;
+  }
+  if (lot->checkpointCount >= lot->checkpointCapacity) {
+    int newCapacity = lot->checkpointCapacity ? lot->checkpointCapacity * 2 : 4;
+    DoseCheckpoint *grown = (DoseCheckpoint *)reallocateOrExit(
+        lot->checkpoints, newCapacity * sizeof(DoseCheckpoint));
+    lot->checkpoints = grown;
+    lot->checkpointCapacity = newCapacity;
+  }
+  lot->checkpoints[lot->checkpointCount].day = today;
+  lot->checkpoints[lot->checkpointCount].dosesUsed = lot->dosesUsed;
+  lot->checkpointCount++;
+}
+
+/**
+ * @brief Moves a lot removed without doses used to the retired lots.
+ *
+ * @param engine The engine-wide state.
+ * @param lot The lot, already unlinked from every index.
+ * @param today The current day number.
+ */
+void retireLot(EngineState *engine, VaccineLot *lot, int today) {
+  lot->removedDay = today;
+  lot->next_vaccine = engine->retiredLots;
+  engine->retiredLots = lot;
+}
+
+/**
+ * @brief Moves a deleted inoculation to the user's deleted inoculations.
+ *
+ * @param engine The engine-wide state.
+ * @param user The user's index entry.
+ * @param inoc The inoculation, already unlinked from the live indexes.
+ * @param today The current day number.
+ */
+void retireInoculation(EngineState *engine, UserIndex *user, Inoculation *inoc,
+                       int today) {
+  if (user->deletedCount >= user->deletedCapacity) {
+    int newCapacity = user->deletedCapacity ? user->deletedCapacity * 2 : 4;
+    Inoculation **grown = (Inoculation **)reallocateOrExit(
+        user->deleted, newCapacity * sizeof(Inoculation *));
+    user->deleted = grown;
+    user->deletedCapacity = newCapacity;
+  }
+  user->deleted[user->deletedCount++] = inoc;
+  inoc->deletedDay = today;
+  if (engine->columns.enabled)
+    setInoculationRowDeleted(&engine->columns, inoc->sequence, 1);
+  inoc->next_global = engine->deletedInoculations;
+  engine->deletedInoculations = inoc;
+}
+
+/**
+ * @brief Checks if a lot existed at the end of a day.
+ *
+ * Lots removed after doses were used stay listed, so only retired lots
+ * stop existing on their removal day.
+ *
+ * @param lot The vaccine lot.
+ * @param day The day number.
+ * @return int 1 if the lot existed, 0 otherwise.
+ */
+int lotExistsAsOf(const VaccineLot *lot, int day) {
+  if (lot->createdDay > day)
+    return 0;
+  return lot->isRemoved || lot->removedDay < 0 || lot->removedDay > day;
+}
+
+/**
+ * @brief Gets the doses a lot had used by the end of a day.
+ *
+ * @param lot The vaccine lot.
+ * @param day The day number.
+ * @return int The doses used.
+ */
+int lotDosesUsedAsOf(const VaccineLot *lot, int day) {
+  int low = 0, high = lot->checkpointCount - 1, used = 0;
+  while (low <= high) {
+    int mid = low + (high - low) / 2;
+    if (lot->checkpoints[mid].day <= day) {
+      used = lot->checkpoints[mid].dosesUsed;
+      low = mid + 1;
+    } else {
+      high = mid - 1;
+    }
+  }
+  return used;
+}
+
+/**
+ * @brief Gets the doses a lot had available at the end of a day.
+ *
+ * @param lot The vaccine lot.
+ * @param day The day number.
+ * @return int The doses available.
+ */
+int lotDosesAvailableAsOf(const VaccineLot *lot, int day) {
+  if (lot->removedDay >= 0 && lot->removedDay <= day)
+    return 0;
+  return lot->initialDoses - lotDosesUsedAsOf(lot, day);
+}
+
+/**
+ * @brief Checks if an inoculation existed at the end of a day.
+ *
+ * @param inoc The inoculation.
+ * @param day The day number.
+ * @return int 1 if the inoculation existed, 0 otherwise.
+ */
+int inoculationExistsAsOf(const Inoculation *inoc, int day) {
+  return dateToDayNumber(inoc->date) <= day &&
+         (inoc->deletedDay < 0 || inoc->deletedDay > day);
+}
+
+/**
+ * @brief Parses the date of an as-of query, which cannot be in the future.
+ *
+ * @param token The date token (may be NULL).
+ * @param currentDate The current date.
+ * @param day Pointer to store the day number of the date.
+ * @return int 1 if the date is valid, 0 otherwise.
+ */
+int parseAsOfDay(const char *token, Date currentDate, int *day) {
+  Date date;
+  if (token == NULL || !parseCalendarDate(token, &date))
+    return 0;
+  *day = dateToDayNumber(date);
+  return *day <= dateToDayNumber(currentDate);
+}
+
+/**
+ * @brief Compares two inoculations by the order in which they were made.
+ *
+ * @param a The first inoculation.
+ * @param b The second inoculation.
+ * @return int Negative if a was made first, positive otherwise.
+ */
+int compareInoculationSequence(const void *a, const void *b) {
+  unsigned long left = ((const Inoculation *)a)->sequence;
+  unsigned long right = ((const Inoculation *)b)->sequence;
+  return (left > right) - (left < right);
+}
+
+/**
+ * @brief Frees the retired lots and deleted inoculations.
+ *
+ * @param engine The engine-wide state.
+ */
+void freeHistory(EngineState *engine) {
+  while (engine->retiredLots != NULL) {
+    VaccineLot *next = engine->retiredLots->next_vaccine;
+    freeVaccineLot(engine->retiredLots);
+    engine->retiredLots = next;
+  }
+  freeInoculationList(engine->deletedInoculations);
+  engine->deletedInoculations = NULL;
+}
@@ -0,0 +1,107 @@
+/**
+ * @file history.h
+ * @brief Header file for the stamped history used by as-of queries.
+ *
+ * This file contains the declarations of the functions that stamp lots and
+ * inoculations with the day number of their mutations, keep the per-lot dose
+ * checkpoints, and answer what existed at the end of a past day.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "project.h"
+
+/**
+ * @brief Records the doses used by a lot at the end of a day.
+ *
+ * @param lot The vaccine lot, after its dose counter changed.
+ * @param today The current day number.
+ */
+void recordLotCheckpoint(VaccineLot *lot, int today);
+
+/**
+ * @brief Moves a lot removed without doses used to the retired lots.
+ *
+ * @param engine The engine-wide state.
+ * @param lot The lot, already unlinked from every index.
+ * @param today The current day number.
+ */
+void retireLot(EngineState *engine, VaccineLot *lot, int today);
+
+/**
+ * @brief Moves a deleted inoculation to the user's deleted inoculations.
+ *
+ * @param engine The engine-wide state.
+ * @param user The user's index entry.
+ * @param inoc The inoculation, already unlinked from the live indexes.
+ * @param today The current day number.
+ */
+void retireInoculation(EngineState *engine, UserIndex *user, Inoculation *inoc,
+                       int today);
+
+/**
+ * @brief Checks if a lot existed at the end of a day.
+ *
+ * @param lot The vaccine lot.
+ * @param day The day number.
+ * @return int 1 if the lot existed, 0 otherwise.
+ */
+int lotExistsAsOf(const VaccineLot *lot, int day);
+
+/**
+ * @brief Gets the doses a lot had used by the end of a day.
+ *
+ * @param lot The vaccine lot.
+ * @param day The day number.
+ * @return int The doses used.
+ */
+int lotDosesUsedAsOf(const VaccineLot *lot, int day);
+
+/**
+ * @brief Gets the doses a lot had available at the end of a day.
+ *
+ * @param lot The vaccine lot.
+ * @param day The day number.
+ * @return int The doses available.
+ */
+int lotDosesAvailableAsOf(const VaccineLot *lot, int day);
+
+/**
+ * @brief Checks if an inoculation existed at the end of a day.
+ *
+ * @param inoc The inoculation.
+ * @param day The day number.
+ * @return int 1 if the inoculation existed, 0 otherwise.
+ */
+int inoculationExistsAsOf(const Inoculation *inoc, int day);
+
+/**
+ * @brief Parses the date of an as-of query, which cannot be in the future.
+ *
+ * @param token The date token (may be NULL).
+ * @param currentDate The current date.
+ * @param day Pointer to store the day number of the date.
+ * @return int 1 if the date is valid, 0 otherwise.
+ */
+int parseAsOfDay(const char *token, Date currentDate, int *day);
+
+/**
+ * @brief Compares two inoculations by the order in which they were made.
+ *
+ * @param a The first inoculation.
+ * @param b The second inoculation.
+ * @return int Negative if a was made first, positive otherwise.
+ */
+int compareInoculationSequence(const void *a, const void *b);
+
+/**
+ * @brief Frees the retired lots and deleted inoculations.
+ *
+ * @param engine The engine-wide state.
+ */
+void freeHistory(EngineState *engine);
+
+#endif
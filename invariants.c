@@ -0,0 +1,384 @@
+/**
+ * @file invariants.c
+ * @brief Implementation of the index consistency checker.
+ *
+ * This file contains the implementation of the checks run after each command
+ * in a CHECK_INVARIANTS build. Each index is compared with the list it
+ * mirrors: the lot hash and the name index with the lot list, the user index
+ * with the global inoculation list, and the dense user ids and the user
+ * cache with the user index. Counts, membership and order are all checked,
+ * and the first disagreement is printed before the program exits, so a
+ * differential run shows it in its output.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "invariants.h"
+#include "alloc.h"
+#include "constants.h"
+#include "project.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef CHECK_INVARIANTS
+
+/**
+ * @brief Stops the program if a check failed.
+ *
+ * @param holds 1 if the check passed.
+ * @param what The name of the check.
+ * @param subject The batch, vaccine or user the check was about.
+ */
+static void require(int holds, const char *what, const char *subject) {
+  if (holds)
+    return;
+  printf("invariant violated: %s (%s)\n", what, subject);
+  exit(1);
+}
+
+/**
+ * @brief Checks the lot list against the lot hash and the name index.
+ *
+ * @param hashTable The hash table of vaccine lots.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param vaccineList The list of vaccine lots.
+ * @param hashSize The size of the hash tables.
+ * @param vaccineCount The current count of vaccine lots.
+ */
+static void checkLots(VaccineLot **hashTable, VaccineNameIndex **nameHashTable,
+                      VaccineLot *vaccineList, int hashSize,
+                      int vaccineCount) {
+  int listed = 0, hashed = 0;
+  for (VaccineLot *lot = vaccineList; lot != NULL; lot = lot->next_vaccine) {
+    listed++;
+    require(findVaccineByBatch(hashTable, lot->lot, hashSize) == lot,
+            "listed lot is in the lot hash", lot->lot);
+    require(findVaccineByName(nameHashTable, lot->name, hashSize) ==
+                lot->nameEntry,
+            "listed lot's name entry is in the name hash", lot->lot);
+    require(lot->dosesUsed <= lot->doses, "doses used within the lot",
+            lot->lot);
+    require(lot->isRemoved == (lot->removedDay >= 0),
+            "removed lots have a removal day", lot->lot);
+  }
+  for (int i = 0; i < hashSize; i++)
+    for (VaccineLot *lot = hashTable[i]; lot != NULL; lot = lot->next_hash)
+      hashed++;
+  require(listed == vaccineCount, "lot list length is the lot count", "-");
+  require(hashed == vaccineCount, "lot hash size is the lot count", "-");
+}
+
+/**
+ * @brief Checks the shelves of a vaccine's sites against its name entry.
+ *
+ * @param entry The vaccine name entry.
+ */
+static void checkSiteStock(const VaccineNameIndex *entry) {
+  long available = 0;
+  int shelved = 0;
+  for (int i = 0; i < entry->lotCount; i++) {
+    const VaccineLot *lot = entry->lots[i];
+    const SiteShelf *shelf = findSiteShelf(&entry->stock, lot->site);
+    require(shelf != NULL && lot->siteSlot >= 0 &&
+                lot->siteSlot < shelf->lotCount &&
+                shelf->lots[lot->siteSlot] == lot,
+            "lot is on its site's shelf", lot->lot);
+    require(shelf->lotExpiry[lot->siteSlot] == entry->lotExpiry[i] &&
+                shelf->lotRemaining[lot->siteSlot] == entry->lotRemaining[i],
+            "shelf mirrors match the name entry", lot->lot);
+    available += entry->lotRemaining[i];
+  }
+  for (int site = 0; site < entry->stock.siteCount; site++) {
+    const SiteShelf *shelf = entry->stock.shelves[site];
+    long onShelf = 0;
+    for (int i = 0; shelf != NULL && i < shelf->lotCount; i++)
+      onShelf += shelf->lotRemaining[i];
+    require(shelf == NULL || shelf->available == onShelf,
+            "site available doses match its shelf", entry->name);
+    shelved += shelf == NULL ? 0 : shelf->lotCount;
+  }
+  require(shelved == entry->lotCount, "every shelved lot is indexed",
+          entry->name);
+  require(entry->stock.available == available,
+          "available doses match the name entry", entry->name);
+}
+
+/**
+ * @brief Checks a vaccine's expiry calendar against its available doses.
+ *
+ * @param entry The vaccine name entry.
+ */
+static void checkExpiryCalendar(const VaccineNameIndex *entry) {
+  const ExpiryCalendar *calendar = &entry->stock.expiries;
+  long total = 0;
+  for (int i = 0; i < calendar->count; i++) {
+    require(calendar->doses[i] > 0, "expiry days have doses", entry->name);
+    require(i == 0 || calendar->days[i - 1] < calendar->days[i],
+            "expiry days are ascending", entry->name);
+    total += calendar->doses[i];
+  }
+  require(total == entry->stock.available,
+          "expiry calendar holds the available doses", entry->name);
+}
+
+/**
+ * @brief Checks a name entry's lots and their mirrored fields.
+ *
+ * @param entry The vaccine name entry.
+ */
+static void checkNameEntry(const VaccineNameIndex *entry) {
+  for (int i = 0; i < entry->lotCount; i++) {
+    const VaccineLot *lot = entry->lots[i];
+    require(lot->nameEntry == entry && lot->nameSlot == i,
+            "name entry lot points back to its slot", lot->lot);
+    require(strcmp(lot->name, entry->name) == 0,
+            "name entry lot has the entry's name", lot->lot);
+    require(entry->lotExpiry[i] == dateToDayNumber(lot->validation),
+            "mirrored expiry matches the lot", lot->lot);
+    require(entry->lotRemaining[i] ==
+                (lot->isRemoved ? 0 : lot->doses - lot->dosesUsed),
+            "mirrored remaining doses match the lot", lot->lot);
+  }
+  checkSiteStock(entry);
+  checkExpiryCalendar(entry);
+}
+
+/**
+ * @brief Checks the name index against the lot count.
+ *
+ * @param nameHashTable The hash table of vaccine names.
+ * @param hashSize The size of the hash table.
+ * @param vaccineCount The current count of vaccine lots.
+ */
+static void checkNames(VaccineNameIndex **nameHashTable, int hashSize,
+                       int vaccineCount) {
+  int indexed = 0;
+  for (int i = 0; i < hashSize; i++) {
+    for (VaccineNameIndex *entry = nameHashTable[i]; entry != NULL;
+         entry = entry->next_hash) {
+      checkNameEntry(entry);
+      indexed += entry->lotCount;
+    }
+  }
+  require(indexed == vaccineCount, "name index size is the lot count", "-");
+}
+
+/**
+ * @brief Checks if a user's inoculations include one.
+ *
+ * @param user The user's index entry.
+ * @param inoc The inoculation.
+ * @return int 1 if the inoculation is in the user's array, 0 otherwise.
+ */
+static int userHolds(const UserIndex *user, const Inoculation *inoc) {
+  for (int i = 0; i < user->inoculationCount; i++)
+    if (user->inoculations[i] == inoc)
+      return 1;
+  return 0;
+}
+
+/**
+ * @brief Checks the global inoculation list against the user index.
+ *
+ * @param userHashTable The hash table of user indices.
+ * @param inoculationList The list of inoculations.
+ * @param hashSize The size of the hash table.
+ */
+static void checkInoculations(UserIndex **userHashTable,
+                              Inoculation *inoculationList, int hashSize) {
+  int listed = 0, held = 0;
+  for (Inoculation *inoc = inoculationList; inoc != NULL;
+       inoc = inoc->next_global) {
+    listed++;
+    UserIndex *user = findUserByName(userHashTable, inoc->user, hashSize);
+    require(user != NULL && userHolds(user, inoc),
+            "listed inoculation is in its user's index", inoc->user);
+    require(inoc->deletedDay < 0, "listed inoculation is not deleted",
+            inoc->user);
+    require(inoc->next_global == NULL ||
+                inoc->next_global->sequence < inoc->sequence,
+            "inoculation list is newest first", inoc->user);
+  }
+  for (int i = 0; i < USER_TABLE_BUCKETS(hashSize); i++) {
+    for (UserIndex *user = userHashTable[i]; user != NULL;
+         user = user->next_hash) {
+      char name[NUMERIC_NAME_SIZE];
+      held += user->inoculationCount;
+      for (int j = 1; j < user->inoculationCount; j++)
+        require(user->inoculations[j - 1]->sequence <
+                    user->inoculations[j]->sequence,
+                "user's inoculations are oldest first",
+                userNameText(user, name));
+    }
+  }
+  require(held == listed, "user index holds every listed inoculation", "-");
+}
+
+/**
+ * @brief Checks the live sealed rows against the users' sealed doses.
+ *
+ * @param engine The engine-wide state.
+ */
+static void checkSealedDoses(EngineState *engine) {
+  const InoculationColumns *columns = &engine->columns;
+  int *seen = allocateOrExit((engine->userCount + 1) * sizeof(int));
+  memset(seen, 0, (engine->userCount + 1) * sizeof(int));
+  ColumnCursor cursor;
+  ColumnRow row;
+  openColumnCursor(&cursor, columns);
+  while (nextColumnRow(&cursor, &row) && row.row < columns->sealedRows) {
+    UserIndex *user = engine->usersById[row.userId];
+    int index = seen[row.userId]++;
+    require(index < user->sealedCount && user->sealed[index].row == row.row &&
+                user->sealed[index].lot->id == (int)row.lotId &&
+                user->sealed[index].date == row.date,
+            "sealed row matches its user's sealed dose", "-");
+  }
+  for (int id = 0; id < engine->userCount; id++)
+    require(seen[id] == engine->usersById[id]->sealedCount,
+            "every sealed dose has a live sealed row", "-");
+  free(seen);
+}
+
+/**
+ * @brief Copies the global inoculation list into an array, oldest first.
+ *
+ * @param inoculationList The list of inoculations.
+ * @return Inoculation** The array, ended by NULL, to be freed by the caller.
+ */
+static Inoculation **listOldestFirst(Inoculation *inoculationList) {
+  int count = 0;
+  for (Inoculation *inoc = inoculationList; inoc != NULL;
+       inoc = inoc->next_global)
+    count++;
+  Inoculation **oldestFirst =
+      allocateOrExit((count + 1) * sizeof(Inoculation *));
+  oldestFirst[count] = NULL;
+  for (Inoculation *inoc = inoculationList; inoc != NULL;
+       inoc = inoc->next_global)
+    oldestFirst[--count] = inoc;
+  return oldestFirst;
+}
+
+/**
+ * @brief Checks the columnar store against the global inoculation list.
+ *
+ * @param inoculationList The list of inoculations.
+ * @param engine The engine-wide state.
+ */
+static void checkColumns(Inoculation *inoculationList, EngineState *engine) {
+  const InoculationColumns *columns = &engine->columns;
+  require(columns->rowCount == engine->nextSequence,
+          "columns hold a row per sequence", "-");
+  Inoculation **oldestFirst = listOldestFirst(inoculationList);
+  ColumnCursor cursor;
+  ColumnRow row;
+  Inoculation **next = oldestFirst;
+  openColumnCursor(&cursor, columns);
+  while (nextColumnRow(&cursor, &row)) {
+    if (row.row < columns->sealedRows)
+      continue; // Checked against the sealed doses
+    Inoculation *inoc = *next++;
+    require(inoc != NULL && row.row == inoc->sequence,
+            "live rows match the listed inoculations", "-");
+    require(userHasName(engine->usersById[row.userId], inoc->user) &&
+                strcmp(columns->lotsById[row.lotId]->lot, inoc->lot) == 0 &&
+                row.date == packDate(inoc->date.day, inoc->date.month,
+                                     inoc->date.year),
+            "inoculation row matches its record", inoc->user);
+  }
+  require(*next == NULL, "every listed inoculation has a live row", "-");
+  free(oldestFirst);
+  checkSealedDoses(engine);
+}
+
+/**
+ * @brief Checks the per-day dose table against the vaccines, the global
+ * inoculation list and the sealed doses.
+ *
+ * @param nameHashTable The hash table of vaccine names.
+ * @param hashSize The size of the hash table.
+ * @param inoculationList The list of inoculations.
+ * @param engine The engine-wide state.
+ */
+static void checkDailyDoses(VaccineNameIndex **nameHashTable, int hashSize,
+                            Inoculation *inoculationList,
+                            EngineState *engine) {
+  const DailyDoses *table = &engine->dailyDoses;
+  for (int i = 0; i < hashSize; i++)
+    for (VaccineNameIndex *entry = nameHashTable[i]; entry != NULL;
+         entry = entry->next_hash)
+      require(entry->dailyColumn < table->columnCount &&
+                  (entry->dailyColumn < 0 ||
+                   strcmp(table->columns[entry->dailyColumn], entry->name) ==
+                       0),
+              "vaccine's daily column has its name", entry->name);
+  long listed = 0, counted = 0;
+  for (Inoculation *inoc = inoculationList; inoc != NULL;
+       inoc = inoc->next_global)
+    listed++;
+  for (int id = 0; id < engine->userCount; id++)
+    listed += engine->usersById[id]->sealedCount;
+  int used = table->dayCount > 0 ? table->rowStart[table->dayCount] : 0;
+  for (int i = 0; i < used; i++) {
+    require(table->counts[i] >= 0, "daily doses are not negative", "-");
+    counted += table->counts[i];
+  }
+  require(counted == listed, "daily doses count every inoculation", "-");
+}
+
+/**
+ * @brief Checks the dense user ids and the user cache against the user
+ * index.
+ *
+ * @param userHashTable The hash table of user indices.
+ * @param hashSize The size of the hash table.
+ * @param engine The engine-wide state.
+ */
+static void checkUsers(UserIndex **userHashTable, int hashSize,
+                       EngineState *engine) {
+  char buffer[NUMERIC_NAME_SIZE];
+  for (int id = 0; id < engine->userCount; id++) {
+    UserIndex *user = engine->usersById[id];
+    const char *name = userNameText(user, buffer);
+    require(user->id == id, "user id matches its slot", name);
+    require(findUserByName(userHashTable, name, hashSize) == user,
+            "user with an id is in the user index", name);
+  }
+  for (int i = 0; i < USER_CACHE_SIZE; i++) {
+    UserIndex *user = engine->userCache.entries[i].user;
+    if (user == NULL)
+      continue;
+    const char *name = userNameText(user, buffer);
+    require(findUserByName(userHashTable, name, hashSize) == user,
+            "cached user is in the user index", name);
+  }
+}
+
+/**
+ * @brief Checks that the indexes agree, exiting with a message if not.
+ *
+ * @param hashTable The hash table of vaccine lots.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param userHashTable The hash table of user indices.
+ * @param vaccineList The list of vaccine lots.
+ * @param inoculationList The list of inoculations.
+ * @param hashSize The size of the hash tables.
+ * @param vaccineCount The current count of vaccine lots.
+ * @param engine The engine-wide state.
+ */
+void checkInvariants(VaccineLot **hashTable, VaccineNameIndex **nameHashTable,
+                     UserIndex **userHashTable, VaccineLot *vaccineList,
+                     Inoculation *inoculationList, int hashSize,
+                     int vaccineCount, EngineState *engine) {
+  checkLots(hashTable, nameHashTable, vaccineList, hashSize, vaccineCount);
+  checkNames(nameHashTable, hashSize, vaccineCount);
+  checkInoculations(userHashTable, inoculationList, hashSize);
+  checkUsers(userHashTable, hashSize, engine);
+  if (engine->columns.enabled)
+    checkColumns(inoculationList, engine);
+  checkDailyDoses(nameHashTable, hashSize, inoculationList, engine);
+}
+
+#endif
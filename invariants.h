@@ -0,0 +1,39 @@
+/**
+ * @file invariants.h
+ * @brief Header file for the index consistency checker.
+ *
+ * This file contains the declaration of the function that checks, after each
+ * command, that every index agrees with the lists it mirrors. It is only
+ * compiled when CHECK_INVARIANTS is defined, as a debug build option:
+ * `make -f Makefileproject CFLAGS="-g -DCHECK_INVARIANTS"`.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef INVARIANTS_H
+#define INVARIANTS_H
+
+#include "project.h"
+
+#ifdef CHECK_INVARIANTS
+
+/**
+ * @brief Checks that the indexes agree, exiting with a message if not.
+ *
+ * @param hashTable The hash table of vaccine lots.
+ * @param nameHashTable The hash table of vaccine names.
+ * @param userHashTable The hash table of user indices.
+ * @param vaccineList The list of vaccine lots.
+ * @param inoculationList The list of inoculations.
+ * @param hashSize The size of the hash tables.
+ * @param vaccineCount The current count of vaccine lots.
+ * @param engine The engine-wide state.
+ */
+void checkInvariants(VaccineLot **hashTable, VaccineNameIndex **nameHashTable,
+                     UserIndex **userHashTable, VaccineLot *vaccineList,
+                     Inoculation *inoculationList, int hashSize,
+                     int vaccineCount, EngineState *engine);
+
+#endif
+
+#endif
@@ -0,0 +1,508 @@
+/**
+ * @file journal.c
+ * @brief Implementation of the undo journal behind what-if branches.
+ *
+ * A branch costs nothing to open: it only remembers the journal length.
+ * While any branch is open, each command records just enough to reverse
+ * its own change, so memory grows with what the branch changes and not
+ * with the size of the system. Dropping a branch undoes its entries newest
+ * first, which leaves every structure exactly as it was when the branch was
+ * opened. Sketches cannot forget a user, so the first change to a sketch
+ * series in a branch saves a copy of the parts that can change.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "journal.h"
+#include "alloc.h"
+#include "command_r.h"
+#include "constants.h"
+#include "engine.h"
+#include "project.h"
+#include "series.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Opens a branch, nested in the innermost open branch if any.
+ *
+ * @param engine The engine-wide state.
+ */
+void openBranch(EngineState *engine) {
+  if (engine->branchCount >= engine->branchCapacity) {
+    int newCapacity = engine->branchCapacity ? engine->branchCapacity * 2 : 4;
+    int *grown =
+        (int *)reallocateOrExit(engine->branchMarks, newCapacity * sizeof(int));
+    engine->branchMarks = grown;
+    engine->branchCapacity = newCapacity;
+  }
+  engine->branchMarks[engine->branchCount++] = engine->journalCount;
+  engine->branchEpoch++;
+  openChangeBranch(&engine->changes);
+}
+
+/**
+ * @brief Appends an empty entry to the journal if a branch is open.
+ *
+ * @param engine The engine-wide state.
+ * @param kind The kind of change.
+ * @return UndoEntry* The new entry, or NULL if no branch is open.
+ */
+static UndoEntry *appendEntry(EngineState *engine, UndoKind kind) {
+  if (engine->branchCount == 0)
+    return NULL;
+  if (engine->journalCount >= engine->journalCapacity) {
+    int newCapacity =
+        engine->journalCapacity ? engine->journalCapacity * 2 : 16;
+    UndoEntry *grown = (UndoEntry *)reallocateOrExit(
+        engine->journal, newCapacity * sizeof(UndoEntry));
+    engine->journal = grown;
+    engine->journalCapacity = newCapacity;
+  }
+  UndoEntry *entry = &engine->journal[engine->journalCount++];
+  memset(entry, 0, sizeof(UndoEntry));
+  entry->kind = kind;
+  return entry;
+}
+
+/**
+ * @brief Records that the current date is about to move forward.
+ *
+ * @param engine The engine-wide state.
+ * @param previous The current date before the change.
+ */
+void journalDateChange(EngineState *engine, Date previous) {
+  UndoEntry *entry = appendEntry(engine, UNDO_DATE);
+  if (entry != NULL)
+    entry->date = previous;
+}
+
+/**
+ * @brief Records that a lot was added.
+ *
+ * @param engine The engine-wide state.
+ * @param lot The new lot.
+ * @param nameCreated 1 if the lot's vaccine name entry was created for it.
+ */
+void journalLotCreated(EngineState *engine, VaccineLot *lot, int nameCreated) {
+  UndoEntry *entry = appendEntry(engine, UNDO_LOT_CREATED);
+  if (entry != NULL) {
+    entry->lot = lot;
+    entry->created = nameCreated;
+  }
+}
+
+/**
+ * @brief Records that a lot without doses used is about to be removed.
+ *
+ * @param engine The engine-wide state.
+ * @param lot The lot, still in every index.
+ */
+void journalLotRetired(EngineState *engine, VaccineLot *lot) {
+  UndoEntry *entry = appendEntry(engine, UNDO_LOT_RETIRED);
+  if (entry == NULL)
+    return;
+  entry->lot = lot;
+  entry->position = lot->nameSlot;
+}
+
+/**
+ * @brief Records that a lot with doses used is about to be marked removed.
+ *
+ * @param engine The engine-wide state.
+ * @param lot The lot, still open.
+ */
+void journalLotClosed(EngineState *engine, VaccineLot *lot) {
+  UndoEntry *entry = appendEntry(engine, UNDO_LOT_CLOSED);
+  if (entry != NULL) {
+    entry->lot = lot;
+    entry->value = lot->doses;
+  }
+}
+
+/**
+ * @brief Records that a dose was applied, before the secondary indexes are
+ * updated.
+ *
+ * @param engine The engine-wide state.
+ * @param user The user's index entry, already holding the inoculation.
+ * @param lot The applied lot, after its dose counter changed.
+ * @param inoc The new inoculation.
+ */
+void journalDose(EngineState *engine, UserIndex *user, VaccineLot *lot,
+                 Inoculation *inoc) {
+  UndoEntry *entry = appendEntry(engine, UNDO_DOSE);
+  if (entry == NULL)
+    return;
+  entry->inoc = inoc;
+  entry->user = user;
+  entry->lot = lot;
+  entry->created = user->id < 0; // Users get their id on their first dose
+  entry->value = lot->checkpointCount;
+  entry->rate = lot->nameEntry->doseRate;
+  saveDailyShape(&engine->dailyDoses, &entry->dailyShape);
+  if (lot->checkpointCount > 0)
+    entry->checkpointUsed =
+        lot->checkpoints[lot->checkpointCount - 1].dosesUsed;
+}
+
+/**
+ * @brief Records that an inoculation was deleted.
+ *
+ * @param engine The engine-wide state.
+ * @param user The user's index entry.
+ * @param inoc The deleted inoculation.
+ * @param position The index the inoculation had in the user's array, or in
+ * the user's sealed doses if its row was sealed.
+ * @param lot The inoculation's lot (may be NULL).
+ */
+void journalDeletion(EngineState *engine, UserIndex *user, Inoculation *inoc,
+                     int position, VaccineLot *lot) {
+  UndoEntry *entry = appendEntry(engine, UNDO_DELETION);
+  if (entry != NULL) {
+    entry->inoc = inoc;
+    entry->user = user;
+    entry->position = position;
+    entry->lot = lot;
+    entry->vaccine = lot != NULL ? lot->nameEntry : NULL;
+    if (entry->vaccine != NULL)
+      entry->rate = entry->vaccine->doseRate;
+  }
+}
+
+/**
+ * @brief Records that a vaccine's dose series was defined.
+ *
+ * @param engine The engine-wide state.
+ * @param vaccine The vaccine name entry.
+ */
+void journalSeries(EngineState *engine, VaccineNameIndex *vaccine) {
+  UndoEntry *entry = appendEntry(engine, UNDO_SERIES);
+  if (entry != NULL)
+    entry->vaccine = vaccine;
+}
+
+/**
+ * @brief Saves a copy of a sketch series the first time it is about to change
+ * in a branch.
+ *
+ * Only the last daily sketch and the total can change, since days are added
+ * in order, so those two are all that is copied.
+ *
+ * @param engine The engine-wide state.
+ * @param series The sketch series.
+ */
+void journalSketch(EngineState *engine, SketchSeries *series) {
+  if (engine->branchCount == 0 || series->savedEpoch == engine->branchEpoch)
+    return;
+  UndoEntry *entry = appendEntry(engine, UNDO_SKETCH);
+  entry->series = series;
+  entry->value = series->count;
+  entry->savedSketches = (HyperLogLog *)allocateOrExit(2 * sizeof(HyperLogLog));
+  if (series->count > 0)
+    entry->savedSketches[0] = series->daily[series->count - 1];
+  entry->savedSketches[1] = series->total;
+  series->savedEpoch = engine->branchEpoch;
+}
+
+/**
+ * @brief Undoes the addition of a lot.
+ *
+ * @param entry The journal entry.
+ * @param context The system tables.
+ */
+static void undoLotCreated(const UndoEntry *entry, UndoContext *context) {
+  VaccineLot *lot = entry->lot;
+  VaccineNameIndex *nameEntry = lot->nameEntry;
+  removeVaccineFromHash(context->hashTable, lot->lot, context->hashSize);
+  removeVaccineFromList(context->vaccineList, lot->lot);
+  removeLotFromName(nameEntry, lot->nameSlot); // The newest, so the last
+  if (entry->created)
+    removeVaccineName(context->nameHashTable, nameEntry, context->hashSize);
+  (*context->vaccineCount)--;
+  freeVaccineLot(lot);
+}
+
+/**
+ * @brief Undoes the removal of a lot without doses used.
+ *
+ * @param engine The engine-wide state.
+ * @param entry The journal entry.
+ * @param context The system tables.
+ */
+static void undoLotRetired(EngineState *engine, const UndoEntry *entry,
+                           UndoContext *context) {
+  VaccineLot *lot = entry->lot;
+  VaccineNameIndex *nameEntry = lot->nameEntry;
+  engine->retiredLots = lot->next_vaccine; // The lot is the newest retired
+  lot->removedDay = -1;
+  addVaccineLotToHash(context->hashTable, lot, context->hashSize);
+  lot->next_vaccine = *context->vaccineList;
+  *context->vaccineList = lot;
+  restoreLotInName(nameEntry, lot, entry->position);
+  (*context->vaccineCount)++;
+}
+
+/**
+ * @brief Undoes the marking of a lot with doses used as removed.
+ *
+ * @param entry The journal entry.
+ */
+static void undoLotClosed(const UndoEntry *entry) {
+  entry->lot->isRemoved = 0;
+  entry->lot->doses = entry->value;
+  entry->lot->removedDay = -1;
+  syncLotHotFields(entry->lot);
+}
+
+/**
+ * @brief Takes a dose off the counts of its vaccine.
+ *
+ * @param engine The engine-wide state.
+ * @param entry The journal entry.
+ * @param vaccine The vaccine of the dose.
+ */
+static void undoVaccineCounts(EngineState *engine, const UndoEntry *entry,
+                              VaccineNameIndex *vaccine) {
+  vaccine->doseRate = entry->rate;
+  countDailyDoses(&engine->dailyDoses, dateToDayNumber(entry->inoc->date),
+                  vaccine->dailyColumn, -1);
+  restoreDailyShape(&engine->dailyDoses, &entry->dailyShape);
+  if (vaccine->dailyColumn >= engine->dailyDoses.columnCount)
+    vaccine->dailyColumn = -1; // Its column was added with the dose
+}
+
+/**
+ * @brief Undoes the application of a dose.
+ *
+ * @param engine The engine-wide state.
+ * @param entry The journal entry.
+ * @param context The system tables.
+ */
+static void undoDose(EngineState *engine, const UndoEntry *entry,
+                     UndoContext *context) {
+  Inoculation *inoc = entry->inoc;
+  UserIndex *user = entry->user;
+  VaccineLot *lot = entry->lot;
+  *context->inoculationList = inoc->next_global; // Newest inoculation
+  user->inoculationCount--;
+  lot->dosesUsed--;
+  syncLotHotFields(lot);
+  undoVaccineCounts(engine, entry, lot->nameEntry);
+  if (engine->columns.enabled)
+    removeLastInoculationRow(&engine->columns);
+  lot->checkpointCount = entry->value;
+  if (entry->value > 0)
+    lot->checkpoints[entry->value - 1].dosesUsed = entry->checkpointUsed;
+  engine->nextSequence = inoc->sequence;
+  engineResyncUser(engine, user, lot->nameEntry);
+  if (entry->created) {
+    user->id = -1;
+    engine->userCount--;
+    char name[NUMERIC_NAME_SIZE];
+    forgetCachedUser(&engine->userCache,
+                     hashUserName64(userNameText(user, name)), user);
+    removeUserEntry(context->userHashTable, user, context->hashSize);
+  }
+  freeInoculation(inoc);
+}
+
+/**
+ * @brief Puts a restored inoculation back on the global list and in its
+ * user's index.
+ *
+ * @param entry The journal entry.
+ * @param context The system tables.
+ */
+static void restoreRecord(const UndoEntry *entry, UndoContext *context) {
+  Inoculation *inoc = entry->inoc;
+  UserIndex *user = entry->user;
+
+  // The global list is ordered newest first
+  Inoculation **link = context->inoculationList;
+  while (*link != NULL && (*link)->sequence > inoc->sequence)
+    link = &(*link)->next_global;
+  inoc->next_global = *link;
+  *link = inoc;
+
+  // Shift the later records back up to reopen the inoculation's place
+  memmove(&user->inoculations[entry->position + 1],
+          &user->inoculations[entry->position],
+          (user->inoculationCount - entry->position) * sizeof(Inoculation *));
+  user->inoculations[entry->position] = inoc;
+  user->inoculationCount++;
+}
+
+/**
+ * @brief Turns a restored inoculation whose row was sealed back into a
+ * sealed dose of its user, freeing its record.
+ *
+ * @param entry The journal entry.
+ */
+static void restoreSealedDose(const UndoEntry *entry) {
+  Inoculation *inoc = entry->inoc;
+  SealedDose dose = {.lot = entry->lot,
+                     .row = (unsigned int)inoc->sequence,
+                     .date = packDate(inoc->date.day, inoc->date.month,
+                                      inoc->date.year)};
+  insertSealedDose(entry->user, entry->position, &dose);
+  freeInoculation(inoc);
+}
+
+/**
+ * @brief Undoes the deletion of an inoculation.
+ *
+ * @param engine The engine-wide state.
+ * @param entry The journal entry.
+ * @param context The system tables.
+ */
+static void undoDeletion(EngineState *engine, const UndoEntry *entry,
+                         UndoContext *context) {
+  Inoculation *inoc = entry->inoc;
+  UserIndex *user = entry->user;
+  int day = dateToDayNumber(inoc->date);
+  engine->deletedInoculations = inoc->next_global; // Newest deleted
+  user->deletedCount--;
+  inoc->deletedDay = -1;
+  if (engine->columns.enabled)
+    setInoculationRowDeleted(&engine->columns, inoc->sequence, 0);
+
+  // Nothing is sealed while a branch is open, so the row's state is as it
+  // was when the inoculation was deleted
+  if (engine->columns.enabled && inoc->sequence < engine->columns.sealedRows)
+    restoreSealedDose(entry);
+  else
+    restoreRecord(entry, context);
+  if (entry->vaccine != NULL) {
+    entry->vaccine->doseRate = entry->rate;
+    countDailyDoses(&engine->dailyDoses, day, entry->vaccine->dailyColumn, 1);
+    engineResyncUser(engine, user, entry->vaccine);
+  }
+}
+
+/**
+ * @brief Undoes the definition of a vaccine's dose series.
+ *
+ * @param entry The journal entry.
+ * @param context The system tables.
+ */
+static void undoSeries(const UndoEntry *entry, UndoContext *context) {
+  clearVaccineSeries(entry->vaccine, context->userHashTable,
+                     context->hashSize);
+}
+
+/**
+ * @brief Restores a sketch series from its saved copy.
+ *
+ * @param entry The journal entry.
+ */
+static void undoSketch(UndoEntry *entry) {
+  SketchSeries *series = entry->series;
+  series->count = entry->value;
+  if (series->count > 0)
+    series->daily[series->count - 1] = entry->savedSketches[0];
+  series->total = entry->savedSketches[1];
+  series->savedEpoch = 0;
+  free(entry->savedSketches);
+  entry->savedSketches = NULL;
+}
+
+/**
+ * @brief Undoes one journal entry.
+ *
+ * @param engine The engine-wide state.
+ * @param entry The journal entry.
+ * @param context The system tables.
+ */
+static void undoEntry(EngineState *engine, UndoEntry *entry,
+                      UndoContext *context) {
+  switch (entry->kind) {
+  case UNDO_DATE:
+    *context->currentDate = entry->date;
+    break;
+  case UNDO_LOT_CREATED:
+    undoLotCreated(entry, context);
+    break;
+  case UNDO_LOT_RETIRED:
+    undoLotRetired(engine, entry, context);
+    break;
+  case UNDO_LOT_CLOSED:
+    undoLotClosed(entry);
+    break;
+  case UNDO_DOSE:
+    undoDose(engine, entry, context);
+    break;
+  case UNDO_DELETION:
+    undoDeletion(engine, entry, context);
+    break;
+  case UNDO_SERIES:
+    undoSeries(entry, context);
+    break;
+  case UNDO_SKETCH:
+    undoSketch(entry);
+    break;
+  }
+}
+
+/**
+ * @brief Undoes the changes made since the innermost branch was opened and
+ * closes it.
+ *
+ * @param engine The engine-wide state.
+ * @param context The system tables.
+ * @return int The number of changes undone.
+ */
+int dropBranch(EngineState *engine, UndoContext *context) {
+  int mark = engine->branchMarks[--engine->branchCount];
+  int undone = engine->journalCount - mark;
+  while (engine->journalCount > mark) {
+    engine->journalCount--;
+    undoEntry(engine, &engine->journal[engine->journalCount], context);
+  }
+  engine->branchEpoch++;
+  engine->catalogEpoch++;
+  dropChangeBranch(&engine->changes);
+  return undone;
+}
+
+/**
+ * @brief Keeps the changes made since the innermost branch was opened and
+ * closes it, handing them to the enclosing branch if any.
+ *
+ * The changes are already applied in place, so committing only forgets how to
+ * undo them once no branch is left that could.
+ *
+ * @param engine The engine-wide state.
+ * @return int The number of changes kept.
+ */
+int commitBranch(EngineState *engine) {
+  int mark = engine->branchMarks[--engine->branchCount];
+  int kept = engine->journalCount - mark;
+  if (engine->branchCount == 0) {
+    for (int i = 0; i < engine->journalCount; i++)
+      free(engine->journal[i].savedSketches);
+    engine->journalCount = 0;
+  }
+  engine->branchEpoch++;
+  commitChangeBranch(&engine->changes);
+  return kept;
+}
+
+/**
+ * @brief Frees the memory used by the journal.
+ *
+ * @param engine The engine-wide state.
+ */
+void freeJournal(EngineState *engine) {
+  for (int i = 0; i < engine->journalCount; i++)
+    free(engine->journal[i].savedSketches);
+  free(engine->journal);
+  free(engine->branchMarks);
+  engine->journal = NULL;
+  engine->journalCount = 0;
+  engine->journalCapacity = 0;
+  engine->branchMarks = NULL;
+  engine->branchCount = 0;
+  engine->branchCapacity = 0;
+}
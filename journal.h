@@ -0,0 +1,137 @@
+/**
+ * @file journal.h
+ * @brief Header file for the undo journal behind what-if branches.
+ *
+ * This file contains the declarations of the functions that record every
+ * change made while a branch is open and undo them, newest first, when the
+ * branch is dropped.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "project.h"
+
+// Structure with the system tables an undo may need to change
+typedef struct {
+  VaccineLot **hashTable;             // Hash table of vaccine lots
+  VaccineNameIndex **nameHashTable;   // Hash table of vaccine names
+  UserIndex **userHashTable;          // Hash table of user indices
+  VaccineLot **vaccineList;           // List of vaccine lots
+  Inoculation **inoculationList;      // Global list of inoculations
+  int hashSize;                       // Size of the hash tables
+  int *vaccineCount;                  // Current count of vaccine lots
+  Date *currentDate;                  // Current date
+} UndoContext;
+
+/**
+ * @brief Opens a branch, nested in the innermost open branch if any.
+ *
+ * @param engine The engine-wide state.
+ */
+void openBranch(EngineState *engine);
+
+/**
+ * @brief Undoes the changes made since the innermost branch was opened and
+ * closes it.
+ *
+ * @param engine The engine-wide state.
+ * @param context The system tables.
+ * @return int The number of changes undone.
+ */
+int dropBranch(EngineState *engine, UndoContext *context);
+
+/**
+ * @brief Keeps the changes made since the innermost branch was opened and
+ * closes it, handing them to the enclosing branch if any.
+ *
+ * @param engine The engine-wide state.
+ * @return int The number of changes kept.
+ */
+int commitBranch(EngineState *engine);
+
+/**
+ * @brief Records that the current date is about to move forward.
+ *
+ * @param engine The engine-wide state.
+ * @param previous The current date before the change.
+ */
+void journalDateChange(EngineState *engine, Date previous);
+
+/**
+ * @brief Records that a lot was added.
+ *
+ * @param engine The engine-wide state.
+ * @param lot The new lot.
+ * @param nameCreated 1 if the lot's vaccine name entry was created for it.
+ */
+void journalLotCreated(EngineState *engine, VaccineLot *lot, int nameCreated);
+
+/**
+ * @brief Records that a lot without doses used is about to be removed.
+ *
+ * @param engine The engine-wide state.
+ * @param lot The lot, still in every index.
+ */
+void journalLotRetired(EngineState *engine, VaccineLot *lot);
+
+/**
+ * @brief Records that a lot with doses used is about to be marked removed.
+ *
+ * @param engine The engine-wide state.
+ * @param lot The lot, still open.
+ */
+void journalLotClosed(EngineState *engine, VaccineLot *lot);
+
+/**
+ * @brief Records that a dose was applied, before the secondary indexes are
+ * updated.
+ *
+ * @param engine The engine-wide state.
+ * @param user The user's index entry, already holding the inoculation.
+ * @param lot The applied lot, after its dose counter changed.
+ * @param inoc The new inoculation.
+ */
+void journalDose(EngineState *engine, UserIndex *user, VaccineLot *lot,
+                 Inoculation *inoc);
+
+/**
+ * @brief Records that an inoculation was deleted.
+ *
+ * @param engine The engine-wide state.
+ * @param user The user's index entry.
+ * @param inoc The deleted inoculation.
+ * @param position The index the inoculation had in the user's array, or in
+ * the user's sealed doses if its row was sealed.
+ * @param lot The inoculation's lot (may be NULL).
+ */
+void journalDeletion(EngineState *engine, UserIndex *user, Inoculation *inoc,
+                     int position, VaccineLot *lot);
+
+/**
+ * @brief Records that a vaccine's dose series was defined.
+ *
+ * @param engine The engine-wide state.
+ * @param vaccine The vaccine name entry.
+ */
+void journalSeries(EngineState *engine, VaccineNameIndex *vaccine);
+
+/**
+ * @brief Saves a copy of a sketch series the first time it is about to change
+ * in a branch.
+ *
+ * @param engine The engine-wide state.
+ * @param series The sketch series.
+ */
+void journalSketch(EngineState *engine, SketchSeries *series);
+
+/**
+ * @brief Frees the memory used by the journal.
+ *
+ * @param engine The engine-wide state.
+ */
+void freeJournal(EngineState *engine);
+
+#endif
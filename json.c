@@ -0,0 +1,441 @@
+/**
+ * @file json.c
+ * @brief Implementation of the JSON output mode.
+ *
+ * The serializer appends straight into a text buffer: strings are escaped
+ * byte by byte, numbers and dates are formatted by hand, and the finished
+ * object is written with a single fwrite, so no field goes through printf.
+ * Bytes from 0x80 up are copied as they are, since the input is UTF-8. In
+ * binary mode the fields are appended as frame fields instead, without keys
+ * or escapes, and the object is written as one response frame.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "json.h"
+#include "columns.h"
+#include "protocol.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Initializes a JSON writer with the JSON output mode off.
+ *
+ * @param json The JSON writer.
+ */
+void initializeJsonWriter(JsonWriter *json) {
+  json->enabled = 0;
+  json->binary = 0;
+  initializeTextBuffer(&json->line);
+  json->needComma = 0;
+  json->out = stdout;
+  json->held = NULL;
+  json->discard = 0;
+}
+
+/**
+ * @brief Appends bytes to a text buffer.
+ *
+ * @param out The output buffer.
+ * @param bytes The bytes.
+ * @param length The number of bytes.
+ */
+static void appendBytes(TextBuffer *out, const char *bytes, size_t length) {
+  memcpy(reserveText(out, length), bytes, length);
+  out->length += length;
+  out->data[out->length] = '\0';
+}
+
+/**
+ * @brief Appends bytes as a quoted and escaped JSON string.
+ *
+ * @param out The output buffer.
+ * @param text The bytes.
+ * @param length The number of bytes.
+ */
+static void appendJsonBytes(TextBuffer *out, const char *text,
+                            size_t length) {
+  static const char hex[] = "0123456789abcdef";
+  // Worst case: every byte becomes a six-byte \u00XX escape
+  char *next = reserveText(out, 6 * length + 2);
+  char *start = next;
+  *next++ = '"';
+  const unsigned char *end = (const unsigned char *)text + length;
+  for (const unsigned char *c = (const unsigned char *)text; c < end; c++) {
+    if (*c == '"' || *c == '\\') {
+      *next++ = '\\';
+      *next++ = (char)*c;
+    } else if (*c == '\n') {
+      *next++ = '\\';
+      *next++ = 'n';
+    } else if (*c == '\t') {
+      *next++ = '\\';
+      *next++ = 't';
+    } else if (*c < 0x20) {
+      memcpy(next, "\\u00", 4);
+      next[4] = hex[*c >> 4];
+      next[5] = hex[*c & 15];
+      next += 6;
+    } else {
+      *next++ = (char)*c;
+    }
+  }
+  *next++ = '"';
+  out->length += (size_t)(next - start);
+  out->data[out->length] = '\0';
+}
+
+/**
+ * @brief Appends a string as a quoted and escaped JSON string.
+ *
+ * @param out The output buffer.
+ * @param text The string.
+ */
+void appendJsonString(TextBuffer *out, const char *text) {
+  appendJsonBytes(out, text, strlen(text));
+}
+
+/**
+ * @brief Appends an integer as a JSON number.
+ *
+ * @param out The output buffer.
+ * @param value The integer.
+ */
+void appendJsonInteger(TextBuffer *out, long value) {
+  char digits[24];
+  int at = sizeof(digits);
+  unsigned long magnitude =
+      value < 0 ? 0UL - (unsigned long)value : (unsigned long)value;
+  do {
+    digits[--at] = (char)('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude > 0);
+  if (value < 0)
+    digits[--at] = '-';
+  appendBytes(out, digits + at, sizeof(digits) - at);
+}
+
+/**
+ * @brief Writes a number with a fixed count of digits, padded with zeros.
+ *
+ * @param at Where to write.
+ * @param value The number.
+ * @param width The number of digits.
+ */
+static void writePadded(char *at, int value, int width) {
+  for (int i = width - 1; i >= 0; i--) {
+    at[i] = (char)('0' + value % 10);
+    value /= 10;
+  }
+}
+
+/**
+ * @brief Appends a date as a quoted YYYY-MM-DD string.
+ *
+ * @param out The output buffer.
+ * @param day The day of the month.
+ * @param month The month.
+ * @param year The year.
+ */
+void appendJsonDate(TextBuffer *out, int day, int month, int year) {
+  char date[12] = "\"0000-00-00\"";
+  writePadded(date + 1, year, 4);
+  writePadded(date + 6, month, 2);
+  writePadded(date + 9, day, 2);
+  appendBytes(out, date, sizeof(date));
+}
+
+/**
+ * @brief Writes the separator and the key of the next value.
+ *
+ * @param json The JSON writer.
+ * @param key The field's name, or NULL inside an array.
+ */
+static void writeKey(JsonWriter *json, const char *key) {
+  if (json->binary) // Frame fields go in a known order, without keys
+    return;
+  if (json->needComma)
+    appendBytes(&json->line, ",", 1);
+  json->needComma = 1;
+  if (key == NULL)
+    return;
+  appendJsonString(&json->line, key);
+  appendBytes(&json->line, ":", 1);
+}
+
+/**
+ * @brief Starts the object answering a command that succeeded.
+ *
+ * @param json The JSON writer.
+ * @param command The command character.
+ */
+void jsonBegin(JsonWriter *json, char command) {
+  if (json->binary) {
+    beginResponseFrame(&json->line, command, 1);
+    return;
+  }
+  char head[] = "{\"command\":\"c\",\"ok\":true";
+  head[12] = command;
+  json->line.length = 0;
+  appendBytes(&json->line, head, sizeof(head) - 1);
+  json->needComma = 1;
+}
+
+/**
+ * @brief Writes a string field, or a string element inside an array.
+ *
+ * @param json The JSON writer.
+ * @param key The field's name, or NULL inside an array.
+ * @param value The string.
+ */
+void jsonString(JsonWriter *json, const char *key, const char *value) {
+  writeKey(json, key);
+  if (json->binary)
+    appendTextField(&json->line, value, strlen(value));
+  else
+    appendJsonString(&json->line, value);
+}
+
+/**
+ * @brief Writes an integer field, or an integer element inside an array.
+ *
+ * @param json The JSON writer.
+ * @param key The field's name, or NULL inside an array.
+ * @param value The integer.
+ */
+void jsonInteger(JsonWriter *json, const char *key, long value) {
+  writeKey(json, key);
+  if (json->binary)
+    appendValueField(&json->line, FRAME_NUMBER, (unsigned long)value);
+  else
+    appendJsonInteger(&json->line, value);
+}
+
+/**
+ * @brief Writes a date field, or a date element inside an array.
+ *
+ * @param json The JSON writer.
+ * @param key The field's name, or NULL inside an array.
+ * @param day The day of the month.
+ * @param month The month.
+ * @param year The year.
+ */
+void jsonDate(JsonWriter *json, const char *key, int day, int month,
+              int year) {
+  writeKey(json, key);
+  if (json->binary)
+    appendValueField(&json->line, FRAME_DATE, packDate(day, month, year));
+  else
+    appendJsonDate(&json->line, day, month, year);
+}
+
+/**
+ * @brief Writes a decimal field with a fixed number of decimal places, or a
+ * decimal element inside an array. In binary mode, the value is sent as a
+ * number scaled by ten to the number of places.
+ *
+ * @param json The JSON writer.
+ * @param key The field's name, or NULL inside an array.
+ * @param value The value.
+ * @param places The number of decimal places.
+ */
+void jsonFixed(JsonWriter *json, const char *key, double value, int places) {
+  long scale = 1;
+  for (int i = 0; i < places; i++)
+    scale *= 10;
+  long scaled = (long)(value * scale + (value < 0 ? -0.5 : 0.5));
+  writeKey(json, key);
+  if (json->binary) {
+    appendValueField(&json->line, FRAME_NUMBER, (unsigned long)scaled);
+    return;
+  }
+  unsigned long magnitude =
+      scaled < 0 ? 0UL - (unsigned long)scaled : (unsigned long)scaled;
+  if (scaled < 0)
+    appendBytes(&json->line, "-", 1);
+  appendJsonInteger(&json->line, (long)(magnitude / scale));
+  if (places == 0)
+    return;
+  char fraction[12] = ".";
+  writePadded(fraction + 1, (int)(magnitude % scale), places);
+  appendBytes(&json->line, fraction, (size_t)places + 1);
+}
+
+/**
+ * @brief Opens a nested object or array.
+ *
+ * @param json The JSON writer.
+ * @param key The field's name, or NULL inside an array.
+ * @param bracket '{' for an object or '[' for an array.
+ */
+void jsonOpen(JsonWriter *json, const char *key, char bracket) {
+  writeKey(json, key);
+  appendBytes(&json->line, &bracket, 1);
+  json->needComma = 0;
+}
+
+/**
+ * @brief Closes the innermost nested object or array.
+ *
+ * @param json The JSON writer.
+ * @param bracket '}' for an object or ']' for an array.
+ */
+void jsonClose(JsonWriter *json, char bracket) {
+  appendBytes(&json->line, &bracket, 1);
+  json->needComma = 1;
+}
+
+/**
+ * @brief Closes the object answering a command, leaving it in the writer's
+ * line buffer instead of writing it.
+ *
+ * @param json The JSON writer.
+ */
+void jsonFinish(JsonWriter *json) {
+  if (json->binary)
+    endResponseFrame(&json->line);
+  else
+    appendBytes(&json->line, "}\n", 2);
+}
+
+/**
+ * @brief Closes the object answering a command and writes it as one line.
+ *
+ * @param json The JSON writer.
+ */
+void jsonEnd(JsonWriter *json) {
+  jsonFinish(json);
+  writeAnswer(json, json->line.data, json->line.length);
+  json->line.length = 0;
+}
+
+/**
+ * @brief Writes an answer that is already built, to the held buffer if there
+ * is one or to the output stream, unless answers are discarded.
+ *
+ * @param json The JSON writer.
+ * @param bytes The answer.
+ * @param length The number of bytes of the answer.
+ */
+void writeAnswer(JsonWriter *json, const char *bytes, size_t length) {
+  if (json->discard || length == 0)
+    return;
+  if (json->held != NULL)
+    appendBytes(json->held, bytes, length);
+  else
+    fwrite(bytes, 1, length, json->out);
+}
+
+/**
+ * @brief Reports an error, as a JSON object with an error code in the JSON
+ * output mode, or as a message line otherwise.
+ *
+ * @param json The JSON writer.
+ * @param command The command character.
+ * @param code The error code.
+ * @param subject The name the error is about, or NULL.
+ * @param message The translated message, or NULL to print nothing.
+ */
+void reportError(JsonWriter *json, char command, const char *code,
+                 const char *subject, const char *message) {
+  if (json->discard)
+    return;
+  if (!json->enabled) {
+    if (message != NULL && subject != NULL)
+      fprintf(json->out, "%s: %s\n", subject, message);
+    else if (message != NULL)
+      fprintf(json->out, "%s\n", message);
+    return;
+  }
+  char head[] = "{\"command\":\"c\",\"ok\":false";
+  head[12] = command;
+  json->line.length = 0;
+  if (json->binary)
+    beginResponseFrame(&json->line, command, 0);
+  else
+    appendBytes(&json->line, head, sizeof(head) - 1);
+  json->needComma = 1;
+  jsonString(json, "error", code);
+  if (subject != NULL)
+    jsonString(json, "subject", subject);
+  jsonEnd(json);
+}
+
+/**
+ * @brief Reports the string a command answers with, as the only field of a
+ * JSON object in the JSON output mode, or as a line otherwise.
+ *
+ * @param json The JSON writer.
+ * @param command The command character.
+ * @param key The field's name.
+ * @param value The string.
+ */
+void reportText(JsonWriter *json, char command, const char *key,
+                const char *value) {
+  if (json->discard)
+    return;
+  if (!json->enabled) {
+    fprintf(json->out, "%s\n", value);
+    return;
+  }
+  jsonBegin(json, command);
+  jsonString(json, key, value);
+  jsonEnd(json);
+}
+
+/**
+ * @brief Reports the number a command answers with, as the only field of a
+ * JSON object in the JSON output mode, or as a line otherwise.
+ *
+ * @param json The JSON writer.
+ * @param command The command character.
+ * @param key The field's name.
+ * @param value The number.
+ */
+void reportNumber(JsonWriter *json, char command, const char *key,
+                  long value) {
+  if (json->discard)
+    return;
+  if (!json->enabled) {
+    fprintf(json->out, "%ld\n", value);
+    return;
+  }
+  jsonBegin(json, command);
+  jsonInteger(json, key, value);
+  jsonEnd(json);
+}
+
+/**
+ * @brief Reports the date a command answers with, as the only field of a
+ * JSON object in the JSON output mode, or as a DD-MM-YYYY line otherwise.
+ *
+ * @param json The JSON writer.
+ * @param command The command character.
+ * @param key The field's name.
+ * @param day The day of the month.
+ * @param month The month.
+ * @param year The year.
+ */
+void reportDate(JsonWriter *json, char command, const char *key, int day,
+                int month, int year) {
+  if (json->discard)
+    return;
+  if (!json->enabled) {
+    fprintf(json->out, "%02d-%02d-%d\n", day, month, year);
+    return;
+  }
+  jsonBegin(json, command);
+  jsonDate(json, key, day, month, year);
+  jsonEnd(json);
+}
+
+/**
+ * @brief Frees the memory used by a JSON writer.
+ *
+ * @param json The JSON writer.
+ */
+void freeJsonWriter(JsonWriter *json) {
+  freeTextBuffer(&json->line);
+  initializeJsonWriter(json);
+}
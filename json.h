@@ -0,0 +1,214 @@
+/**
+ * @file json.h
+ * @brief Header file for the JSON output mode.
+ *
+ * This file contains the declarations of a streaming JSON serializer that
+ * builds each command's answer as one JSON object on one line in a text
+ * buffer, and of the helpers that let the commands report errors with a
+ * stable error code instead of a translated message. Speaking the binary
+ * protocol, the same calls build a response frame of compact fields.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef JSON_H
+#define JSON_H
+
+#include "cache.h"
+#include <stdio.h>
+
+// Structure for the JSON output mode
+typedef struct {
+  int enabled;         // Commands answer with one JSON object per line
+  int binary;          // Objects are written as compact response frames
+  TextBuffer line;     // Object being built
+  int needComma;       // A value was written in the innermost container
+  FILE *out;           // Stream commands write their answers to
+  TextBuffer *held;    // Buffer answers are appended to instead, or NULL
+  int discard;         // Answers are dropped, as replayed commands' are
+} JsonWriter;
+
+/**
+ * @brief Initializes a JSON writer with the JSON output mode off.
+ *
+ * @param json The JSON writer.
+ */
+void initializeJsonWriter(JsonWriter *json);
+
+/**
+ * @brief Appends a string as a quoted and escaped JSON string.
+ *
+ * @param out The output buffer.
+ * @param text The string.
+ */
+void appendJsonString(TextBuffer *out, const char *text);
+
+/**
+ * @brief Appends an integer as a JSON number.
+ *
+ * @param out The output buffer.
+ * @param value The integer.
+ */
+void appendJsonInteger(TextBuffer *out, long value);
+
+/**
+ * @brief Appends a date as a quoted YYYY-MM-DD string.
+ *
+ * @param out The output buffer.
+ * @param day The day of the month.
+ * @param month The month.
+ * @param year The year.
+ */
+void appendJsonDate(TextBuffer *out, int day, int month, int year);
+
+/**
+ * @brief Starts the object answering a command that succeeded.
+ *
+ * @param json The JSON writer.
+ * @param command The command character.
+ */
+void jsonBegin(JsonWriter *json, char command);
+
+/**
+ * @brief Writes a string field, or a string element inside an array.
+ *
+ * @param json The JSON writer.
+ * @param key The field's name, or NULL inside an array.
+ * @param value The string.
+ */
+void jsonString(JsonWriter *json, const char *key, const char *value);
+
+/**
+ * @brief Writes an integer field, or an integer element inside an array.
+ *
+ * @param json The JSON writer.
+ * @param key The field's name, or NULL inside an array.
+ * @param value The integer.
+ */
+void jsonInteger(JsonWriter *json, const char *key, long value);
+
+/**
+ * @brief Writes a date field, or a date element inside an array.
+ *
+ * @param json The JSON writer.
+ * @param key The field's name, or NULL inside an array.
+ * @param day The day of the month.
+ * @param month The month.
+ * @param year The year.
+ */
+void jsonDate(JsonWriter *json, const char *key, int day, int month,
+              int year);
+
+/**
+ * @brief Writes a decimal field with a fixed number of decimal places, or a
+ * decimal element inside an array. In binary mode, the value is sent as a
+ * number scaled by ten to the number of places.
+ *
+ * @param json The JSON writer.
+ * @param key The field's name, or NULL inside an array.
+ * @param value The value.
+ * @param places The number of decimal places.
+ */
+void jsonFixed(JsonWriter *json, const char *key, double value, int places);
+
+/**
+ * @brief Opens a nested object or array.
+ *
+ * @param json The JSON writer.
+ * @param key The field's name, or NULL inside an array.
+ * @param bracket '{' for an object or '[' for an array.
+ */
+void jsonOpen(JsonWriter *json, const char *key, char bracket);
+
+/**
+ * @brief Closes the innermost nested object or array.
+ *
+ * @param json The JSON writer.
+ * @param bracket '}' for an object or ']' for an array.
+ */
+void jsonClose(JsonWriter *json, char bracket);
+
+/**
+ * @brief Closes the object answering a command, leaving it in the writer's
+ * line buffer instead of writing it.
+ *
+ * @param json The JSON writer.
+ */
+void jsonFinish(JsonWriter *json);
+
+/**
+ * @brief Closes the object answering a command and writes it as one line.
+ *
+ * @param json The JSON writer.
+ */
+void jsonEnd(JsonWriter *json);
+
+/**
+ * @brief Writes an answer that is already built, to the held buffer if there
+ * is one or to the output stream, unless answers are discarded.
+ *
+ * @param json The JSON writer.
+ * @param bytes The answer.
+ * @param length The number of bytes of the answer.
+ */
+void writeAnswer(JsonWriter *json, const char *bytes, size_t length);
+
+/**
+ * @brief Reports an error, as a JSON object with an error code in the JSON
+ * output mode, or as a message line otherwise.
+ *
+ * @param json The JSON writer.
+ * @param command The command character.
+ * @param code The error code.
+ * @param subject The name the error is about, or NULL.
+ * @param message The translated message, or NULL to print nothing.
+ */
+void reportError(JsonWriter *json, char command, const char *code,
+                 const char *subject, const char *message);
+
+/**
+ * @brief Reports the string a command answers with, as the only field of a
+ * JSON object in the JSON output mode, or as a line otherwise.
+ *
+ * @param json The JSON writer.
+ * @param command The command character.
+ * @param key The field's name.
+ * @param value The string.
+ */
+void reportText(JsonWriter *json, char command, const char *key,
+                const char *value);
+
+/**
+ * @brief Reports the number a command answers with, as the only field of a
+ * JSON object in the JSON output mode, or as a line otherwise.
+ *
+ * @param json The JSON writer.
+ * @param command The command character.
+ * @param key The field's name.
+ * @param value The number.
+ */
+void reportNumber(JsonWriter *json, char command, const char *key,
+                  long value);
+
+/**
+ * @brief Reports the date a command answers with, as the only field of a
+ * JSON object in the JSON output mode, or as a DD-MM-YYYY line otherwise.
+ *
+ * @param json The JSON writer.
+ * @param command The command character.
+ * @param key The field's name.
+ * @param day The day of the month.
+ * @param month The month.
+ * @param year The year.
+ */
+void reportDate(JsonWriter *json, char command, const char *key, int day,
+                int month, int year);
+
+/**
+ * @brief Frees the memory used by a JSON writer.
+ *
+ * @param json The JSON writer.
+ */
+void freeJsonWriter(JsonWriter *json);
+
+#endif
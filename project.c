@@ -9,9 +9,12 @@
  */
 
 #include "project.h"
+#include "alloc.h"
+#include "charclass.h"
 #include "commands.h"
 #include "constants.h"
-#include <ctype.h>
+#include "engine.h"
+#include "protocol.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -51,13 +54,14 @@ void initializeDataStructures(VaccineLot ***hashTable,
  * @param vaccineCount Pointer to the vaccine counter.
  * @param inoculationList Pointer to the global inoculation list.
  * @param currentDate Pointer to the current date.
+ * @param engine The engine-wide state.
  * @param portuguese Flag indicating if the output should be in Portuguese.
  */
 void processCommands(char *command, VaccineLot **hashTable,
                      VaccineNameIndex **nameHashTable,
                      UserIndex **userHashTable, VaccineLot **vaccineList,
                      int *vaccineCount, Inoculation **inoculationList,
-                     Date *currentDate, int portuguese) {
+                     Date *currentDate, EngineState *engine, int portuguese) {
   while (fgets(command, SIZE_COMMAND, stdin)) {
     command[strcspn(command, "\n")] = 0; // Remove the newline character
 
@@ -68,16 +72,79 @@ void processCommands(char *command, VaccineLot **hashTable,
     if (cmd == 'q') // Exit if the command is 'q'
       break;
 
-    char *args = command + 1;
-    while (*args != '\0' && isspace(*args)) // Skip whitespace
-      args++;
+    char *args = skipSpaces(command + 1);
 
     handleCommand(cmd, args, hashTable, nameHashTable, userHashTable,
                   vaccineList, HASH_SIZE, vaccineCount, MAX_VACCINES,
-                  currentDate, inoculationList, portuguese);
+                  currentDate, inoculationList, engine, portuguese);
   }
 }
 
+/**
+ * @brief Processes request frames of the binary protocol from standard input,
+ * answering each one with a response frame.
+ *
+ * @param command Buffer to store the decoded command.
+ * @param hashTable Vaccine hash table.
+ * @param nameHashTable Vaccine name hash table.
+ * @param userHashTable User hash table.
+ * @param vaccineList Pointer to the global vaccine list.
+ * @param vaccineCount Pointer to the vaccine counter.
+ * @param inoculationList Pointer to the global inoculation list.
+ * @param currentDate Pointer to the current date.
+ * @param engine The engine-wide state.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ */
+void processFrames(char *command, VaccineLot **hashTable,
+                   VaccineNameIndex **nameHashTable, UserIndex **userHashTable,
+                   VaccineLot **vaccineList, int *vaccineCount,
+                   Inoculation **inoculationList, Date *currentDate,
+                   EngineState *engine, int portuguese) {
+  FrameChannel channel;
+  initializeFrameChannel(&channel);
+  while (readCommandFrame(&channel, stdin, command, SIZE_COMMAND)) {
+    char cmd = command[0];
+    if (cmd == 'q') // Exit if the command is 'q'
+      break;
+
+    char *args = skipSpaces(command + 1);
+
+    // Compact answers are frames already, JSON text is framed once written
+    int framed = engine->json.binary;
+    if (!framed)
+      engine->json.held = &channel.answer;
+    engine->request = &channel.request;
+    handleCommand(cmd, args, hashTable, nameHashTable, userHashTable,
+                  vaccineList, HASH_SIZE, vaccineCount, MAX_VACCINES,
+                  currentDate, inoculationList, engine, portuguese);
+    engine->request = NULL;
+    engine->json.held = NULL;
+    if (!framed)
+      endFrameAnswer(&channel, cmd, engine->json.out);
+  }
+  freeFrameChannel(&channel);
+}
+
+/**
+ * @brief Converts text commands from standard input into request frames of
+ * the binary protocol on standard output.
+ *
+ * @return int Exit status.
+ */
+int encodeCommands(void) {
+  char *command = (char *)allocateOrExit(SIZE_COMMAND);
+  TextBuffer frame;
+  initializeTextBuffer(&frame);
+  while (fgets(command, SIZE_COMMAND, stdin)) {
+    command[strcspn(command, "\n")] = 0; // Remove the newline character
+    if (encodeCommandFrame(command, &frame))
+      fwrite(frame.data, 1, frame.length, stdout);
+  }
+  freeTextBuffer(&frame);
+  free(command);
+  return 0;
+}
+
 /**
  * @brief Frees all allocated resources before exiting the program.
  *
@@ -98,16 +165,15 @@ void freeResources(VaccineLot **hashTable, VaccineNameIndex **nameHashTable,
 }
 
 /**
- * @brief Main function of the program.
+ * @brief Runs the engine over the commands read from standard input.
  *
- * @param argc Argument count.
- * @param argv Argument vector.
+ * @param portuguese Flag indicating if the output should be in Portuguese.
+ * @param json Flag indicating if the commands answer in JSON.
+ * @param binary Flag indicating if the commands come as binary frames.
+ * @param columnar Flag indicating if doses are kept in the columnar store.
  * @return int Exit status.
  */
-int main(int argc, char *argv[]) {
-  // Check if the program should use Portuguese
-  int portuguese = (argc > 1 && strcmp(argv[1], "pt") == 0) ? 1 : 0;
-
+int runEngine(int portuguese, int json, int binary, int columnar) {
   // Initialize current date
   Date currentDate = {1, 1, 2025}; // Initial date: 01-01-2025
 
@@ -118,26 +184,52 @@ int main(int argc, char *argv[]) {
   VaccineLot *vaccineList;
   Inoculation *inoculationList;
   int vaccineCount;
+  EngineState engine;
 
   // Initialize data structures
   initializeDataStructures(&hashTable, &nameHashTable, &userHashTable,
                            &vaccineList, &inoculationList, &vaccineCount);
+  initializeEngineState(&engine);
+  // Without JSON text, binary answers are the JSON writer's compact frames
+  engine.json.enabled = json || binary;
+  engine.json.binary = binary && !json;
+  engine.columns.enabled = columnar;
 
   // Allocate memory for command
-  char *command = (char *)malloc(SIZE_COMMAND);
-  if (command == NULL) {
-    printf(portuguese ? "sem memória\n" : "No memory\n");
-    return 1;
-  }
+  char *command = (char *)allocateOrExit(SIZE_COMMAND);
 
-  // Process user commands
-  processCommands(command, hashTable, nameHashTable, userHashTable,
-                  &vaccineList, &vaccineCount, &inoculationList, &currentDate,
-                  portuguese);
+  // Process user commands, as text lines or as binary frames
+  (binary ? processFrames : processCommands)(
+      command, hashTable, nameHashTable, userHashTable, &vaccineList,
+      &vaccineCount, &inoculationList, &currentDate, &engine, portuguese);
 
   // Free resources and exit
   freeResources(hashTable, nameHashTable, userHashTable, inoculationList,
                 command);
+  freeEngineState(&engine);
 
   return 0;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Main function of the program.
+ *
+ * @param argc Argument count.
+ * @param argv Argument vector.
+ * @return int Exit status.
+ */
+int main(int argc, char *argv[]) {
+  // Check if the program should use Portuguese, answer in JSON, speak the
+  // binary protocol or keep the columnar store
+  int portuguese = 0, json = 0, binary = 0, columnar = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "encode") == 0) // Only convert commands into frames
+      return encodeCommands();
+    portuguese |= strcmp(argv[i], "pt") == 0;
+    json |= strcmp(argv[i], "json") == 0;
+    binary |= strcmp(argv[i], "binary") == 0;
+    columnar |= strcmp(argv[i], "columns") == 0;
+  }
+
+  return runEngine(portuguese, json, binary, columnar);
+}
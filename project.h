@@ -11,6 +11,19 @@
 #ifndef PROJECT_H
 #define PROJECT_H
 
+#include "arena.h"
+#include "cache.h"
+#include "changes.h"
+#include "cohort.h"
+#include "columns.h"
+#include "daily.h"
+#include "filter.h"
+#include "json.h"
+#include "protocol.h"
+#include "replication.h"
+#include "sites.h"
+#include "sketch.h"
+
 // Structure for date
 typedef struct {
   int day;
@@ -23,6 +36,13 @@ typedef struct VaccineNameIndex VaccineNameIndex;
 typedef struct VaccineLot VaccineLot;
 typedef struct Inoculation Inoculation;  
 typedef struct UserIndex UserIndex;
+typedef struct SeriesProgress SeriesProgress;
+
+// Structure for the doses used by a lot at the end of a day
+typedef struct {
+  int day;                   // Day number of the checkpoint
+  int dosesUsed;             // Doses used by the end of that day
+} DoseCheckpoint;
 
 // Structure for vaccine name index
 struct VaccineNameIndex {
@@ -30,6 +50,18 @@ struct VaccineNameIndex {
   struct VaccineLot **lots;  // Array of pointers to lots with this name
   int lotCount;              // Number of lots with this name
   int capacity;              // Current capacity of the lots array
+  int *lotExpiry;            // Day number of each lot's validation date
+  int *lotRemaining;         // Doses each lot can still give (0 if removed)
+  int seriesDoses;           // Doses in the vaccine's series (0 if none)
+  int seriesSpacing;         // Minimum days between two doses of the series
+  struct SeriesProgress **dueHeap;  // Unfinished series, min-heap by due day
+  int dueCount;              // Number of entries in the due heap
+  int dueCapacity;           // Current capacity of the due heap
+  CohortBitmap recipients;   // Ids of the users with doses of this vaccine
+  SketchSeries recipientSketches;  // Distinct recipients per day and overall
+  SiteStock stock;           // Lots per site and the doses available
+  DoseRate doseRate;         // Weighted doses given per day
+  int dailyColumn;           // Column in the per-day dose table (-1 if none)
   struct VaccineNameIndex *next_hash;  // For hash table collision handling
 };
 
@@ -41,6 +73,17 @@ struct VaccineLot {
   int doses;
   int dosesUsed;
   int isRemoved;             // Flag to mark removed lots
+  int initialDoses;          // Doses the lot was created with
+  int createdDay;            // Day number when the lot was created
+  int removedDay;            // Day number when the lot was removed (or -1)
+  int id;                    // Dense lot id (-1 until its first dose)
+  int site;                  // Id of the vaccination site holding the lot
+  int siteSlot;              // Position of the lot on its site's shelf
+  DoseCheckpoint *checkpoints;  // Doses used per day with doses, ascending
+  int checkpointCount;       // Number of checkpoints
+  int checkpointCapacity;    // Current capacity of the checkpoints array
+  struct VaccineNameIndex *nameEntry;  // Name index entry of this vaccine
+  int nameSlot;              // Position of the lot in its name entry
   struct VaccineLot *next_hash;     // For hash by lot
   struct VaccineLot *next_vaccine;  // For global list
 };
@@ -50,22 +93,116 @@ struct Inoculation {
   char *user;
   char *lot;
   Date date;
+  unsigned long sequence;            // Order in which inoculations were made
+  int deletedDay;                    // Day number of the deletion (or -1)
   struct Inoculation *next_global;   // For global chronological list
 };
 
+#define MAX_NUMERIC_NAME 18  // Digits of the longest name kept as a number
+#define NUMERIC_NAME_SIZE 19 // Bytes to print a name kept as a number
+
+// Buckets of the user hash table: the names kept as text, then the all-digit
+// names kept as numbers
+#define USER_TABLE_BUCKETS(size) (2 * (size))
+
 // Structure for user inoculation index
 struct UserIndex {
-  char *userName;
+  char *userName;                     // Name, or NULL if kept as a number
+  unsigned long long number;          // Value of an all-digit name
+  int digits;                         // Digits of an all-digit name (or 0)
+  int id;                             // Dense user id (-1 until assigned)
   struct Inoculation **inoculations;  // Array of pointers to this user's inoculations
   int inoculationCount;               // Number of inoculations for this user
   int capacity;                       // Current capacity of the inoculations array
+  SealedDose *sealed;                 // Doses of sealed rows, oldest first
+  int sealedCount;                    // Number of sealed doses
+  int sealedCapacity;                 // Current capacity of the sealed array
+  struct SeriesProgress **series;     // This user's progress in dose series
+  int seriesCount;                    // Number of series progress entries
+  struct Inoculation **deleted;       // This user's deleted inoculations
+  int deletedCount;                   // Number of deleted inoculations
+  int deletedCapacity;                // Current capacity of the deleted array
   struct UserIndex *next_hash;        // For hash table collision handling
 };
 
+// Structure for a user's progress through a vaccine's dose series
+struct SeriesProgress {
+  struct UserIndex *user;
+  struct VaccineNameIndex *vaccine;
+  int dosesTaken;                     // Doses of the vaccine already received
+  int lastDoseDay;                    // Day number of the most recent dose
+  int heapPos;                        // Position in the due heap (-1 if none)
+};
+
+// Kinds of change recorded in the undo journal while a branch is open
+typedef enum {
+  UNDO_DATE,        // The current date moved forward
+  UNDO_LOT_CREATED, // A lot was added
+  UNDO_LOT_RETIRED, // A lot without doses used was removed
+  UNDO_LOT_CLOSED,  // A lot with doses used was marked removed
+  UNDO_DOSE,        // A dose was applied
+  UNDO_DELETION,    // An inoculation was deleted
+  UNDO_SERIES,      // A vaccine's dose series was defined
+  UNDO_SKETCH       // A sketch series was changed for the first time
+} UndoKind;
+
+// Structure for one change in the undo journal
+typedef struct {
+  UndoKind kind;
+  Date date;                          // Previous current date
+  VaccineLot *lot;                    // Lot that changed
+  Inoculation *inoc;                  // Inoculation that changed
+  UserIndex *user;                    // User of the inoculation
+  VaccineNameIndex *vaccine;          // Vaccine that changed
+  int created;                        // The user or vaccine entry was created
+  int position;                       // Index in the entry's array
+  int value;                          // Previous doses or checkpoint count
+  int checkpointUsed;                 // Previous doses of the last checkpoint
+  SketchSeries *series;               // Sketch series that changed
+  HyperLogLog *savedSketches;         // Previous last daily and total sketches
+  DoseRate rate;                      // Previous dose rate of the vaccine
+  DailyShape dailyShape;              // Previous size of the per-day doses
+} UndoEntry;
+
+// Structure for engine-wide state shared by the commands
+typedef struct {
+  UserIndex **usersById;              // Users indexed by their dense id
+  int userCount;                      // Number of users with an id
+  int userCapacity;                   // Current capacity of usersById
+  SketchSeries dailySketches;         // Distinct users vaccinated per day
+  unsigned long nextSequence;         // Sequence of the next inoculation
+  VaccineLot *retiredLots;            // Removed unused lots, kept for history
+  Inoculation *deletedInoculations;   // Deleted inoculations, for history
+  UndoEntry *journal;                 // Changes made since the first branch
+  int journalCount;                   // Number of journal entries
+  int journalCapacity;                // Current capacity of the journal
+  int *branchMarks;                   // Journal length when each branch opened
+  int branchCount;                    // Number of open branches
+  int branchCapacity;                 // Current capacity of branchMarks
+  unsigned long branchEpoch;          // Changes when a branch opens or drops
+  unsigned long catalogEpoch;         // Changes whenever a lot changes
+  ListCache listCache;                // Recent l listings
+  UserFilter userFilter;              // Names of the users given an id
+  UserCache userCache;                // Recently resolved users
+  ScratchArena scratch;               // Allocations freed after each command
+  Replication replication;            // Log shipped or replayed, if any
+  ChangeFeed changes;                 // Committed changes for consumers
+  InoculationColumns columns;         // Inoculations as packed columns
+  JsonWriter json;                    // JSON output mode, if enabled
+  DailyDoses dailyDoses;              // Doses per day and per vaccine
+  const FrameRequest *request;        // Typed fields of a binary request
+} EngineState;
+
 // Function declarations (as in your previous version)
 int isValidBatch(const char *batch);
 int isValidName(const char *name);
 int isValidDate(Date date, Date currentDate);
+int dateToDayNumber(Date date);
+Date dayNumberToDate(int dayNumber);
+int parseCalendarDate(const char *str, Date *date);
+void sortPointers(void **array, int count,
+                  int (*compare)(const void *, const void *),
+                  ScratchArena *scratch);
 unsigned int hashBatch(const char *batch, int size);
 unsigned int hashString(const char *str, int size);
 
@@ -76,6 +213,8 @@ UserIndex **initializeUserHashTable(int size);
 
 VaccineLot *findVaccineByBatch(VaccineLot **hashTable, const char *batch, int size);
 VaccineNameIndex *findVaccineByName(VaccineNameIndex **nameHashTable, const char *name, int size);
+void findVaccinesByNames(VaccineNameIndex **nameHashTable, const char **names,
+                         int count, int size, VaccineNameIndex **found);
 UserIndex *findUserByName(UserIndex **userHashTable, const char *user, int size);
 
 VaccineLot *createVaccineLot(const char *batch, const char *name, Date validation, int doses);
@@ -83,10 +222,29 @@ Inoculation *createInoculation(const char *user, const char *lot, Date date);
 
 void addVaccineLotToHash(VaccineLot **hashTable, VaccineLot *lot, int size);
 void addVaccineLotToNameIndex(VaccineNameIndex **nameHashTable, VaccineLot *lot, int size);
-void addInoculationToUserIndex(UserIndex **userHashTable, Inoculation *inoc, int size);
+UserIndex **findUserSlot(UserIndex **userHashTable, const char *userName,
+                         unsigned long long hash, int size);
+UserIndex *insertUserAtSlot(UserIndex **slot, const char *userName);
+const char *userNameText(const UserIndex *user, char *buffer);
+int userHasName(const UserIndex *user, const char *userName);
+int compareUserNames(const UserIndex *a, const UserIndex *b);
+void addInoculationToUser(UserIndex *userEntry, Inoculation *inoc);
+void insertSealedDose(UserIndex *userEntry, int position,
+                      const SealedDose *dose);
+void removeSealedDose(UserIndex *userEntry, int position);
+VaccineNameIndex *findOrCreateVaccineName(VaccineNameIndex **nameHashTable,
+                                          const char *name, int size);
+int vaccineHasLot(const VaccineNameIndex *nameEntry, const char *batch);
+void syncLotHotFields(VaccineLot *lot);
+void removeLotFromName(VaccineNameIndex *nameEntry, int position);
+void restoreLotInName(VaccineNameIndex *nameEntry, VaccineLot *lot,
+                      int position);
 
 void freeVaccineLot(VaccineLot *lot);
 void freeVaccineHashTable(VaccineLot **hashTable, int size);
+void removeVaccineName(VaccineNameIndex **nameHashTable,
+                       VaccineNameIndex *entry, int size);
+void removeUserEntry(UserIndex **userHashTable, UserIndex *entry, int size);
 void freeVaccineNameHashTable(VaccineNameIndex **nameHashTable, int size);
 void freeUserHashTable(UserIndex **userHashTable, int size);
 void freeInoculation(Inoculation *inoc);
@@ -0,0 +1,402 @@
+/**
+ * @file protocol.c
+ * @brief Implementation of the binary request and response protocol.
+ *
+ * The encoder splits a command line into tokens the way the commands do,
+ * keeping quoted text together, and stores every token in the most compact
+ * field that gives the same text back: numbers without leading zeros as
+ * 32-bit integers, DD-MM-YYYY dates packed, and anything else as it is. The
+ * decoder keeps every field typed and joins their text with single spaces.
+ * Compact answers are built as frames by the JSON writer with the same field
+ * appenders; JSON text answers are held by the JSON writer in one buffer
+ * that is emptied after every request.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "protocol.h"
+#include "alloc.h"
+#include "charclass.h"
+#include "columns.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Stores an unsigned integer, least significant byte first.
+ *
+ * @param bytes Where to store the integer.
+ * @param value The integer.
+ * @param size The number of bytes to store.
+ */
+static void putInteger(unsigned char *bytes, unsigned long value, int size) {
+  for (int i = 0; i < size; i++)
+    bytes[i] = (unsigned char)(value >> (8 * i));
+}
+
+/**
+ * @brief Loads an unsigned integer stored by putInteger.
+ *
+ * @param bytes The stored integer.
+ * @param size The number of bytes stored.
+ * @return unsigned long The integer.
+ */
+static unsigned long getInteger(const unsigned char *bytes, int size) {
+  unsigned long value = 0;
+  for (int i = size - 1; i >= 0; i--)
+    value = value << 8 | bytes[i];
+  return value;
+}
+
+/**
+ * @brief Reads a run of digits as a number.
+ *
+ * @param text The digits.
+ * @param length The number of digits.
+ * @return long The number, or -1 if a byte is not a digit.
+ */
+static long readDigits(const char *text, size_t length) {
+  long value = 0;
+  for (size_t i = 0; i < length; i++) {
+    if (text[i] < '0' || text[i] > '9')
+      return -1;
+    value = value * 10 + (text[i] - '0');
+  }
+  return value;
+}
+
+/**
+ * @brief Chooses the field that stores a token.
+ *
+ * @param token The token.
+ * @param length The number of bytes of the token.
+ * @param value Pointer to store the number or packed date.
+ * @return char The field's type.
+ */
+static char classifyToken(const char *token, size_t length,
+                          unsigned long *value) {
+  if (length == 10 && token[2] == '-' && token[5] == '-') {
+    long day = readDigits(token, 2), month = readDigits(token + 3, 2);
+    long year = readDigits(token + 6, 4);
+    if (day >= 1 && day <= 31 && month >= 1 && month <= 12 && year >= 0) {
+      *value = packDate((int)day, (int)month, (int)year);
+      return FRAME_DATE;
+    }
+  }
+  // Up to 9 digits always fit, and leading zeros would be lost
+  if (length >= 1 && length <= 9 && (token[0] != '0' || length == 1)) {
+    long number = readDigits(token, length);
+    if (number >= 0) {
+      *value = (unsigned long)number;
+      return FRAME_NUMBER;
+    }
+  }
+  return FRAME_TEXT;
+}
+
+/**
+ * @brief Finds the end of a token, keeping quoted text together.
+ *
+ * @param token The token.
+ * @return const char* Pointer to the whitespace or terminator after it.
+ */
+static const char *findTokenEnd(const char *token) {
+  const unsigned char *classes = charClasses();
+  int quoted = 0;
+  for (; *token != '\0'; token++) {
+    if (*token == '"')
+      quoted = !quoted;
+    else if (!quoted && (classes[(unsigned char)*token] & CHAR_SPACE))
+      break;
+  }
+  return token;
+}
+
+/**
+ * @brief Appends a text field to a frame, going on in further text fields
+ * past MAX_TEXT_FIELD bytes.
+ *
+ * @param frame The frame being encoded.
+ * @param text The text.
+ * @param length The number of bytes of the text.
+ */
+void appendTextField(TextBuffer *frame, const char *text, size_t length) {
+  do {
+    size_t part = length < MAX_TEXT_FIELD ? length : MAX_TEXT_FIELD;
+    unsigned char *field =
+        (unsigned char *)reserveText(frame, TEXT_FIELD_SIZE + part);
+    field[0] = FRAME_TEXT;
+    putInteger(field + 1, part, TEXT_FIELD_SIZE - 1);
+    memcpy(field + TEXT_FIELD_SIZE, text, part);
+    frame->length += TEXT_FIELD_SIZE + part;
+    text += part;
+    length -= part;
+  } while (length > 0);
+}
+
+/**
+ * @brief Appends a number or date field to a frame.
+ *
+ * @param frame The frame being encoded.
+ * @param type FRAME_NUMBER or FRAME_DATE.
+ * @param value The number, as its 32 low bits, or the packed date.
+ */
+void appendValueField(TextBuffer *frame, char type, unsigned long value) {
+  unsigned char *field =
+      (unsigned char *)reserveText(frame, VALUE_FIELD_SIZE);
+  field[0] = (unsigned char)type;
+  putInteger(field + 1, value, VALUE_FIELD_SIZE - 1);
+  frame->length += VALUE_FIELD_SIZE;
+}
+
+/**
+ * @brief Appends a token to a request frame.
+ *
+ * @param frame The frame being encoded.
+ * @param token The token.
+ * @param length The number of bytes of the token.
+ */
+static void appendField(TextBuffer *frame, const char *token, size_t length) {
+  unsigned long value = 0;
+  char type = classifyToken(token, length, &value);
+  if (type == FRAME_TEXT)
+    appendTextField(frame, token, length);
+  else
+    appendValueField(frame, type, value);
+}
+
+/**
+ * @brief Encodes a text command line as a request frame.
+ *
+ * @param line The command line, without the newline.
+ * @param frame The buffer to store the frame, emptied first.
+ * @return int 1 if a frame was encoded, 0 if the line is empty.
+ */
+int encodeCommandFrame(const char *line, TextBuffer *frame) {
+  if (*line == '\0')
+    return 0;
+  frame->length = 0;
+  reserveText(frame, FRAME_HEADER_SIZE);
+  frame->length = FRAME_HEADER_SIZE;
+  int fields = 0;
+  const char *token = skipSpaces(line + 1);
+  while (*token != '\0') {
+    // The last field takes the rest of the line as it is
+    const char *end = fields == MAX_FRAME_FIELDS - 1
+                          ? token + strlen(token)
+                          : findTokenEnd(token);
+    appendField(frame, token, (size_t)(end - token));
+    fields++;
+    token = skipSpaces(end);
+  }
+  unsigned char *header = (unsigned char *)frame->data;
+  header[0] = (unsigned char)line[0];
+  header[1] = (unsigned char)fields;
+  putInteger(header + 2, frame->length - FRAME_HEADER_SIZE, 4);
+  return 1;
+}
+
+/**
+ * @brief Initializes a binary connection.
+ *
+ * @param channel The connection.
+ */
+void initializeFrameChannel(FrameChannel *channel) {
+  channel->fields = NULL;
+  channel->capacity = 0;
+  channel->request.count = 0;
+  initializeTextBuffer(&channel->answer);
+}
+
+/**
+ * @brief Writes a number in decimal.
+ *
+ * @param value The number.
+ * @param out Where to write it, with room for 10 digits.
+ * @return int The number of digits written.
+ */
+static int formatNumber(unsigned long value, char *out) {
+  char digits[10];
+  int count = 0;
+  do {
+    digits[count++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value > 0 && count < 10);
+  for (int i = 0; i < count; i++)
+    out[i] = digits[count - 1 - i];
+  return count;
+}
+
+/**
+ * @brief Writes a packed date as DD-MM-YYYY.
+ *
+ * @param packed The packed date.
+ * @param out Where to write it, with room for 10 characters.
+ * @return int The number of characters written.
+ */
+static int formatDate(unsigned long packed, char *out) {
+  int day, month, year;
+  unpackDate((unsigned int)packed, &day, &month, &year);
+  const int parts[3] = {day, month, year};
+  char *next = out;
+  for (int i = 0; i < 3; i++) {
+    if (i == 2) {
+      *next++ = (char)('0' + parts[i] / 1000 % 10);
+      *next++ = (char)('0' + parts[i] / 100 % 10);
+    }
+    *next++ = (char)('0' + parts[i] / 10 % 10);
+    *next++ = (char)('0' + parts[i] % 10);
+    if (i < 2)
+      *next++ = '-';
+  }
+  return (int)(next - out);
+}
+
+/**
+ * @brief Decodes one field of a request frame as text, keeping it typed.
+ *
+ * @param next Pointer to the field, moved past it.
+ * @param end The end of the fields.
+ * @param decoded The typed field, whose text is where to write the text.
+ * @param room The bytes left at the text, counting the terminator.
+ * @return int The number of bytes written, or -1 if the field is malformed.
+ */
+static int decodeField(const unsigned char **next, const unsigned char *end,
+                       FrameField *decoded, size_t room) {
+  const unsigned char *field = *next;
+  int size = field < end && *field == FRAME_TEXT ? TEXT_FIELD_SIZE
+                                                 : VALUE_FIELD_SIZE;
+  if (end - field < size)
+    return -1;
+  unsigned long value = getInteger(field + 1, size - 1);
+  *next = field + size;
+  decoded->type = (char)field[0];
+  decoded->value = value;
+  if (field[0] == FRAME_TEXT) {
+    if (value > (unsigned long)(end - *next) || value >= room)
+      return -1;
+    memcpy(decoded->text, *next, value);
+    *next += value;
+    return (int)value;
+  }
+  if (room <= 10)
+    return -1;
+  if (field[0] == FRAME_NUMBER)
+    return formatNumber(value, decoded->text);
+  if (field[0] == FRAME_DATE)
+    return formatDate(value, decoded->text);
+  return -1;
+}
+
+/**
+ * @brief Reads the fields of a request frame into the connection's buffer.
+ *
+ * @param channel The connection.
+ * @param in The stream to read from.
+ * @param length The number of bytes of the fields.
+ * @return int 1 if the fields were read, 0 otherwise.
+ */
+static int readFrameFields(FrameChannel *channel, FILE *in,
+                           unsigned long length) {
+  if (length > channel->capacity) {
+    channel->fields =
+        (unsigned char *)reallocateOrExit(channel->fields, length);
+    channel->capacity = length;
+  }
+  return fread(channel->fields, 1, length, in) == length;
+}
+
+/**
+ * @brief Reads a request frame, keeping its typed fields in the connection
+ * and decoding it into a text command line.
+ *
+ * @param channel The connection.
+ * @param in The stream to read from.
+ * @param command The buffer to store the command line.
+ * @param size The size of the command buffer.
+ * @return int 1 if a command was decoded, 0 at the end of the stream or on a
+ * malformed frame.
+ */
+int readCommandFrame(FrameChannel *channel, FILE *in, char *command,
+                     size_t size) {
+  unsigned char header[FRAME_HEADER_SIZE];
+  if (fread(header, 1, FRAME_HEADER_SIZE, in) != FRAME_HEADER_SIZE)
+    return 0;
+  // Every field decodes into at least a space, so longer fields cannot fit
+  unsigned long length = getInteger(header + 2, 4);
+  if (length > (unsigned long)size * VALUE_FIELD_SIZE ||
+      !readFrameFields(channel, in, length))
+    return 0;
+  const unsigned char *next = channel->fields;
+  const unsigned char *end = next + length;
+  FrameRequest *request = &channel->request;
+  size_t used = 1;
+  command[0] = (char)header[0];
+  for (request->count = 0; request->count < header[1]; request->count++) {
+    if (used + 1 >= size)
+      return 0;
+    command[used++] = ' ';
+    FrameField *field = &request->fields[request->count];
+    field->text = command + used;
+    int written = decodeField(&next, end, field, size - used);
+    if (written < 0)
+      return 0;
+    field->length = (size_t)written;
+    used += (size_t)written;
+  }
+  command[used] = '\0';
+  return 1;
+}
+
+/**
+ * @brief Starts a response frame in a buffer.
+ *
+ * @param frame The buffer to store the frame, emptied first.
+ * @param opcode The request's opcode.
+ * @param ok 1 if the command succeeded, 0 otherwise.
+ */
+void beginResponseFrame(TextBuffer *frame, char opcode, int ok) {
+  frame->length = 0;
+  unsigned char *header =
+      (unsigned char *)reserveText(frame, RESPONSE_HEADER_SIZE + 1);
+  header[0] = (unsigned char)opcode;
+  header[RESPONSE_HEADER_SIZE] = (unsigned char)ok;
+  frame->length = RESPONSE_HEADER_SIZE + 1;
+}
+
+/**
+ * @brief Finishes a response frame by storing the length of its answer.
+ *
+ * @param frame The frame.
+ */
+void endResponseFrame(TextBuffer *frame) {
+  putInteger((unsigned char *)frame->data + 1,
+             frame->length - RESPONSE_HEADER_SIZE, 4);
+}
+
+/**
+ * @brief Writes the answer held for a request as a response frame.
+ *
+ * @param channel The connection.
+ * @param opcode The request's opcode.
+ * @param out The stream to write the response frame to.
+ */
+void endFrameAnswer(FrameChannel *channel, char opcode, FILE *out) {
+  unsigned char header[RESPONSE_HEADER_SIZE];
+  header[0] = (unsigned char)opcode;
+  putInteger(header + 1, channel->answer.length, 4);
+  fwrite(header, 1, RESPONSE_HEADER_SIZE, out);
+  fwrite(channel->answer.data, 1, channel->answer.length, out);
+  channel->answer.length = 0;
+}
+
+/**
+ * @brief Frees the memory used by a binary connection.
+ *
+ * @param channel The connection.
+ */
+void freeFrameChannel(FrameChannel *channel) {
+  freeTextBuffer(&channel->answer);
+  free(channel->fields);
+  channel->fields = NULL;
+}
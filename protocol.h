@@ -0,0 +1,147 @@
+/**
+ * @file protocol.h
+ * @brief Header file for the binary request and response protocol.
+ *
+ * This file contains the declarations of the length-prefixed binary frames
+ * the engine can read instead of text lines. A request frame holds the
+ * command's opcode and its arguments as typed fields, with dates packed and
+ * numbers as fixed-width integers; a response frame holds the opcode and the
+ * answer's length and bytes. The fields of a request are kept typed, so the
+ * commands with typed entry points take them without parsing any text, and
+ * are decoded into a command line for the others. Answers are the compact
+ * fields of the JSON writer, or JSON text with the JSON output mode on.
+ *
+ * Request frame, integers little-endian:
+ *   u8 opcode, u8 field count, u32 length of the fields, then every field as
+ *   u8 type and either u32 value ('n' number, 'd' packed date) or u16 length
+ *   and the bytes ('s' text).
+ * Response frame:
+ *   u8 opcode, u32 length of the answer, then the answer: u8 1 if the command
+ *   succeeded or 0 with the error code and subject, then the fields as in a
+ *   request, with numbers signed and keys left out, and '[', ']', '{' and '}'
+ *   bytes around arrays and objects. A text longer than 65535 bytes goes on
+ *   in the next text field.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include "cache.h"
+#include <stdio.h>
+
+#define FRAME_HEADER_SIZE 6    // Bytes before the fields of a request
+#define RESPONSE_HEADER_SIZE 5 // Bytes before the answer of a response
+#define VALUE_FIELD_SIZE 5     // Bytes of a number or date field
+#define TEXT_FIELD_SIZE 3      // Bytes of a text field before its text
+#define MAX_TEXT_FIELD 0xffff  // Bytes of text a text field holds
+#define MAX_FRAME_FIELDS 255   // Fields in a request, the last holds the rest
+#define FRAME_NUMBER 'n'       // Number without leading zeros
+#define FRAME_DATE 'd'         // DD-MM-YYYY date, packed
+#define FRAME_TEXT 's'         // Any other token, as it is
+
+// Structure for a field of a request
+typedef struct {
+  char type;           // FRAME_NUMBER, FRAME_DATE or FRAME_TEXT
+  unsigned long value; // The number or packed date
+  char *text;          // The field as text, inside the decoded command line
+  size_t length;       // Number of bytes of the text
+} FrameField;
+
+// Structure for the typed fields of a request
+typedef struct {
+  FrameField fields[MAX_FRAME_FIELDS]; // Fields in the order sent
+  int count;                           // Number of fields
+} FrameRequest;
+
+// Structure for a connection speaking the binary protocol
+typedef struct {
+  unsigned char *fields; // Fields of the request being read
+  size_t capacity;       // Current capacity of fields
+  FrameRequest request;  // Typed fields of the request read last
+  TextBuffer answer;     // JSON text answering the request being run
+} FrameChannel;
+
+/**
+ * @brief Appends a text field to a frame, going on in further text fields
+ * past MAX_TEXT_FIELD bytes.
+ *
+ * @param frame The frame being encoded.
+ * @param text The text.
+ * @param length The number of bytes of the text.
+ */
+void appendTextField(TextBuffer *frame, const char *text, size_t length);
+
+/**
+ * @brief Appends a number or date field to a frame.
+ *
+ * @param frame The frame being encoded.
+ * @param type FRAME_NUMBER or FRAME_DATE.
+ * @param value The number, as its 32 low bits, or the packed date.
+ */
+void appendValueField(TextBuffer *frame, char type, unsigned long value);
+
+/**
+ * @brief Starts a response frame in a buffer.
+ *
+ * @param frame The buffer to store the frame, emptied first.
+ * @param opcode The request's opcode.
+ * @param ok 1 if the command succeeded, 0 otherwise.
+ */
+void beginResponseFrame(TextBuffer *frame, char opcode, int ok);
+
+/**
+ * @brief Finishes a response frame by storing the length of its answer.
+ *
+ * @param frame The frame.
+ */
+void endResponseFrame(TextBuffer *frame);
+
+/**
+ * @brief Encodes a text command line as a request frame.
+ *
+ * @param line The command line, without the newline.
+ * @param frame The buffer to store the frame, emptied first.
+ * @return int 1 if a frame was encoded, 0 if the line is empty.
+ */
+int encodeCommandFrame(const char *line, TextBuffer *frame);
+
+/**
+ * @brief Initializes a binary connection.
+ *
+ * @param channel The connection.
+ */
+void initializeFrameChannel(FrameChannel *channel);
+
+/**
+ * @brief Reads a request frame, keeping its typed fields in the connection
+ * and decoding it into a text command line.
+ *
+ * @param channel The connection.
+ * @param in The stream to read from.
+ * @param command The buffer to store the command line.
+ * @param size The size of the command buffer.
+ * @return int 1 if a command was decoded, 0 at the end of the stream or on a
+ * malformed frame.
+ */
+int readCommandFrame(FrameChannel *channel, FILE *in, char *command,
+                     size_t size);
+
+/**
+ * @brief Writes the answer held for a request as a response frame.
+ *
+ * @param channel The connection.
+ * @param opcode The request's opcode.
+ * @param out The stream to write the response frame to.
+ */
+void endFrameAnswer(FrameChannel *channel, char opcode, FILE *out);
+
+/**
+ * @brief Frees the memory used by a binary connection.
+ *
+ * @param channel The connection.
+ */
+void freeFrameChannel(FrameChannel *channel);
+
+#endif
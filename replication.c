@@ -0,0 +1,353 @@
+/**
+ * @file replication.c
+ * @brief Implementation of log-shipping replication.
+ *
+ * This file contains the implementation of the replication log. Each record
+ * is one line, `<lsn> <command>`, flushed as soon as it is written so a
+ * replica sees it on its next command. A primary holds the commands of open
+ * branches, cuts them back when a branch is dropped and ships the rest with
+ * a single flush once the outermost branch is committed, so only kept changes
+ * get an LSN and the branch commands themselves are never shipped. Replaying
+ * the same commands in the same order rebuilds the same state, errors
+ * included, so only the command text is shipped. A replica accepts a record
+ * only if its LSN follows the last one received, which skips records seen
+ * before and stops at a gap, noting the gap so it can be reported.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "replication.h"
+#include "alloc.h"
+#include "charclass.h"
+#include "constants.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RECORD_SIZE (SIZE_COMMAND + 32)
+
+/**
+ * @brief Initializes a standalone replication state.
+ *
+ * @param replication The replication state.
+ */
+void initializeReplication(Replication *replication) {
+  replication->role = ROLE_STANDALONE;
+  replication->log = NULL;
+  replication->lsn = 0;
+  replication->receivedLsn = 0;
+  replication->gap = 0;
+  replication->path = NULL;
+  replication->pathLsn = 0;
+  replication->partial = NULL;
+  replication->partialLength = 0;
+  replication->pending = NULL;
+  replication->pendingCount = 0;
+  replication->pendingCapacity = 0;
+  replication->held = NULL;
+  replication->heldCount = 0;
+  replication->heldCapacity = 0;
+  replication->marks = NULL;
+  replication->markCount = 0;
+  replication->markCapacity = 0;
+}
+
+/**
+ * @brief Checks if a command is shipped to replicas.
+ *
+ * A `t` without a date only shows the current date, so it is a read.
+ *
+ * @param cmd The command character.
+ * @param args The command arguments.
+ * @return int 1 if the command is shipped to replicas, 0 otherwise.
+ */
+int isReplicatedCommand(char cmd, const char *args) {
+  if (cmd == 't')
+    return *skipSpaces(args) != '\0';
+  return cmd != '\0' && strchr(REPLICATED_COMMANDS, cmd) != NULL;
+}
+
+/**
+ * @brief Checks if a command can change the system.
+ *
+ * @param cmd The command character.
+ * @param args The command arguments.
+ * @return int 1 if a replica must refuse the command, 0 otherwise.
+ */
+int isChangingCommand(char cmd, const char *args) {
+  return isReplicatedCommand(cmd, args) ||
+         (cmd != '\0' && strchr(BRANCH_COMMANDS, cmd) != NULL);
+}
+
+/**
+ * @brief Checks if the system can start a role with a log.
+ *
+ * An empty system can start with any log. Once changed, it can only go on
+ * with the log a promoted replica replayed, if it has not changed since; any
+ * other log would start past LSN 1, so a new replica of it would never apply
+ * a record.
+ *
+ * @param replication The replication state.
+ * @param path The path of the log file.
+ * @return int 1 if the log holds every change made so far, 0 otherwise.
+ */
+int continuesLog(const Replication *replication, const char *path) {
+  if (replication->lsn == 0)
+    return 1;
+  return replication->path != NULL &&
+         replication->pathLsn == replication->lsn &&
+         strcmp(replication->path, path) == 0;
+}
+
+
+/**
+ * @brief Starts shipping changes to a log file, appending to it.
+ *
+ * Numbering carries on from the changes already executed, so a promoted
+ * replica can keep writing to the log it was reading.
+ *
+ * @param replication The replication state.
+ * @param path The path of the log file.
+ * @return int 1 on success, 0 if the file cannot be opened.
+ */
+int startPrimary(Replication *replication, const char *path) {
+  replication->log = fopen(path, "a");
+  if (replication->log == NULL)
+    return 0;
+  replication->role = ROLE_PRIMARY;
+  return 1;
+}
+
+/**
+ * @brief Starts replaying the changes shipped to a log file.
+ *
+ * @param replication The replication state.
+ * @param path The path of the log file.
+ * @return int 1 on success, 0 if the file cannot be opened.
+ */
+int startReplica(Replication *replication, const char *path) {
+  replication->log = fopen(path, "r");
+  if (replication->log == NULL)
+    return 0;
+  replication->partial = (char *)allocateOrExit(RECORD_SIZE);
+  replication->partialLength = 0;
+  replication->receivedLsn = replication->lsn;
+  replication->gap = 0;
+  free(replication->path);
+  replication->path = duplicateOrExit(path);
+  replication->role = ROLE_REPLICA;
+  return 1;
+}
+
+/**
+ * @brief Adds a command to an array of commands.
+ *
+ * @param commands Pointer to the array of commands.
+ * @param count Pointer to the number of commands.
+ * @param capacity Pointer to the array's capacity.
+ * @param command The command text, copied.
+ */
+static void addCommand(char ***commands, int *count, int *capacity,
+                       char *command) {
+  if (*count == *capacity) {
+    int grown = *capacity > 0 ? *capacity * 2 : 16;
+    *commands =
+        (char **)reallocateOrExit(*commands, (size_t)grown * sizeof(char *));
+    *capacity = grown;
+  }
+  (*commands)[(*count)++] = command;
+}
+
+/**
+ * @brief Frees the commands of an array past a count.
+ *
+ * @param commands The array of commands.
+ * @param count Pointer to the number of commands.
+ * @param kept The number of commands to keep.
+ */
+static void cutCommands(char **commands, int *count, int kept) {
+  while (*count > kept)
+    free(commands[--*count]);
+}
+
+/**
+ * @brief Holds a command of a primary until no branch is open.
+ *
+ * @param replication The replication state.
+ * @param cmd The command character.
+ * @param args The command arguments, as given.
+ */
+static void holdCommand(Replication *replication, char cmd, const char *args) {
+  size_t length = strlen(args);
+  char *command = (char *)allocateOrExit(length + 3);
+  command[0] = cmd;
+  command[1] = length > 0 ? ' ' : '\0';
+  memcpy(command + 2, args, length + 1);
+  addCommand(&replication->held, &replication->heldCount,
+             &replication->heldCapacity, command);
+}
+
+/**
+ * @brief Opens a branch over the held commands.
+ *
+ * @param replication The replication state.
+ */
+static void markBranch(Replication *replication) {
+  if (replication->markCount == replication->markCapacity) {
+    int grown = replication->markCapacity > 0 ? replication->markCapacity * 2
+                                              : 8;
+    replication->marks = (int *)reallocateOrExit(
+        replication->marks, (size_t)grown * sizeof(int));
+    replication->markCapacity = grown;
+  }
+  replication->marks[replication->markCount++] = replication->heldCount;
+}
+
+/**
+ * @brief Writes the held commands to the log with a single flush.
+ *
+ * @param replication The replication state.
+ */
+static void shipHeldCommands(Replication *replication) {
+  if (replication->heldCount == 0)
+    return;
+  for (int i = 0; i < replication->heldCount; i++)
+    fprintf(replication->log, "%lu %s\n", ++replication->lsn,
+            replication->held[i]);
+  fflush(replication->log);
+  cutCommands(replication->held, &replication->heldCount, 0);
+}
+
+/**
+ * @brief Logs a command executed by a primary, shipping the changes held
+ * once no branch is open.
+ *
+ * A branch that is dropped takes its held commands with it, and one that is
+ * committed leaves them to the enclosing branch.
+ *
+ * @param replication The replication state.
+ * @param cmd The command character.
+ * @param args The command arguments, as given, or NULL if it is not shipped.
+ * @param branches The change in the number of open branches.
+ */
+void logCommand(Replication *replication, char cmd, const char *args,
+                int branches) {
+  if (branches > 0) {
+    markBranch(replication);
+  } else if (branches < 0 && replication->markCount > 0) {
+    int mark = replication->marks[--replication->markCount];
+    if (cmd == 'x')
+      cutCommands(replication->held, &replication->heldCount, mark);
+  } else if (args != NULL) {
+    holdCommand(replication, cmd, args);
+  }
+  if (replication->markCount == 0)
+    shipHeldCommands(replication);
+}
+
+/**
+ * @brief Accepts a complete record if it follows the last one received.
+ *
+ * @param replication The replication state.
+ * @param record The record, without its newline.
+ */
+static void acceptRecord(Replication *replication, const char *record) {
+  char *end;
+  unsigned long lsn = strtoul(record, &end, 10);
+  if (end == record || lsn <= replication->receivedLsn)
+    return;
+  if (lsn != replication->receivedLsn + 1) {
+    replication->gap = 1; // Records are missing, so none after them applies
+    return;
+  }
+  addCommand(&replication->pending, &replication->pendingCount,
+             &replication->pendingCapacity, duplicateOrExit(skipSpaces(end)));
+  replication->receivedLsn = lsn;
+}
+
+/**
+ * @brief Reads the complete records added to the log since the last call.
+ *
+ * A record the primary has not finished writing stays in the partial buffer
+ * until the rest of it arrives.
+ *
+ * @param replication The replication state.
+ */
+void receiveRecords(Replication *replication) {
+  char *partial = replication->partial;
+  while (fgets(partial + replication->partialLength,
+               RECORD_SIZE - replication->partialLength, replication->log)) {
+    size_t length = strlen(partial);
+    if (partial[length - 1] == '\n') {
+      partial[length - 1] = '\0';
+      acceptRecord(replication, partial);
+      length = 0;
+    } else if (length == RECORD_SIZE - 1) {
+      length = 0; // Longer than any command, so it cannot be one
+    }
+    replication->partialLength = length;
+  }
+  clearerr(replication->log); // Keep tailing once the primary writes more
+}
+
+/**
+ * @brief Frees the commands a replica has applied.
+ *
+ * @param replication The replication state.
+ */
+void clearPendingRecords(Replication *replication) {
+  cutCommands(replication->pending, &replication->pendingCount, 0);
+}
+
+/**
+ * @brief Closes the files and frees the buffers of the current role.
+ *
+ * @param replication The replication state.
+ */
+static void closeLog(Replication *replication) {
+  if (replication->log != NULL)
+    fclose(replication->log);
+  clearPendingRecords(replication);
+  cutCommands(replication->held, &replication->heldCount, 0);
+  free(replication->pending);
+  free(replication->held);
+  free(replication->marks);
+  free(replication->partial);
+  replication->log = NULL;
+  replication->pending = NULL;
+  replication->pendingCapacity = 0;
+  replication->held = NULL;
+  replication->heldCapacity = 0;
+  replication->marks = NULL;
+  replication->markCount = 0;
+  replication->markCapacity = 0;
+  replication->partial = NULL;
+  replication->partialLength = 0;
+}
+
+/**
+ * @brief Stops a replica from tailing the log so it accepts changes.
+ *
+ * Commands still pending or half written are dropped, as the primary is gone.
+ * The log is still the one holding every change, so the promoted system can
+ * go on writing to it as a primary.
+ *
+ * @param replication The replication state.
+ */
+void promoteReplica(Replication *replication) {
+  closeLog(replication);
+  replication->pathLsn = replication->lsn;
+  replication->role = ROLE_STANDALONE;
+}
+
+/**
+ * @brief Frees the memory and closes the files used by replication.
+ *
+ * @param replication The replication state.
+ */
+void freeReplication(Replication *replication) {
+  closeLog(replication);
+  free(replication->path);
+  replication->path = NULL;
+  replication->role = ROLE_STANDALONE;
+}
@@ -0,0 +1,148 @@
+/**
+ * @file replication.h
+ * @brief Header file for log-shipping replication.
+ *
+ * This file contains the declarations of the replication log. A primary
+ * appends every command that can change the system to a log file, numbered
+ * by a log sequence number (LSN). Changes made in a what-if branch are held
+ * back until the outermost branch is committed, and dropped with it. A
+ * replica tails the same file (a regular file or a FIFO), receives the new
+ * records and replays them before it answers a command, refusing the
+ * commands that would change it.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include <stdio.h>
+
+// Commands that can change the system, shipped by a primary
+#define REPLICATED_COMMANDS "cardtv"
+
+// Commands that open and close what-if branches, which are not shipped
+#define BRANCH_COMMANDS "bxy"
+
+// Roles of the engine in replication
+typedef enum {
+  ROLE_STANDALONE, // Neither ships nor receives a log
+  ROLE_PRIMARY,    // Appends its changes to the log
+  ROLE_REPLICA     // Replays the log and only answers reads
+} ReplicationRole;
+
+// Structure for the replication state
+typedef struct {
+  ReplicationRole role;
+  FILE *log;                 // Log being written or tailed, or NULL
+  unsigned long lsn;         // Changing commands executed or applied
+  unsigned long receivedLsn; // Last record received by a replica
+  int gap;                   // 1 if a replica read a record past the next
+  char *path;                // Log a promoted replica replayed, or NULL
+  unsigned long pathLsn;     // Changes that log held when it was promoted
+  char *partial;             // Record still being read from the log
+  size_t partialLength;      // Characters of the record read so far
+  char **pending;            // Commands received but not applied yet
+  int pendingCount;          // Number of pending commands
+  int pendingCapacity;       // Current capacity of pending
+  char **held;               // Commands of open branches not shipped yet
+  int heldCount;             // Number of held commands
+  int heldCapacity;          // Current capacity of held
+  int *marks;                // Held commands when each open branch began
+  int markCount;             // Number of open branches
+  int markCapacity;          // Current capacity of marks
+} Replication;
+
+/**
+ * @brief Initializes a standalone replication state.
+ *
+ * @param replication The replication state.
+ */
+void initializeReplication(Replication *replication);
+
+/**
+ * @brief Checks if a command is shipped to replicas.
+ *
+ * @param cmd The command character.
+ * @param args The command arguments.
+ * @return int 1 if the command is shipped to replicas, 0 otherwise.
+ */
+int isReplicatedCommand(char cmd, const char *args);
+
+/**
+ * @brief Checks if a command can change the system.
+ *
+ * @param cmd The command character.
+ * @param args The command arguments.
+ * @return int 1 if a replica must refuse the command, 0 otherwise.
+ */
+int isChangingCommand(char cmd, const char *args);
+
+/**
+ * @brief Checks if the system can start a role with a log.
+ *
+ * @param replication The replication state.
+ * @param path The path of the log file.
+ * @return int 1 if the log holds every change made so far, 0 otherwise.
+ */
+int continuesLog(const Replication *replication, const char *path);
+
+/**
+ * @brief Starts shipping changes to a log file, appending to it.
+ *
+ * @param replication The replication state.
+ * @param path The path of the log file.
+ * @return int 1 on success, 0 if the file cannot be opened.
+ */
+int startPrimary(Replication *replication, const char *path);
+
+/**
+ * @brief Starts replaying the changes shipped to a log file.
+ *
+ * @param replication The replication state.
+ * @param path The path of the log file.
+ * @return int 1 on success, 0 if the file cannot be opened.
+ */
+int startReplica(Replication *replication, const char *path);
+
+/**
+ * @brief Logs a command executed by a primary, shipping the changes held
+ * once no branch is open.
+ *
+ * @param replication The replication state.
+ * @param cmd The command character.
+ * @param args The command arguments, as given, or NULL if it is not shipped.
+ * @param branches The change in the number of open branches.
+ */
+void logCommand(Replication *replication, char cmd, const char *args,
+                int branches);
+
+/**
+ * @brief Reads the complete records added to the log since the last call.
+ *
+ * @param replication The replication state.
+ */
+void receiveRecords(Replication *replication);
+
+/**
+ * @brief Frees the commands a replica has applied.
+ *
+ * @param replication The replication state.
+ */
+void clearPendingRecords(Replication *replication);
+
+/**
+ * @brief Stops a replica from tailing the log so it accepts changes.
+ *
+ * @param replication The replication state.
+ */
+void promoteReplica(Replication *replication);
+
+/**
+ * @brief Frees the memory and closes the files used by replication.
+ *
+ * @param replication The replication state.
+ */
+void freeReplication(Replication *replication);
+
+#endif
@@ -0,0 +1,426 @@
+/**
+ * @file series.c
+ * @brief Implementation of multi-dose vaccine series tracking.
+ *
+ * Each user keeps one progress entry per vaccine with a defined series. The
+ * entries of users that have not finished a series are also kept in a
+ * per-vaccine min-heap keyed by the day their next dose is due, so the users
+ * that are due or overdue can be listed without scanning every user.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "series.h"
+#include "alloc.h"
+#include "constants.h"
+#include "project.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Gets the day number on which the next dose of a series is due.
+ *
+ * @param progress The series progress entry.
+ * @return int The due day number.
+ */
+static int dueDay(const SeriesProgress *progress) {
+  return progress->lastDoseDay + progress->vaccine->seriesSpacing;
+}
+
+/**
+ * @brief Swaps two entries of a due heap, keeping their positions updated.
+ *
+ * @param heap The due heap.
+ * @param a Index of the first entry.
+ * @param b Index of the second entry.
+ */
+static void heapSwap(SeriesProgress **heap, int a, int b) {
+  SeriesProgress *temp = heap[a];
+  heap[a] = heap[b];
+  heap[b] = temp;
+  heap[a]->heapPos = a;
+  heap[b]->heapPos = b;
+}
+
+/**
+ * @brief Moves a due heap entry up until its parent is not due later.
+ *
+ * @param vaccine The vaccine owning the heap.
+ * @param pos The position of the entry.
+ */
+static void siftUp(VaccineNameIndex *vaccine, int pos) {
+  SeriesProgress **heap = vaccine->dueHeap;
+  while (pos > 0 && dueDay(heap[(pos - 1) / 2]) > dueDay(heap[pos])) {
+    heapSwap(heap, pos, (pos - 1) / 2);
+    pos = (pos - 1) / 2;
+  }
+}
+
+/**
+ * @brief Moves a due heap entry down until no child is due earlier.
+ *
+ * @param vaccine The vaccine owning the heap.
+ * @param pos The position of the entry.
+ */
+static void siftDown(VaccineNameIndex *vaccine, int pos) {
+  SeriesProgress **heap = vaccine->dueHeap;
+  for (;;) {
+    int smallest = pos;
+    int left = 2 * pos + 1;
+    int right = left + 1;
+    if (left < vaccine->dueCount &&
+        dueDay(heap[left]) < dueDay(heap[smallest]))
+      smallest = left;
+    if (right < vaccine->dueCount &&
+        dueDay(heap[right]) < dueDay(heap[smallest]))
+      smallest = right;
+    if (smallest == pos)
+      return;
+    heapSwap(heap, pos, smallest);
+    pos = smallest;
+  }
+}
+
+/**
+ * @brief Inserts a progress entry into its vaccine's due heap.
+ *
+ * @param progress The series progress entry.
+ */
+static void heapPush(SeriesProgress *progress) {
+  VaccineNameIndex *vaccine = progress->vaccine;
+  if (vaccine->dueCount >= vaccine->dueCapacity) {
+    int newCapacity = vaccine->dueCapacity ? vaccine->dueCapacity * 2 : 4;
+    SeriesProgress **newHeap = (SeriesProgress **)reallocateOrExit(
+        vaccine->dueHeap, newCapacity * sizeof(SeriesProgress *));
+    vaccine->dueHeap = newHeap;
+    vaccine->dueCapacity = newCapacity;
+  }
+  progress->heapPos = vaccine->dueCount;
+  vaccine->dueHeap[vaccine->dueCount++] = progress;
+  siftUp(vaccine, progress->heapPos);
+}
+
+/**
+ * @brief Removes a progress entry from its vaccine's due heap.
+ *
+ * @param progress The series progress entry.
+ */
+static void heapRemove(SeriesProgress *progress) {
+  VaccineNameIndex *vaccine = progress->vaccine;
+  int pos = progress->heapPos;
+  int last = --vaccine->dueCount;
+  if (pos != last) {
+    heapSwap(vaccine->dueHeap, pos, last);
+    siftDown(vaccine, pos);
+    siftUp(vaccine, pos);
+  }
+  progress->heapPos = -1;
+}
+
+/**
+ * @brief Places a progress entry in the due heap only if the series is
+ * unfinished, restoring the heap order after its due day changed.
+ *
+ * @param progress The series progress entry.
+ */
+static void requeueProgress(SeriesProgress *progress) {
+  int unfinished = progress->dosesTaken < progress->vaccine->seriesDoses;
+  if (unfinished && progress->heapPos < 0) {
+    heapPush(progress);
+  } else if (unfinished) {
+    siftUp(progress->vaccine, progress->heapPos);
+    siftDown(progress->vaccine, progress->heapPos);
+  } else if (progress->heapPos >= 0) {
+    heapRemove(progress);
+  }
+}
+
+/**
+ * @brief Finds the index of a user's progress entry for a vaccine.
+ *
+ * @param user The user's index entry.
+ * @param vaccine The vaccine name entry.
+ * @return int The index in the user's series array, or -1 if not found.
+ */
+static int findProgressIndex(const UserIndex *user,
+                             const VaccineNameIndex *vaccine) {
+  for (int i = 0; i < user->seriesCount; i++) {
+    if (user->series[i]->vaccine == vaccine) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief Creates a progress entry for a user and a vaccine.
+ *
+ * @param user The user's index entry.
+ * @param vaccine The vaccine name entry.
+ * @return SeriesProgress* The new entry, with no doses recorded.
+ */
+static SeriesProgress *createProgress(UserIndex *user,
+                                      VaccineNameIndex *vaccine) {
+  SeriesProgress *progress =
+      (SeriesProgress *)allocateOrExit(sizeof(SeriesProgress));
+  SeriesProgress **newSeries = (SeriesProgress **)reallocateOrExit(
+      user->series, (user->seriesCount + 1) * sizeof(SeriesProgress *));
+  progress->user = user;
+  progress->vaccine = vaccine;
+  progress->dosesTaken = 0;
+  progress->lastDoseDay = 0;
+  progress->heapPos = -1;
+  user->series = newSeries;
+  user->series[user->seriesCount++] = progress;
+  return progress;
+}
+
+/**
+ * @brief Removes and frees a user's progress entry.
+ *
+ * @param user The user's index entry.
+ * @param index The index of the entry in the user's series array.
+ */
+static void removeProgress(UserIndex *user, int index) {
+  SeriesProgress *progress = user->series[index];
+  if (progress->heapPos >= 0) {
+    heapRemove(progress);
+  }
+  free(progress);
+  user->series[index] = user->series[--user->seriesCount];
+}
+
+/**
+ * @brief Counts a user's doses of a vaccine and finds the most recent one.
+ *
+ * @param user The user's index entry.
+ * @param vaccine The vaccine name entry.
+ * @param lastDoseDay Pointer to store the day number of the most recent dose.
+ * @return int The number of doses of the vaccine received by the user.
+ */
+static int countVaccineDoses(const UserIndex *user,
+                             const VaccineNameIndex *vaccine,
+                             int *lastDoseDay) {
+  int count = 0;
+  for (int i = 0; i < user->sealedCount; i++) {
+    const SealedDose *dose = &user->sealed[i];
+    if (vaccineHasLot(vaccine, dose->lot->lot)) {
+      Date date;
+      unpackDate(dose->date, &date.day, &date.month, &date.year);
+      *lastDoseDay = dateToDayNumber(date); // Sealed doses are oldest first
+      count++;
+    }
+  }
+  for (int i = 0; i < user->inoculationCount; i++) {
+    Inoculation *inoc = user->inoculations[i];
+    if (vaccineHasLot(vaccine, inoc->lot)) {
+      int day = dateToDayNumber(inoc->date);
+      if (count == 0 || day > *lastDoseDay)
+        *lastDoseDay = day;
+      count++;
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief Defines the dose series of a vaccine and indexes existing doses.
+ *
+ * @param vaccine The vaccine name entry.
+ * @param doses The number of doses in the series.
+ * @param spacing The minimum number of days between doses.
+ * @param userHashTable The hash table of user indices.
+ * @param hashSize The size of the hash table.
+ */
+void defineVaccineSeries(VaccineNameIndex *vaccine, int doses, int spacing,
+                         UserIndex **userHashTable, int hashSize) {
+  vaccine->seriesDoses = doses;
+  vaccine->seriesSpacing = spacing;
+
+  // Index the doses given before the series was defined
+  for (int i = 0; i < USER_TABLE_BUCKETS(hashSize); i++) {
+    for (UserIndex *user = userHashTable[i]; user; user = user->next_hash) {
+      int lastDoseDay = 0;
+      int count = countVaccineDoses(user, vaccine, &lastDoseDay);
+      if (count > 0) {
+        SeriesProgress *progress = createProgress(user, vaccine);
+        progress->dosesTaken = count;
+        progress->lastDoseDay = lastDoseDay;
+        requeueProgress(progress);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Checks if a new dose would break the series' minimum spacing.
+ * Doses past the last one of the series are boosters and never too soon.
+ *
+ * @param user The user's index entry (may be NULL).
+ * @param vaccine The vaccine name entry.
+ * @param today The current day number.
+ * @return int 1 if the dose is too soon, 0 otherwise.
+ */
+int isSeriesDoseTooSoon(UserIndex *user, VaccineNameIndex *vaccine,
+                        int today) {
+  if (user == NULL || vaccine->seriesDoses == 0)
+    return 0;
+  int index = findProgressIndex(user, vaccine);
+  if (index < 0)
+    return 0;
+  const SeriesProgress *progress = user->series[index];
+  return progress->dosesTaken < vaccine->seriesDoses &&
+         today < dueDay(progress);
+}
+
+/**
+ * @brief Records a dose of a vaccine with a series in the user's progress.
+ *
+ * @param user The user's index entry.
+ * @param vaccine The vaccine name entry.
+ * @param today The current day number.
+ */
+void recordSeriesDose(UserIndex *user, VaccineNameIndex *vaccine, int today) {
+  if (vaccine->seriesDoses == 0)
+    return;
+  int index = findProgressIndex(user, vaccine);
+  SeriesProgress *progress =
+      index >= 0 ? user->series[index] : createProgress(user, vaccine);
+  progress->dosesTaken++;
+  progress->lastDoseDay = today;
+  requeueProgress(progress);
+}
+
+/**
+ * @brief Recomputes a user's series progress after inoculations are deleted.
+ *
+ * @param user The user's index entry.
+ */
+void refreshUserSeries(UserIndex *user) {
+  for (int i = user->seriesCount - 1; i >= 0; i--) {
+    SeriesProgress *progress = user->series[i];
+    int lastDoseDay = 0;
+    int count = countVaccineDoses(user, progress->vaccine, &lastDoseDay);
+    if (count == 0) {
+      removeProgress(user, i);
+    } else {
+      progress->dosesTaken = count;
+      progress->lastDoseDay = lastDoseDay;
+      requeueProgress(progress);
+    }
+  }
+}
+
+/**
+ * @brief Recomputes a user's progress in one vaccine's series from the user's
+ * inoculations, creating or removing the entry as needed.
+ *
+ * @param user The user's index entry.
+ * @param vaccine The vaccine name entry.
+ */
+void syncUserSeries(UserIndex *user, VaccineNameIndex *vaccine) {
+  if (vaccine->seriesDoses == 0)
+    return;
+  int index = findProgressIndex(user, vaccine);
+  int lastDoseDay = 0;
+  int count = countVaccineDoses(user, vaccine, &lastDoseDay);
+  if (count == 0) {
+    if (index >= 0)
+      removeProgress(user, index);
+    return;
+  }
+  SeriesProgress *progress =
+      index >= 0 ? user->series[index] : createProgress(user, vaccine);
+  progress->dosesTaken = count;
+  progress->lastDoseDay = lastDoseDay;
+  requeueProgress(progress);
+}
+
+/**
+ * @brief Removes the dose series of a vaccine and every progress entry in it.
+ *
+ * @param vaccine The vaccine name entry.
+ * @param userHashTable The hash table of user indices.
+ * @param hashSize The size of the hash table.
+ */
+void clearVaccineSeries(VaccineNameIndex *vaccine, UserIndex **userHashTable,
+                        int hashSize) {
+  for (int i = 0; i < USER_TABLE_BUCKETS(hashSize); i++) {
+    for (UserIndex *user = userHashTable[i]; user; user = user->next_hash) {
+      int index = findProgressIndex(user, vaccine);
+      if (index >= 0)
+        removeProgress(user, index);
+    }
+  }
+  vaccine->seriesDoses = 0;
+  vaccine->seriesSpacing = 0;
+}
+
+/**
+ * @brief Compares two progress entries by due day and then by user name.
+ *
+ * @param a The first entry.
+ * @param b The second entry.
+ * @return int Negative if a < b, zero if equal, positive if a > b.
+ */
+static int compareDue(const void *a, const void *b) {
+  const SeriesProgress *left = (const SeriesProgress *)a;
+  const SeriesProgress *right = (const SeriesProgress *)b;
+  if (dueDay(left) != dueDay(right))
+    return dueDay(left) - dueDay(right);
+  return compareUserNames(left->user, right->user);
+}
+
+/**
+ * @brief Collects the heap entries due by a day, skipping subtrees whose root
+ * is due later.
+ *
+ * @param vaccine The vaccine owning the heap.
+ * @param pos The position of the subtree root.
+ * @param today The current day number.
+ * @param out Array to store the collected entries.
+ * @param count Pointer to the number of collected entries.
+ */
+static void collectDueFrom(VaccineNameIndex *vaccine, int pos, int today,
+                           SeriesProgress **out, int *count) {
+  if (pos >= vaccine->dueCount || dueDay(vaccine->dueHeap[pos]) > today)
+    return;
+  out[(*count)++] = vaccine->dueHeap[pos];
+  collectDueFrom(vaccine, 2 * pos + 1, today, out, count);
+  collectDueFrom(vaccine, 2 * pos + 2, today, out, count);
+}
+
+/**
+ * @brief Collects the unfinished series whose next dose is due by a day.
+ *
+ * @param vaccine The vaccine name entry.
+ * @param today The current day number.
+ * @param count Pointer to store the number of collected entries.
+ * @param scratch The per-command scratch arena for the array.
+ * @return SeriesProgress** Array of entries sorted by due day and user name,
+ * or NULL if there are none.
+ */
+SeriesProgress **collectDueSeries(VaccineNameIndex *vaccine, int today,
+                                  int *count, ScratchArena *scratch) {
+  *count = 0;
+  if (vaccine->dueCount == 0)
+    return NULL;
+  SeriesProgress **due = (SeriesProgress **)arenaAlloc(
+      scratch, vaccine->dueCount * sizeof(SeriesProgress *));
+  collectDueFrom(vaccine, 0, today, due, count);
+  sortPointers((void **)due, *count, compareDue, scratch);
+  return due;
+}
+
+/**
+ * @brief Frees all series progress entries owned by a user.
+ *
+ * @param user The user's index entry.
+ */
+void freeUserSeries(UserIndex *user) {
+  for (int i = 0; i < user->seriesCount; i++) {
+    free(user->series[i]);
+  }
+  free(user->series);
+}
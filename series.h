@@ -0,0 +1,95 @@
+/**
+ * @file series.h
+ * @brief Header file for multi-dose vaccine series tracking.
+ *
+ * This file contains the declarations of the functions that keep each user's
+ * progress through a vaccine's dose series and the per-vaccine index of users
+ * ordered by the day their next dose is due.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef SERIES_H
+#define SERIES_H
+
+#include "project.h"
+
+/**
+ * @brief Defines the dose series of a vaccine and indexes existing doses.
+ *
+ * @param vaccine The vaccine name entry.
+ * @param doses The number of doses in the series.
+ * @param spacing The minimum number of days between doses.
+ * @param userHashTable The hash table of user indices.
+ * @param hashSize The size of the hash table.
+ */
+void defineVaccineSeries(VaccineNameIndex *vaccine, int doses, int spacing,
+                         UserIndex **userHashTable, int hashSize);
+
+/**
+ * @brief Checks if a new dose would break the series' minimum spacing.
+ * Doses past the last one of the series are boosters and never too soon.
+ *
+ * @param user The user's index entry (may be NULL).
+ * @param vaccine The vaccine name entry.
+ * @param today The current day number.
+ * @return int 1 if the dose is too soon, 0 otherwise.
+ */
+int isSeriesDoseTooSoon(UserIndex *user, VaccineNameIndex *vaccine, int today);
+
+/**
+ * @brief Records a dose of a vaccine with a series in the user's progress.
+ *
+ * @param user The user's index entry.
+ * @param vaccine The vaccine name entry.
+ * @param today The current day number.
+ */
+void recordSeriesDose(UserIndex *user, VaccineNameIndex *vaccine, int today);
+
+/**
+ * @brief Recomputes a user's series progress after inoculations are deleted.
+ *
+ * @param user The user's index entry.
+ */
+void refreshUserSeries(UserIndex *user);
+
+/**
+ * @brief Recomputes a user's progress in one vaccine's series from the user's
+ * inoculations, creating or removing the entry as needed.
+ *
+ * @param user The user's index entry.
+ * @param vaccine The vaccine name entry.
+ */
+void syncUserSeries(UserIndex *user, VaccineNameIndex *vaccine);
+
+/**
+ * @brief Removes the dose series of a vaccine and every progress entry in it.
+ *
+ * @param vaccine The vaccine name entry.
+ * @param userHashTable The hash table of user indices.
+ * @param hashSize The size of the hash table.
+ */
+void clearVaccineSeries(VaccineNameIndex *vaccine, UserIndex **userHashTable,
+                        int hashSize);
+
+/**
+ * @brief Collects the unfinished series whose next dose is due by a day.
+ *
+ * @param vaccine The vaccine name entry.
+ * @param today The current day number.
+ * @param count Pointer to store the number of collected entries.
+ * @param scratch The per-command scratch arena for the array.
+ * @return SeriesProgress** Array of entries sorted by due day and user name,
+ * or NULL if there are none.
+ */
+SeriesProgress **collectDueSeries(VaccineNameIndex *vaccine, int today,
+                                  int *count, ScratchArena *scratch);
+
+/**
+ * @brief Frees all series progress entries owned by a user.
+ *
+ * @param user The user's index entry.
+ */
+void freeUserSeries(UserIndex *user);
+
+#endif
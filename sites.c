@@ -0,0 +1,246 @@
+/**
+ * @file sites.c
+ * @brief Implementation of the multi-site inventory.
+ *
+ * A vaccine's shelves are an array indexed by site id, so finding the shelf
+ * of a site is one array access. Lots are appended to a shelf and the last
+ * lot fills the hole left by a removal, as in the name entry; the order of a
+ * shelf does not matter, since picks break expiry ties by batch. The doses
+ * available, overall and per expiry day, are adjusted by the change of each
+ * lot's remaining doses.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "sites.h"
+#include "alloc.h"
+#include "charclass.h"
+#include "project.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Initializes a vaccine's stock with no sites.
+ *
+ * @param stock The vaccine's stock.
+ */
+void initializeSiteStock(SiteStock *stock) {
+  stock->shelves = NULL;
+  stock->siteCount = 0;
+  stock->available = 0;
+  initializeExpiryCalendar(&stock->expiries);
+}
+
+/**
+ * @brief Finds the shelf of a site.
+ *
+ * @param stock The vaccine's stock.
+ * @param site The site id.
+ * @return const SiteShelf* The shelf, or NULL if the site has no lots of the
+ * vaccine.
+ */
+const SiteShelf *findSiteShelf(const SiteStock *stock, int site) {
+  return site < stock->siteCount ? stock->shelves[site] : NULL;
+}
+
+/**
+ * @brief Grows the shelf array to cover a site id.
+ *
+ * @param stock The vaccine's stock.
+ * @param site The site id.
+ */
+static void coverSite(SiteStock *stock, int site) {
+  SiteShelf **grown = (SiteShelf **)reallocateOrExit(
+      stock->shelves, (size_t)(site + 1) * sizeof(SiteShelf *));
+  for (int i = stock->siteCount; i <= site; i++)
+    grown[i] = NULL;
+  stock->shelves = grown;
+  stock->siteCount = site + 1;
+}
+
+/**
+ * @brief Makes room for one more lot on a shelf, creating it if needed.
+ *
+ * @param stock The vaccine's stock.
+ * @param site The site id.
+ * @return SiteShelf* The shelf.
+ */
+static SiteShelf *reserveShelfSlot(SiteStock *stock, int site) {
+  if (site >= stock->siteCount)
+    coverSite(stock, site);
+  SiteShelf *shelf = stock->shelves[site];
+  if (shelf == NULL) {
+    shelf = (SiteShelf *)zeroAllocateOrExit(1, sizeof(SiteShelf));
+    stock->shelves[site] = shelf;
+  }
+  if (shelf->lotCount == shelf->capacity) {
+    int capacity = shelf->capacity ? 2 * shelf->capacity : 4;
+    VaccineLot **lots = (VaccineLot **)reallocateOrExit(
+        shelf->lots, (size_t)capacity * sizeof(VaccineLot *));
+    int *expiry = (int *)reallocateOrExit(shelf->lotExpiry,
+                                          (size_t)capacity * sizeof(int));
+    int *remaining = (int *)reallocateOrExit(shelf->lotRemaining,
+                                             (size_t)capacity * sizeof(int));
+    shelf->lots = lots;
+    shelf->lotExpiry = expiry;
+    shelf->lotRemaining = remaining;
+    shelf->capacity = capacity;
+  }
+  return shelf;
+}
+
+/**
+ * @brief Puts a lot on the shelf of its site, with no doses counted yet.
+ *
+ * @param stock The vaccine's stock.
+ * @param lot The vaccine lot.
+ */
+void addLotToSite(SiteStock *stock, VaccineLot *lot) {
+  SiteShelf *shelf = reserveShelfSlot(stock, lot->site);
+  int slot = shelf->lotCount++;
+  shelf->lots[slot] = lot;
+  shelf->lotExpiry[slot] = dateToDayNumber(lot->validation);
+  shelf->lotRemaining[slot] = 0;
+  lot->siteSlot = slot;
+}
+
+/**
+ * @brief Takes a lot off the shelf of its site, moving the shelf's last lot
+ * into its place.
+ *
+ * @param stock The vaccine's stock.
+ * @param lot The vaccine lot.
+ */
+void removeLotFromSite(SiteStock *stock, VaccineLot *lot) {
+  SiteShelf *shelf = stock->shelves[lot->site];
+  int slot = lot->siteSlot;
+  shelf->available -= shelf->lotRemaining[slot];
+  stock->available -= shelf->lotRemaining[slot];
+  changeExpiringDoses(&stock->expiries, shelf->lotExpiry[slot],
+                      -shelf->lotRemaining[slot]);
+  int last = --shelf->lotCount;
+  if (slot != last) {
+    shelf->lots[slot] = shelf->lots[last];
+    shelf->lotExpiry[slot] = shelf->lotExpiry[last];
+    shelf->lotRemaining[slot] = shelf->lotRemaining[last];
+    shelf->lots[slot]->siteSlot = slot;
+  }
+}
+
+/**
+ * @brief Sets the doses a lot can still give, updating the counts of its
+ * site and of the vaccine.
+ *
+ * @param stock The vaccine's stock.
+ * @param lot The vaccine lot.
+ * @param remaining The doses the lot can still give.
+ */
+void setSiteRemaining(SiteStock *stock, VaccineLot *lot, int remaining) {
+  SiteShelf *shelf = stock->shelves[lot->site];
+  int change = remaining - shelf->lotRemaining[lot->siteSlot];
+  shelf->lotRemaining[lot->siteSlot] = remaining;
+  shelf->available += change;
+  stock->available += change;
+  changeExpiringDoses(&stock->expiries, shelf->lotExpiry[lot->siteSlot],
+                      change);
+}
+
+/**
+ * @brief Splits a trailing site argument off a command's last argument.
+ *
+ * Vaccine names are single tokens, so the site argument is the token after
+ * the name, and a name that itself starts with @ is never taken for one.
+ *
+ * @param text The last argument, cut before the site argument if it has one.
+ * @return char* The site argument after the mark, or NULL if there is none.
+ */
+char *splitSiteArgument(char *text) {
+  const unsigned char *classes = charClasses();
+  char *mark = strrchr(text, SITE_MARK);
+  // The mark must start the last token, after something else
+  if (mark == NULL || mark == text ||
+      !(classes[(unsigned char)mark[-1]] & CHAR_SPACE) ||
+      *skipToken(mark) != '\0')
+    return NULL;
+  char *end = mark;
+  while (end > text && (classes[(unsigned char)end[-1]] & CHAR_SPACE))
+    end--;
+  *end = '\0';
+  return mark + 1;
+}
+
+/**
+ * @brief Parses the digits of a site id.
+ *
+ * @param text The digits.
+ * @param length The number of digits.
+ * @param site Pointer to store the site id.
+ * @return int 1 if the id is valid, 0 otherwise.
+ */
+static int parseSiteDigits(const char *text, size_t length, int *site) {
+  if (length == 0 || length > 4)
+    return 0;
+  int value = 0;
+  for (size_t i = 0; i < length; i++) {
+    if (text[i] < '0' || text[i] > '9')
+      return 0;
+    value = value * 10 + (text[i] - '0');
+  }
+  *site = value;
+  return value < MAX_SITES;
+}
+
+/**
+ * @brief Parses a site id.
+ *
+ * @param text The site id in decimal.
+ * @param site Pointer to store the site id.
+ * @return int 1 if the id is valid, 0 otherwise.
+ */
+int parseSiteId(const char *text, int *site) {
+  return parseSiteDigits(text, strlen(text), site);
+}
+
+/**
+ * @brief Parses a comma-separated list of site ids.
+ *
+ * @param text The list.
+ * @param sites Pointer to store the sites.
+ * @param scratch The per-command scratch arena for the ids.
+ * @return int 1 if every id is valid, 0 otherwise.
+ */
+int parseSiteList(const char *text, SiteList *sites, ScratchArena *scratch) {
+  int count = 1;
+  for (const char *c = text; *c != '\0'; c++)
+    count += *c == ',';
+  sites->sites = (int *)arenaAlloc(scratch, (size_t)count * sizeof(int));
+  sites->count = count;
+  for (int i = 0; i < count; i++) {
+    size_t length = strcspn(text, ",");
+    if (!parseSiteDigits(text, length, &sites->sites[i]))
+      return 0;
+    text += length + 1;
+  }
+  return 1;
+}
+
+/**
+ * @brief Frees the memory used by a vaccine's stock.
+ *
+ * @param stock The vaccine's stock.
+ */
+void freeSiteStock(SiteStock *stock) {
+  for (int i = 0; i < stock->siteCount; i++) {
+    SiteShelf *shelf = stock->shelves[i];
+    if (shelf == NULL)
+      continue;
+    free(shelf->lots);
+    free(shelf->lotExpiry);
+    free(shelf->lotRemaining);
+    free(shelf);
+  }
+  free(stock->shelves);
+  freeExpiryCalendar(&stock->expiries);
+  initializeSiteStock(stock);
+}
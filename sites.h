@@ -0,0 +1,130 @@
+/**
+ * @file sites.h
+ * @brief Header file for the multi-site inventory.
+ *
+ * This file contains the declarations of the per-site stock of a vaccine:
+ * every lot belongs to a vaccination site, and each site keeps its own shelf
+ * of the vaccine's lots with the same mirrored expiry and remaining doses the
+ * vaccine's name entry keeps, so a first-expiry-first-out pick can scan one
+ * site only. Shelves are indexed by site id, and the doses still available
+ * per site and overall, and per expiry day, are updated as lots change.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef SITES_H
+#define SITES_H
+
+#include "arena.h"
+#include "forecast.h"
+
+#define MAX_SITES 1000 // Site ids go from 0 to MAX_SITES - 1
+#define SITE_MARK '@'  // Starts the site argument of c, a and l
+
+// Structure for the lots of a vaccine at one site
+typedef struct {
+  struct VaccineLot **lots;  // Lots at the site, in no particular order
+  int *lotExpiry;            // Day number of each lot's validation date
+  int *lotRemaining;         // Doses each lot can still give (0 if removed)
+  int lotCount;              // Number of lots at the site
+  int capacity;              // Current capacity of the arrays
+  long available;            // Sum of lotRemaining
+} SiteShelf;
+
+// Structure for the stock of a vaccine across sites
+typedef struct {
+  SiteShelf **shelves;       // Shelf of each site id, or NULL if it has none
+  int siteCount;             // Number of site ids covered by shelves
+  long available;            // Doses all sites can still give
+  ExpiryCalendar expiries;   // Doses all sites can still give per expiry day
+} SiteStock;
+
+// Structure for the sites a dose may come from, in order of preference
+typedef struct {
+  int *sites;                // Site ids
+  int count;                 // Number of sites
+} SiteList;
+
+/**
+ * @brief Initializes a vaccine's stock with no sites.
+ *
+ * @param stock The vaccine's stock.
+ */
+void initializeSiteStock(SiteStock *stock);
+
+/**
+ * @brief Finds the shelf of a site.
+ *
+ * @param stock The vaccine's stock.
+ * @param site The site id.
+ * @return const SiteShelf* The shelf, or NULL if the site has no lots of the
+ * vaccine.
+ */
+const SiteShelf *findSiteShelf(const SiteStock *stock, int site);
+
+/**
+ * @brief Puts a lot on the shelf of its site, with no doses counted yet.
+ *
+ * @param stock The vaccine's stock.
+ * @param lot The vaccine lot.
+ */
+void addLotToSite(SiteStock *stock, struct VaccineLot *lot);
+
+/**
+ * @brief Takes a lot off the shelf of its site, moving the shelf's last lot
+ * into its place.
+ *
+ * @param stock The vaccine's stock.
+ * @param lot The vaccine lot.
+ */
+void removeLotFromSite(SiteStock *stock, struct VaccineLot *lot);
+
+/**
+ * @brief Sets the doses a lot can still give, updating the counts of its
+ * site and of the vaccine.
+ *
+ * @param stock The vaccine's stock.
+ * @param lot The vaccine lot.
+ * @param remaining The doses the lot can still give.
+ */
+void setSiteRemaining(SiteStock *stock, struct VaccineLot *lot,
+                      int remaining);
+
+/**
+ * @brief Splits a trailing site argument off a command's last argument.
+ *
+ * Vaccine names are single tokens, so the site argument is the token after
+ * the name, and a name that itself starts with @ is never taken for one.
+ *
+ * @param text The last argument, cut before the site argument if it has one.
+ * @return char* The site argument after the mark, or NULL if there is none.
+ */
+char *splitSiteArgument(char *text);
+
+/**
+ * @brief Parses a site id.
+ *
+ * @param text The site id in decimal.
+ * @param site Pointer to store the site id.
+ * @return int 1 if the id is valid, 0 otherwise.
+ */
+int parseSiteId(const char *text, int *site);
+
+/**
+ * @brief Parses a comma-separated list of site ids.
+ *
+ * @param text The list.
+ * @param sites Pointer to store the sites.
+ * @param scratch The per-command scratch arena for the ids.
+ * @return int 1 if every id is valid, 0 otherwise.
+ */
+int parseSiteList(const char *text, SiteList *sites, ScratchArena *scratch);
+
+/**
+ * @brief Frees the memory used by a vaccine's stock.
+ *
+ * @param stock The vaccine's stock.
+ */
+void freeSiteStock(SiteStock *stock);
+
+#endif
@@ -0,0 +1,220 @@
+/**
+ * @file sketch.c
+ * @brief Implementation of HyperLogLog distinct-count sketches.
+ *
+ * Each sketch has 2^SKETCH_PRECISION one-byte registers, so it takes 1 KB
+ * and estimates with a relative standard error of 1.04 / sqrt(registers).
+ * Sketches are merged by taking the maximum of each register, which makes
+ * the sketch of a range of days the merge of its daily sketches.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#include "sketch.h"
+#include "alloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Hashes a user name into the 64-bit value fed to the sketches.
+ *
+ * Uses FNV-1a followed by a 64-bit finalizer so that every bit of the hash
+ * depends on every byte of the name.
+ *
+ * @param userName The user name.
+ * @return unsigned long long The hash value.
+ */
+unsigned long long hashUserName64(const char *userName) {
+  unsigned long long hash = 14695981039346656037ULL;
+  for (const unsigned char *c = (const unsigned char *)userName; *c; c++) {
+    hash ^= *c;
+    hash *= 1099511628211ULL;
+  }
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+/**
+ * @brief Adds a hash value to a sketch.
+ *
+ * @param sketch The sketch.
+ * @param hash The hash value.
+ */
+static void sketchAdd(HyperLogLog *sketch, unsigned long long hash) {
+  unsigned int index = (unsigned int)(hash >> (64 - SKETCH_PRECISION));
+  unsigned long long rest = hash << SKETCH_PRECISION;
+  // Rank of the first set bit in the remaining bits (capped if all are 0)
+  unsigned char rank = rest ? (unsigned char)(__builtin_clzll(rest) + 1)
+                            : (unsigned char)(64 - SKETCH_PRECISION + 1);
+  if (rank > sketch->registers[index])
+    sketch->registers[index] = rank;
+}
+
+/**
+ * @brief Initializes an empty sketch series.
+ *
+ * @param series The sketch series.
+ */
+void initializeSketchSeries(SketchSeries *series) {
+  series->days = NULL;
+  series->daily = NULL;
+  series->count = 0;
+  series->capacity = 0;
+  memset(&series->total, 0, sizeof(HyperLogLog));
+  series->savedEpoch = 0;
+}
+
+/**
+ * @brief Appends an empty daily sketch to a series.
+ *
+ * @param series The sketch series.
+ * @param day The day number of the new sketch.
+ */
+static void appendDailySketch(SketchSeries *series, int day) {
+  if (series->count >= series->capacity) {
+    int newCapacity = series->capacity ? series->capacity * 2 : 4;
+    series->days =
+        (int *)reallocateOrExit(series->days, newCapacity * sizeof(int));
+    series->daily = (HyperLogLog *)reallocateOrExit(
+        series->daily, newCapacity * sizeof(HyperLogLog));
+    series->capacity = newCapacity;
+  }
+  series->days[series->count] = day;
+  memset(&series->daily[series->count], 0, sizeof(HyperLogLog));
+  series->count++;
+}
+
+/**
+ * @brief Adds a hashed user to a series on a given day.
+ *
+ * @param series The sketch series.
+ * @param day The day number of the dose.
+ * @param hash The user's hash value.
+ */
+void sketchSeriesAdd(SketchSeries *series, int day, unsigned long long hash) {
+  if (series->count == 0 || series->days[series->count - 1] != day)
+    appendDailySketch(series, day);
+  sketchAdd(&series->daily[series->count - 1], hash);
+  sketchAdd(&series->total, hash);
+}
+
+/**
+ * @brief Finds the first daily sketch on or after a day.
+ *
+ * @param series The sketch series.
+ * @param day The day number.
+ * @return int The index of the sketch, or count if there is none.
+ */
+static int lowerBoundDay(const SketchSeries *series, int day) {
+  int low = 0, high = series->count;
+  while (low < high) {
+    int mid = low + (high - low) / 2;
+    if (series->days[mid] < day)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
+/**
+ * @brief Merges the daily sketches of a range of days.
+ *
+ * @param series The sketch series.
+ * @param fromDay The first day number of the range.
+ * @param toDay The last day number of the range.
+ * @param merged The sketch to merge into.
+ */
+void sketchSeriesMergeRange(const SketchSeries *series, int fromDay, int toDay,
+                            HyperLogLog *merged) {
+  for (int i = lowerBoundDay(series, fromDay);
+       i < series->count && series->days[i] <= toDay; i++) {
+    sketchMerge(merged, &series->daily[i]);
+  }
+}
+
+/**
+ * @brief Merges a sketch into another, register by register.
+ *
+ * @param target The sketch to merge into.
+ * @param source The sketch to merge.
+ */
+void sketchMerge(HyperLogLog *target, const HyperLogLog *source) {
+  for (int i = 0; i < SKETCH_REGISTERS; i++) {
+    if (source->registers[i] > target->registers[i])
+      target->registers[i] = source->registers[i];
+  }
+}
+
+/**
+ * @brief Computes the natural logarithm of a number not smaller than 1.
+ *
+ * The number is scaled into [1, 2) by powers of two, where the series
+ * ln(m) = 2 * (y + y^3 / 3 + y^5 / 5 + ...), y = (m - 1) / (m + 1),
+ * converges quickly.
+ *
+ * @param x The number.
+ * @return double The natural logarithm of x.
+ */
+static double naturalLog(double x) {
+  int powers = 0;
+  while (x >= 2) {
+    x /= 2;
+    powers++;
+  }
+  double y = (x - 1) / (x + 1), term = y, sum = 0;
+  for (int k = 1; k < 40; k += 2, term *= y * y)
+    sum += term / k;
+  return powers * 0.69314718055994531 + 2 * sum;
+}
+
+/**
+ * @brief Estimates the number of distinct values added to a sketch.
+ *
+ * Uses the raw HyperLogLog estimate, switching to linear counting while
+ * registers are still empty and the estimate is small.
+ *
+ * @param sketch The sketch.
+ * @return double The estimated cardinality.
+ */
+double sketchEstimate(const HyperLogLog *sketch) {
+  double registers = SKETCH_REGISTERS;
+  double sum = 0;
+  int zeros = 0;
+  for (int i = 0; i < SKETCH_REGISTERS; i++) {
+    unsigned char rank = sketch->registers[i];
+    sum += 1.0 / (double)(1ULL << rank);
+    zeros += rank == 0;
+  }
+  double alpha = 0.7213 / (1.0 + 1.079 / registers);
+  double estimate = alpha * registers * registers / sum;
+  if (estimate <= 2.5 * registers && zeros > 0)
+    estimate = registers * naturalLog(registers / zeros);
+  return estimate;
+}
+
+/**
+ * @brief Gets the relative standard error of the sketch estimates.
+ *
+ * @return double The relative standard error.
+ */
+double sketchStandardError(void) {
+  // 1.04 / sqrt(registers), with sqrt(1024) = 32
+  return 1.04 / (double)(1 << (SKETCH_PRECISION / 2));
+}
+
+/**
+ * @brief Frees the memory used by a sketch series.
+ *
+ * @param series The sketch series.
+ */
+void freeSketchSeries(SketchSeries *series) {
+  free(series->days);
+  free(series->daily);
+  initializeSketchSeries(series);
+}
@@ -0,0 +1,101 @@
+/**
+ * @file sketch.h
+ * @brief Header file for HyperLogLog distinct-count sketches.
+ *
+ * This file contains the declarations of the HyperLogLog sketches used to
+ * estimate the number of distinct users vaccinated, and of the day-indexed
+ * series of sketches that can be merged over any range of days.
+ *
+ * Author: Vicente B. Duarte
+ */
+
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#define SKETCH_PRECISION 10
+#define SKETCH_REGISTERS (1 << SKETCH_PRECISION)
+
+// Structure for a HyperLogLog sketch
+typedef struct {
+  unsigned char registers[SKETCH_REGISTERS]; // Highest rank seen per register
+} HyperLogLog;
+
+// Structure for a sketch per day plus a running total, in day order
+typedef struct {
+  int *days;                // Day number of each daily sketch, ascending
+  HyperLogLog *daily;       // Daily sketches
+  int count;                // Number of daily sketches
+  int capacity;             // Current capacity of the daily arrays
+  HyperLogLog total;        // Sketch of every day merged
+  unsigned long savedEpoch; // Branch epoch of the last saved copy (0 if none)
+} SketchSeries;
+
+/**
+ * @brief Hashes a user name into the 64-bit value fed to the sketches.
+ *
+ * @param userName The user name.
+ * @return unsigned long long The hash value.
+ */
+unsigned long long hashUserName64(const char *userName);
+
+/**
+ * @brief Initializes an empty sketch series.
+ *
+ * @param series The sketch series.
+ */
+void initializeSketchSeries(SketchSeries *series);
+
+/**
+ * @brief Adds a hashed user to a series on a given day.
+ *
+ * Days must be added in non-decreasing order, which holds because doses are
+ * always applied on the current date.
+ *
+ * @param series The sketch series.
+ * @param day The day number of the dose.
+ * @param hash The user's hash value.
+ */
+void sketchSeriesAdd(SketchSeries *series, int day, unsigned long long hash);
+
+/**
+ * @brief Merges the daily sketches of a range of days.
+ *
+ * @param series The sketch series.
+ * @param fromDay The first day number of the range.
+ * @param toDay The last day number of the range.
+ * @param merged The sketch to merge into.
+ */
+void sketchSeriesMergeRange(const SketchSeries *series, int fromDay, int toDay,
+                            HyperLogLog *merged);
+
+/**
+ * @brief Merges a sketch into another, register by register.
+ *
+ * @param target The sketch to merge into.
+ * @param source The sketch to merge.
+ */
+void sketchMerge(HyperLogLog *target, const HyperLogLog *source);
+
+/**
+ * @brief Estimates the number of distinct values added to a sketch.
+ *
+ * @param sketch The sketch.
+ * @return double The estimated cardinality.
+ */
+double sketchEstimate(const HyperLogLog *sketch);
+
+/**
+ * @brief Gets the relative standard error of the sketch estimates.
+ *
+ * @return double The relative standard error.
+ */
+double sketchStandardError(void);
+
+/**
+ * @brief Frees the memory used by a sketch series.
+ *
+ * @param series The sketch series.
+ */
+void freeSketchSeries(SketchSeries *series);
+
+#endif
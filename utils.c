@@ -8,9 +8,9 @@
  * Author: Vicente B. Duarte
  */
 
+#include "charclass.h"
 #include "constants.h"
 #include "project.h"
-#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -22,18 +22,14 @@
  * @return int 1 if the batch is valid, 0 otherwise.
  */
 int isValidBatch(const char *batch) {
-  int length = strlen(batch);
-  if (length > 20) {
-    return 0; // Batch with more than 20 digits
-  }
-
-  for (int i = 0; i < length; i++) {
-    // Valid characters are digits (0-9) or uppercase hexadecimal letters (A-F)
-    if (!(isdigit(batch[i]) || (batch[i] >= 'A' && batch[i] <= 'F'))) {
-      return 0; // Character is not an uppercase hexadecimal digit
-    }
-  }
-  return 1;
+  const unsigned char *classes = charClasses();
+  int length = 0;
+  // Valid characters are digits (0-9) or uppercase hexadecimal letters (A-F)
+  while (length <= MAX_BATCH_LENGTH &&
+         (classes[(unsigned char)batch[length]] & CHAR_BATCH))
+    length++;
+  // Stopped at the end, not at a bad character or past 20 digits
+  return batch[length] == '\0' && length <= MAX_BATCH_LENGTH;
 }
 
 /**
@@ -44,17 +40,13 @@ int isValidBatch(const char *batch) {
  * @return int 1 if the name is valid, 0 otherwise.
  */
 int isValidName(const char *name) {
-  int length = strlen(name);
-  if (length > 50) {
-    return 0; // Name with more than 50 bytes
-  }
-
-  for (int i = 0; i < length; i++) {
-    if (isspace(name[i])) {
-      return 0; // Name contains whitespace
-    }
-  }
-  return 1;
+  const unsigned char *classes = charClasses();
+  int length = 0;
+  while (length <= MAX_NAME_LENGTH &&
+         !(classes[(unsigned char)name[length]] & CHAR_DELIMITER))
+    length++;
+  // Stopped at the end, not at whitespace or past 50 bytes
+  return name[length] == '\0' && length <= MAX_NAME_LENGTH;
 }
 
 /**
@@ -144,3 +136,115 @@ unsigned int hashBatch(const char *batch, int size) {
 
   return hash % size;
 }
+
+/**
+ * @brief Parses a DD-MM-YYYY date and checks that it is a calendar day.
+ *
+ * @param str The date string.
+ * @param date Pointer to store the parsed date.
+ * @return int 1 if the string is a valid date, 0 otherwise.
+ */
+int parseCalendarDate(const char *str, Date *date) {
+  return sscanf(str, "%d-%d-%d", &date->day, &date->month, &date->year) == 3 &&
+         isMonthValid(date->month) &&
+         isDayValid(date->day, date->month, date->year);
+}
+
+/**
+ * @brief Converts a date into a day number (days since 01-01-0000).
+ *
+ * Day numbers increase by one per calendar day, so the difference between two
+ * day numbers is the number of days between the corresponding dates.
+ *
+ * @param date The date to convert.
+ * @return int The day number.
+ */
+int dateToDayNumber(Date date) {
+  int year = date.year - (date.month <= 2);
+  int era = year / 400;
+  int yearOfEra = year - era * 400;
+  int monthIndex = (date.month + 9) % 12; // March is month 0
+  int dayOfYear = (153 * monthIndex + 2) / 5 + date.day - 1;
+  int dayOfEra =
+      yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  return era * 146097 + dayOfEra;
+}
+
+/**
+ * @brief Converts a day number back into a date.
+ *
+ * @param dayNumber The day number, as returned by dateToDayNumber.
+ * @return Date The corresponding date.
+ */
+Date dayNumberToDate(int dayNumber) {
+  int era = dayNumber / 146097;
+  int dayOfEra = dayNumber - era * 146097;
+  int yearOfEra =
+      (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+  int dayOfYear =
+      dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+  int monthIndex = (5 * dayOfYear + 2) / 153;
+  Date date;
+  date.day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+  date.month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+  date.year = era * 400 + yearOfEra + (date.month <= 2);
+  return date;
+}
+
+/**
+ * @brief Merges two sorted runs of pointers.
+ *
+ * @param array The array holding both runs.
+ * @param temp Scratch array with the same size.
+ * @param low The first index of the left run.
+ * @param mid The last index of the left run.
+ * @param high The last index of the right run.
+ * @param compare The comparison function.
+ */
+static void mergeRuns(void **array, void **temp, int low, int mid, int high,
+                      int (*compare)(const void *, const void *)) {
+  int i = low, j = mid + 1, k = low;
+  while (i <= mid && j <= high)
+    temp[k++] = compare(array[j], array[i]) < 0 ? array[j++] : array[i++];
+  while (i <= mid)
+    temp[k++] = array[i++];
+  while (j <= high)
+    temp[k++] = array[j++];
+  memcpy(array + low, temp + low, (high - low + 1) * sizeof(void *));
+}
+
+/**
+ * @brief Recursive step of the merge sort of pointers.
+ *
+ * @param array The array to sort.
+ * @param temp Scratch array with the same size.
+ * @param low The first index of the range.
+ * @param high The last index of the range.
+ * @param compare The comparison function.
+ */
+static void mergeSortPointers(void **array, void **temp, int low, int high,
+                              int (*compare)(const void *, const void *)) {
+  if (low >= high)
+    return;
+  int mid = low + (high - low) / 2;
+  mergeSortPointers(array, temp, low, mid, compare);
+  mergeSortPointers(array, temp, mid + 1, high, compare);
+  mergeRuns(array, temp, low, mid, high, compare);
+}
+
+/**
+ * @brief Sorts an array of pointers with a stable merge sort.
+ *
+ * @param array The array to sort.
+ * @param count The number of pointers.
+ * @param compare The comparison function, called with the pointers.
+ * @param scratch The per-command scratch arena.
+ */
+void sortPointers(void **array, int count,
+                  int (*compare)(const void *, const void *),
+                  ScratchArena *scratch) {
+  if (count < 2)
+    return;
+  void **temp = (void **)arenaAlloc(scratch, count * sizeof(void *));
+  mergeSortPointers(array, temp, 0, count - 1, compare);
+}